@@ -0,0 +1,180 @@
+#include "AdaptiveQuality.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "DirectionPipeline.h"
+#include "RealtimeThread.h"
+#include "SignalGenerator.h"
+
+const char* QualityTierName(QualityTier tier)
+{
+	switch (tier) {
+	case QualityTier::Full: return "completa";
+	case QualityTier::FewerBands: return "menos bandas";
+	case QualityTier::Decimated: return "decimada";
+	case QualityTier::Broadband: return "banda larga";
+	default: return "?";
+	}
+}
+
+QualityGovernor::QualityGovernor(QualityPolicy policy)
+	: settings(policy), upshiftWait(policy.upshiftBlocks)
+{
+	// Used as a modulus by the pipeline: 1 is the least decimation there is
+	settings.decimation = std::max(1u, settings.decimation);
+}
+
+void QualityGovernor::reset()
+{
+	*this = QualityGovernor(settings);
+}
+
+bool QualityGovernor::update(std::uint64_t processingNs, std::uint64_t audioNs, std::uint64_t lagNs)
+{
+	if (audioNs == 0) return false;
+	const float blockLoad = static_cast<float>(processingNs) / static_cast<float>(audioNs);
+	smoothedLoad = primed ? smoothedLoad + settings.smoothing * (blockLoad - smoothedLoad) : blockLoad;
+	primed = true;
+	++sinceChange;
+
+	const int level = static_cast<int>(current);
+	const int cheapest = static_cast<int>(QualityTier::Count) - 1;
+	const bool queueing = lagNs > static_cast<std::uint64_t>(settings.maxLagSec * 1e9);
+
+	if ((smoothedLoad > settings.downshiftLoad || queueing) && level < cheapest && sinceChange >= settings.downshiftBlocks) {
+		// Undoing a recent step up: that tier is not affordable yet, wait longer next time
+		if (lastWasUpshift && sinceChange < upshiftWait) upshiftWait = std::min<std::uint64_t>(upshiftWait * 2, 32ull * settings.upshiftBlocks);
+		current = static_cast<QualityTier>(level + 1);
+		sinceChange = 0;
+		lastWasUpshift = false;
+		return true;
+	}
+	if (smoothedLoad < settings.upshiftLoad && !queueing && level > 0 && sinceChange >= upshiftWait) {
+		// A step up that held for a full wait earns back the short wait
+		if (lastWasUpshift) upshiftWait = settings.upshiftBlocks;
+		current = static_cast<QualityTier>(level - 1);
+		sinceChange = 0;
+		lastWasUpshift = true;
+		return true;
+	}
+	return false;
+}
+
+namespace
+{
+	// Hands out generator packets on the device schedule, stamped with when each was
+	// due; a consumer that falls behind gets them late instead of being waited for.
+	class PacedSource : public CaptureSource
+	{
+	public:
+		PacedSource(CaptureSource& inner, std::uint64_t startNs) : inner(inner), startNs(startNs) {}
+
+		AudioFormat format() const override { return inner.format(); }
+		bool nextPacket(CapturePacket& packet) override
+		{
+			const std::uint64_t dueNs = startNs + position * 1000000000ull / format().sampleRate;
+			const std::uint64_t now = SteadyNowNs();
+			if (now < dueNs) std::this_thread::sleep_for(std::chrono::nanoseconds(dueNs - now));
+			if (!inner.nextPacket(packet)) return false;
+			packet.readyNs = dueNs;
+			position += packet.frameCount;
+			lastReadyNs = dueNs;
+			return true;
+		}
+
+		std::uint64_t lastReady() const { return lastReadyNs; }
+
+	private:
+		CaptureSource& inner;
+		std::uint64_t startNs;
+		std::uint64_t position = 0;
+		std::uint64_t lastReadyNs = 0;
+	};
+
+	struct ContentionRun
+	{
+		std::vector<double> backlogSec; // worst backlog in each second of audio
+		PipelineStats stats;
+	};
+
+	ContentionRun RunUnderContention(double seconds, int busyThreads, bool adaptive)
+	{
+		ContentionRun run;
+		std::atomic<bool> stop = false;
+
+		// Everything on one CPU, so busyThreads sets the analysis thread's share whatever the machine
+		RealtimeOptions pin;
+		pin.cpus = { 0 };
+		std::vector<std::thread> hogs;
+		for (int i = 0; i < busyThreads; ++i) {
+			hogs.emplace_back([&stop, &pin] {
+				ApplyRealtimeOptions(pin);
+				volatile std::uint64_t spin = 0;
+				while (!stop.load(std::memory_order_relaxed)) spin = spin + 1;
+			});
+		}
+
+		std::thread analysis([&] {
+			ApplyRealtimeOptions(pin);
+			SignalGenerator generator({ 8, 48000 }, MakeScene("mixed"), seconds);
+			PacedSource source(generator, SteadyNowNs());
+			DirectionPipeline pipeline(source);
+			pipeline.setMultiSource(4);
+			pipeline.setAdaptiveQuality(adaptive);
+
+			const std::uint64_t framesPerSecond = generator.format().sampleRate;
+			while (pipeline.step()) {
+				const double backlog = (SteadyNowNs() - source.lastReady()) / 1e9;
+				const std::size_t second = static_cast<std::size_t>(pipeline.stats().frames / framesPerSecond);
+				if (run.backlogSec.size() <= second) run.backlogSec.resize(second + 1, 0.0);
+				run.backlogSec[second] = std::max(run.backlogSec[second], backlog);
+				// A backlog longer than the whole scene only keeps growing; no need to wait it out
+				if (backlog > seconds) break;
+			}
+			run.stats = pipeline.stats();
+		});
+
+		analysis.join();
+		stop = true;
+		for (auto& hog : hogs) hog.join();
+		return run;
+	}
+
+	void PrintContentionRun(const char* name, const ContentionRun& run)
+	{
+		std::cout << name << ":\n  atraso acumulado por segundo (ms):";
+		for (const double backlog : run.backlogSec) std::cout << ' ' << static_cast<int>(backlog * 1000.0);
+		std::cout << "\n  carga " << run.stats.qualityLoad << ", " << run.stats.tierDowngrades << " descidas e "
+			<< run.stats.tierUpgrades << " subidas de nivel; quadros por nivel:";
+		for (int tier = 0; tier < static_cast<int>(QualityTier::Count); ++tier) {
+			std::cout << ' ' << QualityTierName(static_cast<QualityTier>(tier)) << '=' << run.stats.tierFrames[tier];
+		}
+		std::cout << "\n  latencia de decisao: ";
+		run.stats.decisionLatencyUs.print(std::cout, "us");
+	}
+}
+
+bool CheckAdaptiveQuality(double seconds, int busyThreads)
+{
+	std::cout << "7.1 com localizacao multi-fonte em tempo real, " << busyThreads << " threads ocupadas na mesma CPU, "
+		<< seconds << " s\n";
+	const ContentionRun fixed = RunUnderContention(seconds, busyThreads, false);
+	PrintContentionRun("Qualidade fixa", fixed);
+	const ContentionRun adaptive = RunUnderContention(seconds, busyThreads, true);
+	PrintContentionRun("Qualidade adaptativa", adaptive);
+
+	// Bounded: once the governor has settled (second half), audio never waits long
+	const std::size_t half = adaptive.backlogSec.size() / 2;
+	double worst = 0.0;
+	for (std::size_t i = half; i < adaptive.backlogSec.size(); ++i) worst = std::max(worst, adaptive.backlogSec[i]);
+	const bool complete = adaptive.stats.frames >= static_cast<std::uint64_t>(seconds * 48000) - 480;
+	const bool ok = complete && worst < 0.25;
+	std::cout << (ok ? "OK" : "FALHOU") << ": atraso maximo na segunda metade " << worst * 1000.0 << " ms (limite 250 ms)\n";
+	return ok;
+}
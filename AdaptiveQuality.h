@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+
+// Analysis cost levels, cheapest last. The level (broadband energy) cue runs at every
+// tier; the FFT stages (GCC-PHAT, multi-source) lose detail step by step.
+enum class QualityTier : std::uint8_t
+{
+	Full,       // as configured
+	FewerBands, // FFT stages only look at bins up to bandLimitHz
+	Decimated,  // ... and transform one packet in decimation
+	Broadband,  // level cue only; the FFT stages just keep their history current
+	Count
+};
+
+const char* QualityTierName(QualityTier tier);
+
+struct QualityPolicy
+{
+	float downshiftLoad = 0.7f;        // smoothed processing time / audio time that costs a tier
+	float upshiftLoad = 0.3f;          // below this a tier is won back
+	float maxLagSec = 0.1f;            // audio that waited longer than this costs a tier at once
+	float smoothing = 0.05f;           // weight of the newest block in the load average
+	unsigned int downshiftBlocks = 5;  // blocks between two downshifts, so the average can follow
+	unsigned int upshiftBlocks = 100;  // calm blocks before stepping up; doubles when a step up fails
+	float bandLimitHz = 4000.0f;
+	unsigned int decimation = 4;       // 0 is taken as 1
+};
+
+// Tracks how much of each block's duration its analysis took and moves between tiers:
+// down quickly when headroom is gone or audio starts queueing, up slowly once it is
+// back. A step up that is undone soon after makes the next one wait twice as long, so
+// a machine that can only just afford a tier does not flap around it.
+class QualityGovernor
+{
+public:
+	explicit QualityGovernor(QualityPolicy policy = {});
+
+	// One analyzed block: wall time spent on it, the audio it covers, and how long that
+	// audio had been waiting when analysis picked it up. Returns true when the tier changed.
+	bool update(std::uint64_t processingNs, std::uint64_t audioNs, std::uint64_t lagNs);
+	void reset();
+
+	QualityTier tier() const { return current; }
+	float load() const { return smoothedLoad; }
+	const QualityPolicy& policy() const { return settings; }
+
+private:
+	QualityPolicy settings;
+	QualityTier current = QualityTier::Full;
+	float smoothedLoad = 0.0f;
+	bool primed = false;
+	std::uint64_t sinceChange = 0;     // blocks since the last tier change
+	std::uint64_t upshiftWait;         // current calm blocks required to step up
+	bool lastWasUpshift = false;
+};
+
+// Plays a generated 7.1 scene in real time through the pipeline with multi-source
+// tracking while busyThreads spin on the same CPU, once at fixed quality and once
+// adaptive, and reports the backlog and tier changes. Passes when the adaptive run
+// keeps its backlog bounded.
+bool CheckAdaptiveQuality(double seconds, int busyThreads);
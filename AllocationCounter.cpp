@@ -0,0 +1,211 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "DirectionPipeline.h"
+#include "DirectionTimeline.h"
+#include "EventStreamServer.h"
+#include "FrameBus.h"
+#include "RecordingWriter.h"
+#include "SharedDirectionState.h"
+#include "SignalGenerator.h"
+
+#ifdef AVIS_COUNT_ALLOCATIONS
+
+namespace
+{
+	std::atomic<std::uint64_t> g_allocations{ 0 };
+
+	void* countedAlloc(std::size_t size)
+	{
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size ? size : 1);
+	}
+
+	void* countedAlignedAlloc(std::size_t size, std::align_val_t align)
+	{
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		const auto alignment = static_cast<std::size_t>(align);
+#ifdef _WIN32
+		return _aligned_malloc(size ? size : 1, alignment);
+#else
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+	}
+
+	void alignedFree(void* p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* p = countedAlloc(size)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	if (void* p = countedAlloc(size)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+	if (void* p = countedAlignedAlloc(size, align)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+	if (void* p = countedAlignedAlloc(size, align)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+bool AllocationCountingEnabled() { return true; }
+std::uint64_t AllocationCount() { return g_allocations.load(std::memory_order_relaxed); }
+
+#else
+
+bool AllocationCountingEnabled() { return false; }
+std::uint64_t AllocationCount() { return 0; }
+
+#endif
+
+namespace
+{
+	struct AllocationScenario
+	{
+		const char* name;
+		int channels;
+		bool allOptions;   // onset gating, multi-source, fixed window, adaptive quality, SHM and event publishers
+	};
+
+	// generator -> FrameBus -> analyzer pipeline + timeline + WAV recorder, as the live
+	// recorder runs them; returns the allocations made after warmUpSec
+	std::uint64_t RunAllocationScenario(const AllocationScenario& scenario, double durationSec, double warmUpSec, std::uint64_t& packets)
+	{
+		const std::string timelinePath = "alloc-check.avtl";
+		const std::string wavPath = "alloc-check.wav";
+		const std::string socketPath = "alloc-check.sock";
+
+		SignalGenerator generator({ scenario.channels, 48000 }, MakeScene("mixed"), durationSec);
+		const AudioFormat format = generator.format();
+		FrameBus bus(format, 1024, 64);
+		auto analysis = bus.subscribe(16, OverflowPolicy::DropOldest);
+		// The generator runs faster than real time: the recorder may hold it up here
+		auto recording = bus.subscribe(32, OverflowPolicy::Block);
+
+		TimelineWriter timeline(timelinePath, format.channels);
+		RecordingWriter writer(wavPath, format.channels, format.sampleRate);
+		std::atomic<int> direction = 0;
+
+		PipelineOptions options;
+		options.timeline = &timeline;
+		std::unique_ptr<DirectionStatePublisher> publisher;
+		std::unique_ptr<EventStreamServer> events;
+		if (scenario.allOptions) {
+			options.onsetGating = true;
+			options.multiSource = 3;
+			options.windowMs = 20.0f;
+			options.adaptiveQuality = true;
+			publisher = std::make_unique<DirectionStatePublisher>("avis-alloc-check");
+			options.publisher = publisher.get();
+			try {
+				events = std::make_unique<EventStreamServer>(socketPath);
+				options.events = events.get();
+			} catch (const std::exception& e) {
+				std::cout << "  (sem servidor de eventos: " << e.what() << ")\n";
+			}
+		}
+
+		// Each consumer sets up everything it needs before the pump starts counting
+		SubscriptionSource analysisSource(analysis, format);
+		SubscriptionSource recordingSource(recording, format);
+		DirectionPipeline pipeline(analysisSource, &direction);
+		pipeline.configure(options);
+
+		std::thread analyzer([&] { pipeline.runToEnd(); });
+		std::thread recorder([&] {
+			CapturePacket packet;
+			while (recordingSource.nextPacket(packet)) writer.write(packet.samples, packet.frameCount);
+		});
+
+		const auto warmUpFrames = static_cast<std::uint64_t>(warmUpSec * format.sampleRate);
+		std::uint64_t published = 0;
+		std::uint64_t before = 0;
+		bool counting = false;
+
+		CapturePacket packet;
+		while (generator.nextPacket(packet)) {
+			bus.publish(packet);
+			published += packet.frameCount;
+			if (!counting && published >= warmUpFrames) {
+				before = AllocationCount();
+				counting = true;
+			}
+		}
+		const std::uint64_t during = AllocationCount() - before;
+		bus.close();
+
+		analyzer.join();
+		recorder.join();
+		if (events) events->stop();
+		timeline.close();
+		writer.close();
+		std::remove(timelinePath.c_str());
+		std::remove(wavPath.c_str());
+
+		packets = pipeline.stats().packets;
+		return during;
+	}
+}
+
+bool CheckSteadyStateAllocations(double durationSec, double warmUpSec)
+{
+	if (!AllocationCountingEnabled()) {
+		std::cerr << "Contagem de alocacoes indisponivel: compile com AVIS_COUNT_ALLOCATIONS\n";
+		return false;
+	}
+
+	// Stereo takes the GCC-PHAT path; the option runs cover every mode documented as allocation-free
+	const AllocationScenario scenarios[] = {
+		{ "8 canais", 8, false },
+		{ "estereo", 2, false },
+		{ "8 canais, todas as opcoes", 8, true },
+		{ "estereo, todas as opcoes", 2, true },
+	};
+
+	bool ok = true;
+	std::cout << "Alocacoes apos aquecimento (" << durationSec - warmUpSec << " s de audio):\n";
+	for (const auto& scenario : scenarios) {
+		std::uint64_t packets = 0;
+		const std::uint64_t during = RunAllocationScenario(scenario, durationSec, warmUpSec, packets);
+		std::cout << "  " << scenario.name << ": " << during << " (" << packets << " pacotes analisados)\n";
+		ok = ok && during == 0;
+	}
+	return ok;
+}
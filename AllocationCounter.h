@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+// Counts heap allocations made through operator new. Counting is compiled in only
+// when AVIS_COUNT_ALLOCATIONS is defined (Debug builds); otherwise the functions
+// below report zero and AllocationCountingEnabled() is false.
+bool AllocationCountingEnabled();
+std::uint64_t AllocationCount();
+
+// Runs generator -> FrameBus -> analyzer pipeline + timeline + WAV recorder, for 8
+// channels and stereo, with default options and with every optional stage on, and
+// checks that no allocation happens after warmUpSec. Returns false on failure.
+bool CheckSteadyStateAllocations(double durationSec, double warmUpSec);
@@ -0,0 +1,454 @@
+#include "Ambisonics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "DirectionAnalyzer.h"
+#include "DirectionUtils.h"
+#include "RecordingWriter.h"
+#include "WavFile.h"
+
+namespace
+{
+	constexpr float Pi = 3.14159265f;
+	constexpr float RadToDeg = 180.0f / Pi;
+	constexpr float Sqrt2 = 1.41421356f;
+
+	// Roughly octave-and-a-half bands over the range where first-order microphones
+	// still behave; the top band moves down at low sample rates.
+	constexpr float CenterHz[AmbisonicsEstimate::Bands] = { 250.0f, 800.0f, 2500.0f, 8000.0f };
+	constexpr float BandQ = 0.75f;
+	constexpr float SilentEnergy = 1e-12f;
+
+	void Describe(float ix, float iy, float iz, float energy, float& azimuth, float& elevation, float& diffuseness)
+	{
+		const float horizontal = std::hypot(ix, iy);
+		const float length = std::hypot(horizontal, iz);
+		if (energy <= SilentEnergy || length <= 0.0f) {
+			azimuth = elevation = 0.0f;
+			diffuseness = 1.0f;
+			return;
+		}
+		// B-format Y points left; this repo counts left as negative
+		azimuth = -std::atan2(iy, ix) * RadToDeg;
+		elevation = std::atan2(iz, horizontal) * RadToDeg;
+		diffuseness = std::clamp(1.0f - length / energy, 0.0f, 1.0f);
+	}
+
+	inline void FlushTiny(float& value)
+	{
+		// Keeps long silences from decaying into denormals
+		if (std::fabs(value) < 1e-30f) value = 0.0f;
+	}
+}
+
+AmbisonicsFormat ParseAmbisonicsFormat(const std::string& name)
+{
+	if (name == "fuma") return AmbisonicsFormat::FuMa;
+	if (name == "ambix") return AmbisonicsFormat::AmbiX;
+	throw std::runtime_error("Formato ambisonico desconhecido: " + name + " (use fuma ou ambix)");
+}
+
+AmbisonicsAnalyzer::AmbisonicsAnalyzer(unsigned int sampleRate, AmbisonicsFormat format, float averagingSec)
+	: sampleRate(sampleRate), channelFormat(format),
+	decay(std::exp(-1.0f / std::max(averagingSec * static_cast<float>(sampleRate), 1.0f)))
+{
+	if (sampleRate == 0) throw std::runtime_error("Taxa de amostragem invalida para a analise ambisonica");
+	if (format == AmbisonicsFormat::FuMa) {
+		xIndex = 1;
+		yIndex = 2;
+		zIndex = 3;
+		wGain = Sqrt2;
+	} else {
+		yIndex = 1;
+		zIndex = 2;
+		xIndex = 3;
+		wGain = 1.0f;
+	}
+
+	// RBJ bandpass with 0 dB peak: b1 = 0, b2 = -b0
+	for (int band = 0; band < Bands; ++band) {
+		const float center = std::min(CenterHz[band], 0.4f * static_cast<float>(sampleRate) / (1 << (Bands - 1 - band)));
+		const float w0 = 2.0f * Pi * center / static_cast<float>(sampleRate);
+		const float alpha = std::sin(w0) / (2.0f * BandQ);
+		const float a0 = 1.0f + alpha;
+		for (int ch = 0; ch < Channels; ++ch) {
+			const int lane = band * Channels + ch;
+			b0[lane] = alpha / a0;
+			a1[lane] = -2.0f * std::cos(w0) / a0;
+			a2[lane] = (1.0f - alpha) / a0;
+		}
+		current.bands[band].centerHz = center;
+	}
+	reset();
+}
+
+void AmbisonicsAnalyzer::reset()
+{
+	std::fill(std::begin(z1), std::end(z1), 0.0f);
+	std::fill(std::begin(z2), std::end(z2), 0.0f);
+	std::fill(std::begin(crossW), std::end(crossW), 0.0f);
+	std::fill(std::begin(square), std::end(square), 0.0f);
+	finishBlock();
+}
+
+template <typename Frame>
+void AmbisonicsAnalyzer::filterBlock(unsigned int frameCount, Frame&& frame)
+{
+	// The filters are recursive along time, so the vector width comes from running
+	// every band and channel side by side; state lives in locals for the block so the
+	// compiler need not assume the input aliases it.
+	alignas(64) float s1[Lanes], s2[Lanes], cross[Lanes], power[Lanes];
+	alignas(64) float in[Lanes], out[Lanes], w[Lanes];
+	std::copy(std::begin(z1), std::end(z1), s1);
+	std::copy(std::begin(z2), std::end(z2), s2);
+	std::copy(std::begin(crossW), std::end(crossW), cross);
+	std::copy(std::begin(square), std::end(square), power);
+	const float keep = decay;
+	const float gain = 1.0f - decay;
+
+	for (unsigned int i = 0; i < frameCount; ++i) {
+		for (int lane = 0; lane < Lanes; ++lane) in[lane] = frame(i, lane % Channels);
+		for (int lane = 0; lane < Lanes; ++lane) {
+			const float y = b0[lane] * in[lane] + s1[lane];
+			s1[lane] = s2[lane] - a1[lane] * y;
+			s2[lane] = -b0[lane] * in[lane] - a2[lane] * y;
+			out[lane] = y;
+		}
+		for (int lane = 0; lane < Lanes; ++lane) w[lane] = out[lane - lane % Channels];
+		for (int lane = 0; lane < Lanes; ++lane) {
+			cross[lane] = keep * cross[lane] + gain * out[lane] * w[lane];
+			power[lane] = keep * power[lane] + gain * out[lane] * out[lane];
+		}
+	}
+
+	std::copy(std::begin(s1), std::end(s1), z1);
+	std::copy(std::begin(s2), std::end(s2), z2);
+	std::copy(std::begin(cross), std::end(cross), crossW);
+	std::copy(std::begin(power), std::end(power), square);
+	finishBlock();
+}
+
+void AmbisonicsAnalyzer::finishBlock()
+{
+	for (int lane = 0; lane < Lanes; ++lane) {
+		FlushTiny(z1[lane]);
+		FlushTiny(z2[lane]);
+		FlushTiny(crossW[lane]);
+		FlushTiny(square[lane]);
+	}
+
+	float sum[3] = {};
+	float total = 0.0f;
+	for (int band = 0; band < Bands; ++band) {
+		const int base = band * Channels;
+		const float ix = wGain * crossW[base + xIndex];
+		const float iy = wGain * crossW[base + yIndex];
+		const float iz = wGain * crossW[base + zIndex];
+		const float energy = 0.5f * (wGain * wGain * square[base] + square[base + xIndex] + square[base + yIndex] + square[base + zIndex]);
+
+		AmbisonicsBand& out = current.bands[band];
+		Describe(ix, iy, iz, energy, out.azimuth, out.elevation, out.diffuseness);
+		out.energy = energy;
+		sum[0] += ix;
+		sum[1] += iy;
+		sum[2] += iz;
+		total += energy;
+	}
+
+	DirectionState& state = current.state;
+	Describe(sum[0], sum[1], sum[2], total, state.azimuth, current.elevation, current.diffuseness);
+	state.confidence = 1.0f - current.diffuseness;
+	// Energy with no direction to it (silence, reverb tails) reads as centered, like a balanced level cue
+	state.direction = state.confidence < 0.1f ? Direction::Center : directionFromAzimuth(state.azimuth);
+}
+
+const AmbisonicsEstimate& AmbisonicsAnalyzer::process(const float* samples, unsigned int frameCount)
+{
+	filterBlock(frameCount, [samples](unsigned int i, int ch) { return samples[static_cast<std::size_t>(i) * Channels + ch]; });
+	return current;
+}
+
+const AmbisonicsEstimate& AmbisonicsAnalyzer::processPlanar(const float* const* channels, unsigned int frameCount)
+{
+	filterBlock(frameCount, [channels](unsigned int i, int ch) { return channels[ch][i]; });
+	return current;
+}
+
+void AnalyzeAmbisonicsFile(const std::string& path, std::ostream& out, int threads, AmbisonicsFormat format)
+{
+	const AudioFormat audio = WavReader(path).format();
+	const std::uint64_t total = WavReader(path).totalFrames();
+	if (audio.channels != AmbisonicsAnalyzer::Channels) {
+		throw std::runtime_error("O formato B de primeira ordem precisa de 4 canais, o arquivo tem " + std::to_string(audio.channels));
+	}
+	const unsigned int hop = std::max(audio.sampleRate / 100, 1u);
+
+	// Segments start on the row grid, and a second of pre-roll is ten averaging time
+	// constants (e^-10) and far longer than the filters ring, so rows match a serial run
+	threads = std::max(1, threads);
+	const std::uint64_t hops = (total + hop - 1) / hop;
+	const std::uint64_t segment = (hops + threads - 1) / threads * hop;
+	const std::uint64_t preRoll = (audio.sampleRate + hop - 1) / hop * hop;
+
+	struct Row
+	{
+		std::uint64_t frame;
+		float azimuth;
+		float elevation;
+		float diffuseness;
+	};
+	std::vector<std::vector<Row>> rows(threads);
+	std::vector<std::thread> workers;
+	std::vector<std::string> errors(threads);
+
+	for (int t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t] {
+			try {
+				const std::uint64_t begin = segment * t;
+				const std::uint64_t end = std::min(total, begin + segment);
+				if (begin >= end) return;
+
+				const std::uint64_t start = begin > preRoll ? begin - preRoll : 0;
+				WavReader reader(path);
+				reader.seek(start);
+				AmbisonicsAnalyzer analyzer(audio.sampleRate, format);
+
+				std::vector<float> chunk(static_cast<std::size_t>(hop) * audio.channels);
+				std::uint64_t position = start;
+				while (position < end) {
+					const unsigned int got = reader.read(chunk.data(), hop);
+					if (got == 0) break;
+					position += got;
+					const AmbisonicsEstimate& estimate = analyzer.process(chunk.data(), got);
+					if (position <= begin) continue;
+					rows[t].push_back({ position, estimate.state.azimuth, estimate.elevation, estimate.diffuseness });
+				}
+			} catch (const std::exception& e) {
+				errors[t] = e.what();
+			}
+		});
+	}
+	for (auto& worker : workers) worker.join();
+	for (const auto& error : errors) {
+		if (!error.empty()) throw std::runtime_error(error);
+	}
+
+	out << "time_s,azimuth,elevation,diffuseness\n";
+	for (const auto& segmentRows : rows) {
+		for (const Row& row : segmentRows) {
+			out << static_cast<double>(row.frame) / audio.sampleRate << ',' << row.azimuth << ',' << row.elevation << ','
+				<< row.diffuseness << '\n';
+		}
+	}
+}
+
+namespace
+{
+	struct PlaneWave
+	{
+		float azimuth;   // repo convention, negative = left
+		float elevation;
+		float power;
+	};
+
+	// Independent white noise per wave, encoded to first order and written in the given
+	// channel order and W normalization
+	std::vector<float> EncodeBFormat(const std::vector<PlaneWave>& waves, unsigned int frames, AmbisonicsFormat format, std::uint32_t seed)
+	{
+		struct Gains
+		{
+			float amplitude, x, y, z;
+		};
+		std::vector<Gains> gains;
+		for (const PlaneWave& wave : waves) {
+			const float az = -wave.azimuth / RadToDeg;
+			const float el = wave.elevation / RadToDeg;
+			// Uniform noise in [-1, 1] has power 1/3
+			gains.push_back({ std::sqrt(3.0f * wave.power), std::cos(el) * std::cos(az), std::cos(el) * std::sin(az), std::sin(el) });
+		}
+
+		std::uint32_t state = seed;
+		std::vector<float> out(static_cast<std::size_t>(frames) * 4);
+		for (unsigned int i = 0; i < frames; ++i) {
+			float w = 0.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+			for (const Gains& g : gains) {
+				state = state * 1664525u + 1013904223u;
+				const float s = g.amplitude * (static_cast<float>(state >> 8) / 8388608.0f - 1.0f);
+				w += s;
+				x += s * g.x;
+				y += s * g.y;
+				z += s * g.z;
+			}
+			float* frame = out.data() + static_cast<std::size_t>(i) * 4;
+			if (format == AmbisonicsFormat::FuMa) {
+				frame[0] = w / Sqrt2;
+				frame[1] = x;
+				frame[2] = y;
+				frame[3] = z;
+			} else {
+				frame[0] = w;
+				frame[1] = y;
+				frame[2] = z;
+				frame[3] = x;
+			}
+		}
+		return out;
+	}
+
+	// Plane wave plus a diffuse field of the given power, spread over 32 directions
+	// evenly covering the sphere (their intensities cancel)
+	std::vector<PlaneWave> WithDiffuseField(PlaneWave direct, float diffusePower)
+	{
+		std::vector<PlaneWave> waves;
+		if (direct.power > 0.0f) waves.push_back(direct);
+		if (diffusePower <= 0.0f) return waves;
+		constexpr int Count = 32;
+		const float golden = Pi * (3.0f - std::sqrt(5.0f));
+		for (int k = 0; k < Count; ++k) {
+			const float z = 1.0f - (2.0f * k + 1.0f) / Count;
+			waves.push_back({ std::remainder(golden * k * RadToDeg, 360.0f), std::asin(z) * RadToDeg, diffusePower / Count });
+		}
+		return waves;
+	}
+
+	float AngleError(float a, float b)
+	{
+		return std::fabs(std::remainder(a - b, 360.0f));
+	}
+}
+
+bool BenchmarkAmbisonics(double durationSec)
+{
+	using Clock = std::chrono::steady_clock;
+	constexpr unsigned int Rate = 48000;
+	constexpr unsigned int Packet = 480;
+	bool ok = true;
+
+	// Direction and diffuseness against known fields, in both channel conventions
+	struct Case
+	{
+		const char* name;
+		PlaneWave direct;
+		float diffusePower;
+		float expectedDiffuseness;
+	};
+	const Case cases[] = {
+		{ "frente", { 0.0f, 0.0f, 0.1f }, 0.0f, 0.0f },
+		{ "esquerda 45", { -45.0f, 0.0f, 0.1f }, 0.0f, 0.0f },
+		{ "direita 90, acima 30", { 90.0f, 30.0f, 0.1f }, 0.0f, 0.0f },
+		{ "tras-esquerda, abaixo 20", { -135.0f, -20.0f, 0.1f }, 0.0f, 0.0f },
+		{ "esquerda 45 + difuso igual", { -45.0f, 0.0f, 0.05f }, 0.05f, 0.5f },
+		{ "tras 170, acima 10 + difuso igual", { 170.0f, 10.0f, 0.05f }, 0.05f, 0.5f },
+		{ "so difuso", { 0.0f, 0.0f, 0.0f }, 0.1f, 1.0f },
+	};
+	const unsigned int caseFrames = Rate;
+	const unsigned int settleFrames = Rate * 3 / 10;
+
+	std::cout << "Campos conhecidos, 1 s cada (media apos 0,3 s):\n";
+	for (const Case& c : cases) {
+		const std::vector<PlaneWave> waves = WithDiffuseField(c.direct, c.diffusePower);
+		float azimuth[2] = {}, elevation[2] = {}, diffuseness[2] = {};
+		for (int f = 0; f < 2; ++f) {
+			const AmbisonicsFormat format = f == 0 ? AmbisonicsFormat::FuMa : AmbisonicsFormat::AmbiX;
+			const std::vector<float> signal = EncodeBFormat(waves, caseFrames, format, 11);
+			AmbisonicsAnalyzer analyzer(Rate, format);
+			double azError = 0.0, elError = 0.0, diffuse = 0.0;
+			int blocks = 0;
+			for (unsigned int at = 0; at + Packet <= caseFrames; at += Packet) {
+				const AmbisonicsEstimate& estimate = analyzer.process(signal.data() + static_cast<std::size_t>(at) * 4, Packet);
+				if (at < settleFrames) continue;
+				azError += AngleError(estimate.state.azimuth, c.direct.azimuth);
+				elError += std::fabs(estimate.elevation - c.direct.elevation);
+				diffuse += estimate.diffuseness;
+				++blocks;
+			}
+			azimuth[f] = static_cast<float>(azError / blocks);
+			elevation[f] = static_cast<float>(elError / blocks);
+			diffuseness[f] = static_cast<float>(diffuse / blocks);
+		}
+
+		const bool directional = c.direct.power > 0.0f;
+		const bool pass = !directional || (azimuth[0] < 10.0f && elevation[0] < 10.0f && azimuth[1] < 10.0f && elevation[1] < 10.0f);
+		const bool formatsAgree = std::fabs(diffuseness[0] - diffuseness[1]) < 0.01f;
+		ok = ok && pass && formatsAgree;
+		std::printf("  %-36s erro azimute %5.2f / elevacao %5.2f graus, difusividade %.3f (esperada %.1f), AmbiX %.3f%s\n",
+			c.name, azimuth[0], elevation[0], diffuseness[0], c.expectedDiffuseness, diffuseness[1],
+			pass && formatsAgree ? "" : "  FALHOU");
+	}
+
+	// Cost per frame against the existing 4-channel level analysis on the same audio
+	const unsigned int frames = static_cast<unsigned int>(std::max(1.0, durationSec) * Rate) / Packet * Packet;
+	const std::vector<float> scene = EncodeBFormat(WithDiffuseField({ 60.0f, 15.0f, 0.05f }, 0.02f), frames, AmbisonicsFormat::FuMa, 3);
+	AmbisonicsAnalyzer analyzer(Rate);
+	DirectionAnalyzer level;
+	volatile float sink = 0.0f;
+
+	auto start = Clock::now();
+	for (unsigned int at = 0; at < frames; at += Packet) {
+		sink = sink + analyzer.process(scene.data() + static_cast<std::size_t>(at) * 4, Packet).state.azimuth;
+	}
+	const double ambiSec = std::chrono::duration<double>(Clock::now() - start).count();
+	start = Clock::now();
+	for (unsigned int at = 0; at < frames; at += Packet) {
+		sink = sink + level.analyzeState(scene.data() + static_cast<std::size_t>(at) * 4, Packet, 4).azimuth;
+	}
+	const double levelSec = std::chrono::duration<double>(Clock::now() - start).count();
+	const double seconds = static_cast<double>(frames) / Rate;
+	std::cout << "Custo em pacotes de " << Packet << " quadros: vetor de intensidade " << ambiSec * 1e9 / frames << " ns/quadro ("
+		<< 100.0 * ambiSec / seconds << "% de um nucleo), nivel quadrafonico " << levelSec * 1e9 / frames << " ns/quadro ("
+		<< 100.0 * levelSec / seconds << "%)\n";
+
+	// Offline: parallel segments against one serial pass over the same file
+	const std::string path = (std::filesystem::temp_directory_path() / "avis-ambisonics-check.wav").string();
+	{
+		RecordingOptions options;
+		options.writeFloat = true;
+		RecordingWriter writer(path, 4, Rate, options);
+		writer.write(scene.data(), frames);
+	}
+	const int threads = static_cast<int>(std::clamp(std::thread::hardware_concurrency(), 2u, 8u));
+	std::ostringstream serial, parallel;
+	start = Clock::now();
+	AnalyzeAmbisonicsFile(path, serial, 1, AmbisonicsFormat::FuMa);
+	const double serialSec = std::chrono::duration<double>(Clock::now() - start).count();
+	start = Clock::now();
+	AnalyzeAmbisonicsFile(path, parallel, threads, AmbisonicsFormat::FuMa);
+	const double parallelSec = std::chrono::duration<double>(Clock::now() - start).count();
+	std::filesystem::remove(path);
+
+	std::istringstream a(serial.str()), b(parallel.str());
+	std::string lineA, lineB;
+	std::size_t count = 0, mismatched = 0;
+	float worst = 0.0f;
+	while (std::getline(a, lineA)) {
+		if (!std::getline(b, lineB)) {
+			++mismatched;
+			break;
+		}
+		if (count++ == 0) continue; // header
+		float ta, aa, ea, da, tb, ab, eb, db;
+		if (std::sscanf(lineA.c_str(), "%f,%f,%f,%f", &ta, &aa, &ea, &da) != 4 ||
+			std::sscanf(lineB.c_str(), "%f,%f,%f,%f", &tb, &ab, &eb, &db) != 4 || ta != tb) {
+			++mismatched;
+			continue;
+		}
+		worst = std::max({ worst, AngleError(aa, ab), std::fabs(ea - eb), 100.0f * std::fabs(da - db) });
+	}
+	if (std::getline(b, lineB)) ++mismatched;
+	const bool agree = mismatched == 0 && worst < 0.01f;
+	ok = ok && agree;
+	std::cout << "Arquivo de " << seconds << " s: 1 thread " << serialSec << " s, " << threads << " threads " << parallelSec
+		<< " s; " << count - 1 << " linhas, maior diferenca " << worst << " (graus / centesimos de difusividade)"
+		<< (agree ? "" : "  FALHOU") << '\n';
+	std::cout << (ok ? "OK" : "FALHOU") << '\n';
+	return ok;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "Direction.h"
+
+// First-order B-format channel conventions. FuMa: W, X, Y, Z with W at -3 dB.
+// AmbiX: ACN order W, Y, Z, X with SN3D normalization.
+enum class AmbisonicsFormat : std::uint8_t
+{
+	FuMa,
+	AmbiX
+};
+
+// "fuma" or "ambix"; throws on anything else.
+AmbisonicsFormat ParseAmbisonicsFormat(const std::string& name);
+
+struct AmbisonicsBand
+{
+	float centerHz = 0.0f;
+	float azimuth = 0.0f;      // degrees, 0 = front, negative = left
+	float elevation = 0.0f;    // degrees, positive = up
+	float diffuseness = 1.0f;  // 0 = one plane wave, 1 = no net energy flow
+	float energy = 0.0f;
+};
+
+// Azimuth, elevation and diffuseness of the summed intensity of all bands; state
+// carries the azimuth and a direction, with confidence = 1 - diffuseness.
+struct AmbisonicsEstimate
+{
+	static constexpr int Bands = 4;
+
+	DirectionState state;
+	float elevation = 0.0f;
+	float diffuseness = 1.0f;
+	AmbisonicsBand bands[Bands];
+};
+
+// Active intensity vector of a first-order B-format stream, per band. W, X, Y and Z
+// go through the same bandpass filters; per band, the intensity is the time average
+// of W times X, Y and Z. Diffuseness compares its length with the energy density.
+// Filter state and the averages (an exponential window of averagingSec, updated per
+// frame) carry over between calls, so any block size gives the same result.
+class AmbisonicsAnalyzer
+{
+public:
+	static constexpr int Bands = AmbisonicsEstimate::Bands;
+	static constexpr int Channels = 4;
+
+	AmbisonicsAnalyzer(unsigned int sampleRate, AmbisonicsFormat format = AmbisonicsFormat::FuMa, float averagingSec = 0.1f);
+
+	// Four interleaved channels in the configured order. Does not allocate.
+	const AmbisonicsEstimate& process(const float* samples, unsigned int frameCount);
+	const AmbisonicsEstimate& processPlanar(const float* const* channels, unsigned int frameCount);
+	void reset();
+
+	const AmbisonicsEstimate& estimate() const { return current; }
+	AmbisonicsFormat format() const { return channelFormat; }
+
+private:
+	// One lane per band and channel (band-major), so the filter loop runs 16 lanes wide
+	static constexpr int Lanes = Bands * Channels;
+
+	template <typename Frame>
+	void filterBlock(unsigned int frameCount, Frame&& frame);
+	void finishBlock();
+
+	unsigned int sampleRate;
+	AmbisonicsFormat channelFormat;
+	float decay;               // per frame, of the averages
+	int xIndex, yIndex, zIndex;
+	float wGain;               // brings W to SN3D
+
+	alignas(64) float b0[Lanes];
+	alignas(64) float a1[Lanes];
+	alignas(64) float a2[Lanes];
+	alignas(64) float z1[Lanes];
+	alignas(64) float z2[Lanes];
+	alignas(64) float crossW[Lanes];  // average of the band's W times the lane's channel
+	alignas(64) float square[Lanes];  // average of the lane's channel squared
+
+	AmbisonicsEstimate current;
+};
+
+// Offline: analyzes a whole B-format WAV file on several threads (contiguous segments
+// with a second of pre-roll each, so every segment has settled like a serial run) and
+// writes "time_s,azimuth,elevation,diffuseness" rows every 10 ms.
+void AnalyzeAmbisonicsFile(const std::string& path, std::ostream& out, int threads, AmbisonicsFormat format);
+
+// Encodes plane waves at known directions over a diffuse field into B-format and
+// reports direction error and diffuseness, the cost against the 4-channel level
+// analysis, and how closely a parallel offline run matches a serial one. Returns
+// false when a direction is off by more than 10 degrees or the runs disagree.
+bool BenchmarkAmbisonics(double durationSec);
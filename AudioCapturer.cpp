@@ -4,8 +4,8 @@
 #include <ostream>
 #include <stdexcept>
 
-#include "Direction.h"
-#include "DirectionUtils.h"
+#include "DirectionPipeline.h"
+#include "Trace.h"
 
 AudioCapturer::AudioCapturer(std::atomic<int>& dirRef)
     : directionRef(dirRef), pwfx(nullptr)
@@ -24,62 +24,67 @@ AudioCapturer::~AudioCapturer()
     CoUninitialize();
 }
 
-void AudioCapturer::run() const
+void AudioCapturer::run()
 {
     std::cout<<"Captura em tempo real inicializada...\n";
+    AVIS_TRACE_THREAD("captura");
 
-    while(true)
+    DirectionPipeline pipeline(*this, &directionRef);
+    pipeline.configure(pipelineOptions);
+    pipeline.setVerbose(true);
+    pipeline.runToEnd();
+    if (const StageCounters* counters = pipeline.stageCounters()) counters->print(std::cout);
+}
+
+AudioFormat AudioCapturer::format() const
+{
+    return { pwfx->nChannels, pwfx->nSamplesPerSec };
+}
+
+bool AudioCapturer::nextPacket(CapturePacket& packet)
+{
+    if (holdingBuffer)
     {
-        Sleep(10);
+        pCaptureClient->ReleaseBuffer(heldFrames);
+        holdingBuffer = false;
+    }
 
+    while(true)
+    {
         UINT32 packetLength = 0;
         HRESULT hr = pCaptureClient->GetNextPacketSize(&packetLength);
 
-        if (FAILED(hr)) continue;
+        if (FAILED(hr) || packetLength == 0)
+        {
+            Sleep(10);
+            continue;
+        }
+
+        BYTE* pData = nullptr;
+        UINT32 numFramesAvailable = 0;
+        DWORD flags = 0;
 
-        while(packetLength!= 0)
+        hr = pCaptureClient->GetBuffer(&pData, &numFramesAvailable, &flags, nullptr, nullptr);
+        if (FAILED(hr))
         {
-            BYTE* pData = nullptr;
-            UINT32 numFramesAvailable = 0;
-            DWORD flags = 0;
-
-            hr = pCaptureClient->GetBuffer(&pData, &numFramesAvailable, &flags, nullptr, nullptr);
-            if (FAILED(hr)) break;
-
-            if((flags & AUDCLNT_BUFFERFLAGS_SILENT)==0 && pData)
-            {
-	            auto isFloat = false;
-	            if(pwfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
-	            {
-                    isFloat = true;
-	            } else if(pwfx->wFormatTag==WAVE_FORMAT_EXTENSIBLE)
-	            {
-		            if(const auto* wfext = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(pwfx.get()); wfext->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT)
-                    {
-                        isFloat = true;
-                    }
-	            }
-
-                if(isFloat)
-                {
-	                const auto floatData = reinterpret_cast<const float*>(pData);
-
-	                const Direction dir = analyzer.analyze(floatData, numFramesAvailable, pwfx->nChannels);
-                    if (dir == Direction::Left) directionRef = 1;
-                    else if (dir == Direction::Right) directionRef = 2;
-                    else directionRef = 0;
-                    std::cout << directionToString(dir) << '\n';
-                }
-            }
-
-            hr = pCaptureClient->ReleaseBuffer(numFramesAvailable);
-            if (FAILED(hr)) break;
-
-            hr = pCaptureClient->GetNextPacketSize(&packetLength);
-            if (FAILED(hr)) break;
+            Sleep(10);
+            continue;
         }
-    }
 
+        holdingBuffer = true;
+        heldFrames = numFramesAvailable;
+
+        // Integer mix formats go to the level analysis as they are; anything else passes through as silence
+        packet.samples = isFloat ? reinterpret_cast<const float*>(pData) : nullptr;
+        packet.pcm = isPcm ? pData : nullptr;
+        packet.pcmEncoding = pcmEncoding;
+        packet.frameCount = numFramesAvailable;
+        packet.silent = (flags & AUDCLNT_BUFFERFLAGS_SILENT) != 0 || !pData || !(isFloat || isPcm);
+        packet.timestampUs = framePosition * 1000000ull / pwfx->nSamplesPerSec;
+        packet.readyNs = SteadyNowNs();
+        framePosition += numFramesAvailable;
+        return true;
+    }
 }
 
 void AudioCapturer::initialize()
@@ -116,6 +121,30 @@ void AudioCapturer::initialize()
 
     pwfx.reset(pWfxRaw);
 
+    if(pwfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
+    {
+        isFloat = true;
+    } else if(pwfx->wFormatTag==WAVE_FORMAT_EXTENSIBLE)
+    {
+        const auto* wfext = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(pwfx.get());
+        isFloat = wfext->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+        isPcm = wfext->SubFormat == KSDATAFORMAT_SUBTYPE_PCM;
+    } else
+    {
+        isPcm = pwfx->wFormatTag == WAVE_FORMAT_PCM;
+    }
+    if(isPcm)
+    {
+        // 24-in-32 containers are left-justified, so they read as Int32
+        switch(pwfx->wBitsPerSample)
+        {
+        case 16: pcmEncoding = PcmEncoding::Int16; break;
+        case 24: pcmEncoding = PcmEncoding::Int24; break;
+        case 32: pcmEncoding = PcmEncoding::Int32; break;
+        default: isPcm = false; break;
+        }
+    }
+
     hr = pAudioClient->Initialize(AUDCLNT_SHAREMODE_SHARED,
         AUDCLNT_STREAMFLAGS_LOOPBACK,
         0, 0, pwfx.get(), nullptr);
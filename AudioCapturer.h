@@ -1,13 +1,16 @@
 #pragma once
+#include <atomic>
 #include <audioclient.h>
 #include <memory>
 #include <mmdeviceapi.h>
 
-#include "DirectionAnalyzer.h"
+#include "CaptureSource.h"
+#include "DirectionPipeline.h"
 #include <wrl/client.h>
 
 using Microsoft::WRL::ComPtr;
 
+
 struct CoTaskDeleter
 {
 	void operator()(WAVEFORMATEX* p) const
@@ -16,17 +19,32 @@ struct CoTaskDeleter
 	}
 };
 
-class AudioCapturer
+// WASAPI loopback capture of the default render device.
+class AudioCapturer : public CaptureSource
 {
 public:
 	explicit AudioCapturer(std::atomic<int>& dirRef);
-	~AudioCapturer();
-	void run() const;
+	~AudioCapturer() override;
+	void run();
+
+	AudioFormat format() const override;
+	// Blocks until the device has a packet; never reports end of stream.
+	bool nextPacket(CapturePacket& packet) override;
+
+	// Outputs and modes for the pipeline built by run() (timeline, shared memory...).
+	void setPipelineOptions(const PipelineOptions& options) { pipelineOptions = options; }
+	int channelCount() const { return pwfx ? pwfx->nChannels : 0; }
 private:
 	std::atomic<int>& directionRef;
+	PipelineOptions pipelineOptions;
 	void initialize();
 
-	DirectionAnalyzer analyzer;
+	bool isFloat = false;
+	bool isPcm = false;            // 16, 24 or 32-bit integer mix format
+	PcmEncoding pcmEncoding = PcmEncoding::Int16;
+	bool holdingBuffer = false;
+	UINT32 heldFrames = 0;
+	std::uint64_t framePosition = 0;
 
 	ComPtr<IMMDeviceEnumerator> pEnumerator;
 	ComPtr<IMMDevice> pDevice;
@@ -0,0 +1,331 @@
+#include "AvisApi.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "DirectionPipeline.h"
+#include "LatencyHistogram.h"
+
+static_assert(AVIS_DIRECTION_UNKNOWN == static_cast<int>(Direction::Unknown), "avis_direction follows Direction");
+
+namespace
+{
+	// Hands the pipeline whatever the caller just pushed, without copying it
+	class PushSource : public CaptureSource
+	{
+	public:
+		explicit PushSource(AudioFormat format) : audioFormat(format) {}
+
+		AudioFormat format() const override { return audioFormat; }
+		bool nextPacket(CapturePacket& packet) override
+		{
+			if (!pending) return false;
+			packet = current;
+			pending = false;
+			return true;
+		}
+
+		void set(const CapturePacket& packet)
+		{
+			current = packet;
+			pending = true;
+		}
+
+	private:
+		AudioFormat audioFormat;
+		CapturePacket current;
+		bool pending = false;
+	};
+
+	// Copies as much of a versioned struct as the caller's struct_size allows
+	template <typename T>
+	void copyOut(T* out, const T& value)
+	{
+		const std::uint32_t callerSize = out->struct_size;
+		std::memcpy(out, &value, std::min<std::size_t>(callerSize, sizeof(T)));
+		out->struct_size = callerSize;
+	}
+
+	// Every avis_config a caller may have been built against ends at least here (v1)
+	constexpr std::size_t ConfigV1Size = offsetof(avis_config, onset_gating) + sizeof(avis_config::onset_gating);
+}
+
+struct avis_analyzer
+{
+	explicit avis_analyzer(const avis_config& config)
+		: source({ config.channels, config.sample_rate }), pipeline(source)
+	{
+		DecisionParams params;
+		params.lateralRatio = config.lateral_ratio;
+		params.frontRearRatio = config.front_rear_ratio;
+		params.lfeInRear = config.lfe_in_rear != 0;
+		pipeline.setDecisionParams(params);
+		pipeline.setDelayEstimation(config.delay_estimation != 0);
+		pipeline.setOnsetGating(config.onset_gating != 0);
+		latest.struct_size = sizeof(avis_state);
+		latest.direction = AVIS_DIRECTION_UNKNOWN;
+	}
+
+	avis_status push(CapturePacket packet)
+	{
+		const std::uint64_t startNs = SteadyNowNs();
+		const AudioFormat format = source.format();
+		packet.timestampUs = position * 1000000 / format.sampleRate;
+		packet.readyNs = startNs;
+
+		const std::uint64_t analyzedBefore = pipeline.stats().fullCostFrames;
+		source.set(packet);
+		pipeline.step();
+		position += packet.frameCount;
+		++pushes;
+
+		const bool decided = pipeline.stats().fullCostFrames != analyzedBefore;
+		if (decided) {
+			const DirectionState& state = pipeline.lastState();
+			latest.direction = static_cast<std::int32_t>(state.direction);
+			latest.azimuth = state.azimuth;
+			latest.confidence = state.confidence;
+			latest.timestamp_us = packet.timestampUs;
+			fresh = true;
+			++decisions;
+		}
+
+		// The callback's own time is not the library's
+		const std::uint64_t elapsedNs = SteadyNowNs() - startNs;
+		pushNs.record(elapsedNs);
+		if (decided && callback) callback(user, &latest);
+		return AVIS_OK;
+	}
+
+	PushSource source;
+	DirectionPipeline pipeline;
+	avis_state_callback callback = nullptr;
+	void* user = nullptr;
+	avis_state latest{};
+	bool fresh = false;
+	std::uint64_t position = 0;
+	std::uint64_t pushes = 0;
+	std::uint64_t decisions = 0;
+	LatencyHistogram pushNs;
+};
+
+extern "C" {
+
+uint32_t avis_abi_version(void)
+{
+	return AVIS_ABI_VERSION;
+}
+
+const char* avis_status_string(avis_status status)
+{
+	switch (status) {
+	case AVIS_OK: return "ok";
+	case AVIS_ERROR_INVALID_ARGUMENT: return "invalid argument";
+	case AVIS_ERROR_UNSUPPORTED_LAYOUT: return "unsupported channel layout";
+	case AVIS_ERROR_OUT_OF_MEMORY: return "out of memory";
+	default: return "internal error";
+	}
+}
+
+void avis_config_init(avis_config* config)
+{
+	if (!config) return;
+	const DecisionParams defaults;
+	*config = avis_config{};
+	config->struct_size = sizeof(avis_config);
+	config->lateral_ratio = defaults.lateralRatio;
+	config->front_rear_ratio = defaults.frontRearRatio;
+	config->lfe_in_rear = defaults.lfeInRear ? 1 : 0;
+	config->delay_estimation = 1;
+}
+
+avis_status avis_create(const avis_config* config, avis_analyzer** analyzer)
+{
+	if (!analyzer) return AVIS_ERROR_INVALID_ARGUMENT;
+	*analyzer = nullptr;
+	if (!config || config->struct_size < ConfigV1Size) return AVIS_ERROR_INVALID_ARGUMENT;
+
+	// Fields newer than the caller's struct keep their avis_config_init defaults
+	avis_config effective;
+	avis_config_init(&effective);
+	std::memcpy(&effective, config, std::min<std::size_t>(config->struct_size, sizeof(avis_config)));
+	effective.struct_size = sizeof(avis_config);
+	if (effective.sample_rate == 0 || effective.lateral_ratio <= 0.0f || effective.front_rear_ratio <= 0.0f) {
+		return AVIS_ERROR_INVALID_ARGUMENT;
+	}
+	if (effective.channels <= 0 || effective.channels > DirectionAnalyzer::MaxChannels) {
+		return AVIS_ERROR_UNSUPPORTED_LAYOUT;
+	}
+
+	try {
+		*analyzer = new avis_analyzer(effective);
+		return AVIS_OK;
+	} catch (const std::bad_alloc&) {
+		return AVIS_ERROR_OUT_OF_MEMORY;
+	} catch (...) {
+		return AVIS_ERROR_INTERNAL;
+	}
+}
+
+void avis_destroy(avis_analyzer* analyzer)
+{
+	delete analyzer;
+}
+
+avis_status avis_push_interleaved(avis_analyzer* analyzer, const float* samples, uint32_t frames)
+{
+	if (!analyzer || (!samples && frames > 0)) return AVIS_ERROR_INVALID_ARGUMENT;
+	CapturePacket packet;
+	packet.samples = samples;
+	packet.frameCount = frames;
+	try {
+		return analyzer->push(packet);
+	} catch (...) {
+		return AVIS_ERROR_INTERNAL;
+	}
+}
+
+avis_status avis_push_planar(avis_analyzer* analyzer, const float* const* channels, uint32_t frames)
+{
+	if (!analyzer || (!channels && frames > 0)) return AVIS_ERROR_INVALID_ARGUMENT;
+	if (channels) {
+		const int numChannels = analyzer->source.format().channels;
+		for (int ch = 0; ch < numChannels; ++ch) {
+			if (!channels[ch] && frames > 0) return AVIS_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	CapturePacket packet;
+	packet.planes = channels;
+	packet.frameCount = frames;
+	try {
+		return analyzer->push(packet);
+	} catch (...) {
+		return AVIS_ERROR_INTERNAL;
+	}
+}
+
+avis_status avis_push_silence(avis_analyzer* analyzer, uint32_t frames)
+{
+	if (!analyzer) return AVIS_ERROR_INVALID_ARGUMENT;
+	CapturePacket packet;
+	packet.frameCount = frames;
+	packet.silent = true;
+	try {
+		return analyzer->push(packet);
+	} catch (...) {
+		return AVIS_ERROR_INTERNAL;
+	}
+}
+
+avis_status avis_set_callback(avis_analyzer* analyzer, avis_state_callback callback, void* user)
+{
+	if (!analyzer) return AVIS_ERROR_INVALID_ARGUMENT;
+	analyzer->callback = callback;
+	analyzer->user = user;
+	return AVIS_OK;
+}
+
+int avis_poll(avis_analyzer* analyzer, avis_state* state)
+{
+	if (!analyzer || !state) return 0;
+	copyOut(state, analyzer->latest);
+	const bool fresh = analyzer->fresh;
+	analyzer->fresh = false;
+	return fresh ? 1 : 0;
+}
+
+avis_status avis_get_stats(const avis_analyzer* analyzer, avis_stats* stats)
+{
+	if (!analyzer || !stats) return AVIS_ERROR_INVALID_ARGUMENT;
+	const PipelineStats& pipeline = analyzer->pipeline.stats();
+
+	avis_stats value{};
+	value.struct_size = sizeof(avis_stats);
+	value.pushes = analyzer->pushes;
+	value.frames = pipeline.frames;
+	value.decisions = analyzer->decisions;
+	value.silent_pushes = pipeline.silentPackets;
+	value.onsets = pipeline.onsets;
+	value.mean_push_ns = analyzer->pushNs.mean();
+	value.p99_push_ns = analyzer->pushNs.percentile(0.99);
+	value.max_push_ns = analyzer->pushNs.max();
+	copyOut(stats, value);
+	return AVIS_OK;
+}
+
+}
+
+void BenchmarkCApi(double seconds)
+{
+	using Clock = std::chrono::steady_clock;
+	const int channelCounts[] = { 2, 6 };
+	const unsigned int blockSizes[] = { 16, 64, 256, 480, 1024 };
+	const double slice = seconds / (std::size(channelCounts) * std::size(blockSizes) * 3);
+
+	// Runs body until the time slice is used up; returns ns per call
+	auto measure = [slice](auto&& body) {
+		std::uint64_t calls = 0;
+		const auto start = Clock::now();
+		auto elapsed = Clock::duration::zero();
+		do {
+			for (int i = 0; i < 256; ++i) body();
+			calls += 256;
+			elapsed = Clock::now() - start;
+		} while (std::chrono::duration<double>(elapsed).count() < slice);
+		return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+	};
+
+	std::cout << "Custo por chamada (ns), analise de nivel sem GCC-PHAT:\n";
+	for (const int channels : channelCounts) {
+		for (const unsigned int frames : blockSizes) {
+			std::vector<float> interleaved(static_cast<std::size_t>(frames) * channels);
+			std::vector<std::vector<float>> planes(channels, std::vector<float>(frames));
+			std::vector<const float*> planePointers(channels);
+			std::uint32_t noise = 1;
+			for (unsigned int i = 0; i < frames; ++i) {
+				for (int ch = 0; ch < channels; ++ch) {
+					noise = noise * 1664525u + 1013904223u;
+					const float x = (static_cast<float>(noise >> 8) / 16777216.0f - 0.5f) * (ch == 0 ? 1.0f : 0.5f);
+					interleaved[static_cast<std::size_t>(i) * channels + ch] = x;
+					planes[ch][i] = x;
+				}
+			}
+			for (int ch = 0; ch < channels; ++ch) planePointers[ch] = planes[ch].data();
+
+			const DirectionAnalyzer direct;
+			volatile float sink = 0.0f;
+			const double directNs = measure([&] {
+				sink = sink + direct.analyzeState(interleaved.data(), frames, channels).azimuth;
+			});
+
+			avis_config config;
+			avis_config_init(&config);
+			config.channels = channels;
+			config.sample_rate = 48000;
+			config.delay_estimation = 0;
+			avis_analyzer* analyzer = nullptr;
+			if (avis_create(&config, &analyzer) != AVIS_OK) continue;
+			avis_state state;
+			state.struct_size = sizeof(state);
+			const double interleavedNs = measure([&] {
+				avis_push_interleaved(analyzer, interleaved.data(), frames);
+				avis_poll(analyzer, &state);
+			});
+			const double planarNs = measure([&] {
+				avis_push_planar(analyzer, planePointers.data(), frames);
+				avis_poll(analyzer, &state);
+			});
+			avis_destroy(analyzer);
+
+			std::cout << "  " << channels << " canais, " << frames << " quadros: direto " << directNs
+				<< ", C intercalado " << interleavedNs << " (" << std::showpos << interleavedNs - directNs << std::noshowpos << ")"
+				<< ", C planar " << planarNs << " (" << std::showpos << planarNs - directNs << std::noshowpos << ")\n";
+		}
+	}
+}
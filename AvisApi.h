@@ -0,0 +1,128 @@
+#pragma once
+
+/*
+ * C ABI for embedding the direction analyzer in another process.
+ *
+ * An analyzer is created for a channel layout and sample rate, and fed with the
+ * caller's buffers: avis_push_interleaved() and avis_push_planar() analyze the
+ * memory they are given in place and keep no pointer to it after they return.
+ * Decisions are read with avis_poll() or delivered to a callback on the pushing
+ * thread. A handle must not be used from two threads at once; separate handles are
+ * independent.
+ *
+ * Stability: functions are only ever added. Structs that cross the boundary start
+ * with struct_size, so older callers keep working when fields are appended. Build
+ * the library with AVIS_BUILD_LIBRARY defined (see examples/avis_push.c for Linux).
+ */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(AVIS_BUILD_LIBRARY)
+#define AVIS_API __declspec(dllexport)
+#elif defined(AVIS_IMPORT_LIBRARY)
+#define AVIS_API __declspec(dllimport)
+#else
+#define AVIS_API
+#endif
+#else
+#define AVIS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AVIS_ABI_VERSION 1
+
+typedef struct avis_analyzer avis_analyzer;
+
+typedef enum avis_status
+{
+	AVIS_OK = 0,
+	AVIS_ERROR_INVALID_ARGUMENT = 1,
+	AVIS_ERROR_UNSUPPORTED_LAYOUT = 2,
+	AVIS_ERROR_OUT_OF_MEMORY = 3,
+	AVIS_ERROR_INTERNAL = 4
+} avis_status;
+
+/* Same order as the analyzer's Direction. */
+typedef enum avis_direction
+{
+	AVIS_DIRECTION_LEFT = 0,
+	AVIS_DIRECTION_RIGHT,
+	AVIS_DIRECTION_CENTER,
+	AVIS_DIRECTION_UP_LEFT,
+	AVIS_DIRECTION_UP_CENTER,
+	AVIS_DIRECTION_UP_RIGHT,
+	AVIS_DIRECTION_CENTER_LEFT,
+	AVIS_DIRECTION_CENTER_RIGHT,
+	AVIS_DIRECTION_DOWN_LEFT,
+	AVIS_DIRECTION_DOWN_CENTER,
+	AVIS_DIRECTION_DOWN_RIGHT,
+	AVIS_DIRECTION_UNKNOWN
+} avis_direction;
+
+typedef struct avis_config
+{
+	uint32_t struct_size;
+	int32_t channels;          /* 1-32; 2, 4, 5, 6 and 8 have named layouts */
+	uint32_t sample_rate;
+	float lateral_ratio;       /* left/right energy ratio that counts as a side */
+	float front_rear_ratio;
+	int32_t lfe_in_rear;
+	int32_t delay_estimation;  /* stereo: fuse the GCC-PHAT delay cue */
+	int32_t onset_gating;      /* full analysis only around onsets */
+} avis_config;
+
+typedef struct avis_state
+{
+	uint32_t struct_size;
+	int32_t direction;         /* avis_direction */
+	float azimuth;             /* degrees, 0 = front, negative = left */
+	float confidence;          /* 0..1 */
+	uint64_t timestamp_us;     /* stream position of the analyzed block */
+} avis_state;
+
+typedef struct avis_stats
+{
+	uint32_t struct_size;
+	uint64_t pushes;
+	uint64_t frames;
+	uint64_t decisions;        /* pushes that produced a new state */
+	uint64_t silent_pushes;
+	uint64_t onsets;
+	double mean_push_ns;       /* time spent inside the push calls */
+	uint64_t p99_push_ns;
+	uint64_t max_push_ns;
+} avis_stats;
+
+typedef void (*avis_state_callback)(void* user, const avis_state* state);
+
+AVIS_API uint32_t avis_abi_version(void);
+AVIS_API const char* avis_status_string(avis_status status);
+
+/* Fills config with the defaults; set channels and sample_rate afterwards. */
+AVIS_API void avis_config_init(avis_config* config);
+AVIS_API avis_status avis_create(const avis_config* config, avis_analyzer** analyzer);
+AVIS_API void avis_destroy(avis_analyzer* analyzer);
+
+/* frames * channels samples, frame-major. */
+AVIS_API avis_status avis_push_interleaved(avis_analyzer* analyzer, const float* samples, uint32_t frames);
+/* channels pointers to frames samples each. */
+AVIS_API avis_status avis_push_planar(avis_analyzer* analyzer, const float* const* channels, uint32_t frames);
+/* Silence of the given length: advances the stream clock without analysis. */
+AVIS_API avis_status avis_push_silence(avis_analyzer* analyzer, uint32_t frames);
+
+/* Called on the pushing thread after each push that produced a state; NULL removes it. */
+AVIS_API avis_status avis_set_callback(avis_analyzer* analyzer, avis_state_callback callback, void* user);
+/* Copies the latest state; returns 1 when it is new since the previous poll, 0 otherwise. */
+AVIS_API int avis_poll(avis_analyzer* analyzer, avis_state* state);
+AVIS_API avis_status avis_get_stats(const avis_analyzer* analyzer, avis_stats* stats);
+
+#ifdef __cplusplus
+}
+
+// Per-call cost of the C entry points against calling DirectionAnalyzer directly.
+void BenchmarkCApi(double seconds);
+#endif
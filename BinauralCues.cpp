@@ -0,0 +1,475 @@
+#include "BinauralCues.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "DirectionUtils.h"
+#include "Fft.h"
+
+namespace
+{
+	constexpr float Pi = 3.14159265f;
+	constexpr float DegToRad = Pi / 180.0f;
+
+	constexpr char FileMagic[4] = { 'A', 'V', 'H', 'C' };
+	constexpr std::uint16_t FormatVersion = 1;
+	constexpr std::size_t HeaderSize = 64;
+
+	struct FileHeader
+	{
+		char magic[4];
+		std::uint16_t version;
+		std::uint16_t bands;
+		std::uint16_t phaseBands;
+		std::uint16_t features;
+		std::uint32_t entries;
+		std::uint32_t sampleRate;  // what the table was built for; informational
+		std::uint32_t frameSize;
+		std::uint8_t reserved[40];
+	};
+
+	static_assert(sizeof(FileHeader) == HeaderSize, "header layout");
+
+	constexpr int Bands = BinauralCueTable::Bands;
+	constexpr int PhaseBands = BinauralCueTable::PhaseBands;
+	constexpr int Features = BinauralCueTable::Features;
+	constexpr float Tiny = 1e-20f;
+	// Power below this (summed over the bands, per frame) is treated as silence
+	constexpr float SilentPower = 1e-12f;
+
+	// Bins [first, last) that fall inside the bands, and the band of each
+	void AssignBins(const float* edges, unsigned int sampleRate, unsigned int frameSize,
+		unsigned int& first, unsigned int& last, std::vector<std::uint8_t>& band)
+	{
+		const float binHz = static_cast<float>(sampleRate) / static_cast<float>(frameSize);
+		if (edges[Bands] >= 0.5f * static_cast<float>(sampleRate)) {
+			throw std::runtime_error("Tabela HRTF vai alem de Nyquist para " + std::to_string(sampleRate) + " Hz");
+		}
+		first = static_cast<unsigned int>(std::ceil(edges[0] / binHz));
+		last = static_cast<unsigned int>(std::ceil(edges[Bands] / binHz));
+		band.assign(last - first, 0);
+		int perBand[Bands] = {};
+		for (unsigned int k = first; k < last; ++k) {
+			const float hz = static_cast<float>(k) * binHz;
+			int b = 0;
+			while (b < Bands - 1 && hz >= edges[b + 1]) ++b;
+			band[k - first] = static_cast<std::uint8_t>(b);
+			++perBand[b];
+		}
+		for (int b = 0; b < Bands; ++b) {
+			if (perBand[b] == 0) {
+				throw std::runtime_error("Bandas da tabela HRTF estreitas demais para quadros de " + std::to_string(frameSize));
+			}
+		}
+	}
+
+	float AzimuthDistance(float a, float b)
+	{
+		return std::fabs(std::remainder(a - b, 360.0f));
+	}
+}
+
+BinauralCueTable::BinauralCueTable(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	FileHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0
+		|| header.version != FormatVersion || header.bands != Bands || header.phaseBands != PhaseBands
+		|| header.features != Features || header.entries == 0) {
+		throw std::runtime_error("Tabela HRTF invalida: " + path);
+	}
+
+	// Checked before anything is sized from header.entries
+	const std::uint64_t expectedBytes = HeaderSize + (Bands + 1 + Features) * sizeof(float)
+		+ static_cast<std::uint64_t>(header.entries) * (2 + Features) * sizeof(float);
+	file.seekg(0, std::ios::end);
+	const std::streamoff fileBytes = file.tellg();
+	file.seekg(HeaderSize);
+	if (fileBytes < 0 || static_cast<std::uint64_t>(fileBytes) != expectedBytes) {
+		throw std::runtime_error("Tabela HRTF com tamanho inconsistente: " + path);
+	}
+
+	count = static_cast<int>(header.entries);
+	stride = (static_cast<std::size_t>(count) + 15) / 16 * 16;
+	edges.resize(Bands + 1);
+	featureWeights.resize(Features);
+	azimuths.resize(count);
+	elevations.resize(count);
+	columns.assign(Features * stride, 0.0f);
+
+	file.read(reinterpret_cast<char*>(edges.data()), edges.size() * sizeof(float));
+	file.read(reinterpret_cast<char*>(featureWeights.data()), featureWeights.size() * sizeof(float));
+	float entry[2 + Features];
+	for (int e = 0; e < count && file; ++e) {
+		file.read(reinterpret_cast<char*>(entry), sizeof(entry));
+		azimuths[e] = entry[0];
+		elevations[e] = entry[1];
+		for (int f = 0; f < Features; ++f) columns[f * stride + e] = entry[2 + f] * featureWeights[f];
+	}
+	if (!file) {
+		throw std::runtime_error("Tabela HRTF truncada: " + path);
+	}
+	for (int b = 0; b < Bands; ++b) {
+		if (!(edges[b] > 0.0f && edges[b + 1] > edges[b])) throw std::runtime_error("Tabela HRTF invalida: " + path);
+	}
+}
+
+void BinauralCueTable::distances(const float* features, float* out) const
+{
+	// Feature-major: each pass is a contiguous, vectorizable sweep over all entries
+	std::fill(out, out + count, 0.0f);
+	for (int f = 0; f < Features; ++f) {
+		const float* column = columns.data() + f * stride;
+		const float query = features[f] * featureWeights[f];
+		for (int e = 0; e < count; ++e) {
+			const float d = column[e] - query;
+			out[e] += d * d;
+		}
+	}
+}
+
+void BinauralFeatures(const float* powerLeft, const float* powerRight, const std::complex<float>* cross, float* features)
+{
+	float shape[Bands];
+	float mean = 0.0f;
+	for (int b = 0; b < Bands; ++b) {
+		features[b] = 10.0f * std::log10((powerLeft[b] + Tiny) / (powerRight[b] + Tiny));
+		shape[b] = 10.0f * std::log10(0.5f * (powerLeft[b] + powerRight[b]) + Tiny);
+		mean += shape[b];
+	}
+	mean /= Bands;
+	for (int p = 0; p < PhaseBands; ++p) {
+		const float magnitude = std::abs(cross[p]);
+		features[Bands + 2 * p] = magnitude > Tiny ? cross[p].real() / magnitude : 1.0f;
+		features[Bands + 2 * p + 1] = magnitude > Tiny ? cross[p].imag() / magnitude : 0.0f;
+	}
+	for (int b = 0; b < Bands; ++b) features[Bands + 2 * PhaseBands + b] = shape[b] - mean;
+}
+
+BinauralCueAnalyzer::BinauralCueAnalyzer(BinauralCueTable table, unsigned int sampleRate, unsigned int frameSize)
+	: cues(std::move(table)), size(frameSize), distances(cues.entries())
+{
+	AssignBins(cues.bandEdges(), sampleRate, frameSize, firstBin, lastBin, binBand);
+	for (int b = 0; b < Bands; ++b) bandCenterHz[b] = std::sqrt(cues.bandEdges()[b] * cues.bandEdges()[b + 1]);
+}
+
+void BinauralCueAnalyzer::reset()
+{
+	std::fill(std::begin(powerLeft), std::end(powerLeft), 0.0f);
+	std::fill(std::begin(powerRight), std::end(powerRight), 0.0f);
+	std::fill(std::begin(cross), std::end(cross), std::complex<float>());
+	primed = false;
+	current = {};
+}
+
+void BinauralCueAnalyzer::onSpectra(const std::complex<float>* left, const std::complex<float>* right, unsigned int frameSize)
+{
+	if (frameSize != size) return;
+
+	float frameLeft[Bands] = {};
+	float frameRight[Bands] = {};
+	std::complex<float> frameCross[PhaseBands] = {};
+	for (unsigned int k = firstBin; k < lastBin; ++k) {
+		const int b = binBand[k - firstBin];
+		const std::complex<float> l = left[k];
+		const std::complex<float> r = right[k];
+		frameLeft[b] += std::norm(l);
+		frameRight[b] += std::norm(r);
+		if (b < PhaseBands) frameCross[b] += l * std::conj(r);
+	}
+
+	float total = 0.0f;
+	for (int b = 0; b < Bands; ++b) total += frameLeft[b] + frameRight[b];
+	if (total < SilentPower) {
+		// Silence carries no cue; start over when sound comes back
+		primed = false;
+		current.valid = false;
+		return;
+	}
+
+	const float a = primed ? smoothing : 1.0f;
+	for (int b = 0; b < Bands; ++b) {
+		powerLeft[b] += a * (frameLeft[b] - powerLeft[b]);
+		powerRight[b] += a * (frameRight[b] - powerRight[b]);
+	}
+	for (int p = 0; p < PhaseBands; ++p) cross[p] += a * (frameCross[p] - cross[p]);
+	primed = true;
+
+	BinauralFeatures(powerLeft, powerRight, cross, features);
+	for (int b = 0; b < Bands; ++b) current.ild[b] = features[b];
+	for (int p = 0; p < PhaseBands; ++p) current.itdUs[p] = std::arg(cross[p]) / (2.0f * Pi * bandCenterHz[p]) * 1e6f;
+
+	cues.distances(features, distances.data());
+	const int n = cues.entries();
+	const int best = static_cast<int>(std::min_element(distances.begin(), distances.end()) - distances.begin());
+	// The best match elsewhere (front/back mirror, other side) says how ambiguous this one is
+	const float bestAzimuth = cues.azimuth(best);
+	float rival = -1.0f;
+	for (int e = 0; e < n; ++e) {
+		if (AzimuthDistance(cues.azimuth(e), bestAzimuth) > 45.0f && (rival < 0.0f || distances[e] < rival)) rival = distances[e];
+	}
+
+	current.valid = true;
+	current.distance = std::sqrt(distances[best]);
+	current.elevation = cues.elevation(best);
+	current.state.azimuth = bestAzimuth;
+	current.state.confidence = rival > 0.0f ? std::clamp((rival - distances[best]) / (rival + distances[best]), 0.0f, 1.0f) : 1.0f;
+	current.state.direction = directionFromAzimuth(bestAzimuth);
+}
+
+namespace
+{
+	constexpr float HeadRadius = 0.0875f;   // m
+	constexpr float SpeedOfSound = 343.0f;  // m/s
+	constexpr int HrirTaps = 256;
+	constexpr float HrirLatency = 16.0f;    // samples before the earliest arrival
+
+	// Windowed-sinc impulse at a fractional position
+	void AddImpulse(float* out, int taps, float position, float gain)
+	{
+		constexpr int Half = 8;
+		const int center = static_cast<int>(std::floor(position));
+		for (int n = center - Half + 1; n <= center + Half; ++n) {
+			if (n < 0 || n >= taps) continue;
+			const float t = static_cast<float>(n) - position;
+			const float sinc = std::fabs(t) < 1e-6f ? 1.0f : std::sin(Pi * t) / (Pi * t);
+			const float window = 0.5f + 0.5f * std::cos(Pi * t / Half);
+			out[n] += gain * sinc * window;
+		}
+	}
+
+	// Brown & Duda structural model for one ear; earSide -1 = left, +1 = right
+	void SphericalHeadEar(float azimuth, float elevation, unsigned int sampleRate, float earSide, float* out)
+	{
+		const float az = azimuth * DegToRad;
+		const float el = elevation * DegToRad;
+		const float fs = static_cast<float>(sampleRate);
+
+		// Angle between the source and the ear's axis
+		const float lateral = std::cos(el) * std::sin(az);
+		const float theta = std::acos(std::clamp(earSide * lateral, -1.0f, 1.0f));
+		const float delaySec = HeadRadius / SpeedOfSound * (theta < 0.5f * Pi ? 1.0f - std::cos(theta) : 1.0f + theta - 0.5f * Pi);
+		const float arrival = HrirLatency + delaySec * fs;
+
+		// Pinna: echoes whose delays move with azimuth (front/back) and elevation
+		constexpr float Rho[5] = { 0.5f, -1.0f, 0.5f, -0.25f, 0.25f };
+		constexpr float A[5] = { 1.0f, 5.0f, 5.0f, 5.0f, 5.0f };
+		constexpr float B[5] = { 2.0f, 4.0f, 7.0f, 11.0f, 13.0f };
+		constexpr float D[5] = { 1.0f, 0.5f, 0.5f, 0.5f, 0.5f };
+		std::fill(out, out + HrirTaps, 0.0f);
+		AddImpulse(out, HrirTaps, arrival, 1.0f);
+		for (int k = 0; k < 5; ++k) {
+			const float echo = A[k] * std::cos(0.5f * std::fabs(az)) * std::sin(D[k] * (0.5f * Pi - el)) + B[k];
+			AddImpulse(out, HrirTaps, arrival + echo * fs / 44100.0f, Rho[k]);
+		}
+
+		// Head shadow: (alpha s + beta) / (s + beta), bilinear
+		constexpr float AlphaMin = 0.1f;
+		constexpr float ThetaMin = 150.0f * DegToRad;
+		const float alpha = (1.0f + 0.5f * AlphaMin) + (1.0f - 0.5f * AlphaMin) * std::cos(theta / ThetaMin * Pi);
+		const float beta = 2.0f * SpeedOfSound / HeadRadius;
+		const float k2 = 2.0f * fs;
+		const float b0 = (alpha * k2 + beta) / (k2 + beta);
+		const float b1 = (beta - alpha * k2) / (k2 + beta);
+		const float a1 = (beta - k2) / (k2 + beta);
+		float x1 = 0.0f, y1 = 0.0f;
+		for (int n = 0; n < HrirTaps; ++n) {
+			const float x = out[n];
+			const float y = b0 * x + b1 * x1 - a1 * y1;
+			x1 = x;
+			y1 = y;
+			out[n] = y;
+		}
+
+		// Sources behind lose some treble to the pinna flap
+		const float rear = 0.5f * std::max(0.0f, -std::cos(az) * std::cos(el));
+		const float k = 1.0f - std::exp(-2.0f * Pi * 4000.0f / fs);
+		float low = 0.0f;
+		for (int n = 0; n < HrirTaps; ++n) {
+			low += k * (out[n] - low);
+			out[n] = (1.0f - rear) * out[n] + rear * low;
+		}
+	}
+
+	void SphericalHeadHrir(float azimuth, float elevation, unsigned int sampleRate, float* left, float* right)
+	{
+		SphericalHeadEar(azimuth, elevation, sampleRate, -1.0f, left);
+		SphericalHeadEar(azimuth, elevation, sampleRate, 1.0f, right);
+	}
+
+	void DefaultBandEdges(unsigned int sampleRate, float* edges)
+	{
+		const float low = 200.0f;
+		const float high = std::min(14000.0f, 0.45f * static_cast<float>(sampleRate));
+		for (int b = 0; b <= Bands; ++b) edges[b] = low * std::pow(high / low, static_cast<float>(b) / Bands);
+	}
+}
+
+void WriteSphericalHeadCueTable(const std::string& path, unsigned int sampleRate, unsigned int frameSize, float azimuthStep)
+{
+	if (frameSize < HrirTaps || (frameSize & (frameSize - 1)) != 0 || azimuthStep <= 0.0f) {
+		throw std::runtime_error("Parametros invalidos para a tabela HRTF");
+	}
+	float edges[Bands + 1];
+	DefaultBandEdges(sampleRate, edges);
+	unsigned int firstBin, lastBin;
+	std::vector<std::uint8_t> binBand;
+	AssignBins(edges, sampleRate, frameSize, firstBin, lastBin, binBand);
+
+	// One unit of distance: 3 dB of ILD, ~20 degrees of interaural phase, 4 dB of spectral shape
+	float weights[Features];
+	for (int f = 0; f < Features; ++f) {
+		weights[f] = f < Bands ? 1.0f / 3.0f : f < Bands + 2 * PhaseBands ? 1.0f / 0.35f : 1.0f / 4.0f;
+	}
+
+	const float elevationGrid[] = { -30.0f, -15.0f, 0.0f, 15.0f, 30.0f, 45.0f, 60.0f };
+	const int azimuths = static_cast<int>(std::round(360.0f / azimuthStep));
+	const FftPlan& plan = GetFftPlan(frameSize);
+	std::vector<float> left(frameSize, 0.0f), right(frameSize, 0.0f);
+	std::vector<std::complex<float>> scratch(frameSize), spectrumLeft(frameSize / 2 + 1), spectrumRight(frameSize / 2 + 1);
+	std::vector<float> entries;
+
+	for (const float elevation : elevationGrid) {
+		for (int i = 0; i < azimuths; ++i) {
+			const float azimuth = std::remainder(-180.0f + (i + 1) * azimuthStep, 360.0f);
+			SphericalHeadHrir(azimuth, elevation, sampleRate, left.data(), right.data());
+			plan.forwardTwoReal(left.data(), right.data(), scratch.data(), spectrumLeft.data(), spectrumRight.data());
+
+			float powerLeft[Bands] = {}, powerRight[Bands] = {};
+			std::complex<float> cross[PhaseBands] = {};
+			for (unsigned int k = firstBin; k < lastBin; ++k) {
+				const int b = binBand[k - firstBin];
+				powerLeft[b] += std::norm(spectrumLeft[k]);
+				powerRight[b] += std::norm(spectrumRight[k]);
+				if (b < PhaseBands) cross[b] += spectrumLeft[k] * std::conj(spectrumRight[k]);
+			}
+			float features[Features];
+			BinauralFeatures(powerLeft, powerRight, cross, features);
+			entries.push_back(azimuth);
+			entries.push_back(elevation);
+			entries.insert(entries.end(), features, features + Features);
+		}
+	}
+
+	FileHeader header = {};
+	std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+	header.version = FormatVersion;
+	header.bands = Bands;
+	header.phaseBands = PhaseBands;
+	header.features = Features;
+	header.entries = static_cast<std::uint32_t>(entries.size() / (2 + Features));
+	header.sampleRate = sampleRate;
+	header.frameSize = frameSize;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(edges), sizeof(edges));
+	file.write(reinterpret_cast<const char*>(weights), sizeof(weights));
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(float));
+	if (!file) {
+		throw std::runtime_error("Falha ao gravar a tabela HRTF: " + path);
+	}
+}
+
+bool BenchmarkBinauralCues(const std::string& tablePath, double durationSec)
+{
+	using Clock = std::chrono::steady_clock;
+	constexpr unsigned int Rate = 48000;
+	constexpr unsigned int Packet = 480;
+
+	const BinauralCueTable table(tablePath);
+	std::cout << "Tabela " << tablePath << ": " << table.entries() << " direcoes, " << Features << " valores cada\n";
+
+	// Off the 5-degree grid, all around, at two elevations
+	std::vector<std::pair<float, float>> directions;
+	for (const float elevation : { 0.0f, 20.0f }) {
+		for (int i = 0; i < 12; ++i) directions.push_back({ std::remainder(-167.5f + 30.0f * i, 360.0f), elevation });
+	}
+	const unsigned int caseFrames = static_cast<unsigned int>(std::max(0.5, durationSec / directions.size()) * Rate) / Packet * Packet;
+	const unsigned int settleFrames = Rate / 5;
+
+	std::uint32_t state = 99;
+	std::vector<float> noise(caseFrames + HrirTaps);
+	for (auto& x : noise) {
+		state = state * 1664525u + 1013904223u;
+		x = 0.1f * (static_cast<float>(state >> 8) / 8388608.0f - 1.0f);
+	}
+
+	float left[HrirTaps], right[HrirTaps];
+	std::vector<float> stereo(static_cast<std::size_t>(caseFrames) * 2);
+	auto render = [&](float azimuth, float elevation) {
+		SphericalHeadHrir(azimuth, elevation, Rate, left, right);
+		for (unsigned int n = 0; n < caseFrames; ++n) {
+			float l = 0.0f, r = 0.0f;
+			for (int t = 0; t < HrirTaps; ++t) {
+				const float x = noise[n + HrirTaps - 1 - t];
+				l += left[t] * x;
+				r += right[t] * x;
+			}
+			stereo[n * 2] = l;
+			stereo[n * 2 + 1] = r;
+		}
+	};
+
+	double azimuthError = 0.0, elevationError = 0.0;
+	std::uint64_t estimates = 0, confusions = 0, sided = 0;
+	std::cout << "Ruido renderizado pelo modelo, azimute/elevacao estimados (media apos 0,2 s):\n";
+	for (const auto& [azimuth, elevation] : directions) {
+		render(azimuth, elevation);
+		GccPhatEstimator delay(Rate);
+		BinauralCueAnalyzer analyzer(table, Rate, delay.frameSize());
+		delay.setSpectrumSink(&analyzer);
+
+		double caseAzimuth = 0.0, caseElevation = 0.0;
+		std::uint64_t caseCount = 0, caseConfused = 0;
+		for (unsigned int at = 0; at < caseFrames; at += Packet) {
+			delay.push(stereo.data() + static_cast<std::size_t>(at) * 2, Packet, 2);
+			const BinauralEstimate& estimate = analyzer.estimate();
+			if (at < settleFrames || !estimate.valid) continue;
+			caseAzimuth += AzimuthDistance(estimate.state.azimuth, azimuth);
+			caseElevation += std::fabs(estimate.elevation - elevation);
+			++caseCount;
+			// Front/back only means something away from the sides
+			if (std::fabs(std::cos(azimuth * DegToRad)) > 0.25f) {
+				++sided;
+				if ((std::cos(estimate.state.azimuth * DegToRad) > 0.0f) != (std::cos(azimuth * DegToRad) > 0.0f)) ++caseConfused;
+			}
+		}
+		azimuthError += caseAzimuth;
+		elevationError += caseElevation;
+		estimates += caseCount;
+		confusions += caseConfused;
+		std::cout << "  " << azimuth << "/" << elevation << ": erro azimute " << (caseCount ? caseAzimuth / caseCount : 0.0)
+			<< ", elevacao " << (caseCount ? caseElevation / caseCount : 0.0) << " graus, "
+			<< caseConfused << " trocas frente/tras de " << caseCount << '\n';
+	}
+
+	// Cost of the binaural stage on top of the GCC-PHAT transform it shares
+	render(40.0f, 0.0f);
+	auto timeRun = [&](bool binaural) {
+		GccPhatEstimator delay(Rate);
+		BinauralCueAnalyzer analyzer(table, Rate, delay.frameSize());
+		if (binaural) delay.setSpectrumSink(&analyzer);
+		const auto start = Clock::now();
+		for (int repeat = 0; repeat < 4; ++repeat) {
+			for (unsigned int at = 0; at < caseFrames; at += Packet) delay.push(stereo.data() + static_cast<std::size_t>(at) * 2, Packet, 2);
+		}
+		return std::chrono::duration<double>(Clock::now() - start).count() / (4.0 * caseFrames / Rate);
+	};
+	const double delayOnly = timeRun(false);
+	const double withCues = timeRun(true);
+
+	const double meanAzimuth = estimates ? azimuthError / estimates : 180.0;
+	const double confusionRate = sided ? static_cast<double>(confusions) / sided : 1.0;
+	std::cout << "Erro medio: azimute " << meanAzimuth << " graus, elevacao " << (estimates ? elevationError / estimates : 0.0)
+		<< " graus; trocas frente/tras " << 100.0 * confusionRate << "%\n";
+	std::cout << "Custo: GCC-PHAT " << 100.0 * delayOnly << "% de um nucleo, com pistas binaurais " << 100.0 * withCues << "%\n";
+	const bool ok = meanAzimuth < 15.0 && confusionRate < 0.1;
+	std::cout << (ok ? "OK" : "FALHOU") << '\n';
+	return ok;
+}
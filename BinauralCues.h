@@ -0,0 +1,104 @@
+#pragma once
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Direction.h"
+#include "GccPhat.h"
+
+// Binaural cue table file (.avhc): for each direction of an HRTF set, the cues a
+// headphone mix rendered through it shows, per band. Features, in this order:
+// Bands ILDs (dB, left over right), the interaural phase of the PhaseBands lowest bands
+// as cos/sin pairs (an ITD that never wraps), and Bands spectral-shape values (dB of the
+// mean ear power relative to its average over bands), which carry the front/back and
+// elevation notches.
+//
+// Layout (little endian): 64-byte header, Bands + 1 band edges (Hz), Features weights,
+// then per entry azimuth, elevation and Features values. Loading multiplies the weights
+// in and stores the table feature-major, so a nearest-neighbour search is one
+// contiguous pass per feature over all entries.
+class BinauralCueTable
+{
+public:
+	static constexpr int Bands = 16;
+	static constexpr int PhaseBands = 8;
+	static constexpr int Features = 2 * Bands + 2 * PhaseBands;
+
+	explicit BinauralCueTable(const std::string& path);
+
+	int entries() const { return count; }
+	float azimuth(int entry) const { return azimuths[entry]; }
+	float elevation(int entry) const { return elevations[entry]; }
+	const float* bandEdges() const { return edges.data(); }
+	const float* weights() const { return featureWeights.data(); }
+
+	// Squared weighted distance from features (unweighted) to every entry, into
+	// distances[0..entries()). Does not allocate.
+	void distances(const float* features, float* out) const;
+
+private:
+	std::vector<float> edges;
+	std::vector<float> featureWeights;
+	std::vector<float> azimuths, elevations;
+	std::vector<float> columns;   // Features rows of stride floats, weights applied
+	int count = 0;
+	std::size_t stride = 0;       // entries rounded up to 16
+};
+
+// Turns band sums of the left and right power and of left times conj(right) into the
+// table's feature vector. Shared by table generation and the analyzer, so both measure
+// the same way.
+void BinauralFeatures(const float* powerLeft, const float* powerRight, const std::complex<float>* cross, float* features);
+
+struct BinauralEstimate
+{
+	bool valid = false;
+	DirectionState state;        // full-circle azimuth; confidence from how clearly it beat the other side
+	float elevation = 0.0f;
+	float distance = 0.0f;       // weighted feature distance to the matched entry
+	float ild[BinauralCueTable::Bands] = {};          // dB, > 0: louder on the left
+	float itdUs[BinauralCueTable::PhaseBands] = {};   // from the band's phase, > 0: left leads
+};
+
+// Per-band ILD/ITD and spectral shape of a stereo headphone mix, matched against a
+// BinauralCueTable. Takes its spectra from a GccPhatEstimator (see StereoSpectrumSink),
+// so the FFT is shared with the delay cue; band powers are averaged over a few frames.
+class BinauralCueAnalyzer : public StereoSpectrumSink
+{
+public:
+	BinauralCueAnalyzer(BinauralCueTable table, unsigned int sampleRate, unsigned int frameSize = 1024);
+
+	void onSpectra(const std::complex<float>* left, const std::complex<float>* right, unsigned int frameSize) override;
+	void reset();
+
+	const BinauralEstimate& estimate() const { return current; }
+	const BinauralCueTable& table() const { return cues; }
+
+private:
+	BinauralCueTable cues;
+	unsigned int size;
+	unsigned int firstBin, lastBin;
+	std::vector<std::uint8_t> binBand;    // band of each bin in [firstBin, lastBin]
+	float bandCenterHz[BinauralCueTable::Bands];
+	float smoothing = 0.25f;
+	bool primed = false;
+	float powerLeft[BinauralCueTable::Bands] = {};
+	float powerRight[BinauralCueTable::Bands] = {};
+	std::complex<float> cross[BinauralCueTable::PhaseBands] = {};
+	float features[BinauralCueTable::Features] = {};
+	std::vector<float> distances;
+	BinauralEstimate current;
+};
+
+// Writes a cue table for a spherical-head model (Brown & Duda: head shadow, Woodworth
+// delay, pinna echoes, plus a mild shadow for sources behind) on a grid of
+// azimuthStep degrees and a few elevations. Stands in for a measured HRTF set.
+void WriteSphericalHeadCueTable(const std::string& path, unsigned int sampleRate = 48000, unsigned int frameSize = 1024,
+	float azimuthStep = 5.0f);
+
+// Renders noise through the model's impulse responses from directions between the
+// table's grid points and reports azimuth/elevation error, front/back confusions and
+// the cost next to GCC-PHAT alone. Returns false when the mean azimuth error exceeds
+// 15 degrees or more than 10% of the estimates land in the wrong hemisphere.
+bool BenchmarkBinauralCues(const std::string& tablePath, double durationSec);
@@ -4,56 +4,18 @@
 #include <iostream>
 #include <comdef.h>
 #include <fstream>
+#include <memory>
 #include <vector>
 #include <algorithm> // Para std::min e std::max
 
+#include "FlacFile.h"
+#include "RecordingWriter.h"
+#include "WavFile.h"
+
 #pragma comment(lib, "Ole32.lib")
 
 #define REFTIMES_PER_SEC  10000000  // Unidade de tempo para WASAPI (100 nanossegundos)
 
-// Estrutura do cabealho WAV
-struct WAVHeader {
-    char chunkID[4] = { 'R', 'I', 'F', 'F' }; // "RIFF"
-    uint32_t chunkSize;                       // Tamanho do arquivo - 8 bytes
-    char format[4] = { 'W', 'A', 'V', 'E' }; // "WAVE"
-    char subchunk1ID[4] = { 'f', 'm', 't', ' ' }; // "fmt "
-    uint32_t subchunk1Size = 16;              // Tamanho do subchunk (16 para PCM)
-    uint16_t audioFormat = 1;                 // Formato de udio (1 para PCM)
-    uint16_t numChannels;                     // Nmero de canais
-    uint32_t sampleRate;                      // Taxa de amostragem
-    uint32_t byteRate;                        // Bytes por segundo
-    uint16_t blockAlign;                      // Alinhamento do bloco
-    uint16_t bitsPerSample;                   // Bits por amostra
-    char subchunk2ID[4] = { 'd', 'a', 't', 'a' }; // "data"
-    uint32_t subchunk2Size;                   // Tamanho dos dados de udio
-};
-
-// Funo para escrever o cabealho WAV
-void WriteWAVHeader(std::ofstream& file, const WAVHeader& header) {
-    file.write(header.chunkID, 4);
-    file.write(reinterpret_cast<const char*>(&header.chunkSize), 4);
-    file.write(header.format, 4);
-    file.write(header.subchunk1ID, 4);
-    file.write(reinterpret_cast<const char*>(&header.subchunk1Size), 4);
-    file.write(reinterpret_cast<const char*>(&header.audioFormat), 2);
-    file.write(reinterpret_cast<const char*>(&header.numChannels), 2);
-    file.write(reinterpret_cast<const char*>(&header.sampleRate), 4);
-    file.write(reinterpret_cast<const char*>(&header.byteRate), 4);
-    file.write(reinterpret_cast<const char*>(&header.blockAlign), 2);
-    file.write(reinterpret_cast<const char*>(&header.bitsPerSample), 2);
-    file.write(header.subchunk2ID, 4);
-    file.write(reinterpret_cast<const char*>(&header.subchunk2Size), 4);
-}
-
-// Funo para normalizar udio em formato float para PCM de 16 bits
-void NormalizeAudio(const float* input, int16_t* output, size_t numSamples) {
-    for (size_t i = 0; i < numSamples; i++) {
-        float sample = input[i];
-        sample = max(-1.0f, min(1.0f, sample)); // Limita o valor entre -1.0 e 1.0
-        output[i] = static_cast<int16_t>(sample * 32767.0f); // Converte para PCM de 16 bits
-    }
-}
-
 void CaptureAudio(const std::string& outputFile) {
     HRESULT hr;
     IMMDeviceEnumerator* pEnumerator = nullptr;
@@ -145,6 +107,22 @@ void CaptureAudio(const std::string& outputFile) {
         return;
     }
 
+    // PCM inteiro: a gravao mantm a profundidade de bits do dispositivo
+    PcmEncoding pcmEncoding = PcmEncoding::Int16;
+    if (!isFloat) {
+        if (pwfx->wBitsPerSample == 24) pcmEncoding = PcmEncoding::Int24;
+        else if (pwfx->wBitsPerSample == 32) pcmEncoding = PcmEncoding::Int32;
+        else if (pwfx->wBitsPerSample != 16) {
+            std::wcerr << "Profundidade de bits no suportada: " << pwfx->wBitsPerSample << std::endl;
+            CoTaskMemFree(pwfx);
+            pAudioClient->Release();
+            pDevice->Release();
+            pEnumerator->Release();
+            CoUninitialize();
+            return;
+        }
+    }
+
     // Inicializa o cliente de udio no modo loopback
     hr = pAudioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_LOOPBACK, hnsRequestedDuration, 0, pwfx, nullptr);
     if (FAILED(hr)) {
@@ -182,35 +160,58 @@ void CaptureAudio(const std::string& outputFile) {
         return;
     }
 
-    // Abre o arquivo WAV para escrita
-    std::ofstream wavFile(outputFile, std::ios::binary);
-    if (!wavFile.is_open()) {
-        std::wcerr << "Erro ao abrir o arquivo WAV para escrita." << std::endl;
-        pCaptureClient->Release();
-        CoTaskMemFree(pwfx);
-        pAudioClient->Release();
-        pDevice->Release();
-        pEnumerator->Release();
-        CoUninitialize();
-        return;
+    // Arquivos ".flac" so comprimidos pelo pool de codificao do FlacWriter;
+    // este lao s copia os blocos
+    std::unique_ptr<FlacWriter> flacWriter;
+    if (outputFile.size() > 5 && outputFile.compare(outputFile.size() - 5, 5, ".flac") == 0) {
+        try {
+            // FLAC vai at 24 bits: PCM de 32 bits perde os 8 bits de baixo
+            const int flacBits = !isFloat && pcmEncoding != PcmEncoding::Int16 ? 24 : 16;
+            flacWriter = std::make_unique<FlacWriter>(outputFile, pwfx->nChannels, pwfx->nSamplesPerSec, flacBits);
+        } catch (const std::exception& e) {
+            std::cerr << "Erro ao criar o arquivo FLAC: " << e.what() << std::endl;
+            pCaptureClient->Release();
+            CoTaskMemFree(pwfx);
+            pAudioClient->Release();
+            pDevice->Release();
+            pEnumerator->Release();
+            CoUninitialize();
+            return;
+        }
     }
 
-    // Prepara o cabealho WAV
-    WAVHeader wavHeader;
-    wavHeader.numChannels = pwfx->nChannels;
-    wavHeader.sampleRate = pwfx->nSamplesPerSec; // Usa a taxa de amostragem do udio capturado
-    wavHeader.bitsPerSample = 16; // Foramos PCM de 16 bits
-    wavHeader.byteRate = wavHeader.sampleRate * wavHeader.numChannels * (wavHeader.bitsPerSample / 8);
-    wavHeader.blockAlign = wavHeader.numChannels * (wavHeader.bitsPerSample / 8);
-
-    // Escreve o cabealho WAV (o tamanho dos dados ser atualizado posteriormente)
-    WriteWAVHeader(wavFile, wavHeader);
+    // Demais caminhos: WAV que vira RF64 depois de 4 GB (ou Wave64 para ".w64"), com
+    // espao pr-alocado e cabealho atualizado periodicamente
+    std::unique_ptr<RecordingWriter> wavWriter;
+    if (!flacWriter) {
+        try {
+            RecordingOptions recording;
+            recording.container = ContainerForPath(outputFile);
+            recording.bitsPerSample = isFloat ? 16 : pwfx->wBitsPerSample;
+            wavWriter = std::make_unique<RecordingWriter>(outputFile, pwfx->nChannels, pwfx->nSamplesPerSec, recording);
+        } catch (const std::exception& e) {
+            std::cerr << "Erro ao abrir o arquivo WAV para escrita: " << e.what() << std::endl;
+            pCaptureClient->Release();
+            CoTaskMemFree(pwfx);
+            pAudioClient->Release();
+            pDevice->Release();
+            pEnumerator->Release();
+            CoUninitialize();
+            return;
+        }
+    }
 
     std::cout << "Capturando udio de sada e salvando em " << outputFile << "..." << std::endl;
 
     // Loop de captura
-    uint32_t totalBytesWritten = 0;
     std::vector<int16_t> pcmBuffer; // Buffer para armazenar dados PCM de 16 bits
+    std::vector<int32_t> flacBuffer; // PCM de 24/32 bits levado a 24 bits para o FLAC
+    // Reserva o tamanho do buffer do dispositivo: resize() no loop nunca realoca
+    UINT32 deviceBufferFrames = 0;
+    if (SUCCEEDED(pAudioClient->GetBufferSize(&deviceBufferFrames))) {
+        pcmBuffer.reserve(static_cast<size_t>(deviceBufferFrames) * pwfx->nChannels);
+        if (flacWriter && !isFloat) flacBuffer.reserve(static_cast<size_t>(deviceBufferFrames) * pwfx->nChannels);
+    }
     while (true) {
         // Obtm os dados capturados
         hr = pCaptureClient->GetBuffer(&pData, &bufferFrameCount, &flags, nullptr, nullptr);
@@ -225,13 +226,22 @@ void CaptureAudio(const std::string& outputFile) {
                 // Normaliza os dados de float para PCM de 16 bits
                 pcmBuffer.resize(bufferFrameCount * pwfx->nChannels);
                 NormalizeAudio(reinterpret_cast<const float*>(pData), pcmBuffer.data(), bufferFrameCount * pwfx->nChannels);
-                wavFile.write(reinterpret_cast<const char*>(pcmBuffer.data()), pcmBuffer.size() * sizeof(int16_t));
-                totalBytesWritten += pcmBuffer.size() * sizeof(int16_t);
+                if (flacWriter) flacWriter->write(pcmBuffer.data(), bufferFrameCount);
+                else wavWriter->write(pcmBuffer.data(), bufferFrameCount);
             }
             else {
                 // Escreve os dados PCM diretamente
-                wavFile.write(reinterpret_cast<const char*>(pData), bufferFrameCount * pwfx->nBlockAlign);
-                totalBytesWritten += bufferFrameCount * pwfx->nBlockAlign;
+                if (flacWriter && pcmEncoding == PcmEncoding::Int16) {
+                    flacWriter->write(reinterpret_cast<const int16_t*>(pData), bufferFrameCount);
+                }
+                else if (flacWriter) {
+                    flacBuffer.resize(static_cast<size_t>(bufferFrameCount) * pwfx->nChannels);
+                    for (size_t i = 0; i < flacBuffer.size(); ++i) {
+                        flacBuffer[i] = LoadPcmSample(pData, pcmEncoding, i) >> 8;
+                    }
+                    flacWriter->write(flacBuffer.data(), bufferFrameCount);
+                }
+                else wavWriter->write(pData, pcmEncoding, bufferFrameCount);
             }
         }
 
@@ -243,14 +253,14 @@ void CaptureAudio(const std::string& outputFile) {
         }
     }
 
-    // Atualiza o cabealho WAV com o tamanho dos dados
-    wavHeader.chunkSize = totalBytesWritten + sizeof(WAVHeader) - 8;
-    wavHeader.subchunk2Size = totalBytesWritten;
-    wavFile.seekp(0);
-    WriteWAVHeader(wavFile, wavHeader);
-
-    // Fecha o arquivo WAV
-    wavFile.close();
+    // Espera o pool terminar os ltimos blocos (FLAC) ou grava o ltimo cabealho e
+    // devolve o espao pr-alocado que sobrou (WAV)
+    try {
+        if (flacWriter) flacWriter->close();
+        else wavWriter->close();
+    } catch (const std::exception& e) {
+        std::cerr << "Erro ao finalizar o arquivo de sada: " << e.what() << std::endl;
+    }
 
     // Para a captura
     hr = pAudioClient->Stop();
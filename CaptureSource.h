@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+struct AudioFormat
+{
+	int channels = 0;
+	unsigned int sampleRate = 0;
+};
+
+// Interleaved integer PCM as devices and WAV files deliver it, little endian.
+enum class PcmEncoding : std::uint8_t
+{
+	Int16,
+	Int24,  // packed, 3 bytes per sample
+	Int32   // also 24-in-32 containers, which are left-justified
+};
+
+inline unsigned int PcmBytesPerSample(PcmEncoding encoding)
+{
+	return encoding == PcmEncoding::Int16 ? 2 : encoding == PcmEncoding::Int24 ? 3 : 4;
+}
+
+// Sample i left-justified in an int32, so full scale is 2^31 for every encoding.
+inline std::int32_t LoadPcmSample(const void* pcm, PcmEncoding encoding, std::size_t i)
+{
+	const auto* p = static_cast<const std::uint8_t*>(pcm) + i * PcmBytesPerSample(encoding);
+	std::uint32_t value = 0;
+	switch (encoding) {
+	case PcmEncoding::Int16: value = static_cast<std::uint32_t>(p[0]) << 16 | static_cast<std::uint32_t>(p[1]) << 24; break;
+	case PcmEncoding::Int24: value = static_cast<std::uint32_t>(p[0]) << 8 | static_cast<std::uint32_t>(p[1]) << 16 | static_cast<std::uint32_t>(p[2]) << 24; break;
+	case PcmEncoding::Int32: value = p[0] | static_cast<std::uint32_t>(p[1]) << 8 | static_cast<std::uint32_t>(p[2]) << 16 | static_cast<std::uint32_t>(p[3]) << 24; break;
+	}
+	return static_cast<std::int32_t>(value);
+}
+
+// One block of float samples handed out by a CaptureSource, interleaved unless the
+// source hands out planes (only sources fed by library callers do).
+struct CapturePacket
+{
+	const float* samples = nullptr;
+	const float* const* planes = nullptr; // one buffer per channel instead of samples (planar input)
+	// Integer PCM instead of samples: the level analysis reads it without converting;
+	// stages that need floats skip the packet
+	const void* pcm = nullptr;
+	PcmEncoding pcmEncoding = PcmEncoding::Int16;
+	unsigned int frameCount = 0;
+	bool silent = false;            // same meaning as AUDCLNT_BUFFERFLAGS_SILENT
+	std::uint64_t timestampUs = 0;  // stream position of the first frame
+	std::uint64_t readyNs = 0;      // SteadyNowNs() when the device had the whole packet, 0 if unknown
+};
+
+// Monotonic clock shared by sources and the pipeline for latency measurements.
+inline std::uint64_t SteadyNowNs()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Anything that produces audio for the analysis pipeline: the WASAPI loopback,
+// a synthetic generator, a WAV replay...
+class CaptureSource
+{
+public:
+	virtual ~CaptureSource() = default;
+
+	virtual AudioFormat format() const = 0;
+	// Returns false at end of stream. The packet data stays valid until the next call.
+	virtual bool nextPacket(CapturePacket& packet) = 0;
+};
@@ -0,0 +1,564 @@
+#include "CoroutinePipeline.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "CaptureSource.h"
+#include "DirectionPipeline.h"
+#include "FrameBus.h"
+#include "LatencyHistogram.h"
+#include "SignalGenerator.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+EventLoop::EventLoop()
+{
+#ifdef __linux__
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (epollFd < 0 || wakeFd < 0) {
+		if (epollFd >= 0) ::close(epollFd);
+		if (wakeFd >= 0) ::close(wakeFd);
+		throw std::runtime_error("Falha ao criar epoll/eventfd");
+	}
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr; // the only registration without a coroutine behind it
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) != 0) {
+		::close(epollFd);
+		::close(wakeFd);
+		throw std::runtime_error("Falha ao registrar o eventfd no epoll");
+	}
+#else
+	throw std::runtime_error("O pipeline com corrotinas requer epoll (Linux)");
+#endif
+}
+
+EventLoop::~EventLoop()
+{
+	// Suspended frames go first: they may still refer to fds below
+	tasks.clear();
+#ifdef __linux__
+	if (epollFd >= 0) ::close(epollFd);
+	if (wakeFd >= 0) ::close(wakeFd);
+#endif
+}
+
+void EventLoop::spawn(Task task)
+{
+	schedule(task.handle);
+	tasks.push_back(std::move(task));
+}
+
+void EventLoop::stop()
+{
+	stopping.store(true);
+#ifdef __linux__
+	const std::uint64_t one = 1;
+	[[maybe_unused]] const ssize_t written = ::write(wakeFd, &one, sizeof(one));
+#endif
+}
+
+void EventLoop::watch(int fd, std::coroutine_handle<> handle)
+{
+#ifdef __linux__
+	// One-shot: the fd is disarmed once it fires, so a waiter is resumed exactly once
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = handle.address();
+	const bool known = std::find(watched.begin(), watched.end(), fd) != watched.end();
+	if (epoll_ctl(epollFd, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0) {
+		throw std::runtime_error("epoll_ctl falhou");
+	}
+	if (!known) watched.push_back(fd);
+#else
+	(void)fd;
+	(void)handle;
+#endif
+}
+
+void EventLoop::run()
+{
+#ifdef __linux__
+	epoll_event events[16];
+	while (!stopping.load()) {
+		while (!ready.empty()) {
+			const std::coroutine_handle<> handle = ready.front();
+			ready.pop_front();
+			handle.resume();
+		}
+
+		bool live = false;
+		for (const Task& task : tasks) {
+			if (task.handle.done() && task.handle.promise().error) {
+				std::rethrow_exception(std::exchange(task.handle.promise().error, nullptr));
+			}
+			live = live || !task.handle.done();
+		}
+		if (!live || stopping.load()) break;
+
+		const int count = epoll_wait(epollFd, events, static_cast<int>(std::size(events)), -1);
+		++wakeupCount;
+		for (int i = 0; i < count; ++i) {
+			if (events[i].data.ptr == nullptr) {
+				std::uint64_t value;
+				[[maybe_unused]] const ssize_t bytes = ::read(wakeFd, &value, sizeof(value));
+				continue;
+			}
+			schedule(std::coroutine_handle<>::from_address(events[i].data.ptr));
+		}
+	}
+#endif
+}
+
+PeriodicTimer::PeriodicTimer(std::uint64_t firstNs, std::uint64_t periodNs)
+{
+#ifdef __linux__
+	// steady_clock is CLOCK_MONOTONIC here, so SteadyNowNs() deadlines arm the timer directly
+	timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerFd < 0) throw std::runtime_error("Falha ao criar timerfd");
+	itimerspec spec{};
+	spec.it_value.tv_sec = static_cast<time_t>(firstNs / 1000000000);
+	spec.it_value.tv_nsec = static_cast<long>(firstNs % 1000000000);
+	spec.it_interval.tv_sec = static_cast<time_t>(periodNs / 1000000000);
+	spec.it_interval.tv_nsec = static_cast<long>(periodNs % 1000000000);
+	if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+		::close(timerFd);
+		throw std::runtime_error("Falha ao armar timerfd");
+	}
+#else
+	(void)firstNs;
+	(void)periodNs;
+	throw std::runtime_error("PeriodicTimer requer timerfd (Linux)");
+#endif
+}
+
+PeriodicTimer::~PeriodicTimer()
+{
+#ifdef __linux__
+	if (timerFd >= 0) ::close(timerFd);
+#endif
+}
+
+std::uint64_t PeriodicTimer::expirations()
+{
+#ifdef __linux__
+	std::uint64_t count = 0;
+	if (::read(timerFd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) return 0;
+	return count;
+#else
+	return 0;
+#endif
+}
+
+#ifdef __linux__
+namespace
+{
+	constexpr unsigned int PacketFrames = 480;
+	constexpr std::uint64_t PacketNs = 10000000; // 480 frames at 48 kHz
+	constexpr std::size_t ChannelCapacity = 4;
+	constexpr std::size_t SlotCount = 2 * ChannelCapacity;
+
+	// Stands in for the loopback device: int16 packets that become available on a
+	// fixed 10 ms schedule starting at startNs.
+	class SimulatedDevice
+	{
+	public:
+		SimulatedDevice(int channels, double seconds, std::uint64_t startNs)
+			: generator({ channels, 48000 }, MakeScene("mixed"), seconds, PacketFrames),
+			channels(channels), startNs(startNs)
+		{
+		}
+
+		std::uint64_t readyNs(std::uint64_t index) const { return startNs + index * PacketNs; }
+
+		// Copies the next packet out in the device format; false at end of stream.
+		bool read(std::vector<std::int16_t>& out, unsigned int& frames)
+		{
+			CapturePacket packet;
+			if (!generator.nextPacket(packet)) return false;
+			frames = packet.frameCount;
+			out.resize(static_cast<std::size_t>(frames) * channels);
+			for (std::size_t i = 0; i < out.size(); ++i) {
+				const float x = std::clamp(packet.samples[i], -1.0f, 1.0f);
+				out[i] = static_cast<std::int16_t>(x * 32767.0f);
+			}
+			return true;
+		}
+
+		int channelCount() const { return channels; }
+
+	private:
+		SignalGenerator generator;
+		int channels;
+		std::uint64_t startNs;
+	};
+
+	void ConvertInt16(const std::vector<std::int16_t>& in, std::vector<float>& out)
+	{
+		out.resize(in.size());
+		for (std::size_t i = 0; i < in.size(); ++i) out[i] = in[i] * (1.0f / 32768.0f);
+	}
+
+	// Feeds DirectionPipeline one packet at a time from whoever holds the samples
+	class HandoffSource : public CaptureSource
+	{
+	public:
+		explicit HandoffSource(AudioFormat format) : audioFormat(format) {}
+
+		AudioFormat format() const override { return audioFormat; }
+		bool nextPacket(CapturePacket& packet) override
+		{
+			if (!pending) return false;
+			packet = current;
+			pending = false;
+			return true;
+		}
+
+		void set(const CapturePacket& packet)
+		{
+			current = packet;
+			pending = true;
+		}
+
+	private:
+		AudioFormat audioFormat;
+		CapturePacket current;
+		bool pending = false;
+	};
+
+	// Remembers the last packet handed to the pipeline, for stamping its decision
+	class TapSource : public CaptureSource
+	{
+	public:
+		explicit TapSource(CaptureSource& inner) : inner(inner) {}
+
+		AudioFormat format() const override { return inner.format(); }
+		bool nextPacket(CapturePacket& packet) override
+		{
+			if (!inner.nextPacket(packet)) return false;
+			last = packet;
+			return true;
+		}
+
+		const CapturePacket& lastPacket() const { return last; }
+
+	private:
+		CaptureSource& inner;
+		CapturePacket last;
+	};
+
+	struct Decision
+	{
+		Direction direction = Direction::Unknown;
+		float azimuth = 0.0f;
+		std::uint64_t timestampUs = 0;
+		std::uint64_t readyNs = 0;
+	};
+
+	// Shared by both designs, so the log stage costs the same in each
+	void WriteLogLine(int fd, const Decision& decision)
+	{
+		char line[96];
+		const int length = std::snprintf(line, sizeof(line), "%llu %d %.1f\n",
+			static_cast<unsigned long long>(decision.timestampUs), static_cast<int>(decision.direction), decision.azimuth);
+		[[maybe_unused]] const ssize_t written = ::write(fd, line, static_cast<std::size_t>(length));
+	}
+
+	struct RunResult
+	{
+		std::uint64_t packets = 0;
+		std::uint64_t voluntarySwitches = 0;
+		std::uint64_t involuntarySwitches = 0;
+		double cpuSeconds = 0.0;
+		double wallSeconds = 0.0;
+		std::uint64_t wakeups = 0; // coroutine loop only
+		LatencyHistogram publishedUs;
+		LatencyHistogram loggedUs;
+	};
+
+	// Process-wide counters (every thread of the design under test)
+	struct UsageSnapshot
+	{
+		UsageSnapshot()
+		{
+			rusage usage{};
+			getrusage(RUSAGE_SELF, &usage);
+			voluntary = static_cast<std::uint64_t>(usage.ru_nvcsw);
+			involuntary = static_cast<std::uint64_t>(usage.ru_nivcsw);
+			cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+			wallNs = SteadyNowNs();
+		}
+
+		void finish(RunResult& result) const
+		{
+			const UsageSnapshot end;
+			result.voluntarySwitches = end.voluntary - voluntary;
+			result.involuntarySwitches = end.involuntary - involuntary;
+			result.cpuSeconds = end.cpu - cpu;
+			result.wallSeconds = (end.wallNs - wallNs) / 1e9;
+		}
+
+		std::uint64_t voluntary;
+		std::uint64_t involuntary;
+		double cpu;
+		std::uint64_t wallNs;
+	};
+
+	struct RawSlot
+	{
+		std::vector<std::int16_t> samples;
+		unsigned int frames = 0;
+		std::uint64_t index = 0;
+	};
+
+	struct FloatSlot
+	{
+		std::vector<float> samples;
+		unsigned int frames = 0;
+		std::uint64_t index = 0;
+	};
+
+	struct CoroutineStages
+	{
+		CoroutineStages(EventLoop& loop, SimulatedDevice& device, int logFd, std::atomic<int>& direction)
+			: loop(loop), device(device), logFd(logFd), direction(direction), raw(SlotCount), converted(SlotCount),
+			rawReady(loop, ChannelCapacity), floatReady(loop, ChannelCapacity), analyzed(loop, ChannelCapacity),
+			published(loop, ChannelCapacity)
+		{
+		}
+
+		Task source(PeriodicTimer& timer)
+		{
+			std::uint64_t index = 0;
+			for (;;) {
+				co_await loop.readable(timer.fd());
+				for (std::uint64_t due = timer.expirations(); due > 0; --due, ++index) {
+					RawSlot& slot = raw[index % SlotCount];
+					if (!device.read(slot.samples, slot.frames)) {
+						rawReady.close();
+						co_return;
+					}
+					slot.index = index;
+					co_await rawReady.push(index % SlotCount);
+				}
+			}
+		}
+
+		Task convert()
+		{
+			while (const std::optional<std::size_t> slot = co_await rawReady.pop()) {
+				const RawSlot& in = raw[*slot];
+				FloatSlot& out = converted[*slot];
+				ConvertInt16(in.samples, out.samples);
+				out.frames = in.frames;
+				out.index = in.index;
+				co_await floatReady.push(*slot);
+			}
+			floatReady.close();
+		}
+
+		Task analyze()
+		{
+			const AudioFormat format{ device.channelCount(), 48000 };
+			HandoffSource handoff(format);
+			DirectionPipeline pipeline(handoff);
+			while (const std::optional<std::size_t> slot = co_await floatReady.pop()) {
+				const FloatSlot& in = converted[*slot];
+				CapturePacket packet;
+				packet.samples = in.samples.data();
+				packet.frameCount = in.frames;
+				packet.timestampUs = in.index * PacketNs / 1000;
+				packet.readyNs = device.readyNs(in.index);
+				handoff.set(packet);
+				pipeline.step();
+
+				const DirectionState& state = pipeline.lastState();
+				co_await analyzed.push(Decision{ state.direction, state.azimuth, packet.timestampUs, packet.readyNs });
+			}
+			analyzed.close();
+		}
+
+		Task publish()
+		{
+			while (const std::optional<Decision> decision = co_await analyzed.pop()) {
+				direction.store(static_cast<int>(decision->direction), std::memory_order_release);
+				result.publishedUs.record((SteadyNowNs() - decision->readyNs) / 1000);
+				co_await published.push(*decision);
+			}
+			published.close();
+		}
+
+		Task log()
+		{
+			while (const std::optional<Decision> decision = co_await published.pop()) {
+				WriteLogLine(logFd, *decision);
+				result.loggedUs.record((SteadyNowNs() - decision->readyNs) / 1000);
+				++result.packets;
+			}
+		}
+
+		EventLoop& loop;
+		SimulatedDevice& device;
+		int logFd;
+		std::atomic<int>& direction;
+		std::vector<RawSlot> raw;
+		std::vector<FloatSlot> converted;
+		Channel<std::size_t> rawReady;
+		Channel<std::size_t> floatReady;
+		Channel<Decision> analyzed;
+		Channel<Decision> published;
+		RunResult result;
+	};
+
+	RunResult RunCoroutine(int channels, double seconds, int logFd)
+	{
+		const std::uint64_t startNs = SteadyNowNs() + PacketNs;
+		SimulatedDevice device(channels, seconds, startNs);
+		std::atomic<int> direction{ static_cast<int>(Direction::Unknown) };
+
+		EventLoop loop;
+		PeriodicTimer timer(startNs, PacketNs);
+		CoroutineStages stages(loop, device, logFd, direction);
+		loop.spawn(stages.source(timer));
+		loop.spawn(stages.convert());
+		loop.spawn(stages.analyze());
+		loop.spawn(stages.publish());
+		loop.spawn(stages.log());
+
+		const UsageSnapshot usage;
+		loop.run();
+		usage.finish(stages.result);
+		stages.result.wakeups = loop.wakeups();
+		return std::move(stages.result);
+	}
+
+	// pollMs > 0: the capture thread sleeps pollMs between buffer checks like AudioCapturer;
+	// 0: it sleeps until each packet's deadline (the best a thread-per-stage design can do).
+	RunResult RunThreaded(int channels, double seconds, int logFd, int pollMs)
+	{
+		const std::uint64_t startNs = SteadyNowNs() + PacketNs;
+		SimulatedDevice device(channels, seconds, startNs);
+		const AudioFormat format{ channels, 48000 };
+		FrameBus bus(format, PacketFrames, 16);
+		auto subscription = bus.subscribe(ChannelCapacity, OverflowPolicy::Block);
+		std::atomic<int> direction{ static_cast<int>(Direction::Unknown) };
+
+		std::mutex logMutex;
+		std::condition_variable logReady;
+		std::deque<Decision> logQueue;
+		bool logClosed = false;
+		RunResult result;
+
+		const UsageSnapshot usage;
+		std::thread capture([&] {
+			std::vector<std::int16_t> raw;
+			std::vector<float> samples;
+			for (std::uint64_t index = 0;; ++index) {
+				const std::uint64_t dueNs = device.readyNs(index);
+				if (pollMs > 0) {
+					while (SteadyNowNs() < dueNs) std::this_thread::sleep_for(std::chrono::milliseconds(pollMs));
+				} else {
+					std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(dueNs)));
+				}
+
+				CapturePacket packet;
+				if (!device.read(raw, packet.frameCount)) break;
+				ConvertInt16(raw, samples);
+				packet.samples = samples.data();
+				packet.timestampUs = index * PacketNs / 1000;
+				packet.readyNs = dueNs;
+				bus.publish(packet);
+			}
+			bus.close();
+		});
+
+		std::thread analysis([&] {
+			SubscriptionSource subscribed(subscription, format);
+			TapSource source(subscribed);
+			DirectionPipeline pipeline(source, &direction);
+			while (pipeline.step()) {
+				const DirectionState& state = pipeline.lastState();
+				const CapturePacket& packet = source.lastPacket();
+				result.publishedUs.record((SteadyNowNs() - packet.readyNs) / 1000);
+				{
+					std::lock_guard<std::mutex> lock(logMutex);
+					logQueue.push_back(Decision{ state.direction, state.azimuth, packet.timestampUs, packet.readyNs });
+				}
+				logReady.notify_one();
+			}
+			{
+				std::lock_guard<std::mutex> lock(logMutex);
+				logClosed = true;
+			}
+			logReady.notify_one();
+		});
+
+		std::thread logger([&] {
+			std::unique_lock<std::mutex> lock(logMutex);
+			for (;;) {
+				logReady.wait(lock, [&] { return logClosed || !logQueue.empty(); });
+				if (logQueue.empty()) break;
+				const Decision decision = logQueue.front();
+				logQueue.pop_front();
+				lock.unlock();
+				WriteLogLine(logFd, decision);
+				result.loggedUs.record((SteadyNowNs() - decision.readyNs) / 1000);
+				++result.packets;
+				lock.lock();
+			}
+		});
+
+		capture.join();
+		analysis.join();
+		logger.join();
+		usage.finish(result);
+		return result;
+	}
+
+	void PrintRun(const char* name, const RunResult& run)
+	{
+		const double seconds = std::max(run.wallSeconds, 1e-9);
+		std::cout << name << ":\n"
+			<< "  " << run.packets << " pacotes em " << run.wallSeconds << " s, "
+			<< (run.voluntarySwitches + run.involuntarySwitches) / seconds << " trocas de contexto/s ("
+			<< run.voluntarySwitches / seconds << " voluntarias), CPU " << 100.0 * run.cpuSeconds / seconds << "%";
+		if (run.wakeups) std::cout << ", " << run.wakeups / seconds << " despertares/s";
+		std::cout << "\n  pronto -> publicado: ";
+		run.publishedUs.print(std::cout, "us");
+		std::cout << "  pronto -> registrado: ";
+		run.loggedUs.print(std::cout, "us");
+	}
+}
+#endif
+
+void BenchmarkCoroutinePipeline(double seconds, int channels)
+{
+#ifdef __linux__
+	std::FILE* logFile = std::tmpfile();
+	if (!logFile) throw std::runtime_error("Falha ao criar o arquivo de log temporario");
+	const int logFd = fileno(logFile);
+
+	std::cout << channels << " canais, pacotes de 10 ms em tempo real, " << seconds << " s por projeto\n";
+	PrintRun("Threads, captura por sondagem de 10 ms (como AudioCapturer)", RunThreaded(channels, seconds, logFd, 10));
+	PrintRun("Threads, captura dormindo ate cada prazo", RunThreaded(channels, seconds, logFd, 0));
+	PrintRun("Corrotinas em uma thread (epoll + timerfd)", RunCoroutine(channels, seconds, logFd));
+	std::fclose(logFile);
+#else
+	(void)seconds;
+	(void)channels;
+	std::cout << "O pipeline com corrotinas requer epoll/timerfd (Linux)\n";
+#endif
+}
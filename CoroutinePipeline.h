@@ -0,0 +1,205 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Single-threaded alternative to the capture/analysis/logger threads: each stage is a
+// coroutine on one EventLoop, which sleeps in epoll_wait until a file descriptor is
+// ready (a timerfd pacing the device, the eventfd behind stop()) and then resumes
+// whatever can make progress. Stages hand work to each other through bounded Channels,
+// so a stage that runs ahead suspends instead of parking a thread. Linux only: elsewhere
+// EventLoop and PeriodicTimer throw from their constructors.
+
+// Fire-and-forget coroutine owned by an EventLoop. It starts suspended and runs when
+// spawned; an exception escaping it is rethrown by EventLoop::run().
+class Task
+{
+public:
+	struct promise_type
+	{
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() { error = std::current_exception(); }
+
+		std::exception_ptr error;
+	};
+
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other) {
+			if (handle) handle.destroy();
+			handle = std::exchange(other.handle, {});
+		}
+		return *this;
+	}
+	~Task()
+	{
+		if (handle) handle.destroy();
+	}
+
+	bool done() const { return !handle || handle.done(); }
+
+private:
+	friend class EventLoop;
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+class EventLoop
+{
+public:
+	EventLoop();
+	~EventLoop();
+
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	// The loop owns task from here on; it first runs on the next turn of run().
+	void spawn(Task task);
+	// Resumes handle on the loop thread at the next turn.
+	void schedule(std::coroutine_handle<> handle) { ready.push_back(handle); }
+	// Safe from any thread: run() returns after the current turn.
+	void stop();
+	// Runs until stop() or until every task has finished.
+	void run();
+
+	struct ReadableAwaiter
+	{
+		EventLoop& loop;
+		int fd;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { loop.watch(fd, handle); }
+		void await_resume() const noexcept {}
+	};
+	// co_await loop.readable(fd) suspends until fd is readable. One waiter per fd.
+	ReadableAwaiter readable(int fd) { return { *this, fd }; }
+
+	// Times epoll_wait returned, i.e. how often the thread actually slept and woke.
+	std::uint64_t wakeups() const { return wakeupCount; }
+
+private:
+	void watch(int fd, std::coroutine_handle<> handle);
+
+	int epollFd = -1;
+	int wakeFd = -1;
+	std::vector<int> watched;
+	std::deque<std::coroutine_handle<>> ready;
+	std::vector<Task> tasks;
+	std::atomic<bool> stopping{ false };
+	std::uint64_t wakeupCount = 0;
+};
+
+// timerfd on the steady clock: first expiry at firstNs (SteadyNowNs() time base), then
+// every periodNs. Awaiting readable(fd()) wakes at the next expiry.
+class PeriodicTimer
+{
+public:
+	PeriodicTimer(std::uint64_t firstNs, std::uint64_t periodNs);
+	~PeriodicTimer();
+
+	PeriodicTimer(const PeriodicTimer&) = delete;
+	PeriodicTimer& operator=(const PeriodicTimer&) = delete;
+
+	int fd() const { return timerFd; }
+	// Expirations since the previous call, 0 when none.
+	std::uint64_t expirations();
+
+private:
+	int timerFd = -1;
+};
+
+// Bounded queue between two stages of the same loop (one producer, one consumer).
+// push() suspends while the channel is full and pop() while it is empty; pop() yields
+// nothing once the channel is closed and drained.
+template <typename T>
+class Channel
+{
+public:
+	Channel(EventLoop& loop, std::size_t capacity) : loop(loop), capacity(capacity) {}
+
+	struct PushAwaiter
+	{
+		Channel& channel;
+		T value;
+
+		bool await_ready()
+		{
+			if (channel.items.size() >= channel.capacity) return false;
+			channel.deliver(std::move(value));
+			return true;
+		}
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			channel.pusher = handle;
+			channel.pending = this;
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct PopAwaiter
+	{
+		Channel& channel;
+
+		bool await_ready() const noexcept { return !channel.items.empty() || channel.closed; }
+		void await_suspend(std::coroutine_handle<> handle) { channel.popper = handle; }
+		std::optional<T> await_resume()
+		{
+			if (channel.items.empty()) return std::nullopt;
+			std::optional<T> value(std::move(channel.items.front()));
+			channel.items.pop_front();
+			if (channel.pending) {
+				// Room again: the waiting producer's value goes in and the producer runs next turn
+				channel.items.push_back(std::move(channel.pending->value));
+				channel.pending = nullptr;
+				channel.loop.schedule(std::exchange(channel.pusher, {}));
+			}
+			return value;
+		}
+	};
+
+	PushAwaiter push(T value) { return { *this, std::move(value) }; }
+	PopAwaiter pop() { return { *this }; }
+
+	void close()
+	{
+		closed = true;
+		wakeConsumer();
+	}
+
+private:
+	void deliver(T value)
+	{
+		items.push_back(std::move(value));
+		wakeConsumer();
+	}
+
+	void wakeConsumer()
+	{
+		if (popper) loop.schedule(std::exchange(popper, {}));
+	}
+
+	EventLoop& loop;
+	std::size_t capacity;
+	std::deque<T> items;
+	bool closed = false;
+	std::coroutine_handle<> popper;
+	std::coroutine_handle<> pusher;
+	PushAwaiter* pending = nullptr;
+};
+
+// Runs the same synthetic device (10 ms packets of int16, in real time) through the
+// threaded design (capture thread -> FrameBus -> analysis thread -> logger thread,
+// with the capture thread polling like AudioCapturer or sleeping to each deadline) and
+// through the coroutine pipeline, and compares context switches per second and the
+// packet-ready -> published / -> logged latency percentiles.
+void BenchmarkCoroutinePipeline(double seconds, int channels);
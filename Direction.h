@@ -15,4 +15,13 @@ enum class Direction : std::uint8_t
 	DownCenter,
 	DownRight,
 	Unknown
-};
\ No newline at end of file
+};
+
+// Full result of one analysis step. Azimuth is in degrees, 0 = front,
+// negative = left, positive = right; confidence is in [0, 1].
+struct DirectionState
+{
+	Direction direction = Direction::Unknown;
+	float azimuth = 0.0f;
+	float confidence = 0.0f;
+};
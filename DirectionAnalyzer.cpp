@@ -1,15 +1,55 @@
 #include "DirectionAnalyzer.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 
 Direction DirectionAnalyzer::analyze(const float* samples, unsigned int frameCount, int numChannels) const
 {
-	if (numChannels <= 0 || frameCount == 0 || !samples) {
-		return Direction::Unknown;
+	return analyzeState(samples, frameCount, numChannels).direction;
+}
+
+DirectionState DirectionAnalyzer::analyzeState(const float* samples, unsigned int frameCount, int numChannels, float* energyOut) const
+{
+	if (numChannels <= 0 || numChannels > MaxChannels || frameCount == 0 || !samples) {
+		return {};
+	}
+
+	// Scratch lives on the stack so the per-packet path never touches the heap
+	float energy[MaxChannels];
+	measure(samples, frameCount, numChannels, energy);
+
+	if (energyOut) {
+		std::copy(energy, energy + numChannels, energyOut);
+	}
+
+	return decide(energy, numChannels);
+}
+
+DirectionState DirectionAnalyzer::analyzePlanar(const float* const* channels, unsigned int frameCount, int numChannels, float* energyOut) const
+{
+	if (numChannels <= 0 || numChannels > MaxChannels || frameCount == 0 || !channels) {
+		return {};
 	}
 
-	std::vector energy(numChannels, 0.0f);
+	float energy[MaxChannels];
+	measurePlanar(channels, frameCount, numChannels, energy);
+
+	if (energyOut) {
+		std::copy(energy, energy + numChannels, energyOut);
+	}
+
+	return decide(energy, numChannels);
+}
+
+void DirectionAnalyzer::measure(const float* samples, unsigned int frameCount, int numChannels, float* energy)
+{
+	std::fill(energy, energy + numChannels, 0.0f);
 
 	for(unsigned i = 0; i<frameCount; ++i)
 	{
@@ -18,13 +58,243 @@ Direction DirectionAnalyzer::analyze(const float* samples, unsigned int frameCou
 			energy[ch] += std::abs(samples[i * numChannels + ch]);
 		}
 	}
+}
+
+void DirectionAnalyzer::measurePlanar(const float* const* channels, unsigned int frameCount, int numChannels, float* energy)
+{
+	for (int ch = 0; ch < numChannels; ++ch) {
+		const float* x = channels[ch];
+		float sum = 0.0f;
+		for (unsigned int i = 0; i < frameCount; ++i) sum += std::abs(x[i]);
+		energy[ch] = sum;
+	}
+}
+
+DirectionState DirectionAnalyzer::analyzePcm(const void* samples, PcmEncoding encoding, unsigned int frameCount, int numChannels, float* energyOut) const
+{
+	if (numChannels <= 0 || numChannels > MaxChannels || frameCount == 0 || !samples) {
+		return {};
+	}
+
+	float energy[MaxChannels];
+	measurePcm(samples, encoding, frameCount, numChannels, energy);
+
+	if (energyOut) {
+		std::copy(energy, energy + numChannels, energyOut);
+	}
+
+	return decide(energy, numChannels);
+}
+
+namespace
+{
+	// |x| is accumulated per lane over periods of whole frames, so lane j always holds
+	// channel j % numChannels whatever the layout and the inner loop is one straight run
+	// (widen, abs, add). A period known at compile time is what lets the compiler turn
+	// that run into whole vectors; 64, 48, 60 and 56 cover every layout up to 8 channels.
+	constexpr int MaxPeriod = 64;
+
+	// Partial sums of type Partial are folded into 64-bit totals every flushPeriods
+	// periods, before they can overflow
+	template <int FixedPeriod, typename Partial, typename Load>
+	void SumAbsInteger(Load load, std::size_t sampleCount, int numChannels, int runtimePeriod, std::uint32_t flushPeriods,
+		double scale, float* energy)
+	{
+		const int period = FixedPeriod ? FixedPeriod : runtimePeriod;
+		assert(period >= numChannels && period <= MaxPeriod);
+		std::int64_t total[MaxPeriod] = {};
+		Partial partial[MaxPeriod] = {};
+
+		std::size_t i = 0;
+		std::uint32_t periods = 0;
+		for (; i + period <= sampleCount; i += period) {
+			for (int j = 0; j < period; ++j) partial[j] += static_cast<Partial>(std::abs(load(i + j)));
+			if (++periods == flushPeriods) {
+				for (int j = 0; j < period; ++j) {
+					total[j] += partial[j];
+					partial[j] = 0;
+				}
+				periods = 0;
+			}
+		}
+		for (int j = 0; j < period; ++j) total[j] += partial[j];
+		// The tail starts on a frame boundary too
+		for (int j = 0; i < sampleCount; ++i, ++j) total[j] += std::abs(static_cast<std::int64_t>(load(i)));
+
+		for (int ch = 0; ch < numChannels; ++ch) {
+			std::int64_t sum = 0;
+			for (int j = ch; j < period; j += numChannels) sum += total[j];
+			energy[ch] = static_cast<float>(static_cast<double>(sum) * scale);
+		}
+	}
+
+	template <typename Partial, typename Load>
+	void SumAbsPcm(Load load, std::size_t sampleCount, int numChannels, std::uint32_t flushPeriods, double scale, float* energy)
+	{
+		if (64 % numChannels == 0) SumAbsInteger<64, Partial>(load, sampleCount, numChannels, 0, flushPeriods, scale, energy);
+		else if (48 % numChannels == 0) SumAbsInteger<48, Partial>(load, sampleCount, numChannels, 0, flushPeriods, scale, energy);
+		else if (60 % numChannels == 0) SumAbsInteger<60, Partial>(load, sampleCount, numChannels, 0, flushPeriods, scale, energy);
+		else if (56 % numChannels == 0) SumAbsInteger<56, Partial>(load, sampleCount, numChannels, 0, flushPeriods, scale, energy);
+		else {
+			// Smallest whole number of frames of at least 32 samples
+			const int period = numChannels * ((32 + numChannels - 1) / numChannels);
+			SumAbsInteger<0, Partial>(load, sampleCount, numChannels, period, flushPeriods, scale, energy);
+		}
+	}
+}
+
+void DirectionAnalyzer::measurePcm(const void* samples, PcmEncoding encoding, unsigned int frameCount, int numChannels, float* energy)
+{
+	if (numChannels <= 0) return;
+	if (numChannels > MaxChannels) {
+		// Wider than the lane buffers: convert sample by sample, in measure()'s order
+		std::fill(energy, energy + numChannels, 0.0f);
+		for (std::size_t i = 0, count = static_cast<std::size_t>(frameCount) * numChannels; i < count; ++i) {
+			energy[i % numChannels] += std::abs(LoadPcmSample(samples, encoding, i) / 2147483648.0f);
+		}
+		return;
+	}
+
+	const std::size_t count = static_cast<std::size_t>(frameCount) * numChannels;
+	switch (encoding) {
+	case PcmEncoding::Int16: {
+		// 65535 * 32768 still fits an int32
+		const auto* x = static_cast<const std::int16_t*>(samples);
+		SumAbsPcm<std::int32_t>([x](std::size_t i) { return static_cast<std::int32_t>(x[i]); }, count, numChannels, 65535, 1.0 / 32768.0, energy);
+		break;
+	}
+	case PcmEncoding::Int24: {
+		// 255 * 2^23 still fits an int32
+		const auto* p = static_cast<const std::uint8_t*>(samples);
+		SumAbsPcm<std::int32_t>([p](std::size_t i) {
+			const std::uint8_t* s = p + 3 * i;
+			return static_cast<std::int32_t>(static_cast<std::uint32_t>(s[0]) << 8 | static_cast<std::uint32_t>(s[1]) << 16 | static_cast<std::uint32_t>(s[2]) << 24) >> 8;
+		}, count, numChannels, 255, 1.0 / 8388608.0, energy);
+		break;
+	}
+	case PcmEncoding::Int32: {
+		// |INT32_MIN| needs 64 bits from the start
+		const auto* x = static_cast<const std::int32_t*>(samples);
+		SumAbsPcm<std::int64_t>([x](std::size_t i) { return static_cast<std::int64_t>(x[i]); }, count, numChannels, 0, 1.0 / 2147483648.0, energy);
+		break;
+	}
+	default:
+		std::fill(energy, energy + numChannels, 0.0f);
+		break;
+	}
+}
+
+void DirectionAnalyzer::analyzeBatch(const float* const* streams, int streamCount, unsigned int frameCount, int numChannels,
+	DirectionState* states, float* energyOut) const
+{
+	if (streamCount <= 0 || !states) {
+		return;
+	}
+	if (numChannels <= 0 || numChannels > MaxChannels || frameCount == 0 || !streams) {
+		std::fill(states, states + streamCount, DirectionState{});
+		return;
+	}
+
+	// Scratch on the stack as in analyzeState(), a group of streams at a time
+	constexpr int Group = 16;
+	float energy[Group * MaxChannels];
+	for (int first = 0; first < streamCount; first += Group) {
+		const int count = std::min(Group, streamCount - first);
+		measureBatch(streams + first, count, frameCount, numChannels, energy);
+		for (int s = 0; s < count; ++s) {
+			states[first + s] = decide(energy + s * numChannels, numChannels);
+		}
+		if (energyOut) {
+			std::copy(energy, energy + count * numChannels, energyOut + static_cast<std::size_t>(first) * numChannels);
+		}
+	}
+}
+
+namespace
+{
+	// Width streams at once (a multiple of 4). Tiles of up to 64 samples of each stream
+	// are transposed, in 4x4 blocks the compiler turns into shuffles, so that sample k of
+	// every stream sits in one row; the sum then adds whole rows, one accumulator lane per
+	// stream and channel. Every lane still adds its samples in stream order from zero,
+	// exactly like measure(), which is why the lanes can be vectors without
+	// reassociating anything.
+	template <int Width>
+	void MeasureStreams(const float* const* streams, unsigned int frameCount, int numChannels, float* energy)
+	{
+		constexpr int TileSamples = 64;
+		assert(numChannels > 0 && numChannels <= DirectionAnalyzer::MaxChannels);
+		const unsigned int tileFrames = TileSamples / numChannels;
+		alignas(64) float tile[TileSamples * Width];
+		alignas(64) float sum[DirectionAnalyzer::MaxChannels * Width] = {};
+
+		for (unsigned int frame = 0; frame < frameCount; frame += tileFrames) {
+			const std::size_t samples = static_cast<std::size_t>(std::min(tileFrames, frameCount - frame)) * numChannels;
+			const std::size_t offset = static_cast<std::size_t>(frame) * numChannels;
+			for (int s = 0; s < Width; s += 4) {
+				const float* x0 = streams[s] + offset;
+				const float* x1 = streams[s + 1] + offset;
+				const float* x2 = streams[s + 2] + offset;
+				const float* x3 = streams[s + 3] + offset;
+				std::size_t k = 0;
+				for (; k + 4 <= samples; k += 4) {
+					for (int q = 0; q < 4; ++q) {
+						float* row = tile + (k + q) * Width + s;
+						row[0] = x0[k + q];
+						row[1] = x1[k + q];
+						row[2] = x2[k + q];
+						row[3] = x3[k + q];
+					}
+				}
+				for (; k < samples; ++k) {
+					float* row = tile + k * Width + s;
+					row[0] = x0[k];
+					row[1] = x1[k];
+					row[2] = x2[k];
+					row[3] = x3[k];
+				}
+			}
+			int ch = 0;
+			for (std::size_t k = 0; k < samples; ++k) {
+				float* acc = sum + ch * Width;
+				const float* row = tile + k * Width;
+				for (int s = 0; s < Width; ++s) acc[s] += std::abs(row[s]);
+				if (++ch == numChannels) ch = 0;
+			}
+		}
+
+		for (int s = 0; s < Width; ++s) {
+			for (int c = 0; c < numChannels; ++c) energy[s * numChannels + c] = sum[c * Width + s];
+		}
+	}
+}
+
+void DirectionAnalyzer::measureBatch(const float* const* streams, int streamCount, unsigned int frameCount, int numChannels, float* energy)
+{
+	if (numChannels <= 0 || streamCount <= 0) return;
+
+	// The transpose, not the sum, sets the pace, and it gains nothing past 8 streams
+	// (see BenchmarkBatchAnalysis); fewer than 4 left are not worth a transpose. Layouts
+	// wider than the lane buffers take measure() per stream.
+	int s = 0;
+	if (numChannels <= MaxChannels) {
+		for (; s + 8 <= streamCount; s += 8) MeasureStreams<8>(streams + s, frameCount, numChannels, energy + s * numChannels);
+		for (; s + 4 <= streamCount; s += 4) MeasureStreams<4>(streams + s, frameCount, numChannels, energy + s * numChannels);
+	}
+	for (; s < streamCount; ++s) measure(streams[s], frameCount, numChannels, energy + s * numChannels);
+}
+
+DirectionState DirectionAnalyzer::decide(const float* energy, int numChannels) const
+{
+	if (numChannels <= 0 || !energy) {
+		return {};
+	}
 
 	float left = 0, right = 0, up = 0, down = 0;
 
 	// Handle different channel configurations more accurately
 	switch (numChannels) {
 	case 1: // Mono
-		return Direction::Center;
+		return { Direction::Center, 0.0f, 0.0f };
 		
 	case 2: // Stereo: [L, R]
 		left = energy[0];
@@ -51,14 +321,14 @@ Direction DirectionAnalyzer::analyze(const float* samples, unsigned int frameCou
 		left = energy[0] + energy[4];  // Front Left + Rear Left
 		right = energy[1] + energy[5]; // Front Right + Rear Right
 		up = energy[0] + energy[1] + energy[2]; // Front channels + Center
-		down = energy[4] + energy[5] + energy[3]; // Rear channels + LFE
+		down = energy[4] + energy[5] + (params.lfeInRear ? energy[3] : 0.0f); // Rear channels + LFE
 		break;
 		
 	case 8: // 7.1 surround: [FL, FR, FC, LFE, RL, RR, SL, SR]
 		left = energy[0] + energy[4] + energy[6];  // FL + RL + SL
 		right = energy[1] + energy[5] + energy[7]; // FR + RR + SR
 		up = energy[0] + energy[1] + energy[2];    // Front channels + Center
-		down = energy[4] + energy[5] + energy[6] + energy[7] + energy[3]; // Rear + Side + LFE
+		down = energy[4] + energy[5] + energy[6] + energy[7] + (params.lfeInRear ? energy[3] : 0.0f); // Rear + Side + LFE
 		break;
 		
 	default: // Fallback for other configurations
@@ -75,29 +345,224 @@ Direction DirectionAnalyzer::analyze(const float* samples, unsigned int frameCou
 		break;
 	}
 
-	const bool isLeft = left > right * 1.2f;
-	const bool isRight = right > left * 1.2f;
-	const bool isUp = up > down * 1.2f;
-	const bool isDown = down > up * 1.2f;
+	const bool isLeft = left > right * params.lateralRatio;
+	const bool isRight = right > left * params.lateralRatio;
+	const bool isUp = up > down * params.frontRearRatio;
+	const bool isDown = down > up * params.frontRearRatio;
+
+	// Normalized balances in [-1, 1]: x grows to the right, y to the front
+	const float x = (right - left) / (right + left + 1e-9f);
+	const float y = (up - down) / (up + down + 1e-9f);
+
+	DirectionState state;
+	state.confidence = std::min(1.0f, std::hypot(x, y));
+	// Without front/rear information only the lateral balance is meaningful
+	state.azimuth = (up == 0.0f && down == 0.0f) ? x * 90.0f : std::atan2(x, y) * 57.29578f;
 
 	// For stereo, only return left/right/center
 	if(numChannels == 2)
 	{
-		if (isLeft) return Direction::Left;
-		if (isRight) return Direction::Right;
-		return Direction::Center;
+		if (isLeft) state.direction = Direction::Left;
+		else if (isRight) state.direction = Direction::Right;
+		else state.direction = Direction::Center;
+		return state;
 	}
 
 	// For multi-channel, support full directional analysis
-	if (isUp && isLeft) return Direction::UpLeft;
-	if (isUp && isRight) return Direction::UpRight;
-	if (isUp) return Direction::UpCenter;
-	if (isDown && isLeft) return Direction::DownLeft;
-	if (isDown && isRight) return Direction::DownRight;
-	if (isDown) return Direction::DownCenter;
-	if (isLeft) return Direction::CenterLeft;
-	if (isRight) return Direction::CenterRight;
-
-	return Direction::Center; // Changed from Unknown to Center for balanced audio
-
-}
\ No newline at end of file
+	if (isUp && isLeft) state.direction = Direction::UpLeft;
+	else if (isUp && isRight) state.direction = Direction::UpRight;
+	else if (isUp) state.direction = Direction::UpCenter;
+	else if (isDown && isLeft) state.direction = Direction::DownLeft;
+	else if (isDown && isRight) state.direction = Direction::DownRight;
+	else if (isDown) state.direction = Direction::DownCenter;
+	else if (isLeft) state.direction = Direction::CenterLeft;
+	else if (isRight) state.direction = Direction::CenterRight;
+	else state.direction = Direction::Center; // Changed from Unknown to Center for balanced audio
+
+	return state;
+}
+
+bool BenchmarkPcmAnalysis(double durationSec)
+{
+	using Clock = std::chrono::steady_clock;
+	constexpr unsigned int Packet = 480;
+	constexpr unsigned int Packets = 100;
+	const struct
+	{
+		const char* name;
+		int channels;
+	} layouts[] = { { "estereo", 2 }, { "5.1", 6 }, { "7.1", 8 } };
+	const double slice = durationSec / (std::size(layouts) * 5);
+	bool ok = true;
+
+	std::cout << "Analise de nivel, milhoes de quadros/s em pacotes de " << Packet << " quadros:\n";
+	for (const auto& layout : layouts) {
+		const int channels = layout.channels;
+		const std::size_t count = static_cast<std::size_t>(Packet) * Packets * channels;
+
+		// Noise with a different level per channel, quantized the way a device or WAV file would
+		std::uint32_t state = 5;
+		std::vector<float> samples(count);
+		std::vector<std::int16_t> pcm16(count);
+		std::vector<std::uint8_t> pcm24(count * 3);
+		std::vector<std::int32_t> pcm32(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			state = state * 1664525u + 1013904223u;
+			const double x = (static_cast<double>(state >> 8) / 8388608.0 - 1.0) * (0.2 + 0.1 * static_cast<double>(i % channels));
+			pcm16[i] = static_cast<std::int16_t>(std::lround(x * 32767.0));
+			const std::int32_t x24 = static_cast<std::int32_t>(std::lround(x * 8388607.0));
+			pcm24[3 * i] = static_cast<std::uint8_t>(x24);
+			pcm24[3 * i + 1] = static_cast<std::uint8_t>(x24 >> 8);
+			pcm24[3 * i + 2] = static_cast<std::uint8_t>(x24 >> 16);
+			pcm32[i] = static_cast<std::int32_t>(std::llround(x * 2147483647.0));
+			samples[i] = static_cast<float>(x);
+		}
+
+		// Reference: the float path on what the WAV reader would have converted each encoding to
+		auto compare = [&](const void* data, PcmEncoding encoding, std::size_t sampleBytes, auto toFloat) {
+			std::vector<float> converted(static_cast<std::size_t>(Packet) * channels);
+			float expected[DirectionAnalyzer::MaxChannels], got[DirectionAnalyzer::MaxChannels];
+			double worst = 0.0;
+			for (unsigned int p = 0; p < Packets; ++p) {
+				const std::size_t first = static_cast<std::size_t>(p) * Packet * channels;
+				for (std::size_t i = 0; i < converted.size(); ++i) converted[i] = toFloat(first + i);
+				DirectionAnalyzer::measure(converted.data(), Packet, channels, expected);
+				DirectionAnalyzer::measurePcm(static_cast<const std::uint8_t*>(data) + first * sampleBytes, encoding, Packet, channels, got);
+				for (int ch = 0; ch < channels; ++ch) worst = std::max<double>(worst, std::fabs(got[ch] - expected[ch]) / std::max(expected[ch], 1e-20f));
+			}
+			return worst;
+		};
+		const double error16 = compare(pcm16.data(), PcmEncoding::Int16, 2, [&](std::size_t i) { return pcm16[i] / 32768.0f; });
+		const double error24 = compare(pcm24.data(), PcmEncoding::Int24, 3, [&](std::size_t i) {
+			const std::int32_t v = static_cast<std::int32_t>(static_cast<std::uint32_t>(pcm24[3 * i]) << 8 |
+				static_cast<std::uint32_t>(pcm24[3 * i + 1]) << 16 | static_cast<std::uint32_t>(pcm24[3 * i + 2]) << 24);
+			return v / 2147483648.0f;
+		});
+		const double error32 = compare(pcm32.data(), PcmEncoding::Int32, 4, [&](std::size_t i) { return pcm32[i] / 2147483648.0f; });
+		const double worst = std::max({ error16, error24, error32 });
+		ok = ok && worst <= 1e-4;
+
+		float energy[DirectionAnalyzer::MaxChannels];
+		volatile float sink = 0.0f;
+		auto rate = [&](auto&& packet) {
+			std::uint64_t frames = 0;
+			const auto start = Clock::now();
+			double elapsed = 0.0;
+			do {
+				for (unsigned int p = 0; p < Packets; ++p) {
+					packet(static_cast<std::size_t>(p) * Packet * channels);
+					sink = sink + energy[0];
+				}
+				frames += static_cast<std::uint64_t>(Packet) * Packets;
+				elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			} while (elapsed < slice);
+			return frames / elapsed / 1e6;
+		};
+
+		std::vector<float> scratch(static_cast<std::size_t>(Packet) * channels);
+		const double floatRate = rate([&](std::size_t first) { DirectionAnalyzer::measure(samples.data() + first, Packet, channels, energy); });
+		const double convertRate = rate([&](std::size_t first) {
+			for (std::size_t i = 0; i < scratch.size(); ++i) scratch[i] = pcm16[first + i] / 32768.0f;
+			DirectionAnalyzer::measure(scratch.data(), Packet, channels, energy);
+		});
+		const double int16Rate = rate([&](std::size_t first) { DirectionAnalyzer::measurePcm(pcm16.data() + first, PcmEncoding::Int16, Packet, channels, energy); });
+		const double int24Rate = rate([&](std::size_t first) { DirectionAnalyzer::measurePcm(pcm24.data() + 3 * first, PcmEncoding::Int24, Packet, channels, energy); });
+		const double int32Rate = rate([&](std::size_t first) { DirectionAnalyzer::measurePcm(pcm32.data() + first, PcmEncoding::Int32, Packet, channels, energy); });
+
+		std::cout << "  " << layout.name << ": float " << floatRate << ", int16 convertido " << convertRate << ", int16 " << int16Rate
+			<< ", int24 " << int24Rate << ", int32 " << int32Rate << "; maior diferenca relativa " << worst
+			<< (worst <= 1e-4 ? "" : "  FALHOU") << '\n';
+	}
+	std::cout << (ok ? "OK" : "FALHOU") << '\n';
+	return ok;
+}
+
+bool BenchmarkBatchAnalysis(double durationSec, int streamCount)
+{
+	using Clock = std::chrono::steady_clock;
+	constexpr unsigned int Packet = 480;
+	constexpr unsigned int Packets = 8;
+	// Whole groups of the widest width, so every width sees the same streams
+	streamCount = std::max(16, streamCount / 16 * 16);
+	const struct
+	{
+		const char* name;
+		int channels;
+	} layouts[] = { { "estereo", 2 }, { "5.1", 6 } };
+	const double slice = durationSec / (std::size(layouts) * 4);
+	bool ok = true;
+
+	std::cout << "Analise em lote de " << streamCount << " fluxos, milhoes de quadros/s somando todos, pacotes de " << Packet << " quadros:\n";
+	for (const auto& layout : layouts) {
+		const int channels = layout.channels;
+		const std::size_t packetSamples = static_cast<std::size_t>(Packet) * channels;
+
+		// Each stream its own noise and balance; packet p of stream s at (p * streamCount + s) * packetSamples
+		std::uint32_t state = 11;
+		std::vector<float> samples(packetSamples * Packets * streamCount);
+		for (std::size_t i = 0; i < samples.size(); ++i) {
+			state = state * 1664525u + 1013904223u;
+			const std::size_t stream = i / packetSamples % streamCount;
+			const double gain = 0.1 + 0.05 * static_cast<double>((i % channels + stream) % 7);
+			samples[i] = static_cast<float>((static_cast<double>(state >> 8) / 8388608.0 - 1.0) * gain);
+		}
+		std::vector<const float*> streams(static_cast<std::size_t>(streamCount) * Packets);
+		for (std::size_t i = 0; i < streams.size(); ++i) streams[i] = samples.data() + i * packetSamples;
+
+		// Batch results must match the per-stream path exactly; one stream short of whole
+		// groups, so the 8-, 4- and 1-stream paths all run
+		const int checked = streamCount - 1;
+		DirectionAnalyzer analyzer;
+		std::vector<float> expected(static_cast<std::size_t>(streamCount) * channels), got(expected.size());
+		std::vector<DirectionState> states(streamCount);
+		bool same = true;
+		for (unsigned int p = 0; p < Packets; ++p) {
+			const float* const* packet = streams.data() + static_cast<std::size_t>(p) * streamCount;
+			analyzer.analyzeBatch(packet, checked, Packet, channels, states.data(), got.data());
+			for (int s = 0; s < checked; ++s) {
+				const DirectionState single = analyzer.analyzeState(packet[s], Packet, channels, expected.data() + s * channels);
+				same = same && single.direction == states[s].direction && single.azimuth == states[s].azimuth
+					&& single.confidence == states[s].confidence;
+			}
+			same = same && std::equal(expected.begin(), expected.begin() + checked * channels, got.begin());
+		}
+		ok = ok && same;
+
+		volatile float sink = 0.0f;
+		auto rate = [&](auto&& packet) {
+			std::uint64_t frames = 0;
+			const auto start = Clock::now();
+			double elapsed = 0.0;
+			do {
+				for (unsigned int p = 0; p < Packets; ++p) {
+					packet(streams.data() + static_cast<std::size_t>(p) * streamCount);
+					sink = sink + got[0];
+				}
+				frames += static_cast<std::uint64_t>(Packet) * Packets * streamCount;
+				elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			} while (elapsed < slice);
+			return frames / elapsed / 1e6;
+		};
+		auto groups = [&](auto measureGroup, int width) {
+			return rate([&, width](const float* const* packet) {
+				for (int s = 0; s < streamCount; s += width) measureGroup(packet + s, Packet, channels, got.data() + s * channels);
+			});
+		};
+
+		const double singleRate = rate([&](const float* const* packet) {
+			for (int s = 0; s < streamCount; ++s) DirectionAnalyzer::measure(packet[s], Packet, channels, got.data() + s * channels);
+		});
+		const double rate4 = groups(MeasureStreams<4>, 4);
+		const double rate8 = groups(MeasureStreams<8>, 8);
+		const double rate16 = groups(MeasureStreams<16>, 16);
+		const double batchRate = rate([&](const float* const* packet) {
+			DirectionAnalyzer::measureBatch(packet, streamCount, Packet, channels, got.data());
+		});
+
+		std::cout << "  " << layout.name << ": por fluxo " << singleRate << ", 4 fluxos por grupo " << rate4 << ", 8 " << rate8
+			<< ", 16 " << rate16 << ", measureBatch " << batchRate << " (" << batchRate / singleRate << "x)" << (same ? "; resultados identicos" : "  FALHOU: resultados diferentes")
+			<< '\n';
+	}
+	std::cout << (ok ? "OK" : "FALHOU") << '\n';
+	return ok;
+}
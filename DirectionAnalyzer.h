@@ -1,8 +1,64 @@
 #pragma once
+#include "CaptureSource.h"
 #include "Direction.h"
 
+// Thresholds and channel grouping used by DirectionAnalyzer::decide().
+struct DecisionParams
+{
+	float lateralRatio = 1.2f;    // left/right energy ratio that counts as a side
+	float frontRearRatio = 1.2f;  // front/rear energy ratio that counts as up/down
+	bool lfeInRear = true;        // 5.1/7.1: count the LFE channel in the rear group
+};
+
 class DirectionAnalyzer
 {
 public:
+	// Layouts with more channels are reported as Direction::Unknown.
+	static constexpr int MaxChannels = 32;
+
+	DirectionAnalyzer() = default;
+	explicit DirectionAnalyzer(const DecisionParams& params) : params(params) {}
+
+	const DecisionParams& decisionParams() const { return params; }
+	void setDecisionParams(const DecisionParams& value) { params = value; }
+
 	Direction analyze(const float* samples, unsigned int frameCount, int numChannels) const;
+	DirectionState analyzeState(const float* samples, unsigned int frameCount, int numChannels, float* energyOut = nullptr) const;
+	// Same, reading one buffer per channel.
+	DirectionState analyzePlanar(const float* const* channels, unsigned int frameCount, int numChannels, float* energyOut = nullptr) const;
+	// Same, from interleaved integer PCM.
+	DirectionState analyzePcm(const void* samples, PcmEncoding encoding, unsigned int frameCount, int numChannels, float* energyOut = nullptr) const;
+
+	// Sums |x| per channel into energy[0..numChannels).
+	static void measure(const float* samples, unsigned int frameCount, int numChannels, float* energy);
+	static void measurePlanar(const float* const* channels, unsigned int frameCount, int numChannels, float* energy);
+	// Integer PCM: |x| summed exactly in integers and scaled so full scale is 1.0, i.e.
+	// what measure() gives on the converted floats, without converting.
+	static void measurePcm(const void* samples, PcmEncoding encoding, unsigned int frameCount, int numChannels, float* energy);
+	// streamCount streams of the same layout and frameCount at once: streams[s] is one
+	// interleaved block, states[s] its result and energyOut, when given, receives
+	// energies as [s * numChannels + ch]. Vector lanes run across streams instead of
+	// channels, so stereo fills them as well as 7.1; each stream is still summed in
+	// measure()'s order, so the results equal analyzeState() per stream bit for bit.
+	void analyzeBatch(const float* const* streams, int streamCount, unsigned int frameCount, int numChannels,
+		DirectionState* states, float* energyOut = nullptr) const;
+	// Like measure() and measurePcm(), takes any channel count; layouts wider than
+	// MaxChannels fall back to a plain per-sample loop.
+	static void measureBatch(const float* const* streams, int streamCount, unsigned int frameCount, int numChannels, float* energy);
+	// Turns per-channel energies into a direction, azimuth and confidence.
+	DirectionState decide(const float* energy, int numChannels) const;
+
+private:
+	DecisionParams params;
 };
+
+// Per layout (stereo, 5.1, 7.1): level-analysis throughput on float samples, on int16
+// converted to float first (what PCM sources cost before measurePcm) and on int16,
+// packed int24 and int32 directly, in 480-frame packets. Returns false when an integer
+// path's energies differ from the float path's by more than 1e-4 (relative).
+bool BenchmarkPcmAnalysis(double durationSec);
+
+// Stereo and 5.1 streams in 480-frame packets: measure() per stream against lane
+// groups of 4, 8 and 16 streams and measureBatch() itself, in aggregate frames/s.
+// Returns false when a batch result differs from the per-stream one.
+bool BenchmarkBatchAnalysis(double durationSec, int streamCount = 64);
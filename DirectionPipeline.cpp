@@ -0,0 +1,297 @@
+#include "DirectionPipeline.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "DirectionTimeline.h"
+#include "DirectionUtils.h"
+#include "EventStreamServer.h"
+#include "SharedDirectionState.h"
+#include "Trace.h"
+
+DirectionPipeline::DirectionPipeline(CaptureSource& source, std::atomic<int>* directionRef)
+	: source(source), directionRef(directionRef), onsetDetector(source.format().sampleRate),
+	energy(source.format().channels)
+{
+	const AudioFormat format = source.format();
+	if (format.channels == 2 && format.sampleRate > 0) {
+		delayEstimator = std::make_unique<GccPhatEstimator>(format.sampleRate);
+	}
+}
+
+void DirectionPipeline::configure(const PipelineOptions& options)
+{
+	setTimeline(options.timeline);
+	setPublisher(options.publisher);
+	setEventServer(options.events);
+	setOnsetGating(options.onsetGating);
+	setMultiSource(options.multiSource);
+	const float rate = static_cast<float>(source.format().sampleRate);
+	setFixedWindow(static_cast<unsigned int>(options.windowMs * rate / 1000.0f), static_cast<unsigned int>(options.hopMs * rate / 1000.0f));
+	setAdaptiveQuality(options.adaptiveQuality);
+	setAmbisonics(options.ambisonics, options.ambisonicsFormat);
+	setBinaural(options.binauralTable);
+	setVerbose(options.verbose);
+	setDeadline(options.deadlineUs);
+	setHardwareCounters(options.hardwareCounters);
+}
+
+void DirectionPipeline::setOnsetGating(bool enabled, float holdSec, float backgroundSec)
+{
+	const unsigned int rate = source.format().sampleRate;
+	onsetGating = enabled;
+	holdFrames = static_cast<std::uint64_t>(holdSec * rate);
+	backgroundFrames = static_cast<std::uint64_t>(backgroundSec * rate);
+	onsetDetector.reset();
+}
+
+void DirectionPipeline::setMultiSource(int maxSources)
+{
+	const AudioFormat format = source.format();
+	if (maxSources > 0 && format.channels >= 2) {
+		localizer = std::make_unique<MultiSourceLocalizer>(format, 1024, 0, 72, maxSources);
+	} else {
+		localizer.reset();
+	}
+	applyQualityTier();
+}
+
+void DirectionPipeline::setFixedWindow(unsigned int windowFrames, unsigned int hopFrames)
+{
+	windowState = DirectionState();
+	windowEnergy.assign(energy.size(), 0.0f);
+	if (windowFrames > 0) {
+		reframer = std::make_unique<FrameReframer>(static_cast<int>(energy.size()), windowFrames, std::min(hopFrames, windowFrames));
+	} else {
+		reframer.reset();
+	}
+}
+
+void DirectionPipeline::setAdaptiveQuality(bool enabled, const QualityPolicy& policy)
+{
+	governor = enabled ? std::make_unique<QualityGovernor>(policy) : nullptr;
+	pipelineStats.qualityTier = QualityTier::Full;
+	applyQualityTier();
+}
+
+void DirectionPipeline::setAmbisonics(bool enabled, AmbisonicsFormat format)
+{
+	const AudioFormat audio = source.format();
+	if (enabled && audio.channels != AmbisonicsAnalyzer::Channels) {
+		throw std::runtime_error("Formato B de primeira ordem precisa de 4 canais, a fonte tem " + std::to_string(audio.channels));
+	}
+	ambisonics = enabled ? std::make_unique<AmbisonicsAnalyzer>(audio.sampleRate, format) : nullptr;
+}
+
+void DirectionPipeline::setBinaural(const std::string& tablePath)
+{
+	if (tablePath.empty()) {
+		if (delayEstimator) delayEstimator->setSpectrumSink(nullptr);
+		binaural.reset();
+		return;
+	}
+	if (!delayEstimator) {
+		throw std::runtime_error("A analise binaural precisa de audio estereo");
+	}
+	auto analyzer = std::make_unique<BinauralCueAnalyzer>(BinauralCueTable(tablePath), source.format().sampleRate, delayEstimator->frameSize());
+	delayEstimator->setSpectrumSink(analyzer.get());
+	binaural = std::move(analyzer);
+}
+
+void DirectionPipeline::applyQualityTier()
+{
+	const bool banded = governor && governor->tier() >= QualityTier::FewerBands;
+	const float maxHz = banded ? governor->policy().bandLimitHz : 0.0f;
+	if (delayEstimator) delayEstimator->setMaxFrequency(maxHz);
+	if (localizer) localizer->setMaxFrequency(maxHz);
+}
+
+void DirectionPipeline::setHardwareCounters(bool enabled)
+{
+	countStages = enabled;
+	if (!enabled) counters.reset();
+}
+
+bool DirectionPipeline::step()
+{
+	// perf_event_open counts the opening thread, so the group is opened by the first step()
+	if (countStages && !counters) counters = std::make_unique<StageCounters>();
+	StageCounters* stages = counters && counters->available() ? counters.get() : nullptr;
+	if (stages) stages->restart();
+
+	CapturePacket packet;
+	{
+		AVIS_TRACE_SCOPE("captura");
+		if (!source.nextPacket(packet)) return false;
+	}
+	if (stages) stages->mark(PipelineStage::Capture, packet.frameCount);
+
+	const std::uint64_t arrivedNs = SteadyNowNs();
+	const int numChannels = static_cast<int>(energy.size());
+
+	const std::uint64_t position = pipelineStats.frames;
+	++pipelineStats.packets;
+	pipelineStats.frames += packet.frameCount;
+
+	if (packet.silent || (!packet.samples && !packet.planes && !packet.pcm) || packet.frameCount == 0) {
+		++pipelineStats.silentPackets;
+		// A window (or the intensity average) must not span the gap
+		if (reframer) reframer->reset();
+		if (ambisonics) ambisonics->reset();
+		return true;
+	}
+
+	// Integer PCM only feeds the level analysis; the other stages work on floats
+	const bool floatData = packet.samples || packet.planes;
+	bool fullCost = true;
+	if (onsetGating && floatData) {
+		AVIS_TRACE_SCOPE("onset");
+		const bool onset = packet.planes ? onsetDetector.processPlanar(packet.planes, packet.frameCount, numChannels)
+			: onsetDetector.process(packet.samples, packet.frameCount, numChannels);
+		if (onset) {
+			++pipelineStats.onsets;
+			activeUntil = position + packet.frameCount + holdFrames;
+		}
+		fullCost = position < activeUntil || pipelineStats.fullCostFrames == 0 || position - lastFullCost >= backgroundFrames;
+	}
+
+	if (!fullCost) {
+		// Keep the delay history current so an onset window starts with a full frame
+		if (delayEstimator && (useDelay || binaural) && floatData) pushDelay(packet, false);
+		if (localizer) localizer->reset();
+		if (reframer) reframer->reset();
+		if (ambisonics) ambisonics->reset();
+		if (stages) stages->mark(PipelineStage::Analysis, packet.frameCount);
+		return true;
+	}
+	lastFullCost = position;
+	pipelineStats.fullCostFrames += packet.frameCount;
+
+	// The FFT stages transform every packet, one in decimation, or none (history only)
+	const QualityTier tier = governor ? governor->tier() : QualityTier::Full;
+	pipelineStats.tierFrames[static_cast<int>(tier)] += packet.frameCount;
+	const bool transform = tier < QualityTier::Decimated ||
+		(tier == QualityTier::Decimated && pipelineStats.packets % governor->policy().decimation == 0);
+
+	unsigned int energyFrames = packet.frameCount;
+	{
+		AVIS_TRACE_SCOPE("analise");
+		if (!floatData) {
+			state = analyzer.analyzePcm(packet.pcm, packet.pcmEncoding, packet.frameCount, numChannels, energy.data());
+		} else if (ambisonics) {
+			state = (packet.planes ? ambisonics->processPlanar(packet.planes, packet.frameCount)
+				: ambisonics->process(packet.samples, packet.frameCount)).state;
+			// Channel levels are only needed for the timeline
+			if (timeline) {
+				if (packet.planes) DirectionAnalyzer::measurePlanar(packet.planes, packet.frameCount, numChannels, energy.data());
+				else DirectionAnalyzer::measure(packet.samples, packet.frameCount, numChannels, energy.data());
+			}
+		} else if (reframer) {
+			auto onWindow = [&](const float* window, std::uint64_t) {
+				windowState = analyzer.analyzeState(window, reframer->windowSize(), numChannels, windowEnergy.data());
+			};
+			if (packet.planes) reframer->pushPlanar(packet.planes, packet.frameCount, onWindow);
+			else reframer->push(packet.samples, packet.frameCount, onWindow);
+			state = windowState;
+			energy = windowEnergy;
+			energyFrames = reframer->windowSize();
+		} else {
+			state = packet.planes ? analyzer.analyzePlanar(packet.planes, packet.frameCount, numChannels, energy.data())
+				: analyzer.analyzeState(packet.samples, packet.frameCount, numChannels, energy.data());
+		}
+	}
+	if (delayEstimator && (useDelay || binaural) && floatData) {
+		AVIS_TRACE_SCOPE("gcc-phat");
+		pushDelay(packet, transform);
+		if (useDelay && tier != QualityTier::Broadband) state = FuseStereoCues(state, delayEstimator->estimate());
+		// Binaural cues ride on the same transform, so they go stale (and are not used) at Broadband
+		if (binaural && tier != QualityTier::Broadband && binaural->estimate().valid) state = binaural->estimate().state;
+	}
+	if (localizer && packet.samples) {
+		AVIS_TRACE_SCOPE("multi-fonte");
+		localizer->push(packet.samples, packet.frameCount, transform);
+	}
+	if (stages) stages->mark(PipelineStage::Analysis, packet.frameCount);
+
+	{
+		AVIS_TRACE_SCOPE("publicacao");
+		if (directionRef) {
+			if (state.direction == Direction::Left) *directionRef = 1;
+			else if (state.direction == Direction::Right) *directionRef = 2;
+			else *directionRef = 0;
+		}
+
+		if (publisher) {
+			publisher->publish(packet.timestampUs, state);
+		}
+		if (events) {
+			events->publish(packet.timestampUs, state);
+		}
+	}
+
+	const std::uint64_t publishedNs = SteadyNowNs();
+	pipelineStats.processingUs.record((publishedNs - arrivedNs) / 1000);
+	if (packet.readyNs != 0 && publishedNs >= packet.readyNs) {
+		const std::uint64_t latencyUs = (publishedNs - packet.readyNs) / 1000;
+		pipelineStats.decisionLatencyUs.record(latencyUs);
+		if (deadlineUs > 0 && latencyUs > deadlineUs) {
+			++pipelineStats.deadlineMisses;
+			AVIS_TRACE_DEADLINE_MISS();
+		}
+	}
+
+	if (governor) {
+		const std::uint64_t audioNs = static_cast<std::uint64_t>(packet.frameCount) * 1000000000ull / source.format().sampleRate;
+		const std::uint64_t lagNs = packet.readyNs != 0 && arrivedNs > packet.readyNs ? arrivedNs - packet.readyNs : 0;
+		if (governor->update(publishedNs - arrivedNs, audioNs, lagNs)) {
+			const QualityTier next = governor->tier();
+			if (next > pipelineStats.qualityTier) ++pipelineStats.tierDowngrades;
+			else ++pipelineStats.tierUpgrades;
+			pipelineStats.qualityTier = next;
+			applyQualityTier();
+			if (publisher) {
+				publisher->publishQuality(static_cast<std::uint32_t>(next),
+					static_cast<std::uint32_t>(pipelineStats.tierDowngrades + pipelineStats.tierUpgrades));
+			}
+			if (verbose) std::cout << "[qualidade: " << QualityTierName(next) << ", carga " << governor->load() << "]\n";
+		}
+		pipelineStats.qualityLoad = governor->load();
+	}
+
+	if (verbose) {
+		std::cout << directionToString(state.direction);
+		if (ambisonics) {
+			std::cout << " | azimute " << state.azimuth << " elevacao " << ambisonics->estimate().elevation
+				<< " difusividade " << ambisonics->estimate().diffuseness;
+		}
+		if (binaural && binaural->estimate().valid) {
+			std::cout << " | azimute " << state.azimuth << " elevacao " << binaural->estimate().elevation;
+		}
+		for (int i = 0; i < sourceCount(); ++i) {
+			std::cout << (i == 0 ? " | fontes:" : "") << ' ' << sources()[i].azimuth;
+		}
+		std::cout << '\n';
+	}
+
+	if (timeline) {
+		AVIS_TRACE_SCOPE("timeline");
+		for (auto& e : energy) e /= static_cast<float>(energyFrames);
+		timeline->append(packet.timestampUs, state, energy.data());
+	}
+	if (stages) stages->mark(PipelineStage::Publish, packet.frameCount);
+	return true;
+}
+
+void DirectionPipeline::pushDelay(const CapturePacket& packet, bool analyze)
+{
+	if (packet.planes) delayEstimator->pushPlanar(packet.planes[0], packet.planes[1], packet.frameCount, analyze);
+	else delayEstimator->push(packet.samples, packet.frameCount, static_cast<int>(energy.size()), analyze);
+}
+
+void DirectionPipeline::runToEnd()
+{
+	while (step()) {
+	}
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AdaptiveQuality.h"
+#include "Ambisonics.h"
+#include "BinauralCues.h"
+#include "CaptureSource.h"
+#include "DirectionAnalyzer.h"
+#include "GccPhat.h"
+#include "HardwareCounters.h"
+#include "LatencyHistogram.h"
+#include "MirroredRing.h"
+#include "MultiSourceLocalizer.h"
+#include "OnsetDetector.h"
+
+class DirectionStatePublisher;
+class EventStreamServer;
+class TimelineWriter;
+
+// Optional outputs and analysis modes, as chosen on the command line.
+struct PipelineOptions
+{
+	TimelineWriter* timeline = nullptr;
+	DirectionStatePublisher* publisher = nullptr;
+	EventStreamServer* events = nullptr;
+	bool onsetGating = false;
+	int multiSource = 0;
+	float windowMs = 0.0f;       // fixed level-analysis window; 0 = each packet as delivered
+	float hopMs = 0.0f;          // 0 = half the window
+	bool adaptiveQuality = false;
+	bool ambisonics = false;     // 4-channel input is first-order B-format
+	AmbisonicsFormat ambisonicsFormat = AmbisonicsFormat::FuMa;
+	std::string binauralTable;   // .avhc cue table: stereo is treated as a binaural mix
+	unsigned int deadlineUs = 0; // decision latency budget; 0 = none
+	bool hardwareCounters = false;
+	bool verbose = false;
+};
+
+struct PipelineStats
+{
+	std::uint64_t packets = 0;
+	std::uint64_t silentPackets = 0;
+	std::uint64_t frames = 0;
+	std::uint64_t fullCostFrames = 0;   // frames that went through the full localization
+	std::uint64_t onsets = 0;
+	std::uint64_t deadlineMisses = 0;
+	// Adaptive quality (all zero/Full when it is off)
+	QualityTier qualityTier = QualityTier::Full;
+	std::uint64_t tierDowngrades = 0;
+	std::uint64_t tierUpgrades = 0;
+	std::uint64_t tierFrames[static_cast<int>(QualityTier::Count)] = {}; // analyzed at each tier
+	float qualityLoad = 0.0f;           // smoothed processing time / audio time
+	LatencyHistogram decisionLatencyUs; // packet ready -> direction published
+	LatencyHistogram processingUs;      // time spent in step() after the packet arrived
+
+	double fullCostFraction() const { return frames ? static_cast<double>(fullCostFrames) / frames : 0.0; }
+};
+
+// Pulls packets from a CaptureSource, analyzes them and publishes the result to
+// the overlay atomic (1 = left, 2 = right, 0 = anything else) and, optionally, a timeline,
+// the shared-memory ring and the event stream.
+class DirectionPipeline
+{
+public:
+	explicit DirectionPipeline(CaptureSource& source, std::atomic<int>* directionRef = nullptr);
+
+	void configure(const PipelineOptions& options);
+	void setTimeline(TimelineWriter* writer) { timeline = writer; }
+	void setPublisher(DirectionStatePublisher* shared) { publisher = shared; }
+	void setEventServer(EventStreamServer* server) { events = server; }
+	void setVerbose(bool enabled) { verbose = enabled; }
+	// Packets whose decision latency exceeds this count as deadline misses and, when
+	// a flight-recorder trace is running, trigger a dump.
+	void setDeadline(unsigned int microseconds) { deadlineUs = microseconds; }
+	// Stereo only: fuse the GCC-PHAT delay cue with the level cue (on by default).
+	void setDelayEstimation(bool enabled) { useDelay = enabled; }
+	// Run the localization only from an onset until holdSec after it, plus one
+	// background estimate every backgroundSec; other packets only feed the detector.
+	void setOnsetGating(bool enabled, float holdSec = 0.2f, float backgroundSec = 0.25f);
+	// Also track up to maxSources simultaneous sources (0 disables); see sources().
+	// Needs interleaved packets: planar packets skip it.
+	void setMultiSource(int maxSources);
+	// Run the level analysis on fixed windows of windowFrames advancing by hopFrames
+	// (0 = half the window) instead of on packets as they come; 0 frames turns it off.
+	// Each packet publishes the state of the last window it completed.
+	void setFixedWindow(unsigned int windowFrames, unsigned int hopFrames = 0);
+	// Step down through QualityTier when analysis stops keeping up with the audio, and
+	// back up when it does again. Tier changes show up in stats(), in verbose output and
+	// in the shared-memory header.
+	void setAdaptiveQuality(bool enabled, const QualityPolicy& policy = {});
+	// Treat the 4 channels as first-order B-format: direction comes from the intensity
+	// vector (AmbisonicsAnalyzer) instead of the quad level cue, and overrides the fixed
+	// window. Throws for other channel counts.
+	void setAmbisonics(bool enabled, AmbisonicsFormat format = AmbisonicsFormat::FuMa);
+	// Stereo only: read the mix as binaural (HRTF-rendered) and match its per-band
+	// ILD/ITD and spectral shape against the cue table at tablePath, on the GCC-PHAT
+	// spectra. Gives a full-circle azimuth in place of the left/right cues. An empty
+	// path turns it off; throws for other channel counts or an unreadable table.
+	void setBinaural(const std::string& tablePath);
+	// Count cycles, instructions and cache/branch misses per stage (capture, analysis,
+	// publish) with perf_event_open. The counters belong to the thread that calls step().
+	void setHardwareCounters(bool enabled);
+	void setDecisionParams(const DecisionParams& params) { analyzer.setDecisionParams(params); }
+
+	// Processes one packet; returns false at end of stream.
+	bool step();
+	void runToEnd();
+
+	const PipelineStats& stats() const { return pipelineStats; }
+	const DirectionState& lastState() const { return state; }
+	// Empty unless setMultiSource() was enabled.
+	int sourceCount() const { return localizer ? localizer->sourceCount() : 0; }
+	const SourceEstimate* sources() const { return localizer ? localizer->sources() : nullptr; }
+	// Elevation, diffuseness and per-band detail; null unless setAmbisonics() was enabled.
+	const AmbisonicsEstimate* ambisonicsEstimate() const { return ambisonics ? &ambisonics->estimate() : nullptr; }
+	// Per-band cues and elevation; null unless setBinaural() was given a table.
+	const BinauralEstimate* binauralEstimate() const { return binaural ? &binaural->estimate() : nullptr; }
+	// Null unless setHardwareCounters() was enabled and step() has run.
+	const StageCounters* stageCounters() const { return counters.get(); }
+
+private:
+	void pushDelay(const CapturePacket& packet, bool analyze);
+	void applyQualityTier();
+
+	CaptureSource& source;
+	std::atomic<int>* directionRef;
+	TimelineWriter* timeline = nullptr;
+	DirectionStatePublisher* publisher = nullptr;
+	EventStreamServer* events = nullptr;
+	bool verbose = false;
+	unsigned int deadlineUs = 0;
+	bool useDelay = true;
+	bool onsetGating = false;
+	std::uint64_t holdFrames = 0;
+	std::uint64_t backgroundFrames = 0;
+	std::uint64_t activeUntil = 0;   // stream position (frames) where the onset window ends
+	std::uint64_t lastFullCost = 0;  // stream position of the last fully analyzed packet
+	bool countStages = false;
+
+	DirectionAnalyzer analyzer;
+	OnsetDetector onsetDetector;
+	std::unique_ptr<GccPhatEstimator> delayEstimator;
+	std::unique_ptr<MultiSourceLocalizer> localizer;
+	std::unique_ptr<FrameReframer> reframer;
+	std::unique_ptr<QualityGovernor> governor;
+	std::unique_ptr<AmbisonicsAnalyzer> ambisonics;
+	std::unique_ptr<BinauralCueAnalyzer> binaural;
+	DirectionState windowState;       // level state of the last fixed window
+	std::vector<float> windowEnergy;
+	std::unique_ptr<StageCounters> counters;
+	DirectionState state;
+	std::vector<float> energy;
+	PipelineStats pipelineStats;
+};
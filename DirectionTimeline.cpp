@@ -0,0 +1,417 @@
+#include "DirectionTimeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "DirectionUtils.h"
+
+namespace
+{
+	constexpr char FileMagic[4] = { 'A', 'V', 'T', 'L' };
+	constexpr char IndexMagic[4] = { 'A', 'V', 'T', 'I' };
+	constexpr std::uint16_t FormatVersion = 1;
+	constexpr std::size_t FileHeaderSize = 12;   // magic, version, numBands, recordsPerBlock
+	constexpr std::size_t BlockHeaderSize = 16;  // recordCount, firstTimestampUs, payloadBytes
+	constexpr std::size_t IndexEntrySize = 20;   // firstTimestampUs, offset, recordCount
+	constexpr std::size_t TrailerSize = 20;      // indexOffset, totalRecords, magic
+
+	void putU16(std::vector<std::uint8_t>& out, std::uint16_t v)
+	{
+		out.push_back(static_cast<std::uint8_t>(v));
+		out.push_back(static_cast<std::uint8_t>(v >> 8));
+	}
+
+	void putU32(std::vector<std::uint8_t>& out, std::uint32_t v)
+	{
+		for (int i = 0; i < 4; ++i) out.push_back(static_cast<std::uint8_t>(v >> (8 * i)));
+	}
+
+	void putU64(std::vector<std::uint8_t>& out, std::uint64_t v)
+	{
+		for (int i = 0; i < 8; ++i) out.push_back(static_cast<std::uint8_t>(v >> (8 * i)));
+	}
+
+	void putVarint(std::vector<std::uint8_t>& out, std::uint64_t v)
+	{
+		while (v >= 0x80) {
+			out.push_back(static_cast<std::uint8_t>(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(static_cast<std::uint8_t>(v));
+	}
+
+	void storeLE(std::uint8_t* p, std::uint64_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; ++i) p[i] = static_cast<std::uint8_t>(v >> (8 * i));
+	}
+
+	std::uint64_t getLE(const std::uint8_t* p, int bytes)
+	{
+		std::uint64_t v = 0;
+		for (int i = 0; i < bytes; ++i) v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+		return v;
+	}
+
+	std::uint64_t getVarint(const std::uint8_t*& p, const std::uint8_t* end)
+	{
+		std::uint64_t v = 0;
+		for (int shift = 0; p < end && shift < 64; shift += 7) {
+			const std::uint8_t b = *p++;
+			v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+			if ((b & 0x80) == 0) return v;
+		}
+		throw std::runtime_error("Timeline corrompida (varint truncado)");
+	}
+
+	std::uint8_t quantizeEnergy(float e)
+	{
+		const float db = 20.0f * std::log10(std::max(e, 1e-6f));
+		return static_cast<std::uint8_t>(std::clamp(std::lround((db + 120.0f) * 2.0f), 0L, 255L));
+	}
+
+	float dequantizeEnergy(std::uint8_t q)
+	{
+		return q == 0 ? 0.0f : std::pow(10.0f, (q * 0.5f - 120.0f) / 20.0f);
+	}
+}
+
+TimelineWriter::TimelineWriter(const std::string& path, int numBands, std::uint32_t recordsPerBlock)
+	: file(path, std::ios::binary | std::ios::trunc), numBands(numBands), recordsPerBlock(recordsPerBlock)
+{
+	if (!file.is_open()) {
+		throw std::runtime_error("Falha ao abrir timeline para escrita: " + path);
+	}
+	if (numBands < 0 || numBands > 0xFFFF || recordsPerBlock == 0) {
+		throw std::runtime_error("Parametros de timeline invalidos");
+	}
+
+	std::vector<std::uint8_t> header(FileMagic, FileMagic + 4);
+	putU16(header, FormatVersion);
+	putU16(header, static_cast<std::uint16_t>(numBands));
+	putU32(header, recordsPerBlock);
+	file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+
+	timestamps.reserve(recordsPerBlock);
+	directions.reserve(recordsPerBlock);
+	azimuths.reserve(recordsPerBlock);
+	confidences.reserve(recordsPerBlock);
+	bands.resize(static_cast<std::size_t>(numBands) * recordsPerBlock);
+	// Worst case: 10-byte varints. With the index reserved too, append() does not allocate
+	// until the file passes 4096 blocks.
+	encoded.reserve(BlockHeaderSize + static_cast<std::size_t>(recordsPerBlock) * (10 + 4 + numBands));
+	index.reserve(4096);
+}
+
+TimelineWriter::~TimelineWriter()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void TimelineWriter::append(std::uint64_t timestampUs, const DirectionState& state, const float* bandEnergy)
+{
+	if (closed) return;
+
+	// Clamp instead of failing so a clock hiccup in the live loop cannot corrupt the file
+	timestampUs = std::max(timestampUs, lastTimestampUs);
+	lastTimestampUs = timestampUs;
+
+	const std::size_t row = timestamps.size();
+	timestamps.push_back(timestampUs);
+	directions.push_back(static_cast<std::uint8_t>(state.direction));
+	azimuths.push_back(static_cast<std::int16_t>(std::lround(std::clamp(state.azimuth, -180.0f, 180.0f) * (32767.0f / 180.0f))));
+	confidences.push_back(static_cast<std::uint8_t>(std::lround(std::clamp(state.confidence, 0.0f, 1.0f) * 255.0f)));
+	for (int b = 0; b < numBands; ++b) {
+		bands[b * recordsPerBlock + row] = bandEnergy ? quantizeEnergy(bandEnergy[b]) : 0;
+	}
+
+	if (timestamps.size() == recordsPerBlock) {
+		flushBlock();
+	}
+}
+
+void TimelineWriter::flushBlock()
+{
+	const auto count = static_cast<std::uint32_t>(timestamps.size());
+	if (count == 0) return;
+
+	// The block header is patched in front of the payload once its size is known
+	encoded.assign(BlockHeaderSize, 0);
+	std::uint64_t previous = timestamps.front();
+	for (const std::uint64_t ts : timestamps) {
+		putVarint(encoded, ts - previous);
+		previous = ts;
+	}
+	encoded.insert(encoded.end(), directions.begin(), directions.end());
+	for (const std::int16_t az : azimuths) putU16(encoded, static_cast<std::uint16_t>(az));
+	encoded.insert(encoded.end(), confidences.begin(), confidences.end());
+	for (int b = 0; b < numBands; ++b) {
+		const auto* column = bands.data() + static_cast<std::size_t>(b) * recordsPerBlock;
+		encoded.insert(encoded.end(), column, column + count);
+	}
+
+	TimelineBlockInfo info;
+	info.firstTimestampUs = timestamps.front();
+	info.offset = static_cast<std::uint64_t>(file.tellp());
+	info.recordCount = count;
+	index.push_back(info);
+
+	storeLE(encoded.data(), count, 4);
+	storeLE(encoded.data() + 4, info.firstTimestampUs, 8);
+	storeLE(encoded.data() + 12, encoded.size() - BlockHeaderSize, 4);
+	file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+
+	timestamps.clear();
+	directions.clear();
+	azimuths.clear();
+	confidences.clear();
+}
+
+void TimelineWriter::close()
+{
+	if (closed) return;
+	flushBlock();
+	closed = true;
+
+	std::uint64_t totalRecords = 0;
+	std::vector<std::uint8_t> tail;
+	const auto indexOffset = static_cast<std::uint64_t>(file.tellp());
+	putU32(tail, static_cast<std::uint32_t>(index.size()));
+	for (const auto& info : index) {
+		putU64(tail, info.firstTimestampUs);
+		putU64(tail, info.offset);
+		putU32(tail, info.recordCount);
+		totalRecords += info.recordCount;
+	}
+	putU64(tail, indexOffset);
+	putU64(tail, totalRecords);
+	tail.insert(tail.end(), IndexMagic, IndexMagic + 4);
+	file.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail.size()));
+	file.close();
+
+	if (file.fail()) {
+		throw std::runtime_error("Falha ao gravar timeline");
+	}
+}
+
+TimelineReader::TimelineReader(const std::string& path)
+	: file(path, std::ios::binary)
+{
+	if (!file.is_open()) {
+		throw std::runtime_error("Falha ao abrir timeline: " + path);
+	}
+
+	std::uint8_t header[FileHeaderSize];
+	if (!file.read(reinterpret_cast<char*>(header), FileHeaderSize) || std::memcmp(header, FileMagic, 4) != 0) {
+		throw std::runtime_error("Arquivo nao e uma timeline AVTL: " + path);
+	}
+	if (getLE(header + 4, 2) != FormatVersion) {
+		throw std::runtime_error("Versao de timeline nao suportada");
+	}
+	numBands = static_cast<int>(getLE(header + 6, 2));
+
+	std::uint8_t trailer[TrailerSize];
+	file.seekg(0, std::ios::end);
+	const auto fileSize = static_cast<std::uint64_t>(file.tellg());
+	file.seekg(-static_cast<std::streamoff>(TrailerSize), std::ios::end);
+	if (fileSize < FileHeaderSize + TrailerSize || !file.read(reinterpret_cast<char*>(trailer), TrailerSize) || std::memcmp(trailer + 16, IndexMagic, 4) != 0) {
+		// The live loop may have been killed before close(); walk the block headers instead
+		rebuildIndex(fileSize);
+		return;
+	}
+	const std::uint64_t indexOffset = getLE(trailer, 8);
+	totalRecords = getLE(trailer + 8, 8);
+
+	std::uint8_t countBytes[4];
+	file.seekg(static_cast<std::streamoff>(indexOffset));
+	file.read(reinterpret_cast<char*>(countBytes), 4);
+	const auto blockCount = static_cast<std::size_t>(getLE(countBytes, 4));
+
+	std::vector<std::uint8_t> entries(blockCount * IndexEntrySize);
+	if (!file.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size()))) {
+		throw std::runtime_error("Indice de timeline truncado");
+	}
+	index.resize(blockCount);
+	for (std::size_t i = 0; i < blockCount; ++i) {
+		const std::uint8_t* e = entries.data() + i * IndexEntrySize;
+		index[i].firstTimestampUs = getLE(e, 8);
+		index[i].offset = getLE(e + 8, 8);
+		index[i].recordCount = static_cast<std::uint32_t>(getLE(e + 16, 4));
+	}
+}
+
+void TimelineReader::rebuildIndex(std::uint64_t fileSize)
+{
+	file.clear();
+	index.clear();
+	totalRecords = 0;
+
+	std::uint64_t offset = FileHeaderSize;
+	std::uint8_t header[BlockHeaderSize];
+	while (offset + BlockHeaderSize <= fileSize) {
+		file.seekg(static_cast<std::streamoff>(offset));
+		if (!file.read(reinterpret_cast<char*>(header), BlockHeaderSize)) break;
+
+		const auto count = static_cast<std::uint32_t>(getLE(header, 4));
+		const std::uint64_t payload = getLE(header + 12, 4);
+		if (count == 0 || offset + BlockHeaderSize + payload > fileSize) break; // torn last block
+
+		index.push_back({ getLE(header + 4, 8), offset, count });
+		totalRecords += count;
+		offset += BlockHeaderSize + payload;
+	}
+	file.clear();
+}
+
+std::size_t TimelineReader::findBlock(std::uint64_t timestampUs) const
+{
+	// Timestamps only never decrease, so a block may end on the very timestamp the next
+	// one starts with: take the first block starting at or after it, then step back one
+	const auto it = std::lower_bound(index.begin(), index.end(), timestampUs,
+		[](const TimelineBlockInfo& info, std::uint64_t ts) { return info.firstTimestampUs < ts; });
+	return it == index.begin() ? 0 : static_cast<std::size_t>(it - index.begin()) - 1;
+}
+
+void TimelineReader::readBlock(std::size_t block, std::vector<TimelineRecord>& out)
+{
+	if (block >= index.size()) {
+		throw std::out_of_range("Bloco de timeline inexistente");
+	}
+
+	std::uint8_t header[BlockHeaderSize];
+	file.clear();
+	file.seekg(static_cast<std::streamoff>(index[block].offset));
+	if (!file.read(reinterpret_cast<char*>(header), BlockHeaderSize)) {
+		throw std::runtime_error("Bloco de timeline truncado");
+	}
+	const auto count = static_cast<std::size_t>(getLE(header, 4));
+	std::uint64_t timestamp = getLE(header + 4, 8);
+	raw.resize(static_cast<std::size_t>(getLE(header + 12, 4)));
+	if (!file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()))) {
+		throw std::runtime_error("Bloco de timeline truncado");
+	}
+
+	out.resize(count);
+	const std::uint8_t* p = raw.data();
+	const std::uint8_t* end = p + raw.size();
+	for (auto& record : out) {
+		timestamp += getVarint(p, end);
+		record.timestampUs = timestamp;
+	}
+
+	const std::size_t fixedBytes = count * (4 + static_cast<std::size_t>(numBands));
+	if (static_cast<std::size_t>(end - p) < fixedBytes) {
+		throw std::runtime_error("Bloco de timeline corrompido");
+	}
+	const std::uint8_t* dirColumn = p;
+	const std::uint8_t* azColumn = dirColumn + count;
+	const std::uint8_t* confColumn = azColumn + 2 * count;
+	const std::uint8_t* bandColumns = confColumn + count;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		auto& record = out[i];
+		record.state.direction = static_cast<Direction>(std::min<std::uint8_t>(dirColumn[i], static_cast<std::uint8_t>(Direction::Unknown)));
+		record.state.azimuth = static_cast<std::int16_t>(getLE(azColumn + 2 * i, 2)) * (180.0f / 32767.0f);
+		record.state.confidence = confColumn[i] / 255.0f;
+		record.bandEnergy.resize(numBands);
+		for (int b = 0; b < numBands; ++b) {
+			record.bandEnergy[b] = dequantizeEnergy(bandColumns[b * count + i]);
+		}
+	}
+}
+
+void TimelineReader::readRange(std::uint64_t fromUs, std::uint64_t toUs, std::vector<TimelineRecord>& out)
+{
+	std::vector<TimelineRecord> block;
+	for (std::size_t b = findBlock(fromUs); b < index.size() && index[b].firstTimestampUs < toUs; ++b) {
+		readBlock(b, block);
+		for (auto& record : block) {
+			if (record.timestampUs >= fromUs && record.timestampUs < toUs) {
+				out.push_back(std::move(record));
+			}
+		}
+	}
+}
+
+void ExportTimelineCsv(const std::string& timelinePath, std::ostream& out)
+{
+	TimelineReader reader(timelinePath);
+	out << "timestamp_us,direction,azimuth,confidence";
+	for (int b = 0; b < reader.bandCount(); ++b) out << ",band" << b;
+	out << '\n';
+
+	std::vector<TimelineRecord> records;
+	for (std::size_t block = 0; block < reader.blocks().size(); ++block) {
+		reader.readBlock(block, records);
+		for (const auto& r : records) {
+			out << r.timestampUs << ',' << directionToString(r.state.direction) << ',' << r.state.azimuth << ',' << r.state.confidence;
+			for (const float e : r.bandEnergy) out << ',' << e;
+			out << '\n';
+		}
+	}
+}
+
+void ExportTimelineJson(const std::string& timelinePath, std::ostream& out)
+{
+	TimelineReader reader(timelinePath);
+	out << "[\n";
+
+	bool first = true;
+	std::vector<TimelineRecord> records;
+	for (std::size_t block = 0; block < reader.blocks().size(); ++block) {
+		reader.readBlock(block, records);
+		for (const auto& r : records) {
+			out << (first ? "  " : ",\n  ");
+			first = false;
+			out << "{\"t\":" << r.timestampUs << ",\"direction\":\"" << directionToString(r.state.direction)
+				<< "\",\"azimuth\":" << r.state.azimuth << ",\"confidence\":" << r.state.confidence << ",\"bands\":[";
+			for (std::size_t b = 0; b < r.bandEnergy.size(); ++b) {
+				out << (b ? "," : "") << r.bandEnergy[b];
+			}
+			out << "]}";
+		}
+	}
+	out << "\n]\n";
+}
+
+void BenchmarkTimelineReader(const std::string& timelinePath)
+{
+	using Clock = std::chrono::steady_clock;
+
+	TimelineReader reader(timelinePath);
+	std::vector<TimelineRecord> records;
+
+	auto start = Clock::now();
+	std::uint64_t decoded = 0;
+	for (std::size_t block = 0; block < reader.blocks().size(); ++block) {
+		reader.readBlock(block, records);
+		decoded += records.size();
+	}
+	const double scanSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "Leitura sequencial: " << decoded << " registros em " << scanSeconds * 1000.0 << " ms ("
+		<< (scanSeconds > 0 ? decoded / scanSeconds / 1e6 : 0.0) << " M registros/s)\n";
+
+	if (reader.blocks().empty()) return;
+
+	constexpr int Seeks = 1000;
+	const std::uint64_t lastTs = reader.blocks().back().firstTimestampUs;
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<std::uint64_t> pick(0, lastTs);
+
+	start = Clock::now();
+	for (int i = 0; i < Seeks; ++i) {
+		reader.readBlock(reader.findBlock(pick(rng)), records);
+	}
+	const double seekSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "Busca aleatoria: " << seekSeconds * 1e6 / Seeks << " us por busca ("
+		<< reader.blocks().size() << " blocos)\n";
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Direction.h"
+
+// Binary direction timeline (.avtl).
+//
+// Layout: FileHeader, then blocks of up to recordsPerBlock records, then the
+// block index and a trailer pointing at it. Every block is stored column by
+// column:
+//   timestamps  varint deltas in microseconds (the first one from the block start)
+//   direction   1 byte per record
+//   azimuth     int16, degrees * 32767 / 180
+//   confidence  uint8, confidence * 255
+//   bands       numBands columns of uint8, 0.5 dB steps from -120 dBFS
+// The index holds the first timestamp and file offset of each block, so a seek
+// is a binary search plus one block decode. A file without a trailer (capture
+// killed before close) is still readable: the reader walks the block headers.
+
+struct TimelineRecord
+{
+	std::uint64_t timestampUs = 0;
+	DirectionState state;
+	std::vector<float> bandEnergy; // mean |x| per band, linear scale
+};
+
+struct TimelineBlockInfo
+{
+	std::uint64_t firstTimestampUs = 0;
+	std::uint64_t offset = 0;
+	std::uint32_t recordCount = 0;
+};
+
+class TimelineWriter
+{
+public:
+	TimelineWriter(const std::string& path, int numBands, std::uint32_t recordsPerBlock = 1024);
+	~TimelineWriter();
+
+	TimelineWriter(const TimelineWriter&) = delete;
+	TimelineWriter& operator=(const TimelineWriter&) = delete;
+
+	// Timestamps must be non-decreasing. bandEnergy holds numBands values.
+	void append(std::uint64_t timestampUs, const DirectionState& state, const float* bandEnergy);
+	void close();
+
+	int bandCount() const { return numBands; }
+
+private:
+	void flushBlock();
+
+	std::ofstream file;
+	int numBands;
+	std::uint32_t recordsPerBlock;
+	bool closed = false;
+
+	std::uint64_t lastTimestampUs = 0;
+	std::vector<std::uint64_t> timestamps;
+	std::vector<std::uint8_t> directions;
+	std::vector<std::int16_t> azimuths;
+	std::vector<std::uint8_t> confidences;
+	std::vector<std::uint8_t> bands; // band-major within the block
+	std::vector<std::uint8_t> encoded;
+	std::vector<TimelineBlockInfo> index;
+};
+
+class TimelineReader
+{
+public:
+	explicit TimelineReader(const std::string& path);
+
+	int bandCount() const { return numBands; }
+	std::uint64_t recordCount() const { return totalRecords; }
+	const std::vector<TimelineBlockInfo>& blocks() const { return index; }
+
+	// Decodes block i into out (previous contents are replaced).
+	void readBlock(std::size_t block, std::vector<TimelineRecord>& out);
+	// Index of the first block that can hold records at timestampUs, found by binary search.
+	std::size_t findBlock(std::uint64_t timestampUs) const;
+	// Appends all records with from <= timestamp < to.
+	void readRange(std::uint64_t fromUs, std::uint64_t toUs, std::vector<TimelineRecord>& out);
+
+private:
+	void rebuildIndex(std::uint64_t fileSize);
+
+	std::ifstream file;
+	int numBands = 0;
+	std::uint64_t totalRecords = 0;
+	std::vector<TimelineBlockInfo> index;
+	std::vector<std::uint8_t> raw;
+};
+
+void ExportTimelineCsv(const std::string& timelinePath, std::ostream& out);
+void ExportTimelineJson(const std::string& timelinePath, std::ostream& out);
+void BenchmarkTimelineReader(const std::string& timelinePath);
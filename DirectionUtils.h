@@ -1,8 +1,10 @@
 #pragma once
+#include <cmath>
+
 #include "Direction.h"
-#include <string>
 
-inline std::string directionToString(Direction dir) {
+// Returns a static string: no allocation, safe on the capture thread.
+inline const char* directionToString(Direction dir) {
     switch (dir) {
 		case Direction::Left: return "LEFT";
 	    case Direction::Right: return "RIGHT";
@@ -18,4 +20,16 @@ inline std::string directionToString(Direction dir) {
 	    case Direction::Unknown: return "UNKNOWN";
 		default: return "NADA";
     }
-}
\ No newline at end of file
+}
+
+// Full-circle azimuth (degrees, 0 = front, negative = left) to the nearest of the eight
+// directions around the listener, front mapped to "up".
+inline Direction directionFromAzimuth(float azimuth) {
+	const float side = std::fabs(azimuth);
+	const bool left = azimuth < 0.0f;
+	if (side <= 22.5f) return Direction::UpCenter;
+	if (side <= 67.5f) return left ? Direction::UpLeft : Direction::UpRight;
+	if (side <= 112.5f) return left ? Direction::CenterLeft : Direction::CenterRight;
+	if (side <= 157.5f) return left ? Direction::DownLeft : Direction::DownRight;
+	return Direction::DownCenter;
+}
@@ -0,0 +1,182 @@
+#include "EnergyCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "DirectionUtils.h"
+#include "WavFile.h"
+
+namespace
+{
+	constexpr std::uint64_t HashPrime = 0x9E3779B97F4A7C15ull;
+
+	std::uint64_t mix(std::uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	const char* statusName(EnergyCacheStatus status)
+	{
+		switch (status) {
+		case EnergyCacheStatus::Hit: return "valido";
+		case EnergyCacheStatus::Rehashed: return "valido (conteudo reverificado)";
+		default: return "reconstruido";
+		}
+	}
+}
+
+std::string EnergyCachePath(const std::string& wavPath)
+{
+	return wavPath + ".avep";
+}
+
+std::uint64_t HashFileContent(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Nao foi possivel abrir: " + path);
+	}
+
+	// Four independent lanes keep the multiplies from serializing
+	std::uint64_t lanes[4] = { 1, 2, 3, 4 };
+	std::uint64_t length = 0;
+	std::vector<char> buffer(1 << 20);
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		const std::size_t got = static_cast<std::size_t>(file.gcount());
+		if (got == 0) break;
+		// Zero padding to whole words is safe because the length is mixed in at the end
+		std::fill(buffer.begin() + got, buffer.begin() + (got + 31) / 32 * 32, '\0');
+
+		for (std::size_t offset = 0; offset < got; offset += 32) {
+			for (int lane = 0; lane < 4; ++lane) {
+				std::uint64_t word;
+				std::memcpy(&word, buffer.data() + offset + lane * 8, sizeof(word));
+				lanes[lane] = (lanes[lane] ^ word) * HashPrime;
+				lanes[lane] ^= lanes[lane] >> 31;
+			}
+		}
+		length += got;
+	}
+
+	std::uint64_t h = length * HashPrime;
+	for (const std::uint64_t lane : lanes) h = mix(h ^ mix(lane));
+	return h;
+}
+
+PyramidSourceKey ReadSourceKey(const std::string& path, bool hashContent)
+{
+	PyramidSourceKey key;
+	key.bytes = std::filesystem::file_size(path);
+	key.modified = static_cast<std::int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+	if (hashContent) key.contentHash = HashFileContent(path);
+	return key;
+}
+
+std::unique_ptr<EnergyPyramid> OpenEnergyCache(const std::string& wavPath, EnergyCacheStatus* status, double cellMs)
+{
+	const std::string cachePath = EnergyCachePath(wavPath);
+	PyramidSourceKey key = ReadSourceKey(wavPath, false);
+
+	if (std::filesystem::exists(cachePath)) {
+		try {
+			auto cache = std::make_unique<EnergyPyramid>(cachePath);
+			const PyramidSourceKey& cached = cache->sourceKey();
+			const unsigned int cellFrames = static_cast<unsigned int>(std::max(1.0, cellMs * cache->format().sampleRate / 1000.0));
+
+			if (cached.bytes == key.bytes && cache->cellFrames() == cellFrames) {
+				if (cached.modified == key.modified) {
+					if (status) *status = EnergyCacheStatus::Hit;
+					return cache;
+				}
+				key.contentHash = HashFileContent(wavPath);
+				if (cached.contentHash == key.contentHash) {
+					cache.reset();
+					RewritePyramidSourceKey(cachePath, key);
+					if (status) *status = EnergyCacheStatus::Rehashed;
+					return std::make_unique<EnergyPyramid>(cachePath);
+				}
+			}
+		} catch (const std::exception&) {
+			// Unreadable or truncated cache: rebuilt below
+		}
+	}
+
+	if (key.contentHash == 0) key.contentHash = HashFileContent(wavPath);
+
+	WavReader reader(wavPath);
+	const AudioFormat format = reader.format();
+	{
+		const auto cellFrames = static_cast<unsigned int>(std::max(1.0, cellMs * format.sampleRate / 1000.0));
+		EnergyPyramidBuilder builder(cachePath, format, PyramidPrecision::Float32, cellFrames);
+		builder.setSourceKey(key);
+		std::vector<float> buffer(static_cast<std::size_t>(format.sampleRate) * format.channels);
+		while (const unsigned int frames = reader.read(buffer.data(), format.sampleRate)) {
+			builder.push(buffer.data(), frames);
+		}
+		builder.close();
+	}
+
+	if (status) *status = EnergyCacheStatus::Rebuilt;
+	return std::make_unique<EnergyPyramid>(cachePath);
+}
+
+void DecideWindows(const EnergyPyramid& cache, const DecisionParams& params, double windowSec, std::vector<DirectionState>& out)
+{
+	out.clear();
+	const int numChannels = cache.format().channels;
+	if (numChannels > DirectionAnalyzer::MaxChannels || windowSec <= 0.0) return;
+
+	const DirectionAnalyzer analyzer(params);
+	const auto windowUs = static_cast<std::uint64_t>(windowSec * 1e6);
+	const std::uint64_t duration = cache.durationUs();
+
+	float values[DirectionAnalyzer::MaxChannels * PyramidBands];
+	float energy[DirectionAnalyzer::MaxChannels];
+	for (std::uint64_t from = 0; from < duration; from += windowUs) {
+		cache.query(from, std::min(from + windowUs, duration), values);
+		for (int ch = 0; ch < numChannels; ++ch) {
+			energy[ch] = values[ch * PyramidBands + static_cast<int>(PyramidBand::Full)];
+		}
+		out.push_back(analyzer.decide(energy, numChannels));
+	}
+}
+
+void RetuneFromCache(const std::string& wavPath, double windowSec, const std::vector<float>& ratios, DecisionParams params)
+{
+	using Clock = std::chrono::steady_clock;
+
+	auto start = Clock::now();
+	EnergyCacheStatus status = EnergyCacheStatus::Rebuilt;
+	const std::unique_ptr<EnergyPyramid> cache = OpenEnergyCache(wavPath, &status);
+	const double openSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "Cache " << EnergyCachePath(wavPath) << ": " << statusName(status) << " em " << openSeconds * 1000.0 << " ms ("
+		<< cache->durationUs() / 1e6 << " s de audio, " << cache->format().channels << " canais)\n";
+
+	std::vector<DirectionState> states;
+	for (const float ratio : ratios) {
+		params.lateralRatio = ratio;
+		start = Clock::now();
+		DecideWindows(*cache, params, windowSec, states);
+		const double decideSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::uint64_t counts[static_cast<int>(Direction::Unknown) + 1] = {};
+		for (const DirectionState& state : states) ++counts[static_cast<int>(state.direction)];
+
+		std::cout << "  razao " << ratio << ": " << states.size() << " janelas em " << decideSeconds * 1000.0 << " ms;";
+		for (int d = 0; d <= static_cast<int>(Direction::Unknown); ++d) {
+			if (counts[d] == 0) continue;
+			std::cout << ' ' << directionToString(static_cast<Direction>(d)) << '=' << 100.0 * counts[d] / states.size() << '%';
+		}
+		std::cout << '\n';
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DirectionAnalyzer.h"
+#include "EnergyPyramid.h"
+
+// Per-window channel/band energies of an analyzed WAV file, cached next to it as
+// "<file>.avep" (an energy pyramid whose header carries the source key). Decisions
+// only need these energies, so thresholds, channel groupings and window lengths can
+// be retuned without decoding the audio again.
+//
+// Validation: same size and modification time is a hit without reading the audio.
+// A changed time with the same size rehashes the content, and the cache stays
+// valid when the bytes are unchanged (e.g. after a copy). Anything else rebuilds.
+
+enum class EnergyCacheStatus : std::uint8_t
+{
+	Hit,
+	Rehashed,
+	Rebuilt
+};
+
+std::string EnergyCachePath(const std::string& wavPath);
+// Size and modification time, plus the content hash when hashContent is set.
+PyramidSourceKey ReadSourceKey(const std::string& path, bool hashContent);
+std::uint64_t HashFileContent(const std::string& path);
+
+// Opens the cache for wavPath, (re)building it first when it is missing or stale.
+std::unique_ptr<EnergyPyramid> OpenEnergyCache(const std::string& wavPath, EnergyCacheStatus* status = nullptr,
+	double cellMs = 10.0);
+
+// Directions of consecutive windows of windowSec, decided from the cached energies.
+void DecideWindows(const EnergyPyramid& cache, const DecisionParams& params, double windowSec, std::vector<DirectionState>& out);
+
+// Re-evaluates the file once per lateral ratio and prints the share of each direction.
+void RetuneFromCache(const std::string& wavPath, double windowSec, const std::vector<float>& ratios, DecisionParams params);
@@ -0,0 +1,566 @@
+#include "EnergyPyramid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#include "DirectionAnalyzer.h"
+#include "DirectionUtils.h"
+#include "WavFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr char FileMagic[4] = { 'A', 'V', 'E', 'P' };
+	constexpr std::uint16_t FormatVersion = 1;
+	constexpr std::size_t HeaderSize = 64;
+	constexpr std::uint32_t MaxLevels = 48; // 2^47 base cells is far beyond any recording
+	constexpr float HalfScale = 1024.0f;
+
+	struct FileHeader
+	{
+		char magic[4];
+		std::uint16_t version;
+		std::uint16_t precision;
+		std::uint32_t sampleRate;
+		std::uint16_t channels;
+		std::uint16_t bands;
+		std::uint32_t cellFrames;
+		std::uint32_t levels;
+		std::uint64_t cellCount;
+		std::uint64_t sourceBytes;
+		std::int64_t sourceModified;
+		std::uint64_t sourceHash;
+		std::uint8_t reserved[8];
+	};
+
+	static_assert(sizeof(FileHeader) == HeaderSize, "header layout");
+
+	std::uint16_t floatToHalf(float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const std::uint32_t sign = (bits >> 16) & 0x8000;
+		const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+		std::uint32_t mantissa = bits & 0x7FFFFF;
+
+		if (exponent >= 31) return static_cast<std::uint16_t>(sign | 0x7C00);
+		if (exponent <= 0) {
+			if (exponent < -10) return static_cast<std::uint16_t>(sign);
+			mantissa |= 0x800000;
+			const int shift = 14 - exponent;
+			return static_cast<std::uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+		}
+		// Round to nearest; a carry out of the mantissa correctly bumps the exponent
+		return static_cast<std::uint16_t>((sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+	}
+
+	float halfToFloat(std::uint16_t half)
+	{
+		const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000) << 16;
+		const std::uint32_t exponent = (half >> 10) & 0x1F;
+		const std::uint32_t mantissa = half & 0x3FF;
+
+		if (exponent == 0) {
+			const float value = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign ? -value : value;
+		}
+		const std::uint32_t bits = sign | (exponent == 31 ? 0x7F800000 : (exponent + 127 - 15) << 23) | (mantissa << 13);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Base cells under cell i of level L, clipped to the recording.
+	std::uint64_t coverage(int level, std::uint64_t cell, std::uint64_t cellCount)
+	{
+		const std::uint64_t first = cell << level;
+		return std::min((cell + 1) << level, cellCount) - first;
+	}
+
+	std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+EnergyPyramidBuilder::EnergyPyramidBuilder(const std::string& path, AudioFormat format,
+	PyramidPrecision precision, unsigned int cellFrames)
+	: path(path), audioFormat(format), precision(precision), cellFrames(cellFrames),
+	cellValues(static_cast<std::size_t>(std::max(format.channels, 0)) * PyramidBands)
+{
+	if (format.channels <= 0 || format.sampleRate == 0 || cellFrames == 0) {
+		throw std::runtime_error("Formato invalido para a piramide de energia");
+	}
+
+	constexpr double Pi = 3.14159265358979323846;
+	lowCoeff = static_cast<float>(1.0 - std::exp(-2.0 * Pi * 250.0 / format.sampleRate));
+	highCoeff = static_cast<float>(1.0 - std::exp(-2.0 * Pi * 4000.0 / format.sampleRate));
+	lowState.assign(format.channels, 0.0f);
+	highState.assign(format.channels, 0.0f);
+	accum.assign(cellValues, 0.0);
+	levels.resize(1);
+}
+
+EnergyPyramidBuilder::~EnergyPyramidBuilder()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void EnergyPyramidBuilder::push(const float* samples, unsigned int frameCount)
+{
+	const int numChannels = audioFormat.channels;
+	while (frameCount > 0) {
+		const unsigned int take = std::min(frameCount, cellFrames - framesInCell);
+		for (unsigned int i = 0; i < take; ++i) {
+			const float* frame = samples + static_cast<std::size_t>(i) * numChannels;
+			for (int ch = 0; ch < numChannels; ++ch) {
+				const float x = frame[ch];
+				// The tiny bias keeps the decaying states out of the (very slow) denormal range after a sound stops
+				lowState[ch] += lowCoeff * (x - lowState[ch]) + 1e-20f;
+				highState[ch] += highCoeff * (x - highState[ch]) + 1e-20f;
+
+				double* cell = accum.data() + static_cast<std::size_t>(ch) * PyramidBands;
+				cell[0] += std::fabs(x);
+				cell[1] += std::fabs(lowState[ch]);
+				cell[2] += std::fabs(highState[ch] - lowState[ch]);
+				cell[3] += std::fabs(x - highState[ch]);
+			}
+		}
+
+		samples += static_cast<std::size_t>(take) * numChannels;
+		frameCount -= take;
+		framesInCell += take;
+		if (framesInCell == cellFrames) finishCell();
+	}
+}
+
+void EnergyPyramidBuilder::finishCell()
+{
+	std::vector<float>& base = levels[0];
+	for (std::size_t v = 0; v < cellValues; ++v) {
+		base.push_back(static_cast<float>(accum[v] / framesInCell));
+	}
+	std::fill(accum.begin(), accum.end(), 0.0);
+	framesInCell = 0;
+
+	// Every completed pair becomes one full cell of the level above
+	for (std::size_t level = 0; levels[level].size() / cellValues % 2 == 0; ++level) {
+		carry(level);
+	}
+}
+
+void EnergyPyramidBuilder::carry(std::size_t level)
+{
+	if (level + 1 == levels.size()) levels.emplace_back();
+	const std::uint64_t cellCount = this->cellCount();
+	const std::uint64_t parent = levels[level + 1].size() / cellValues;
+	const std::uint64_t left = parent * 2;
+	const double wl = static_cast<double>(coverage(static_cast<int>(level), left, cellCount));
+	const double wr = left + 1 < levels[level].size() / cellValues ? static_cast<double>(coverage(static_cast<int>(level), left + 1, cellCount)) : 0.0;
+
+	const float* a = levels[level].data() + left * cellValues;
+	const float* b = a + cellValues;
+	for (std::size_t v = 0; v < cellValues; ++v) {
+		const double sum = a[v] * wl + (wr > 0.0 ? b[v] * wr : 0.0);
+		levels[level + 1].push_back(static_cast<float>(sum / (wl + wr)));
+	}
+}
+
+void EnergyPyramidBuilder::close()
+{
+	if (closed) return;
+	closed = true;
+
+	if (framesInCell > 0) finishCell();
+	if (cellCount() == 0) {
+		throw std::runtime_error("Piramide de energia vazia: " + path);
+	}
+
+	// Trailing odd cells still need a parent on every level, up to a single root cell
+	for (std::size_t level = 0; levels[level].size() > cellValues; ++level) {
+		const std::size_t count = levels[level].size() / cellValues;
+		if (level + 1 == levels.size() || levels[level + 1].size() / cellValues < (count + 1) / 2) carry(level);
+	}
+
+	FileHeader header{};
+	std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+	header.version = FormatVersion;
+	header.precision = static_cast<std::uint16_t>(precision);
+	header.sampleRate = audioFormat.sampleRate;
+	header.channels = static_cast<std::uint16_t>(audioFormat.channels);
+	header.bands = PyramidBands;
+	header.cellFrames = cellFrames;
+	header.levels = static_cast<std::uint32_t>(levels.size());
+	header.cellCount = cellCount();
+	header.sourceBytes = source.bytes;
+	header.sourceModified = source.modified;
+	header.sourceHash = source.contentHash;
+
+	const std::size_t valueBytes = precision == PyramidPrecision::Float16 ? 2 : 4;
+	std::vector<std::uint64_t> offsets(levels.size());
+	std::uint64_t offset = alignUp(HeaderSize + offsets.size() * sizeof(std::uint64_t), 64);
+	for (std::size_t level = 0; level < levels.size(); ++level) {
+		offsets[level] = offset;
+		offset = alignUp(offset + levels[level].size() * valueBytes, 64);
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		throw std::runtime_error("Nao foi possivel criar a piramide de energia: " + path);
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(std::uint64_t));
+
+	std::vector<std::uint16_t> halves;
+	for (std::size_t level = 0; level < levels.size(); ++level) {
+		const std::uint64_t position = static_cast<std::uint64_t>(file.tellp());
+		const std::vector<char> padding(offsets[level] - position, 0);
+		file.write(padding.data(), padding.size());
+
+		const std::vector<float>& values = levels[level];
+		if (precision == PyramidPrecision::Float16) {
+			halves.resize(values.size());
+			for (std::size_t v = 0; v < values.size(); ++v) halves[v] = floatToHalf(values[v] * HalfScale);
+			file.write(reinterpret_cast<const char*>(halves.data()), halves.size() * sizeof(std::uint16_t));
+		} else {
+			file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+		}
+	}
+	if (!file) {
+		throw std::runtime_error("Falha ao gravar a piramide de energia: " + path);
+	}
+}
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size{};
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		file = nullptr;
+		throw std::runtime_error("Nao foi possivel abrir: " + path);
+	}
+	bytes = static_cast<std::size_t>(size.QuadPart);
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	address = mapping ? static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	if (!address) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Nao foi possivel mapear: " + path);
+	}
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat info{};
+	if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+		if (fd >= 0) ::close(fd);
+		throw std::runtime_error("Nao foi possivel abrir: " + path);
+	}
+	bytes = static_cast<std::size_t>(info.st_size);
+	void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Nao foi possivel mapear: " + path);
+	}
+	address = static_cast<const std::uint8_t*>(mapped);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(address);
+	CloseHandle(mapping);
+	CloseHandle(file);
+#else
+	munmap(const_cast<std::uint8_t*>(address), bytes);
+#endif
+}
+
+EnergyPyramid::EnergyPyramid(const std::string& path)
+	: file(path)
+{
+	FileHeader header;
+	if (file.size() < HeaderSize) {
+		throw std::runtime_error("Piramide de energia invalida: " + path);
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0 || header.version != FormatVersion
+		|| header.bands != PyramidBands || header.channels == 0 || header.sampleRate == 0 || header.cellFrames == 0
+		|| header.levels == 0 || header.levels > MaxLevels || header.precision > static_cast<std::uint16_t>(PyramidPrecision::Float16)) {
+		throw std::runtime_error("Piramide de energia invalida: " + path);
+	}
+
+	audioFormat = { header.channels, header.sampleRate };
+	precision = static_cast<PyramidPrecision>(header.precision);
+	frames = header.cellFrames;
+	cells = header.cellCount;
+	cellValues = static_cast<std::size_t>(header.channels) * PyramidBands;
+	source = { header.sourceBytes, header.sourceModified, header.sourceHash };
+
+	levelOffsets.resize(header.levels);
+	const std::size_t tableEnd = HeaderSize + levelOffsets.size() * sizeof(std::uint64_t);
+	if (file.size() < tableEnd) {
+		throw std::runtime_error("Piramide de energia truncada: " + path);
+	}
+	std::memcpy(levelOffsets.data(), file.data() + HeaderSize, levelOffsets.size() * sizeof(std::uint64_t));
+
+	// Every level must lie inside the mapping; compared by division so a hostile
+	// offset or cell count cannot wrap the arithmetic
+	const std::size_t valueBytes = precision == PyramidPrecision::Float16 ? 2 : 4;
+	const std::uint64_t cellBytes = cellValues * valueBytes;
+	for (std::size_t level = 0; level < levelOffsets.size(); ++level) {
+		const std::uint64_t offset = levelOffsets[level];
+		const std::uint64_t count = (cells >> level) + ((cells & ((1ull << level) - 1)) != 0);
+		if (offset < tableEnd || offset % valueBytes != 0 || offset > file.size()
+			|| count > (file.size() - offset) / cellBytes) {
+			throw std::runtime_error("Piramide de energia truncada: " + path);
+		}
+	}
+}
+
+void RewritePyramidSourceKey(const std::string& pyramidPath, const PyramidSourceKey& key)
+{
+	std::fstream file(pyramidPath, std::ios::binary | std::ios::in | std::ios::out);
+	FileHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0) {
+		throw std::runtime_error("Piramide de energia invalida: " + pyramidPath);
+	}
+	header.sourceBytes = key.bytes;
+	header.sourceModified = key.modified;
+	header.sourceHash = key.contentHash;
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!file) {
+		throw std::runtime_error("Falha ao gravar a piramide de energia: " + pyramidPath);
+	}
+}
+
+std::uint64_t EnergyPyramid::durationUs() const
+{
+	return cells * frames * 1000000ull / audioFormat.sampleRate;
+}
+
+std::uint64_t EnergyPyramid::cellAt(std::uint64_t timestampUs, bool roundUp) const
+{
+	const std::uint64_t scaled = timestampUs * audioFormat.sampleRate;
+	const std::uint64_t frame = roundUp ? (scaled + 999999) / 1000000 : scaled / 1000000;
+	return std::min(roundUp ? (frame + frames - 1) / frames : frame / frames, cells);
+}
+
+void EnergyPyramid::accumulate(int level, std::uint64_t cell, double weight, double* sums) const
+{
+	const std::uint8_t* base = file.data() + levelOffsets[level];
+	if (precision == PyramidPrecision::Float16) {
+		const std::uint16_t* values = reinterpret_cast<const std::uint16_t*>(base) + cell * cellValues;
+		for (std::size_t v = 0; v < cellValues; ++v) sums[v] += weight * halfToFloat(values[v]) * (1.0 / HalfScale);
+	} else {
+		const float* values = reinterpret_cast<const float*>(base) + cell * cellValues;
+		for (std::size_t v = 0; v < cellValues; ++v) sums[v] += weight * values[v];
+	}
+}
+
+void EnergyPyramid::finish(const double* sums, double weight, float* out) const
+{
+	for (std::size_t v = 0; v < cellValues; ++v) {
+		out[v] = weight > 0.0 ? static_cast<float>(sums[v] / weight) : 0.0f;
+	}
+}
+
+std::size_t EnergyPyramid::query(std::uint64_t fromUs, std::uint64_t toUs, float* out) const
+{
+	double sums[DirectionAnalyzer::MaxChannels * PyramidBands] = {};
+	std::uint64_t first = cellAt(fromUs, false);
+	std::uint64_t last = std::min(std::max(cellAt(toUs, true), first + 1), cells);
+	if (cellValues > sizeof(sums) / sizeof(sums[0]) || first >= last) {
+		std::fill(out, out + cellValues, 0.0f);
+		return 0;
+	}
+
+	// Bottom-up decomposition of [first, last): odd edges are taken at the current level
+	double weight = 0.0;
+	std::size_t read = 0;
+	for (int level = 0; first < last && level < levelCount(); ++level) {
+		if (first & 1) {
+			const double w = static_cast<double>(coverage(level, first, cells));
+			accumulate(level, first++, w, sums);
+			weight += w;
+			++read;
+		}
+		if (last & 1) {
+			const double w = static_cast<double>(coverage(level, --last, cells));
+			accumulate(level, last, w, sums);
+			weight += w;
+			++read;
+		}
+		first >>= 1;
+		last >>= 1;
+	}
+
+	finish(sums, weight, out);
+	return read;
+}
+
+std::size_t EnergyPyramid::scan(std::uint64_t fromUs, std::uint64_t toUs, float* out) const
+{
+	double sums[DirectionAnalyzer::MaxChannels * PyramidBands] = {};
+	const std::uint64_t first = cellAt(fromUs, false);
+	const std::uint64_t last = std::min(std::max(cellAt(toUs, true), first + 1), cells);
+	if (cellValues > sizeof(sums) / sizeof(sums[0]) || first >= last) {
+		std::fill(out, out + cellValues, 0.0f);
+		return 0;
+	}
+
+	for (std::uint64_t cell = first; cell < last; ++cell) accumulate(0, cell, 1.0, sums);
+	finish(sums, static_cast<double>(last - first), out);
+	return static_cast<std::size_t>(last - first);
+}
+
+DirectionState EnergyPyramid::dominantDirection(std::uint64_t fromUs, std::uint64_t toUs) const
+{
+	float values[DirectionAnalyzer::MaxChannels * PyramidBands];
+	float energy[DirectionAnalyzer::MaxChannels];
+	if (audioFormat.channels > DirectionAnalyzer::MaxChannels) return {};
+
+	query(fromUs, toUs, values);
+	for (int ch = 0; ch < audioFormat.channels; ++ch) {
+		energy[ch] = values[ch * PyramidBands + static_cast<int>(PyramidBand::Full)];
+	}
+	return DirectionAnalyzer().decide(energy, audioFormat.channels);
+}
+
+void EnergyPyramid::render(std::uint64_t fromUs, std::uint64_t toUs, unsigned int columns, std::vector<float>& out) const
+{
+	out.assign(static_cast<std::size_t>(columns) * cellValues, 0.0f);
+	if (columns == 0 || toUs <= fromUs) return;
+
+	const double step = static_cast<double>(toUs - fromUs) / columns;
+	for (unsigned int c = 0; c < columns; ++c) {
+		const auto begin = fromUs + static_cast<std::uint64_t>(step * c);
+		const auto end = fromUs + static_cast<std::uint64_t>(step * (c + 1));
+		query(begin, std::max(end, begin + 1), out.data() + static_cast<std::size_t>(c) * cellValues);
+	}
+}
+
+void BuildEnergyPyramid(const std::string& wavPath, const std::string& pyramidPath, PyramidPrecision precision, double cellMs)
+{
+	using Clock = std::chrono::steady_clock;
+
+	WavReader reader(wavPath);
+	const AudioFormat format = reader.format();
+	const auto cellFrames = static_cast<unsigned int>(std::max(1.0, cellMs * format.sampleRate / 1000.0));
+
+	const auto start = Clock::now();
+	EnergyPyramidBuilder builder(pyramidPath, format, precision, cellFrames);
+	std::vector<float> buffer(static_cast<std::size_t>(format.sampleRate) * format.channels);
+	while (const unsigned int frames = reader.read(buffer.data(), format.sampleRate)) {
+		builder.push(buffer.data(), frames);
+	}
+	builder.close();
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	const EnergyPyramid pyramid(pyramidPath);
+	std::ifstream written(pyramidPath, std::ios::binary | std::ios::ate);
+	std::cout << "Piramide " << pyramidPath << ": " << pyramid.cellCount() << " celulas de " << cellFrames << " quadros, "
+		<< pyramid.levelCount() << " niveis, " << static_cast<std::uint64_t>(written.tellg()) / 1024 << " KiB ("
+		<< (precision == PyramidPrecision::Float16 ? "f16" : "f32") << "), gerada em " << seconds << " s\n";
+}
+
+void QueryEnergyPyramid(const std::string& pyramidPath, double fromSec, double toSec, unsigned int columns)
+{
+	const EnergyPyramid pyramid(pyramidPath);
+	const AudioFormat format = pyramid.format();
+	const auto fromUs = static_cast<std::uint64_t>(std::max(fromSec, 0.0) * 1e6);
+	const auto toUs = static_cast<std::uint64_t>(std::max(toSec, fromSec) * 1e6);
+
+	if (columns == 0) {
+		std::vector<float> values(static_cast<std::size_t>(format.channels) * PyramidBands);
+		const std::size_t read = pyramid.query(fromUs, toUs, values.data());
+		const DirectionState state = pyramid.dominantDirection(fromUs, toUs);
+		std::cout << "Intervalo " << fromSec << "-" << toSec << " s: " << directionToString(state.direction)
+			<< " azimute=" << state.azimuth << " confianca=" << state.confidence << " (" << read << " celulas lidas)\n";
+		for (int ch = 0; ch < format.channels; ++ch) {
+			const float* e = values.data() + static_cast<std::size_t>(ch) * PyramidBands;
+			std::cout << "  canal " << ch << ": total=" << e[0] << " graves=" << e[1] << " medios=" << e[2] << " agudos=" << e[3] << '\n';
+		}
+		return;
+	}
+
+	std::vector<float> values;
+	pyramid.render(fromUs, toUs, columns, values);
+	std::cout << "inicio_s";
+	for (int ch = 0; ch < format.channels; ++ch) std::cout << ",canal" << ch;
+	std::cout << '\n';
+	const double step = (toSec - fromSec) / columns;
+	for (unsigned int c = 0; c < columns; ++c) {
+		std::cout << fromSec + step * c;
+		for (int ch = 0; ch < format.channels; ++ch) {
+			std::cout << ',' << values[(static_cast<std::size_t>(c) * format.channels + ch) * PyramidBands];
+		}
+		std::cout << '\n';
+	}
+}
+
+void BenchmarkEnergyPyramid(const std::string& pyramidPath, int queries)
+{
+	using Clock = std::chrono::steady_clock;
+
+	const EnergyPyramid pyramid(pyramidPath);
+	const std::uint64_t duration = pyramid.durationUs();
+	const std::size_t valueCount = static_cast<std::size_t>(pyramid.format().channels) * PyramidBands;
+	std::vector<float> fast(valueCount);
+	std::vector<float> slow(valueCount);
+
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<std::uint64_t> pick(0, duration);
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges(std::max(queries, 1));
+	for (auto& range : ranges) {
+		range = { pick(rng), pick(rng) };
+		if (range.first > range.second) std::swap(range.first, range.second);
+	}
+
+	std::size_t pyramidCells = 0;
+	auto start = Clock::now();
+	for (const auto& range : ranges) pyramidCells += pyramid.query(range.first, range.second, fast.data());
+	const double pyramidSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::size_t scanCells = 0;
+	start = Clock::now();
+	for (const auto& range : ranges) scanCells += pyramid.scan(range.first, range.second, slow.data());
+	const double scanSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	// Same answer both ways, up to float rounding
+	double maxError = 0.0;
+	for (const auto& range : ranges) {
+		pyramid.query(range.first, range.second, fast.data());
+		pyramid.scan(range.first, range.second, slow.data());
+		for (std::size_t v = 0; v < valueCount; ++v) {
+			maxError = std::max(maxError, std::fabs(static_cast<double>(fast[v]) - slow[v]) / std::max(std::fabs(slow[v]), 1e-9f));
+		}
+	}
+
+	const double n = static_cast<double>(ranges.size());
+	std::cout << "Piramide " << pyramidPath << ": " << pyramid.cellCount() << " celulas, " << pyramid.levelCount() << " niveis, "
+		<< duration / 1e6 << " s\n";
+	std::cout << "  piramide:  " << pyramidSeconds * 1e6 / n << " us por consulta, " << pyramidCells / n << " celulas lidas\n";
+	std::cout << "  varredura: " << scanSeconds * 1e6 / n << " us por consulta, " << scanCells / n << " celulas lidas\n";
+	std::cout << "  erro relativo maximo: " << maxError << '\n';
+}
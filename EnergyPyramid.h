@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "Direction.h"
+
+// Energy pyramid file (.avep): mean |x| per channel and band over fixed cells of
+// cellFrames frames (level 0), then every level above halves the resolution, up to
+// one cell for the whole recording.
+//
+// Layout (little endian): 64-byte header, one uint64 file offset per level, then the
+// levels, each aligned to 64 bytes. A cell holds channels * PyramidBands values,
+// channel-major. Half-precision files store value * HalfScale so quiet passages stay
+// in the normal half range. A level-L cell covers base cells [i * 2^L, (i + 1) * 2^L)
+// clipped to the recording, and holds their coverage-weighted mean, so any range is
+// the weighted sum of at most two cells per level. The header also records which
+// source the pyramid was built from (see EnergyCache.h).
+
+enum class PyramidBand : std::uint8_t
+{
+	Full,
+	Low,   // below 250 Hz
+	Mid,   // 250 Hz - 4 kHz
+	High,  // above 4 kHz
+	Count
+};
+
+constexpr int PyramidBands = static_cast<int>(PyramidBand::Count);
+
+enum class PyramidPrecision : std::uint16_t
+{
+	Float32,
+	Float16
+};
+
+// Identity of the audio file a pyramid was built from; all zero when unknown.
+struct PyramidSourceKey
+{
+	std::uint64_t bytes = 0;
+	std::int64_t modified = 0;    // last write time, file clock ticks
+	std::uint64_t contentHash = 0;
+
+	bool operator==(const PyramidSourceKey& other) const
+	{
+		return bytes == other.bytes && modified == other.modified && contentHash == other.contentHash;
+	}
+};
+
+class EnergyPyramidBuilder
+{
+public:
+	EnergyPyramidBuilder(const std::string& path, AudioFormat format,
+		PyramidPrecision precision = PyramidPrecision::Float32, unsigned int cellFrames = 480);
+	~EnergyPyramidBuilder();
+
+	EnergyPyramidBuilder(const EnergyPyramidBuilder&) = delete;
+	EnergyPyramidBuilder& operator=(const EnergyPyramidBuilder&) = delete;
+
+	// Interleaved samples, any block size.
+	void push(const float* samples, unsigned int frameCount);
+	// Completes the upper levels and writes the file.
+	void close();
+	void setSourceKey(const PyramidSourceKey& key) { source = key; }
+
+	std::uint64_t cellCount() const { return levels.empty() ? 0 : levels[0].size() / cellValues; }
+
+private:
+	void finishCell();
+	void carry(std::size_t level);
+
+	std::string path;
+	AudioFormat audioFormat;
+	PyramidPrecision precision;
+	unsigned int cellFrames;
+	std::size_t cellValues;
+	bool closed = false;
+	PyramidSourceKey source;
+
+	float lowCoeff;
+	float highCoeff;
+	std::vector<float> lowState;   // one-pole low-pass at 250 Hz, per channel
+	std::vector<float> highState;  // one-pole low-pass at 4 kHz, per channel
+	std::vector<double> accum;
+	unsigned int framesInCell = 0;
+	std::vector<std::vector<float>> levels;
+};
+
+// Read-only file mapping (mmap / MapViewOfFile).
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const std::uint8_t* data() const { return address; }
+	std::size_t size() const { return bytes; }
+
+private:
+	const std::uint8_t* address = nullptr;
+	std::size_t bytes = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
+
+class EnergyPyramid
+{
+public:
+	explicit EnergyPyramid(const std::string& path);
+
+	AudioFormat format() const { return audioFormat; }
+	PyramidPrecision valuePrecision() const { return precision; }
+	unsigned int cellFrames() const { return frames; }
+	std::uint64_t cellCount() const { return cells; }
+	int levelCount() const { return static_cast<int>(levelOffsets.size()); }
+	std::uint64_t durationUs() const;
+	const PyramidSourceKey& sourceKey() const { return source; }
+
+	// Mean energy over [fromUs, toUs) into out[channel * PyramidBands + band]; the
+	// range is widened to whole cells. Returns the number of cells read.
+	std::size_t query(std::uint64_t fromUs, std::uint64_t toUs, float* out) const;
+	// Direction of the full-band energies over the range.
+	DirectionState dominantDirection(std::uint64_t fromUs, std::uint64_t toUs) const;
+	// One query per column; out receives columns * channels * PyramidBands values.
+	void render(std::uint64_t fromUs, std::uint64_t toUs, unsigned int columns, std::vector<float>& out) const;
+
+	// Level-0 scan of the same range, for comparison.
+	std::size_t scan(std::uint64_t fromUs, std::uint64_t toUs, float* out) const;
+
+private:
+	std::uint64_t cellAt(std::uint64_t timestampUs, bool roundUp) const;
+	void accumulate(int level, std::uint64_t cell, double weight, double* sums) const;
+	void finish(const double* sums, double weight, float* out) const;
+
+	MappedFile file;
+	AudioFormat audioFormat;
+	PyramidPrecision precision = PyramidPrecision::Float32;
+	unsigned int frames = 0;
+	std::uint64_t cells = 0;
+	std::size_t cellValues = 0;
+	std::vector<std::uint64_t> levelOffsets;
+	PyramidSourceKey source;
+};
+
+// Replaces the source key in an existing pyramid file without touching the levels.
+void RewritePyramidSourceKey(const std::string& pyramidPath, const PyramidSourceKey& key);
+
+// Reads a WAV file into a pyramid and reports its size and build time.
+void BuildEnergyPyramid(const std::string& wavPath, const std::string& pyramidPath, PyramidPrecision precision, double cellMs);
+// Prints the dominant direction over a range, or a CSV render with columns > 0.
+void QueryEnergyPyramid(const std::string& pyramidPath, double fromSec, double toSec, unsigned int columns);
+// Random range queries through the pyramid vs a level-0 scan.
+void BenchmarkEnergyPyramid(const std::string& pyramidPath, int queries);
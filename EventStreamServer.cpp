@@ -0,0 +1,549 @@
+#include "EventStreamServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "CaptureSource.h"
+#include "LatencyHistogram.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#endif
+
+namespace EventWire
+{
+	void Encode(std::uint64_t timestampUs, std::uint32_t sequence, const DirectionState& state, unsigned char* out)
+	{
+		const auto azimuth = static_cast<std::int16_t>(std::lround(std::clamp(state.azimuth, -180.0f, 180.0f) * (32767.0f / 180.0f)));
+		const auto confidence = static_cast<std::uint8_t>(std::lround(std::clamp(state.confidence, 0.0f, 1.0f) * 255.0f));
+		for (int i = 0; i < 8; ++i) out[i] = static_cast<unsigned char>(timestampUs >> (8 * i));
+		for (int i = 0; i < 4; ++i) out[8 + i] = static_cast<unsigned char>(sequence >> (8 * i));
+		out[12] = static_cast<unsigned char>(static_cast<std::uint16_t>(azimuth));
+		out[13] = static_cast<unsigned char>(static_cast<std::uint16_t>(azimuth) >> 8);
+		out[14] = static_cast<unsigned char>(state.direction);
+		out[15] = confidence;
+	}
+
+	void Decode(const unsigned char* in, std::uint64_t& timestampUs, std::uint32_t& sequence, DirectionState& state)
+	{
+		timestampUs = 0;
+		sequence = 0;
+		for (int i = 0; i < 8; ++i) timestampUs |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+		for (int i = 0; i < 4; ++i) sequence |= static_cast<std::uint32_t>(in[8 + i]) << (8 * i);
+		const auto azimuth = static_cast<std::int16_t>(in[12] | (in[13] << 8));
+		state.azimuth = azimuth * (180.0f / 32767.0f);
+		state.direction = static_cast<Direction>(in[14]);
+		state.confidence = in[15] / 255.0f;
+	}
+}
+
+#ifdef __linux__
+
+namespace
+{
+	struct Staged
+	{
+		std::uint64_t timestampUs;
+		DirectionState state;
+	};
+
+	struct Client
+	{
+		int fd = -1;
+		std::uint64_t cursor = 0;  // next broadcast event to send
+		unsigned char pending[EventWire::EventBytes] = {};
+		std::size_t pendingBytes = 0;
+		std::size_t pendingOffset = 0;
+		bool closed = false;
+	};
+
+	int listenUnix(const std::string& path)
+	{
+		sockaddr_un address{};
+		if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Caminho de socket longo demais: " + path);
+		address.sun_family = AF_UNIX;
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+		const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0) throw std::runtime_error("Falha ao criar socket Unix");
+		unlink(path.c_str());
+		if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 512) != 0) {
+			close(fd);
+			throw std::runtime_error("Falha ao escutar em " + path);
+		}
+		return fd;
+	}
+
+	int listenTcp(int port)
+	{
+		const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0) throw std::runtime_error("Falha ao criar socket TCP");
+		const int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(static_cast<std::uint16_t>(port));
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 512) != 0) {
+			close(fd);
+			throw std::runtime_error("Falha ao escutar na porta TCP " + std::to_string(port));
+		}
+		return fd;
+	}
+}
+
+struct EventStreamServer::Impl
+{
+	std::string socketPath;
+	std::size_t queueEvents;
+	unsigned int batchMs;
+
+	int unixFd = -1;
+	int tcpFd = -1;
+	int epollFd = -1;
+	int wakeFd = -1;
+	std::atomic<bool> stopping{ false };
+
+	// Single-producer ring between publish() and the server thread
+	std::vector<Staged> staging;
+	std::atomic<std::uint64_t> stagingHead{ 0 };
+	std::atomic<std::uint64_t> stagingTail{ 0 };
+
+	// Events encoded once and shared by every client; each client is a cursor into it
+	std::vector<unsigned char> broadcast;
+	std::size_t broadcastEvents = 0;
+	std::uint64_t head = 0;
+	std::uint32_t sequence = 0;
+
+	std::vector<Client> clients;
+
+	std::atomic<std::uint64_t> published{ 0 };
+	std::atomic<std::uint64_t> stagingDropped{ 0 };
+	std::atomic<std::uint64_t> clientDropped{ 0 };
+	std::atomic<std::uint64_t> sendCalls{ 0 };
+	std::atomic<std::uint64_t> accepted{ 0 };
+
+	// Owns every descriptor, so a constructor that throws halfway leaks none of them
+	~Impl();
+
+	void run(std::atomic<std::size_t>& connected);
+	void accept(int listenFd);
+	void drainStaging();
+	void flush(Client& client);
+};
+
+EventStreamServer::EventStreamServer(const std::string& socketPath, int tcpPort, std::size_t queueEvents, unsigned int batchMs)
+	: impl(std::make_unique<Impl>())
+{
+	impl->socketPath = socketPath;
+	impl->queueEvents = std::max<std::size_t>(1, queueEvents);
+	impl->batchMs = std::max(1u, batchMs);
+	impl->staging.resize(4096);
+
+	// Twice the client queue, so a client's backlog is never overwritten before it is dropped
+	std::size_t ring = 1;
+	while (ring < impl->queueEvents * 2) ring <<= 1;
+	impl->broadcastEvents = ring;
+	impl->broadcast.resize(ring * EventWire::EventBytes);
+
+	impl->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (impl->epollFd < 0) throw std::runtime_error("Falha ao criar epoll do servidor de eventos");
+	impl->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (impl->wakeFd < 0) throw std::runtime_error("Falha ao criar eventfd do servidor de eventos");
+	impl->unixFd = listenUnix(socketPath);
+	if (tcpPort > 0) impl->tcpFd = listenTcp(tcpPort);
+
+	for (const int fd : { impl->wakeFd, impl->unixFd, impl->tcpFd }) {
+		if (fd < 0) continue;
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = fd;
+		if (epoll_ctl(impl->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			throw std::runtime_error("Falha ao registrar socket no epoll do servidor de eventos");
+		}
+	}
+
+	worker = std::thread([this] { impl->run(connectedClients); });
+}
+
+EventStreamServer::~EventStreamServer()
+{
+	stop();
+}
+
+EventStreamServer::Impl::~Impl()
+{
+	for (Client& client : clients) close(client.fd);
+	for (const int fd : { unixFd, tcpFd, epollFd, wakeFd }) {
+		if (fd >= 0) close(fd);
+	}
+	if (unixFd >= 0) unlink(socketPath.c_str());
+}
+
+void EventStreamServer::stop()
+{
+	if (!worker.joinable()) return;
+	impl->stopping = true;
+	const std::uint64_t one = 1;
+	(void)!write(impl->wakeFd, &one, sizeof(one));
+	worker.join();
+}
+
+void EventStreamServer::publish(std::uint64_t timestampUs, const DirectionState& state)
+{
+	const std::uint64_t at = impl->stagingHead.load(std::memory_order_relaxed);
+	if (at - impl->stagingTail.load(std::memory_order_acquire) >= impl->staging.size()) {
+		impl->stagingDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	impl->staging[at % impl->staging.size()] = { timestampUs, state };
+	impl->stagingHead.store(at + 1, std::memory_order_release);
+	impl->published.fetch_add(1, std::memory_order_relaxed);
+}
+
+EventStreamStats EventStreamServer::stats() const
+{
+	EventStreamStats result;
+	result.published = impl->published.load();
+	result.stagingDropped = impl->stagingDropped.load();
+	result.clientDropped = impl->clientDropped.load();
+	result.sendCalls = impl->sendCalls.load();
+	result.clientsAccepted = impl->accepted.load();
+	return result;
+}
+
+void EventStreamServer::Impl::accept(int listenFd)
+{
+	for (;;) {
+		const int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) return;
+
+		if (listenFd == tcpFd) {
+			const int yes = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+		}
+
+		Client client;
+		client.fd = fd;
+		client.cursor = head;
+		std::memcpy(client.pending, EventWire::Magic, 4);
+		client.pending[4] = static_cast<unsigned char>(EventWire::Version);
+		client.pending[5] = static_cast<unsigned char>(EventWire::Version >> 8);
+		client.pending[6] = static_cast<unsigned char>(EventWire::EventBytes);
+		client.pending[7] = static_cast<unsigned char>(EventWire::EventBytes >> 8);
+		client.pendingBytes = EventWire::HeaderBytes;
+		clients.push_back(client);
+
+		// Clients never send anything; readable means hang-up or junk to discard
+		epoll_event event{};
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.fd = fd;
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+		accepted.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void EventStreamServer::Impl::drainStaging()
+{
+	const std::uint64_t end = stagingHead.load(std::memory_order_acquire);
+	std::uint64_t at = stagingTail.load(std::memory_order_relaxed);
+	for (; at < end; ++at) {
+		const Staged& staged = staging[at % staging.size()];
+		unsigned char* out = broadcast.data() + (head % broadcastEvents) * EventWire::EventBytes;
+		EventWire::Encode(staged.timestampUs, sequence++, staged.state, out);
+		++head;
+	}
+	stagingTail.store(at, std::memory_order_release);
+}
+
+void EventStreamServer::Impl::flush(Client& client)
+{
+	// Drop-oldest: a client that fell behind skips to the newest queueEvents
+	if (head - client.cursor > queueEvents) {
+		clientDropped.fetch_add(head - client.cursor - queueEvents, std::memory_order_relaxed);
+		client.cursor = head - queueEvents;
+	}
+
+	iovec parts[3];
+	int count = 0;
+	if (client.pendingBytes > client.pendingOffset) {
+		parts[count++] = { client.pending + client.pendingOffset, client.pendingBytes - client.pendingOffset };
+	}
+	const std::uint64_t available = head - client.cursor;
+	if (available > 0) {
+		const std::size_t first = static_cast<std::size_t>(client.cursor % broadcastEvents);
+		const std::size_t run = std::min<std::size_t>(static_cast<std::size_t>(available), broadcastEvents - first);
+		parts[count++] = { broadcast.data() + first * EventWire::EventBytes, run * EventWire::EventBytes };
+		if (run < available) {
+			parts[count++] = { broadcast.data(), static_cast<std::size_t>(available - run) * EventWire::EventBytes };
+		}
+	}
+	if (count == 0) return;
+
+	// sendmsg is writev plus MSG_NOSIGNAL, so a vanished client cannot raise SIGPIPE
+	msghdr message{};
+	message.msg_iov = parts;
+	message.msg_iovlen = static_cast<std::size_t>(count);
+	const ssize_t sent = sendmsg(client.fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+	sendCalls.fetch_add(1, std::memory_order_relaxed);
+	if (sent < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) client.closed = true;
+		return;
+	}
+
+	std::size_t remaining = static_cast<std::size_t>(sent);
+	const std::size_t fromPending = std::min(remaining, client.pendingBytes - client.pendingOffset);
+	client.pendingOffset += fromPending;
+	remaining -= fromPending;
+	if (client.pendingOffset == client.pendingBytes) client.pendingOffset = client.pendingBytes = 0;
+
+	client.cursor += remaining / EventWire::EventBytes;
+	if (const std::size_t partial = remaining % EventWire::EventBytes) {
+		// Keep the rest of a half-sent event aside so dropping stays on event boundaries
+		const unsigned char* event = broadcast.data() + (client.cursor % broadcastEvents) * EventWire::EventBytes;
+		std::memcpy(client.pending, event, EventWire::EventBytes);
+		client.pendingBytes = EventWire::EventBytes;
+		client.pendingOffset = partial;
+		++client.cursor;
+	}
+}
+
+void EventStreamServer::Impl::run(std::atomic<std::size_t>& connected)
+{
+	epoll_event events[64];
+	char discard[256];
+
+	while (!stopping.load()) {
+		const int ready = epoll_wait(epollFd, events, 64, static_cast<int>(batchMs));
+		for (int i = 0; i < ready; ++i) {
+			const int fd = events[i].data.fd;
+			if (fd == wakeFd) continue;
+			if (fd == unixFd || fd == tcpFd) {
+				accept(fd);
+				continue;
+			}
+
+			auto client = std::find_if(clients.begin(), clients.end(), [fd](const Client& c) { return c.fd == fd; });
+			if (client == clients.end()) continue;
+			bool hangUp = (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) != 0;
+			for (;;) {
+				const ssize_t got = recv(fd, discard, sizeof(discard), MSG_DONTWAIT);
+				if (got > 0) continue;
+				if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) hangUp = true;
+				break;
+			}
+			client->closed = client->closed || hangUp;
+		}
+
+		drainStaging();
+		for (Client& client : clients) {
+			if (!client.closed) flush(client);
+		}
+
+		for (std::size_t i = 0; i < clients.size();) {
+			if (clients[i].closed) {
+				close(clients[i].fd);
+				clients[i] = clients.back();
+				clients.pop_back();
+			} else {
+				++i;
+			}
+		}
+		connected.store(clients.size(), std::memory_order_relaxed);
+	}
+}
+
+void BenchmarkEventStream(int clientCount, double durationSec, unsigned int eventsPerSec)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Hundreds of clients need two descriptors each
+	rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	const std::string path = "/tmp/avis_events_" + std::to_string(getpid()) + ".sock";
+	EventStreamServer server(path, 0, 1024, 5);
+
+	struct Reader
+	{
+		int fd = -1;
+		bool slow = false;
+		std::vector<unsigned char> buffer;
+		bool headerSeen = false;
+		std::uint64_t received = 0;
+		std::uint64_t gaps = 0;
+		std::uint64_t disorder = 0;
+		std::int64_t lastSequence = -1;
+	};
+
+	std::vector<Reader> readers(clientCount);
+	const int reader = epoll_create1(EPOLL_CLOEXEC);
+	for (int i = 0; i < clientCount; ++i) {
+		Reader& r = readers[i];
+		r.slow = i % 10 == 9;
+		r.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (r.slow) {
+			const int small = 4096;
+			setsockopt(r.fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+		}
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		if (connect(r.fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+			throw std::runtime_error("Falha ao conectar cliente " + std::to_string(i));
+		}
+		fcntl(r.fd, F_SETFL, fcntl(r.fd, F_GETFL) | O_NONBLOCK);
+		if (!r.slow) {
+			epoll_event event{};
+			event.events = EPOLLIN;
+			event.data.u32 = static_cast<std::uint32_t>(i);
+			epoll_ctl(reader, EPOLL_CTL_ADD, r.fd, &event);
+		}
+	}
+
+	while (server.clientCount() < static_cast<std::size_t>(clientCount)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	LatencyHistogram latencyUs;
+	auto drain = [&](Reader& r) {
+		unsigned char chunk[65536];
+		for (;;) {
+			const ssize_t got = recv(r.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+			if (got <= 0) break;
+			r.buffer.insert(r.buffer.end(), chunk, chunk + got);
+		}
+
+		std::size_t at = 0;
+		if (!r.headerSeen && r.buffer.size() >= EventWire::HeaderBytes) {
+			r.headerSeen = std::memcmp(r.buffer.data(), EventWire::Magic, 4) == 0;
+			at = EventWire::HeaderBytes;
+		}
+		const std::uint64_t nowUs = SteadyNowNs() / 1000;
+		for (; r.headerSeen && at + EventWire::EventBytes <= r.buffer.size(); at += EventWire::EventBytes) {
+			std::uint64_t timestampUs = 0;
+			std::uint32_t sequence = 0;
+			DirectionState state;
+			EventWire::Decode(r.buffer.data() + at, timestampUs, sequence, state);
+			++r.received;
+			if (r.lastSequence >= 0) {
+				if (sequence <= r.lastSequence) ++r.disorder;
+				else r.gaps += sequence - r.lastSequence - 1;
+			}
+			r.lastSequence = sequence;
+			if (!r.slow && nowUs >= timestampUs) latencyUs.record(nowUs - timestampUs);
+		}
+		r.buffer.erase(r.buffer.begin(), r.buffer.begin() + static_cast<std::ptrdiff_t>(at));
+	};
+
+	std::atomic<bool> done = false;
+	std::thread consumer([&] {
+		epoll_event events[256];
+		auto lastSlow = Clock::now();
+		while (!done.load()) {
+			const int ready = epoll_wait(reader, events, 256, 20);
+			for (int i = 0; i < ready; ++i) drain(readers[events[i].data.u32]);
+			if (Clock::now() - lastSlow > std::chrono::milliseconds(500)) {
+				for (Reader& r : readers) {
+					if (r.slow) drain(r);
+				}
+				lastSlow = Clock::now();
+			}
+		}
+		for (Reader& r : readers) drain(r);
+	});
+
+	const auto period = std::chrono::duration<double>(1.0 / std::max(1u, eventsPerSec));
+	const auto start = Clock::now();
+	const auto end = start + std::chrono::duration<double>(durationSec);
+	std::uint64_t published = 0;
+	for (auto next = start; next < end; next += std::chrono::duration_cast<Clock::duration>(period)) {
+		std::this_thread::sleep_until(next);
+		DirectionState state{ static_cast<Direction>(published % 12), static_cast<float>(published % 360) - 180.0f, 0.5f };
+		server.publish(SteadyNowNs() / 1000, state);
+		++published;
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	done = true;
+	consumer.join();
+	const EventStreamStats stats = server.stats();
+	server.stop();
+
+	std::uint64_t fastReceived = 0, fastGaps = 0, slowReceived = 0, slowGaps = 0, disorder = 0;
+	int fastCount = 0, slowCount = 0;
+	for (Reader& r : readers) {
+		(r.slow ? slowReceived : fastReceived) += r.received;
+		(r.slow ? slowGaps : fastGaps) += r.gaps;
+		(r.slow ? slowCount : fastCount) += 1;
+		disorder += r.disorder;
+		close(r.fd);
+	}
+	close(reader);
+
+	const double deliveries = static_cast<double>(published) * clientCount;
+	std::cout << clientCount << " clientes (" << slowCount << " lentos), " << published << " eventos em "
+		<< durationSec << " s\n";
+	std::cout << "  clientes rapidos: " << fastReceived << " de " << published * fastCount << " recebidos, "
+		<< fastGaps << " lacunas\n";
+	std::cout << "  clientes lentos:  " << slowReceived << " recebidos, " << slowGaps << " descartados\n";
+	std::cout << "  fora de ordem: " << disorder << ", descartes no servidor: " << stats.clientDropped
+		<< ", estagio cheio: " << stats.stagingDropped << '\n';
+	std::cout << "  envios: " << stats.sendCalls << " (" << (deliveries > 0 ? stats.sendCalls / deliveries : 0.0)
+		<< " por evento por cliente)\n";
+	std::cout << "  latencia ponta a ponta: ";
+	latencyUs.print(std::cout, "us");
+}
+
+#else
+
+struct EventStreamServer::Impl
+{
+};
+
+EventStreamServer::EventStreamServer(const std::string&, int, std::size_t, unsigned int)
+{
+	throw std::runtime_error("Servidor de eventos nao suportado nesta plataforma");
+}
+
+EventStreamServer::~EventStreamServer() = default;
+
+void EventStreamServer::stop()
+{
+}
+
+void EventStreamServer::publish(std::uint64_t, const DirectionState&)
+{
+}
+
+EventStreamStats EventStreamServer::stats() const
+{
+	return {};
+}
+
+void BenchmarkEventStream(int, double, unsigned int)
+{
+	std::cout << "events-bench so esta disponivel no Linux\n";
+}
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Direction.h"
+
+// Wire format (little-endian). On connect the server sends an 8-byte stream header:
+// "AVES", u16 version, u16 event size; then a stream of 16-byte events.
+namespace EventWire
+{
+	constexpr char Magic[4] = { 'A', 'V', 'E', 'S' };
+	constexpr std::uint16_t Version = 1;
+	constexpr std::size_t HeaderBytes = 8;
+	constexpr std::size_t EventBytes = 16;
+
+	// u64 timestamp (us) | u32 sequence | i16 azimuth (x 32767/180) | u8 direction | u8 confidence (x 255)
+	void Encode(std::uint64_t timestampUs, std::uint32_t sequence, const DirectionState& state, unsigned char* out);
+	void Decode(const unsigned char* in, std::uint64_t& timestampUs, std::uint32_t& sequence, DirectionState& state);
+}
+
+struct EventStreamStats
+{
+	std::uint64_t published = 0;
+	std::uint64_t stagingDropped = 0;  // publisher outran the server thread
+	std::uint64_t clientDropped = 0;   // events skipped for slow clients (drop-oldest)
+	std::uint64_t sendCalls = 0;       // writev calls, one per client per batch at most
+	std::uint64_t clientsAccepted = 0;
+};
+
+// Streams direction events to local subscribers over a Unix-domain socket and,
+// optionally, loopback TCP. publish() only writes into a lock-free staging ring;
+// a server thread wakes every batchMs, encodes the new events once into a shared
+// broadcast ring and sends each client its backlog with a single writev. Each
+// client may lag at most queueEvents behind; older events are dropped for that
+// client only.
+class EventStreamServer
+{
+public:
+	// tcpPort 0 disables TCP. Linux and other POSIX systems only.
+	EventStreamServer(const std::string& socketPath, int tcpPort = 0,
+		std::size_t queueEvents = 1024, unsigned int batchMs = 5);
+	~EventStreamServer();
+
+	EventStreamServer(const EventStreamServer&) = delete;
+	EventStreamServer& operator=(const EventStreamServer&) = delete;
+
+	// Called from the analysis thread: no locks, no syscalls, no allocation.
+	void publish(std::uint64_t timestampUs, const DirectionState& state);
+	void stop();
+
+	EventStreamStats stats() const;
+	std::size_t clientCount() const { return connectedClients.load(std::memory_order_relaxed); }
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+	std::thread worker;
+	std::atomic<std::size_t> connectedClients{ 0 };
+};
+
+// Load test: clientCount local clients (a tenth of them deliberately slow) read the
+// Unix socket while events are published at eventsPerSec; reports delivery,
+// drops, send calls per event and end-to-end latency.
+void BenchmarkEventStream(int clientCount, double durationSec, unsigned int eventsPerSec);
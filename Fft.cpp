@@ -0,0 +1,106 @@
+#include "Fft.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+	constexpr double Pi = 3.14159265358979323846;
+}
+
+FftPlan::FftPlan(std::size_t size)
+	: n(size), twiddles(size / 2), bitReverse(size)
+{
+	if (size < 2 || (size & (size - 1)) != 0) {
+		throw std::runtime_error("Tamanho de FFT deve ser potencia de dois");
+	}
+
+	for (std::size_t k = 0; k < n / 2; ++k) {
+		const double angle = -2.0 * Pi * static_cast<double>(k) / static_cast<double>(n);
+		twiddles[k] = { static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)) };
+	}
+
+	int bits = 0;
+	while ((std::size_t(1) << bits) < n) ++bits;
+	for (std::size_t i = 0; i < n; ++i) {
+		std::size_t r = 0;
+		for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+		bitReverse[i] = r;
+	}
+}
+
+void FftPlan::transform(std::complex<float>* data, bool invert) const
+{
+	for (std::size_t i = 0; i < n; ++i) {
+		if (i < bitReverse[i]) std::swap(data[i], data[bitReverse[i]]);
+	}
+
+	// Complex products are spelled out: std::complex operator* goes through the
+	// NaN-safe library routine on GCC/Clang, which is several times slower
+	for (std::size_t len = 2; len <= n; len <<= 1) {
+		const std::size_t half = len / 2;
+		const std::size_t step = n / len;
+		for (std::size_t start = 0; start < n; start += len) {
+			for (std::size_t k = 0; k < half; ++k) {
+				const std::complex<float> w = twiddles[k * step];
+				const float wr = w.real();
+				const float wi = invert ? -w.imag() : w.imag();
+
+				std::complex<float>& a = data[start + k];
+				std::complex<float>& b = data[start + k + half];
+				const float tr = b.real() * wr - b.imag() * wi;
+				const float ti = b.real() * wi + b.imag() * wr;
+				b = { a.real() - tr, a.imag() - ti };
+				a = { a.real() + tr, a.imag() + ti };
+			}
+		}
+	}
+}
+
+void FftPlan::forward(std::complex<float>* data) const
+{
+	transform(data, false);
+}
+
+void FftPlan::inverse(std::complex<float>* data) const
+{
+	transform(data, true);
+}
+
+void FftPlan::forwardTwoReal(const float* a, const float* b, std::complex<float>* scratch,
+	std::complex<float>* outA, std::complex<float>* outB) const
+{
+	for (std::size_t i = 0; i < n; ++i) scratch[i] = { a[i], b[i] };
+	forward(scratch);
+
+	// A[k] = (Z[k] + conj(Z[N-k])) / 2,  B[k] = (Z[k] - conj(Z[N-k])) / 2i
+	for (std::size_t k = 0; k <= n / 2; ++k) {
+		const std::complex<float> z = scratch[k];
+		const std::complex<float> zc = std::conj(scratch[(n - k) & (n - 1)]);
+		outA[k] = { 0.5f * (z.real() + zc.real()), 0.5f * (z.imag() + zc.imag()) };
+		outB[k] = { 0.5f * (z.imag() - zc.imag()), -0.5f * (z.real() - zc.real()) };
+	}
+}
+
+const FftPlan& GetFftPlan(std::size_t size)
+{
+	static std::mutex mutex;
+	static std::map<std::size_t, std::unique_ptr<FftPlan>> plans;
+
+	std::lock_guard lock(mutex);
+	auto& plan = plans[size];
+	if (!plan) plan = std::make_unique<FftPlan>(size);
+	return *plan;
+}
+
+std::vector<float> MakeHannWindow(std::size_t size)
+{
+	std::vector<float> window(size);
+	for (std::size_t i = 0; i < size; ++i) {
+		window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * Pi * static_cast<double>(i) / static_cast<double>(size)));
+	}
+	return window;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// In-place iterative radix-2 complex FFT. Twiddles and the bit-reversal table are
+// computed once per size; use GetFftPlan() to share plans between analyzers.
+class FftPlan
+{
+public:
+	explicit FftPlan(std::size_t size);
+
+	std::size_t size() const { return n; }
+	void forward(std::complex<float>* data) const;
+	// Unscaled: forward followed by inverse multiplies by size().
+	void inverse(std::complex<float>* data) const;
+
+	// Spectra of two real signals with one complex transform: packs a + ib, then
+	// splits the result. Writes the size()/2 + 1 non-negative bins of each.
+	void forwardTwoReal(const float* a, const float* b, std::complex<float>* scratch,
+		std::complex<float>* outA, std::complex<float>* outB) const;
+
+private:
+	void transform(std::complex<float>* data, bool invert) const;
+
+	std::size_t n;
+	std::vector<std::complex<float>> twiddles;
+	std::vector<std::size_t> bitReverse;
+};
+
+// Process-wide plan cache; size must be a power of two. Thread-safe, plans live forever.
+const FftPlan& GetFftPlan(std::size_t size);
+
+// Periodic Hann window of the given length.
+std::vector<float> MakeHannWindow(std::size_t size);
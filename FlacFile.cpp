@@ -0,0 +1,1176 @@
+#include "FlacFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include "WavFile.h"
+
+namespace
+{
+	constexpr int MaxLpcOrder = 32;
+
+	std::uint8_t crc8Table[256];
+	std::uint16_t crc16Table[256];
+
+	struct CrcTables
+	{
+		CrcTables()
+		{
+			for (int i = 0; i < 256; ++i) {
+				std::uint8_t c8 = static_cast<std::uint8_t>(i);
+				std::uint16_t c16 = static_cast<std::uint16_t>(i << 8);
+				for (int b = 0; b < 8; ++b) {
+					c8 = static_cast<std::uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+					c16 = static_cast<std::uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+				}
+				crc8Table[i] = c8;
+				crc16Table[i] = c16;
+			}
+		}
+	} crcTables;
+
+	std::uint8_t crc8(const std::uint8_t* data, std::size_t size)
+	{
+		std::uint8_t crc = 0;
+		for (std::size_t i = 0; i < size; ++i) crc = crc8Table[crc ^ data[i]];
+		return crc;
+	}
+
+	std::uint16_t crc16(const std::uint8_t* data, std::size_t size)
+	{
+		std::uint16_t crc = 0;
+		for (std::size_t i = 0; i < size; ++i) crc = static_cast<std::uint16_t>((crc << 8) ^ crc16Table[(crc >> 8) ^ data[i]]);
+		return crc;
+	}
+
+	// MSB-first bit packer over a byte vector.
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<std::uint8_t>& out) : out(out) {}
+
+		void put(std::uint32_t value, int bits)
+		{
+			if (bits == 0) return;
+			acc = (acc << bits) | (value & (0xFFFFFFFFu >> (32 - bits)));
+			pending += bits;
+			while (pending >= 8) {
+				pending -= 8;
+				out.push_back(static_cast<std::uint8_t>(acc >> pending));
+			}
+		}
+
+		void putSigned(std::int32_t value, int bits) { put(static_cast<std::uint32_t>(value), bits); }
+
+		void putZeros(std::uint32_t count)
+		{
+			for (; count >= 32; count -= 32) put(0, 32);
+			put(0, static_cast<int>(count));
+		}
+
+		void align()
+		{
+			if (pending > 0) put(0, 8 - pending);
+		}
+
+	private:
+		std::vector<std::uint8_t>& out;
+		std::uint64_t acc = 0;
+		int pending = 0;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const std::uint8_t* data, std::size_t size) : data(data), size(size) {}
+
+		std::uint32_t get(int bits)
+		{
+			std::uint32_t value = 0;
+			while (bits > 0) {
+				if (position >= size * 8) throw std::runtime_error("Quadro FLAC truncado");
+				const int offset = static_cast<int>(position & 7);
+				const int take = std::min(bits, 8 - offset);
+				const std::uint32_t byte = data[position >> 3];
+				value = (value << take) | ((byte >> (8 - offset - take)) & ((1u << take) - 1));
+				position += take;
+				bits -= take;
+			}
+			return value;
+		}
+
+		std::int32_t getSigned(int bits)
+		{
+			if (bits == 0) return 0;
+			const std::uint32_t value = get(bits);
+			return bits == 32 ? static_cast<std::int32_t>(value)
+				: static_cast<std::int32_t>(value << (32 - bits)) >> (32 - bits);
+		}
+
+		std::uint32_t getUnary()
+		{
+			std::uint32_t zeros = 0;
+			while (true) {
+				if (position >= size * 8) throw std::runtime_error("Quadro FLAC truncado");
+				if ((position & 7) == 0 && data[position >> 3] == 0) {
+					zeros += 8;
+					position += 8;
+					continue;
+				}
+				if (get(1)) return zeros;
+				++zeros;
+			}
+		}
+
+		std::uint64_t getUtf8()
+		{
+			std::uint32_t first = get(8);
+			int extra = 0;
+			while (extra < 7 && (first & (0x80 >> extra))) ++extra;
+			if (extra == 1 || extra == 7) throw std::runtime_error("Numero de quadro FLAC invalido");
+			std::uint64_t value = extra == 0 ? first : first & (0x3F >> (extra - 1));
+			for (int i = 1; i < extra; ++i) value = (value << 6) | (get(8) & 0x3F);
+			return value;
+		}
+
+		void align() { position = (position + 7) & ~static_cast<std::size_t>(7); }
+		std::size_t bytePosition() const { return position >> 3; }
+
+	private:
+		const std::uint8_t* data;
+		std::size_t size;
+		std::size_t position = 0;
+	};
+
+	void putUtf8(BitWriter& writer, std::uint64_t value)
+	{
+		if (value < 0x80) {
+			writer.put(static_cast<std::uint32_t>(value), 8);
+			return;
+		}
+		int extra = 1;
+		while (extra < 6 && value >= (1ull << (5 * extra + 6))) ++extra;
+		writer.put(static_cast<std::uint32_t>((0xFF00u >> (extra + 1)) & 0xFF) | static_cast<std::uint32_t>(value >> (6 * extra)), 8);
+		for (int i = extra - 1; i >= 0; --i) writer.put(0x80 | static_cast<std::uint32_t>((value >> (6 * i)) & 0x3F), 8);
+	}
+
+	int sampleRateCode(unsigned int rate)
+	{
+		switch (rate) {
+		case 88200: return 1;
+		case 176400: return 2;
+		case 192000: return 3;
+		case 8000: return 4;
+		case 16000: return 5;
+		case 22050: return 6;
+		case 24000: return 7;
+		case 32000: return 8;
+		case 44100: return 9;
+		case 48000: return 10;
+		case 96000: return 11;
+		default: return 0; // taken from STREAMINFO
+		}
+	}
+
+	std::uint32_t zigzag(std::int32_t value)
+	{
+		return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+	}
+
+	enum class SubframeType : std::uint8_t { Constant, Verbatim, Fixed, Lpc };
+
+	struct SubframePlan
+	{
+		SubframeType type = SubframeType::Verbatim;
+		int order = 0;
+		int precision = 0;
+		int shift = 0;
+		std::int32_t coefs[MaxLpcOrder] = {};
+		int partitionOrder = 0;
+		bool wideParams = false;              // 5-bit Rice parameters
+		std::vector<std::uint8_t> params;
+		std::vector<std::int32_t> residual;   // n - order values
+		std::uint64_t bits = 0;
+	};
+
+	// Per-thread scratch so encoding a block allocates only on first use.
+	struct EncoderScratch
+	{
+		std::vector<std::int32_t> channels[8]; // stereo: L, R, mid, side; otherwise one per channel
+		std::vector<float> window;
+		std::vector<float> windowed;
+		std::vector<std::uint64_t> sums;
+		SubframePlan candidate;
+		SubframePlan plans[8];
+	};
+
+	// Cheapest partitioned Rice coding of plan.residual; fills order, params and returns the bits.
+	std::uint64_t planResidual(SubframePlan& plan, unsigned int blockSize, int predictorOrder, int maxPartitionOrder,
+		std::vector<std::uint64_t>& sums)
+	{
+		int top = 0;
+		while (top < maxPartitionOrder && (blockSize & ((2u << top) - 1)) == 0
+			&& (blockSize >> (top + 1)) > static_cast<unsigned int>(predictorOrder)) {
+			++top;
+		}
+
+		const std::size_t partitions = std::size_t(1) << top;
+		sums.assign(partitions, 0);
+		const unsigned int length = blockSize >> top;
+		std::size_t index = 0;
+		for (std::size_t p = 0; p < partitions; ++p) {
+			const unsigned int count = p == 0 ? length - predictorOrder : length;
+			std::uint64_t sum = 0;
+			for (unsigned int i = 0; i < count; ++i) sum += zigzag(plan.residual[index++]);
+			sums[p] = sum;
+		}
+
+		std::uint64_t best = ~0ull;
+		for (int order = top; order >= 0; --order) {
+			const std::size_t count = std::size_t(1) << order;
+			const unsigned int partLength = blockSize >> order;
+			std::uint64_t bits = 0;
+			bool wide = false;
+			std::uint8_t params[1 << 8];
+			for (std::size_t p = 0; p < count; ++p) {
+				const std::uint64_t n = p == 0 ? partLength - predictorOrder : partLength;
+				const std::uint64_t sum = sums[p];
+				int k = 0;
+				while (k < 30 && (n << (k + 1)) < sum) ++k;
+				// sum >> k slightly underestimates the quotients, which is fine for choosing
+				std::uint64_t cost = n * (k + 1) + (sum >> k);
+				if (k > 0) {
+					const std::uint64_t lower = n * k + (sum >> (k - 1));
+					if (lower < cost) {
+						cost = lower;
+						--k;
+					}
+				}
+				wide |= k > 14;
+				params[p] = static_cast<std::uint8_t>(k);
+				bits += cost;
+			}
+			bits += count * (wide ? 5 : 4) + 6;
+			if (bits < best) {
+				best = bits;
+				plan.partitionOrder = order;
+				plan.wideParams = wide;
+				plan.params.assign(params, params + count);
+			}
+			if (order > 0) {
+				for (std::size_t p = 0; p < count / 2; ++p) sums[p] = sums[2 * p] + sums[2 * p + 1];
+			}
+		}
+		return best;
+	}
+
+	void fixedResidual(const std::int32_t* x, unsigned int n, int order, std::vector<std::int32_t>& out)
+	{
+		out.resize(n - order);
+		std::int32_t* r = out.data();
+		for (unsigned int i = order; i < n; ++i) {
+			std::int64_t e;
+			switch (order) {
+			case 0: e = x[i]; break;
+			case 1: e = static_cast<std::int64_t>(x[i]) - x[i - 1]; break;
+			case 2: e = static_cast<std::int64_t>(x[i]) - 2ll * x[i - 1] + x[i - 2]; break;
+			case 3: e = static_cast<std::int64_t>(x[i]) - 3ll * x[i - 1] + 3ll * x[i - 2] - x[i - 3]; break;
+			default: e = static_cast<std::int64_t>(x[i]) - 4ll * x[i - 1] + 6ll * x[i - 2] - 4ll * x[i - 3] + x[i - 4]; break;
+			}
+			r[i - order] = static_cast<std::int32_t>(e);
+		}
+	}
+
+	// Returns false when a residual would not fit the 32-bit range decoders assume.
+	bool lpcResidual(const std::int32_t* x, unsigned int n, const SubframePlan& plan, std::vector<std::int32_t>& out)
+	{
+		const int order = plan.order;
+		out.resize(n - order);
+		for (unsigned int i = order; i < n; ++i) {
+			std::int64_t prediction = 0;
+			for (int j = 0; j < order; ++j) prediction += static_cast<std::int64_t>(plan.coefs[j]) * x[i - 1 - j];
+			const std::int64_t e = x[i] - (prediction >> plan.shift);
+			if (e > (1ll << 30) || e < -(1ll << 30)) return false;
+			out[i - order] = static_cast<std::int32_t>(e);
+		}
+		return true;
+	}
+
+	// Levinson-Durbin on autoc[0..maxOrder]; lpc[o - 1] holds the order-o predictor.
+	int levinson(const double* autoc, int maxOrder, double lpc[][MaxLpcOrder], double* error)
+	{
+		double a[MaxLpcOrder] = {};
+		double err = autoc[0];
+		for (int i = 0; i < maxOrder; ++i) {
+			if (err <= 0.0) return i;
+			double r = -autoc[i + 1];
+			for (int j = 0; j < i; ++j) r -= a[j] * autoc[i - j];
+			r /= err;
+
+			a[i] = r;
+			for (int j = 0; j < i / 2; ++j) {
+				const double t = a[j];
+				a[j] += r * a[i - 1 - j];
+				a[i - 1 - j] += r * t;
+			}
+			if (i & 1) a[i / 2] += a[i / 2] * r;
+			err *= 1.0 - r * r;
+
+			for (int j = 0; j <= i; ++j) lpc[i][j] = -a[j];
+			error[i] = err;
+		}
+		return maxOrder;
+	}
+
+	// Quantizes with error feedback so rounding errors do not accumulate along the predictor.
+	bool quantize(const double* lpc, int order, int precision, SubframePlan& plan)
+	{
+		double cmax = 0.0;
+		for (int i = 0; i < order; ++i) cmax = std::max(cmax, std::fabs(lpc[i]));
+		if (cmax <= 0.0) return false;
+
+		int log2cmax;
+		std::frexp(cmax, &log2cmax);
+		const int qbits = precision - 1;
+		const std::int32_t qmax = (1 << qbits) - 1;
+		const std::int32_t qmin = -(1 << qbits);
+		const int shift = std::min(15, qbits - log2cmax);
+		if (shift < 0) return false;
+
+		double error = 0.0;
+		for (int i = 0; i < order; ++i) {
+			error += lpc[i] * (1 << shift);
+			const auto q = static_cast<std::int32_t>(std::clamp(std::lround(error), static_cast<long>(qmin), static_cast<long>(qmax)));
+			error -= q;
+			plan.coefs[i] = q;
+		}
+		plan.order = order;
+		plan.precision = precision;
+		plan.shift = shift;
+		return true;
+	}
+
+	void swapPlans(SubframePlan& a, SubframePlan& b)
+	{
+		std::swap(a.type, b.type);
+		std::swap(a.order, b.order);
+		std::swap(a.precision, b.precision);
+		std::swap(a.shift, b.shift);
+		std::swap(a.coefs, b.coefs);
+		std::swap(a.partitionOrder, b.partitionOrder);
+		std::swap(a.wideParams, b.wideParams);
+		a.params.swap(b.params);
+		a.residual.swap(b.residual);
+		std::swap(a.bits, b.bits);
+	}
+
+	void planSubframe(const std::int32_t* x, unsigned int n, int bps, const FlacLevel& level, EncoderScratch& scratch, SubframePlan& best)
+	{
+		best.type = SubframeType::Verbatim;
+		best.order = 0;
+		best.bits = 8ull + static_cast<std::uint64_t>(n) * bps;
+
+		if (std::all_of(x, x + n, [&](std::int32_t v) { return v == x[0]; })) {
+			best.type = SubframeType::Constant;
+			best.bits = 8ull + bps;
+			return;
+		}
+
+		SubframePlan& candidate = scratch.candidate;
+
+		// Fixed predictors: pick the order with the smallest |residual| sum, as the reference encoder does
+		const int maxFixed = std::min<int>(level.maxFixedOrder, static_cast<int>(n) - 1);
+		if (maxFixed >= 0) {
+			std::uint64_t total[5] = {};
+			for (unsigned int i = 4; i < n; ++i) {
+				const std::int64_t e0 = x[i];
+				const std::int64_t e1 = e0 - x[i - 1];
+				const std::int64_t e2 = e1 - (static_cast<std::int64_t>(x[i - 1]) - x[i - 2]);
+				const std::int64_t e3 = e2 - (static_cast<std::int64_t>(x[i - 1]) - 2ll * x[i - 2] + x[i - 3]);
+				const std::int64_t e4 = e3 - (static_cast<std::int64_t>(x[i - 1]) - 3ll * x[i - 2] + 3ll * x[i - 3] - x[i - 4]);
+				total[0] += static_cast<std::uint64_t>(e0 < 0 ? -e0 : e0);
+				total[1] += static_cast<std::uint64_t>(e1 < 0 ? -e1 : e1);
+				total[2] += static_cast<std::uint64_t>(e2 < 0 ? -e2 : e2);
+				total[3] += static_cast<std::uint64_t>(e3 < 0 ? -e3 : e3);
+				total[4] += static_cast<std::uint64_t>(e4 < 0 ? -e4 : e4);
+			}
+			int order = 0;
+			for (int o = 1; o <= maxFixed; ++o) {
+				if (total[o] < total[order]) order = o;
+			}
+
+			candidate.type = SubframeType::Fixed;
+			candidate.order = order;
+			fixedResidual(x, n, order, candidate.residual);
+			candidate.bits = 8ull + static_cast<std::uint64_t>(order) * bps
+				+ planResidual(candidate, n, order, level.maxPartitionOrder, scratch.sums);
+			if (candidate.bits < best.bits) swapPlans(best, candidate);
+		}
+
+		const int maxOrder = std::min<int>(level.maxLpcOrder, static_cast<int>(n) - 1);
+		if (maxOrder <= 0) return;
+
+		// Tukey(0.5) window, rebuilt only when the block size changes
+		if (scratch.window.size() != n) {
+			scratch.window.assign(n, 1.0f);
+			const unsigned int taper = n / 4;
+			for (unsigned int i = 0; i < taper; ++i) {
+				const float w = 0.5f - 0.5f * static_cast<float>(std::cos(3.14159265358979323846 * i / taper));
+				scratch.window[i] = w;
+				scratch.window[n - 1 - i] = w;
+			}
+		}
+		scratch.windowed.resize(n);
+		for (unsigned int i = 0; i < n; ++i) scratch.windowed[i] = static_cast<float>(x[i]) * scratch.window[i];
+
+		double autoc[MaxLpcOrder + 1];
+		for (int lag = 0; lag <= maxOrder; ++lag) {
+			double sum = 0.0;
+			for (unsigned int i = lag; i < n; ++i) sum += static_cast<double>(scratch.windowed[i]) * scratch.windowed[i - lag];
+			autoc[lag] = sum;
+		}
+		if (autoc[0] <= 0.0) return;
+
+		double lpc[MaxLpcOrder][MaxLpcOrder];
+		double error[MaxLpcOrder];
+		const int orders = levinson(autoc, maxOrder, lpc, error);
+		if (orders == 0) return;
+
+		auto tryOrder = [&](int order) {
+			if (!quantize(lpc[order - 1], order, level.lpcPrecision, candidate)) return;
+			candidate.type = SubframeType::Lpc;
+			if (!lpcResidual(x, n, candidate, candidate.residual)) return;
+			candidate.bits = 8ull + static_cast<std::uint64_t>(order) * bps + 9 + static_cast<std::uint64_t>(order) * level.lpcPrecision
+				+ planResidual(candidate, n, order, level.maxPartitionOrder, scratch.sums);
+			if (candidate.bits < best.bits) swapPlans(best, candidate);
+		};
+
+		if (level.exhaustiveLpc) {
+			for (int order = 1; order <= orders; ++order) tryOrder(order);
+			return;
+		}
+
+		// Expected size from the prediction error: half a bit per halving of the residual power
+		int chosen = 1;
+		double chosenBits = 1e300;
+		for (int order = 1; order <= orders; ++order) {
+			const double perSample = 0.5 * std::log2(std::max(error[order - 1] / n, 1e-9));
+			const double bits = (n - order) * std::max(perSample, 0.0) + order * static_cast<double>(level.lpcPrecision + bps);
+			if (bits < chosenBits) {
+				chosenBits = bits;
+				chosen = order;
+			}
+		}
+		tryOrder(chosen);
+	}
+
+	void writeSubframe(BitWriter& writer, const std::int32_t* x, unsigned int n, int bps, const SubframePlan& plan)
+	{
+		writer.put(0, 1);
+		switch (plan.type) {
+		case SubframeType::Constant:
+			writer.put(0, 6);
+			writer.put(0, 1);
+			writer.putSigned(x[0], bps);
+			return;
+		case SubframeType::Verbatim:
+			writer.put(1, 6);
+			writer.put(0, 1);
+			for (unsigned int i = 0; i < n; ++i) writer.putSigned(x[i], bps);
+			return;
+		case SubframeType::Fixed:
+			writer.put(8 | plan.order, 6);
+			writer.put(0, 1);
+			for (int i = 0; i < plan.order; ++i) writer.putSigned(x[i], bps);
+			break;
+		case SubframeType::Lpc:
+			writer.put(32 | (plan.order - 1), 6);
+			writer.put(0, 1);
+			for (int i = 0; i < plan.order; ++i) writer.putSigned(x[i], bps);
+			writer.put(plan.precision - 1, 4);
+			writer.putSigned(plan.shift, 5);
+			for (int i = 0; i < plan.order; ++i) writer.putSigned(plan.coefs[i], plan.precision);
+			break;
+		}
+
+		writer.put(plan.wideParams ? 1 : 0, 2);
+		writer.put(plan.partitionOrder, 4);
+		const unsigned int partLength = n >> plan.partitionOrder;
+		std::size_t index = 0;
+		for (std::size_t p = 0; p < plan.params.size(); ++p) {
+			const int k = plan.params[p];
+			writer.put(k, plan.wideParams ? 5 : 4);
+			const unsigned int count = p == 0 ? partLength - plan.order : partLength;
+			for (unsigned int i = 0; i < count; ++i) {
+				const std::uint32_t u = zigzag(plan.residual[index++]);
+				const std::uint32_t q = u >> k;
+				if (q < 31) {
+					writer.put(1, static_cast<int>(q) + 1);
+				} else {
+					writer.putZeros(q);
+					writer.put(1, 1);
+				}
+				writer.put(u, k);
+			}
+		}
+	}
+
+	void encodeFrame(const std::int32_t* samples, unsigned int frames, int numChannels, unsigned int sampleRate, int bps,
+		std::uint64_t number, const FlacLevel& level, EncoderScratch& scratch, std::vector<std::uint8_t>& out)
+	{
+		out.clear();
+		BitWriter writer(out);
+
+		// Deinterleave; stereo also gets mid and side
+		const bool stereo = numChannels == 2 && level.stereoDecorrelation;
+		std::vector<std::int32_t>* channels = scratch.channels;
+		int assignment = numChannels - 1;
+		const SubframePlan* chosen[8] = {};
+		const std::int32_t* chosenData[8] = {};
+		int chosenBps[8] = {};
+
+		if (stereo) {
+			for (int c = 0; c < 4; ++c) channels[c].resize(frames);
+			for (unsigned int i = 0; i < frames; ++i) {
+				const std::int32_t l = samples[2 * i];
+				const std::int32_t r = samples[2 * i + 1];
+				channels[0][i] = l;
+				channels[1][i] = r;
+				channels[2][i] = (l + r) >> 1;
+				channels[3][i] = l - r;
+			}
+			for (int c = 0; c < 4; ++c) planSubframe(channels[c].data(), frames, c == 3 ? bps + 1 : bps, level, scratch, scratch.plans[c]);
+
+			const std::uint64_t lr = scratch.plans[0].bits + scratch.plans[1].bits;
+			const std::uint64_t ls = scratch.plans[0].bits + scratch.plans[3].bits;
+			const std::uint64_t rs = scratch.plans[1].bits + scratch.plans[3].bits;
+			const std::uint64_t ms = scratch.plans[2].bits + scratch.plans[3].bits;
+			const std::uint64_t best = std::min({ lr, ls, rs, ms });
+			int first = 0, second = 1;
+			if (best == lr) { assignment = 1; first = 0; second = 1; }
+			else if (best == ls) { assignment = 8; first = 0; second = 3; }
+			else if (best == rs) { assignment = 9; first = 3; second = 1; }
+			else { assignment = 10; first = 2; second = 3; }
+
+			chosen[0] = &scratch.plans[first];
+			chosen[1] = &scratch.plans[second];
+			chosenData[0] = channels[first].data();
+			chosenData[1] = channels[second].data();
+			chosenBps[0] = first == 3 ? bps + 1 : bps;
+			chosenBps[1] = second == 3 ? bps + 1 : bps;
+		} else {
+			for (int ch = 0; ch < numChannels; ++ch) {
+				channels[ch].resize(frames);
+				for (unsigned int i = 0; i < frames; ++i) channels[ch][i] = samples[static_cast<std::size_t>(i) * numChannels + ch];
+				planSubframe(channels[ch].data(), frames, bps, level, scratch, scratch.plans[ch]);
+				chosen[ch] = &scratch.plans[ch];
+				chosenData[ch] = channels[ch].data();
+				chosenBps[ch] = bps;
+			}
+		}
+
+		// Frame header
+		const bool fullBlock = frames == FlacWriter::BlockFrames;
+		const int rateCode = sampleRateCode(sampleRate);
+		writer.put(0xFFF8, 16);
+		writer.put(fullBlock ? 12 : 7, 4);
+		writer.put(rateCode, 4);
+		writer.put(assignment, 4);
+		writer.put(bps == 24 ? 6 : 4, 3);
+		writer.put(0, 1);
+		putUtf8(writer, number);
+		if (!fullBlock) writer.put(frames - 1, 16);
+		writer.put(crc8(out.data(), out.size()), 8);
+
+		for (int ch = 0; ch < numChannels; ++ch) {
+			writeSubframe(writer, chosenData[ch], frames, chosenBps[ch], *chosen[ch]);
+		}
+		writer.align();
+		const std::uint16_t crc = crc16(out.data(), out.size());
+		writer.put(crc, 16);
+	}
+}
+
+FlacLevel GetFlacLevel(int level)
+{
+	static const FlacLevel levels[] = {
+		{ 2, 0, 0, false, 3, false },
+		{ 4, 0, 0, false, 3, true },
+		{ 4, 0, 0, false, 4, true },
+		{ 4, 6, 12, false, 4, true },
+		{ 4, 8, 12, false, 4, true },
+		{ 4, 8, 12, false, 5, true },
+		{ 4, 8, 13, false, 6, true },
+		{ 4, 12, 14, false, 6, true },
+		{ 4, 12, 15, true, 6, true },
+	};
+	return levels[std::clamp(level, 0, 8)];
+}
+
+FlacWriter::FlacWriter(const std::string& path, int numChannels, unsigned int sampleRate, int bitsPerSample, int level, int threads)
+	: file(path, std::ios::binary | std::ios::trunc), numChannels(numChannels), sampleRate(sampleRate),
+	bitsPerSample(bitsPerSample), level(GetFlacLevel(level))
+{
+	if (numChannels < 1 || numChannels > 8 || sampleRate == 0 || sampleRate >= (1u << 20)
+		|| (bitsPerSample != 16 && bitsPerSample != 24)) {
+		throw std::runtime_error("Formato nao suportado pelo codificador FLAC");
+	}
+	if (!file.is_open()) {
+		throw std::runtime_error("Erro ao abrir o arquivo FLAC para escrita: " + path);
+	}
+	writeStreamInfo();
+
+	if (threads <= 0) threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+
+	// Enough blocks for every encoder to be busy while the writer fills the next few
+	blocks.resize(static_cast<std::size_t>(threads) * 2 + 4);
+	for (Block& block : blocks) {
+		block.samples.resize(static_cast<std::size_t>(BlockFrames) * numChannels);
+		block.encoded.reserve(static_cast<std::size_t>(BlockFrames) * numChannels * 4 + 64);
+		freeList.push_back(&block);
+	}
+	acquire();
+
+	for (int i = 0; i < threads; ++i) workers.emplace_back(&FlacWriter::workerLoop, this);
+}
+
+FlacWriter::~FlacWriter()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void FlacWriter::writeStreamInfo()
+{
+	std::vector<std::uint8_t> info;
+	BitWriter writer(info);
+	for (const char c : { 'f', 'L', 'a', 'C' }) writer.put(static_cast<std::uint8_t>(c), 8);
+	writer.put(1, 1);   // last metadata block
+	writer.put(0, 7);   // STREAMINFO
+	writer.put(34, 24);
+	writer.put(BlockFrames, 16);
+	writer.put(BlockFrames, 16);
+	writer.put(minFrameBytes, 24);
+	writer.put(maxFrameBytes, 24);
+	writer.put(sampleRate, 20);
+	writer.put(numChannels - 1, 3);
+	writer.put(bitsPerSample - 1, 5);
+	writer.put(static_cast<std::uint32_t>(totalFrames >> 32), 4);
+	writer.put(static_cast<std::uint32_t>(totalFrames), 32);
+	for (int i = 0; i < 16; ++i) writer.put(0, 8); // MD5 not computed
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(info.data()), info.size());
+}
+
+void FlacWriter::acquire()
+{
+	std::unique_lock lock(mutex);
+	if (freeList.empty()) {
+		++stallCount;
+		released.wait(lock, [this] { return !freeList.empty(); });
+	}
+	current = freeList.back();
+	freeList.pop_back();
+	current->frames = 0;
+	current->done = false;
+}
+
+void FlacWriter::submit()
+{
+	current->number = nextNumber++;
+	totalFrames += current->frames;
+	{
+		std::lock_guard lock(mutex);
+		work.push_back(current);
+		pending.push_back(current);
+	}
+	queued.notify_one();
+	current = nullptr;
+}
+
+template <typename T, typename Convert>
+void FlacWriter::append(const T* samples, unsigned int frameCount, Convert convert)
+{
+	if (closed) throw std::runtime_error("Arquivo FLAC ja fechado");
+
+	while (frameCount > 0) {
+		if (!current) acquire();
+		const unsigned int take = std::min(frameCount, BlockFrames - current->frames);
+		const std::size_t count = static_cast<std::size_t>(take) * numChannels;
+		std::int32_t* out = current->samples.data() + static_cast<std::size_t>(current->frames) * numChannels;
+		for (std::size_t i = 0; i < count; ++i) out[i] = convert(samples[i]);
+
+		samples += count;
+		frameCount -= take;
+		current->frames += take;
+		if (current->frames == BlockFrames) submit();
+	}
+}
+
+void FlacWriter::write(const float* samples, unsigned int frameCount)
+{
+	const float scale = bitsPerSample == 24 ? 8388607.0f : 32767.0f;
+	append(samples, frameCount, [scale](float x) { return static_cast<std::int32_t>(std::clamp(x, -1.0f, 1.0f) * scale); });
+}
+
+void FlacWriter::write(const std::int16_t* samples, unsigned int frameCount)
+{
+	const int shift = bitsPerSample - 16;
+	append(samples, frameCount, [shift](std::int16_t x) { return static_cast<std::int32_t>(x) * (1 << shift); });
+}
+
+void FlacWriter::write(const std::int32_t* samples, unsigned int frameCount)
+{
+	append(samples, frameCount, [](std::int32_t x) { return x; });
+}
+
+void FlacWriter::workerLoop()
+{
+	EncoderScratch scratch;
+	std::vector<Block*> batch;
+	batch.reserve(blocks.size());
+	while (true) {
+		Block* block;
+		{
+			std::unique_lock lock(mutex);
+			queued.wait(lock, [this] { return stopping || !work.empty(); });
+			if (work.empty()) return;
+			block = work.front();
+			work.pop_front();
+		}
+
+		encodeFrame(block->samples.data(), block->frames, numChannels, sampleRate, bitsPerSample, block->number, level, scratch, block->encoded);
+
+		// One worker at a time writes every finished block in order. The file is written
+		// outside the lock, so the capture thread only ever waits on queue operations;
+		// blocks finished meanwhile are picked up by the writer's next round.
+		std::unique_lock lock(mutex);
+		block->done = true;
+		if (writing) continue;
+		writing = true;
+		while (!pending.empty() && pending.front()->done) {
+			while (!pending.empty() && pending.front()->done) {
+				batch.push_back(pending.front());
+				pending.pop_front();
+			}
+			lock.unlock();
+			for (Block* ready : batch) {
+				const auto size = static_cast<std::uint32_t>(ready->encoded.size());
+				file.write(reinterpret_cast<const char*>(ready->encoded.data()), size);
+				totalBytes += size;
+				minFrameBytes = minFrameBytes == 0 ? size : std::min(minFrameBytes, size);
+				maxFrameBytes = std::max(maxFrameBytes, size);
+			}
+			lock.lock();
+			freeList.insert(freeList.end(), batch.begin(), batch.end());
+			batch.clear();
+			released.notify_all();
+		}
+		writing = false;
+	}
+}
+
+void FlacWriter::close()
+{
+	if (closed) return;
+	closed = true;
+
+	if (current && current->frames > 0) submit();
+	{
+		std::unique_lock lock(mutex);
+		released.wait(lock, [this] { return pending.empty() && !writing; });
+		stopping = true;
+	}
+	queued.notify_all();
+	for (auto& worker : workers) worker.join();
+	workers.clear();
+
+	writeStreamInfo();
+	file.close();
+	if (!file) {
+		throw std::runtime_error("Falha ao gravar o arquivo FLAC");
+	}
+}
+
+FlacReader::FlacReader(const std::string& path)
+	: file(path, std::ios::binary)
+{
+	if (!file.is_open()) {
+		throw std::runtime_error("Erro ao abrir o arquivo FLAC: " + path);
+	}
+
+	char magic[4];
+	if (!file.read(magic, 4) || std::memcmp(magic, "fLaC", 4) != 0) {
+		throw std::runtime_error("Arquivo nao e FLAC: " + path);
+	}
+
+	bool last = false;
+	bool haveInfo = false;
+	while (!last) {
+		std::uint8_t header[4];
+		if (!file.read(reinterpret_cast<char*>(header), 4)) throw std::runtime_error("Metadados FLAC truncados: " + path);
+		last = (header[0] & 0x80) != 0;
+		const int type = header[0] & 0x7F;
+		const std::uint32_t length = (header[1] << 16) | (header[2] << 8) | header[3];
+		std::vector<std::uint8_t> body(length);
+		if (!file.read(reinterpret_cast<char*>(body.data()), length)) throw std::runtime_error("Metadados FLAC truncados: " + path);
+
+		if (type == 0 && length >= 34) {
+			BitReader reader(body.data(), body.size());
+			reader.get(16);
+			reader.get(16);
+			reader.get(24);
+			reader.get(24);
+			audioFormat.sampleRate = reader.get(20);
+			audioFormat.channels = static_cast<int>(reader.get(3)) + 1;
+			bps = static_cast<int>(reader.get(5)) + 1;
+			streamFrames = static_cast<std::uint64_t>(reader.get(4)) << 32;
+			streamFrames |= reader.get(32);
+			haveInfo = true;
+		}
+	}
+	if (!haveInfo) {
+		throw std::runtime_error("FLAC sem STREAMINFO: " + path);
+	}
+}
+
+bool FlacReader::decodeFrame()
+{
+	// Keep at least one maximal frame (65535 frames * 8 channels * 33 bits) buffered
+	constexpr std::size_t Window = 4 << 20;
+	if (raw.size() - rawPosition < Window && file) {
+		raw.erase(raw.begin(), raw.begin() + static_cast<std::ptrdiff_t>(rawPosition));
+		rawPosition = 0;
+		const std::size_t have = raw.size();
+		raw.resize(have + Window);
+		file.read(reinterpret_cast<char*>(raw.data() + have), Window);
+		raw.resize(have + static_cast<std::size_t>(file.gcount()));
+	}
+	if (rawPosition >= raw.size()) return false;
+
+	const std::uint8_t* frame = raw.data() + rawPosition;
+	BitReader reader(frame, raw.size() - rawPosition);
+
+	if (reader.get(15) != 0x7FFC) throw std::runtime_error("Sincronismo FLAC perdido");
+	reader.get(1);
+	const std::uint32_t blockCode = reader.get(4);
+	const std::uint32_t rateCode = reader.get(4);
+	const std::uint32_t assignment = reader.get(4);
+	const std::uint32_t sizeCode = reader.get(3);
+	reader.get(1);
+	reader.getUtf8();
+
+	unsigned int frames;
+	if (blockCode == 1) frames = 192;
+	else if (blockCode >= 2 && blockCode <= 5) frames = 576u << (blockCode - 2);
+	else if (blockCode == 6) frames = reader.get(8) + 1;
+	else if (blockCode == 7) frames = reader.get(16) + 1;
+	else if (blockCode >= 8) frames = 256u << (blockCode - 8);
+	else throw std::runtime_error("Tamanho de bloco FLAC invalido");
+
+	if (rateCode == 12) reader.get(8);
+	else if (rateCode == 13 || rateCode == 14) reader.get(16);
+
+	static const int sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+	const int frameBps = sizeCode == 0 ? bps : sizes[sizeCode];
+	if (frameBps == 0) throw std::runtime_error("Tamanho de amostra FLAC invalido");
+
+	const std::size_t headerBytes = reader.bytePosition();
+	if (reader.get(8) != crc8(frame, headerBytes)) throw std::runtime_error("CRC do cabecalho FLAC invalido");
+
+	const int numChannels = assignment <= 7 ? static_cast<int>(assignment) + 1 : 2;
+	if (numChannels != audioFormat.channels || assignment > 10) throw std::runtime_error("Canais FLAC inconsistentes");
+
+	scratch.resize(static_cast<std::size_t>(frames) * numChannels);
+	for (int ch = 0; ch < numChannels; ++ch) {
+		std::int32_t* x = scratch.data() + static_cast<std::size_t>(ch) * frames;
+		int channelBps = frameBps;
+		if ((assignment == 8 && ch == 1) || (assignment == 9 && ch == 0) || (assignment == 10 && ch == 1)) ++channelBps;
+
+		reader.get(1);
+		const std::uint32_t type = reader.get(6);
+		int wasted = 0;
+		if (reader.get(1)) wasted = static_cast<int>(reader.getUnary()) + 1;
+		channelBps -= wasted;
+
+		int order = 0;
+		std::int32_t coefs[MaxLpcOrder] = {};
+		int precision = 0;
+		int shift = 0;
+		if (type == 0) {
+			std::fill(x, x + frames, reader.getSigned(channelBps));
+		} else if (type == 1) {
+			for (unsigned int i = 0; i < frames; ++i) x[i] = reader.getSigned(channelBps);
+		} else if (type >= 8 && type <= 12) {
+			order = static_cast<int>(type - 8);
+		} else if (type >= 32) {
+			order = static_cast<int>(type - 31);
+		} else {
+			throw std::runtime_error("Subquadro FLAC reservado");
+		}
+
+		if (type >= 8) {
+			if (static_cast<unsigned int>(order) > frames) throw std::runtime_error("Ordem FLAC invalida");
+			for (int i = 0; i < order; ++i) x[i] = reader.getSigned(channelBps);
+			if (type >= 32) {
+				precision = static_cast<int>(reader.get(4)) + 1;
+				shift = reader.getSigned(5);
+				if (precision == 16 || shift < 0) throw std::runtime_error("Coeficientes FLAC invalidos");
+				for (int i = 0; i < order; ++i) coefs[i] = reader.getSigned(precision);
+			}
+
+			// Residual
+			const std::uint32_t method = reader.get(2);
+			if (method > 1) throw std::runtime_error("Metodo de residuo FLAC reservado");
+			const int paramBits = method == 0 ? 4 : 5;
+			const std::uint32_t escape = method == 0 ? 15 : 31;
+			const int partitionOrder = static_cast<int>(reader.get(4));
+			const unsigned int partLength = frames >> partitionOrder;
+			unsigned int index = order;
+			for (unsigned int p = 0; p < (1u << partitionOrder); ++p) {
+				const unsigned int count = p == 0 ? partLength - order : partLength;
+				const std::uint32_t k = reader.get(paramBits);
+				if (k == escape) {
+					const int rawBits = static_cast<int>(reader.get(5));
+					for (unsigned int i = 0; i < count; ++i) x[index++] = reader.getSigned(rawBits);
+					continue;
+				}
+				for (unsigned int i = 0; i < count; ++i) {
+					const std::uint32_t u = (reader.getUnary() << k) | reader.get(static_cast<int>(k));
+					x[index++] = static_cast<std::int32_t>(u >> 1) ^ -static_cast<std::int32_t>(u & 1);
+				}
+			}
+
+			// Prediction
+			for (unsigned int i = order; i < frames; ++i) {
+				std::int64_t prediction = 0;
+				if (type < 32) {
+					switch (order) {
+					case 1: prediction = x[i - 1]; break;
+					case 2: prediction = 2ll * x[i - 1] - x[i - 2]; break;
+					case 3: prediction = 3ll * x[i - 1] - 3ll * x[i - 2] + x[i - 3]; break;
+					case 4: prediction = 4ll * x[i - 1] - 6ll * x[i - 2] + 4ll * x[i - 3] - x[i - 4]; break;
+					default: break;
+					}
+				} else {
+					for (int j = 0; j < order; ++j) prediction += static_cast<std::int64_t>(coefs[j]) * x[i - 1 - j];
+					prediction >>= shift;
+				}
+				x[i] = static_cast<std::int32_t>(x[i] + prediction);
+			}
+		}
+
+		if (wasted > 0) {
+			for (unsigned int i = 0; i < frames; ++i) x[i] = static_cast<std::int32_t>(static_cast<std::uint32_t>(x[i]) << wasted);
+		}
+	}
+
+	reader.align();
+	const std::size_t bodyBytes = reader.bytePosition();
+	if (reader.get(16) != crc16(frame, bodyBytes)) throw std::runtime_error("CRC do quadro FLAC invalido");
+	rawPosition += reader.bytePosition();
+
+	std::int32_t* a = scratch.data();
+	std::int32_t* b = scratch.data() + frames;
+	for (unsigned int i = 0; i < frames && assignment >= 8; ++i) {
+		if (assignment == 8) {
+			b[i] = a[i] - b[i];
+		} else if (assignment == 9) {
+			a[i] += b[i];
+		} else {
+			const std::int32_t mid = static_cast<std::int32_t>(static_cast<std::uint32_t>(a[i]) << 1) | (b[i] & 1);
+			const std::int32_t side = b[i];
+			a[i] = (mid + side) >> 1;
+			b[i] = (mid - side) >> 1;
+		}
+	}
+
+	decoded.resize(scratch.size());
+	for (unsigned int i = 0; i < frames; ++i) {
+		for (int ch = 0; ch < numChannels; ++ch) {
+			decoded[static_cast<std::size_t>(i) * numChannels + ch] = scratch[static_cast<std::size_t>(ch) * frames + i];
+		}
+	}
+	decodedPosition = 0;
+	return true;
+}
+
+unsigned int FlacReader::readPcm(std::int32_t* out, unsigned int frameCount)
+{
+	const int numChannels = audioFormat.channels;
+	unsigned int done = 0;
+	while (done < frameCount) {
+		if (decodedPosition == decoded.size() && !decodeFrame()) break;
+		const std::size_t available = (decoded.size() - decodedPosition) / numChannels;
+		const std::size_t take = std::min<std::size_t>(available, frameCount - done);
+		std::copy_n(decoded.data() + decodedPosition, take * numChannels, out + static_cast<std::size_t>(done) * numChannels);
+		decodedPosition += take * numChannels;
+		done += static_cast<unsigned int>(take);
+	}
+	return done;
+}
+
+unsigned int FlacReader::read(float* out, unsigned int frameCount)
+{
+	std::int32_t chunk[4096];
+	const int numChannels = audioFormat.channels;
+	const float scale = 1.0f / static_cast<float>(1u << (bps - 1));
+	const unsigned int step = 4096 / numChannels;
+
+	unsigned int done = 0;
+	while (done < frameCount) {
+		const unsigned int got = readPcm(chunk, std::min(step, frameCount - done));
+		if (got == 0) break;
+		for (std::size_t i = 0; i < static_cast<std::size_t>(got) * numChannels; ++i) {
+			out[static_cast<std::size_t>(done) * numChannels + i] = chunk[i] * scale;
+		}
+		done += got;
+	}
+	return done;
+}
+
+namespace
+{
+	// Encodes pcm, decodes it again and compares; returns encoded bytes, or 0 on mismatch.
+	std::uint64_t roundTrip(const std::vector<std::int32_t>& pcm, int numChannels, unsigned int rate, int bps, int level,
+		int threads, const std::string& path, double* encodeSeconds, double* decodeSeconds)
+	{
+		using Clock = std::chrono::steady_clock;
+		const unsigned int frames = static_cast<unsigned int>(pcm.size() / numChannels);
+
+		auto start = Clock::now();
+		std::uint64_t bytes = 0;
+		{
+			FlacWriter writer(path, numChannels, rate, bps, level, threads);
+			// Feed in capture-sized pieces, as a recorder would
+			for (unsigned int offset = 0; offset < frames; offset += 480) {
+				writer.write(pcm.data() + static_cast<std::size_t>(offset) * numChannels, std::min(480u, frames - offset));
+			}
+			writer.close();
+			bytes = std::filesystem::file_size(path);
+		}
+		if (encodeSeconds) *encodeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		start = Clock::now();
+		FlacReader reader(path);
+		std::vector<std::int32_t> decoded(pcm.size() + numChannels);
+		const unsigned int got = reader.readPcm(decoded.data(), frames + 1);
+		if (decodeSeconds) *decodeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		const bool same = got == frames && reader.totalFrames() == frames && reader.bitsPerSample() == bps
+			&& std::equal(pcm.begin(), pcm.end(), decoded.begin());
+		return same ? bytes : 0;
+	}
+}
+
+void BenchmarkFlac(const std::string& wavPath, int threads)
+{
+	WavReader reader(wavPath);
+	const AudioFormat format = reader.format();
+
+	// 16-bit PCM as CaptureAudio records it
+	std::vector<std::int32_t> pcm(static_cast<std::size_t>(reader.totalFrames()) * format.channels);
+	std::vector<float> buffer(static_cast<std::size_t>(format.sampleRate) * format.channels);
+	std::size_t filled = 0;
+	while (const unsigned int frames = reader.read(buffer.data(), format.sampleRate)) {
+		for (std::size_t i = 0; i < static_cast<std::size_t>(frames) * format.channels; ++i) {
+			pcm[filled++] = static_cast<std::int32_t>(std::clamp(std::lround(buffer[i] * 32768.0f), -32768l, 32767l));
+		}
+	}
+	pcm.resize(filled);
+
+	const double audioSeconds = static_cast<double>(filled / format.channels) / format.sampleRate;
+	const double wavBytes = static_cast<double>(filled) * 2 + 44;
+	const std::string path = wavPath + ".bench.flac";
+
+	std::cout << "FLAC de " << wavPath << ": " << audioSeconds << " s, " << format.channels << " canais, "
+		<< (threads > 0 ? threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1)) << " threads\n";
+	for (const int level : { 0, 2, 5, 8 }) {
+		double encodeSeconds = 0.0;
+		double decodeSeconds = 0.0;
+		const std::uint64_t bytes = roundTrip(pcm, format.channels, format.sampleRate, 16, level, threads, path, &encodeSeconds, &decodeSeconds);
+		std::cout << "  nivel " << level << ": ";
+		if (bytes == 0) {
+			std::cout << "ERRO: decodificacao difere da entrada\n";
+			continue;
+		}
+		std::cout << "razao " << 100.0 * bytes / wavBytes << "% do WAV, codificacao " << audioSeconds / encodeSeconds
+			<< "x tempo real (" << wavBytes / encodeSeconds / 1e6 << " MB/s), decodificacao " << audioSeconds / decodeSeconds
+			<< "x tempo real, identico\n";
+	}
+	std::filesystem::remove(path);
+}
+
+bool CheckFlacRoundTrip(int threads)
+{
+	struct Case
+	{
+		const char* name;
+		int channels;
+		int bps;
+		unsigned int frames;
+		int level;
+	};
+	const Case cases[] = {
+		{ "silencio estereo", 2, 16, 10000, 5 },
+		{ "ruido em escala cheia", 2, 16, 3 * FlacWriter::BlockFrames + 17, 5 },
+		{ "um quadro mono", 1, 16, 1, 5 },
+		{ "L = R", 2, 16, 9000, 2 },
+		{ "7.1 em 24 bits", 8, 24, 20000, 8 },
+		{ "tons, nivel 0", 2, 16, 50000, 0 },
+		{ "tons, nivel 8", 2, 16, 50000, 8 },
+		{ "blocos exatos", 6, 16, 4 * FlacWriter::BlockFrames, 3 },
+	};
+
+	const std::string path = (std::filesystem::temp_directory_path() / "avis-flac-check.flac").string();
+	std::uint32_t state = 12345;
+	auto noise = [&state] {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+
+	bool ok = true;
+	for (const Case& c : cases) {
+		const std::int32_t top = (1 << (c.bps - 1)) - 1;
+		std::vector<std::int32_t> pcm(static_cast<std::size_t>(c.frames) * c.channels);
+		for (unsigned int i = 0; i < c.frames; ++i) {
+			for (int ch = 0; ch < c.channels; ++ch) {
+				std::int32_t& v = pcm[static_cast<std::size_t>(i) * c.channels + ch];
+				if (std::strncmp(c.name, "silencio", 8) == 0) v = 0;
+				else if (std::strncmp(c.name, "ruido", 5) == 0) v = static_cast<std::int32_t>(noise() % (2u * top + 2)) - top - 1;
+				else if (std::strncmp(c.name, "L = R", 5) == 0) v = ch == 0 ? static_cast<std::int32_t>(noise() % 2001) - 1000 : pcm[static_cast<std::size_t>(i) * c.channels];
+				else {
+					const double tone = std::sin(i * 0.01 * (ch + 1)) * 0.6 + std::sin(i * 0.37) * 0.1;
+					v = static_cast<std::int32_t>(tone * top) + static_cast<std::int32_t>(noise() % 65) - 32;
+				}
+				v = std::clamp(v, -top - 1, top);
+			}
+		}
+
+		// Extremes in the first frames catch sign and bit-width mistakes
+		if (c.frames > 2) {
+			pcm[0] = top;
+			pcm[c.channels] = -top - 1;
+		}
+
+		const std::uint64_t bytes = roundTrip(pcm, c.channels, 48000, c.bps, c.level, threads, path, nullptr, nullptr);
+		const double rawBytes = static_cast<double>(pcm.size()) * c.bps / 8;
+		std::cout << "  " << c.name << ": " << (bytes ? "ok" : "FALHOU");
+		if (bytes) std::cout << " (" << 100.0 * bytes / rawBytes << "% do PCM)";
+		std::cout << '\n';
+		ok = ok && bytes != 0;
+	}
+	std::filesystem::remove(path);
+	std::cout << (ok ? "Ida e volta FLAC identica\n" : "Ida e volta FLAC com diferencas\n");
+	return ok;
+}
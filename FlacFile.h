@@ -0,0 +1,144 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CaptureSource.h"
+
+// Streaming FLAC (16/24-bit, 1-8 channels, fixed 4096-frame blocks).
+//
+// Every FLAC frame is independent, so FlacWriter only gathers samples into block
+// buffers on the calling thread and hands full blocks to a pool of encoder threads;
+// frames are written back in order as they complete. Blocks are reused from a fixed
+// pool, so a capture thread never allocates; it only waits when every block is still
+// queued for encoding (counted in stalls()).
+//
+// Encoder: per channel the cheapest of constant, verbatim, fixed predictors
+// (order 0-4) and, from level 3, LPC (Tukey window, Levinson-Durbin, quantized
+// coefficients); stereo picks the cheapest of L/R, L/S, R/S and M/S; residuals are
+// partitioned Rice codes. The STREAMINFO MD5 is left zero ("not computed").
+
+struct FlacLevel
+{
+	int maxFixedOrder;
+	int maxLpcOrder;        // 0 = fixed predictors only
+	int lpcPrecision;       // bits per quantized coefficient
+	bool exhaustiveLpc;     // encode every LPC order instead of the estimated best
+	int maxPartitionOrder;
+	bool stereoDecorrelation;
+};
+
+// Levels 0 (fastest) to 8 (smallest), modelled on the reference encoder's presets.
+FlacLevel GetFlacLevel(int level);
+
+class FlacWriter
+{
+public:
+	FlacWriter(const std::string& path, int numChannels, unsigned int sampleRate, int bitsPerSample = 16,
+		int level = 5, int threads = 0);
+	~FlacWriter();
+
+	FlacWriter(const FlacWriter&) = delete;
+	FlacWriter& operator=(const FlacWriter&) = delete;
+
+	// Float input is converted like RecordingWriter (clamped, * 32767 for 16-bit).
+	void write(const float* samples, unsigned int frameCount);
+	void write(const std::int16_t* samples, unsigned int frameCount);
+	// Samples already in [-2^(bps-1), 2^(bps-1)).
+	void write(const std::int32_t* samples, unsigned int frameCount);
+	// Encodes the last partial block, waits for the pool and fixes up STREAMINFO.
+	void close();
+
+	std::uint64_t framesWritten() const { return totalFrames; }
+	std::uint64_t bytesWritten() const { return totalBytes; }
+	std::uint64_t stalls() const { return stallCount; }
+
+	static constexpr unsigned int BlockFrames = 4096;
+
+private:
+	struct Block
+	{
+		std::vector<std::int32_t> samples; // interleaved
+		unsigned int frames = 0;
+		std::uint64_t number = 0;
+		std::vector<std::uint8_t> encoded;
+		bool done = false;
+	};
+
+	template <typename T, typename Convert>
+	void append(const T* samples, unsigned int frameCount, Convert convert);
+	void submit();
+	void acquire();
+	void workerLoop();
+	void writeStreamInfo();
+
+	std::ofstream file;
+	int numChannels;
+	unsigned int sampleRate;
+	int bitsPerSample;
+	FlacLevel level;
+	bool closed = false;
+
+	std::vector<Block> blocks;
+	Block* current = nullptr;
+	std::uint64_t nextNumber = 0;
+	std::uint64_t totalFrames = 0;
+	std::uint64_t totalBytes = 0;
+	std::uint64_t stallCount = 0;
+	std::uint32_t minFrameBytes = 0;
+	std::uint32_t maxFrameBytes = 0;
+
+	std::mutex mutex;
+	std::condition_variable queued;    // work for the encoders
+	std::condition_variable released;  // a block came back to the free list
+	std::deque<Block*> work;
+	std::deque<Block*> pending;        // submitted, in stream order, until handed to the writer
+	std::vector<Block*> freeList;      // reserved for every block
+	bool writing = false;              // a worker is writing finished blocks to the file
+	bool stopping = false;
+	std::vector<std::thread> workers;
+};
+
+// Decodes FLAC streams with the features FlacWriter uses (and the rest of the
+// subset: variable block sizes, escape-coded partitions, wasted bits). Frame CRCs
+// are checked; a mismatch throws.
+class FlacReader
+{
+public:
+	explicit FlacReader(const std::string& path);
+
+	AudioFormat format() const { return audioFormat; }
+	int bitsPerSample() const { return bps; }
+	std::uint64_t totalFrames() const { return streamFrames; }
+
+	// Interleaved samples in their native integer range; returns frames read (0 at end).
+	unsigned int readPcm(std::int32_t* out, unsigned int frameCount);
+	// Same, scaled to float in [-1, 1].
+	unsigned int read(float* out, unsigned int frameCount);
+
+private:
+	bool decodeFrame();
+
+	std::ifstream file;
+	AudioFormat audioFormat;
+	int bps = 0;
+	std::uint64_t streamFrames = 0;
+	std::vector<std::uint8_t> raw;      // undecoded bytes from the file
+	std::size_t rawPosition = 0;
+	std::vector<std::int32_t> decoded;  // interleaved, current frame
+	std::size_t decodedPosition = 0;
+	std::vector<std::int32_t> scratch;
+};
+
+// Encodes a WAV at several levels and reports ratio and throughput; every result is
+// decoded again and compared sample by sample.
+void BenchmarkFlac(const std::string& wavPath, int threads);
+// Round trip over synthetic edge cases (silence, full-scale noise, 24-bit, 8 channels,
+// partial last block) with the given encoder thread count (0 = hardware threads).
+// Returns false on any mismatch.
+bool CheckFlacRoundTrip(int threads);
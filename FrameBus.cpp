@@ -0,0 +1,253 @@
+#include "FrameBus.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Trace.h"
+
+FrameRef::FrameRef(FrameBlock* block)
+	: block(block)
+{
+	if (block) block->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameRef::FrameRef(const FrameRef& other)
+	: FrameRef(other.block)
+{
+}
+
+FrameRef::FrameRef(FrameRef&& other) noexcept
+	: block(other.block)
+{
+	other.block = nullptr;
+}
+
+FrameRef& FrameRef::operator=(FrameRef other) noexcept
+{
+	std::swap(block, other.block);
+	return *this;
+}
+
+FrameRef::~FrameRef()
+{
+	reset();
+}
+
+void FrameRef::reset()
+{
+	if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		block->pool->release(block);
+	}
+	block = nullptr;
+}
+
+FrameBlockPool::FrameBlockPool(std::size_t blockCount, std::size_t samplesPerBlock)
+	: blocks(std::make_unique<FrameBlock[]>(blockCount)), slab(blockCount * samplesPerBlock)
+{
+	freeList.reserve(blockCount);
+	for (std::size_t i = 0; i < blockCount; ++i) {
+		FrameBlock& block = blocks[i];
+		block.samples = slab.data() + i * samplesPerBlock;
+		block.capacity = samplesPerBlock;
+		block.pool = this;
+		freeList.push_back(&block);
+	}
+}
+
+FrameRef FrameBlockPool::acquire()
+{
+	FrameBlock* block = nullptr;
+	{
+		std::lock_guard lock(mutex);
+		if (freeList.empty()) return {};
+		block = freeList.back();
+		freeList.pop_back();
+	}
+	return FrameRef(block);
+}
+
+std::size_t FrameBlockPool::available() const
+{
+	std::lock_guard lock(mutex);
+	return freeList.size();
+}
+
+void FrameBlockPool::release(FrameBlock* block)
+{
+	std::lock_guard lock(mutex);
+	freeList.push_back(block); // never reallocates: reserved for every block
+}
+
+FrameSubscription::FrameSubscription(std::size_t capacity, OverflowPolicy policy, std::chrono::milliseconds blockTimeout)
+	: ring(std::max<std::size_t>(capacity, 1)), policy(policy), blockTimeout(blockTimeout)
+{
+}
+
+void FrameSubscription::push(const FrameRef& block)
+{
+	FrameRef evicted; // released outside the lock
+	{
+		std::unique_lock lock(mutex);
+		if (closed) return;
+
+		if (size == ring.size()) {
+			if (policy == OverflowPolicy::Block) {
+				notFull.wait_for(lock, blockTimeout, [this] { return size < ring.size() || closed; });
+			}
+			if (closed) return;
+
+			if (size == ring.size()) {
+				droppedCount.fetch_add(1, std::memory_order_relaxed);
+				if (policy != OverflowPolicy::DropOldest) return;
+
+				evicted = std::move(ring[head]);
+				head = (head + 1) % ring.size();
+				--size;
+			}
+		}
+
+		ring[(head + size) % ring.size()] = block;
+		++size;
+	}
+	notEmpty.notify_one();
+}
+
+bool FrameSubscription::pop(FrameRef& out, std::chrono::milliseconds timeout)
+{
+	{
+		std::unique_lock lock(mutex);
+		if (!notEmpty.wait_for(lock, timeout, [this] { return size > 0 || closed; }) || size == 0) {
+			return false;
+		}
+
+		out = std::move(ring[head]);
+		head = (head + 1) % ring.size();
+		--size;
+	}
+	deliveredCount.fetch_add(1, std::memory_order_relaxed);
+	notFull.notify_one();
+	return true;
+}
+
+bool FrameSubscription::isClosed() const
+{
+	std::lock_guard lock(mutex);
+	return closed && size == 0;
+}
+
+void FrameSubscription::close()
+{
+	{
+		std::lock_guard lock(mutex);
+		closed = true;
+	}
+	notEmpty.notify_all();
+	notFull.notify_all();
+}
+
+FrameBus::FrameBus(AudioFormat format, unsigned int maxFramesPerBlock, std::size_t poolBlocks)
+	: audioFormat(format), maxFramesPerBlock(maxFramesPerBlock),
+	pool(poolBlocks, static_cast<std::size_t>(maxFramesPerBlock) * format.channels)
+{
+	if (format.channels <= 0 || maxFramesPerBlock == 0) {
+		throw std::runtime_error("Formato invalido para o barramento de captura");
+	}
+}
+
+std::shared_ptr<FrameSubscription> FrameBus::subscribe(std::size_t capacity, OverflowPolicy policy,
+	std::chrono::milliseconds blockTimeout)
+{
+	auto subscription = std::make_shared<FrameSubscription>(capacity, policy, blockTimeout);
+	std::lock_guard lock(mutex);
+	subscribers.push_back(subscription);
+	return subscription;
+}
+
+void FrameBus::publish(const CapturePacket& packet)
+{
+	AVIS_TRACE_SCOPE("barramento");
+	const auto numChannels = static_cast<std::size_t>(audioFormat.channels);
+	// Integer PCM and planar input are converted here, once, so every subscriber gets interleaved float blocks
+	const bool planar = !packet.samples && packet.planes;
+	const bool pcm = !packet.samples && !planar && packet.pcm;
+	const bool silent = packet.silent || (!packet.samples && !planar && !pcm);
+
+	for (unsigned int offset = 0; offset < packet.frameCount; offset += maxFramesPerBlock) {
+		const unsigned int frames = std::min(maxFramesPerBlock, packet.frameCount - offset);
+
+		FrameRef ref = pool.acquire();
+		if (!ref) {
+			// Every block is held by lagging subscribers; losing this packet is the bounded outcome
+			exhaustedCount.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		FrameBlock* block = ref.block;
+		const std::size_t count = frames * numChannels;
+		if (silent) {
+			std::fill(block->samples, block->samples + count, 0.0f);
+		} else if (planar) {
+			float* out = block->samples;
+			for (unsigned int i = 0; i < frames; ++i) {
+				for (std::size_t ch = 0; ch < numChannels; ++ch) *out++ = packet.planes[ch][offset + i];
+			}
+		} else if (pcm) {
+			const std::size_t first = offset * numChannels;
+			for (std::size_t i = 0; i < count; ++i) {
+				block->samples[i] = LoadPcmSample(packet.pcm, packet.pcmEncoding, first + i) / 2147483648.0f;
+			}
+		} else {
+			std::copy(packet.samples + offset * numChannels, packet.samples + offset * numChannels + count, block->samples);
+		}
+		block->frameCount = frames;
+		block->silent = silent;
+		block->timestampUs = packet.timestampUs + static_cast<std::uint64_t>(offset) * 1000000ull / audioFormat.sampleRate;
+		block->readyNs = packet.readyNs;
+
+		// Non-blocking subscribers first, so a Block subscriber's wait cannot delay them
+		std::lock_guard lock(mutex);
+		for (const auto& subscriber : subscribers) {
+			if (subscriber->policy != OverflowPolicy::Block) subscriber->push(ref);
+		}
+		for (const auto& subscriber : subscribers) {
+			if (subscriber->policy == OverflowPolicy::Block) subscriber->push(ref);
+		}
+	}
+}
+
+void FrameBus::close()
+{
+	std::lock_guard lock(mutex);
+	for (const auto& subscriber : subscribers) {
+		subscriber->close();
+	}
+}
+
+void PumpSource(CaptureSource& source, FrameBus& bus, const std::atomic<bool>& stop)
+{
+	CapturePacket packet;
+	while (!stop.load(std::memory_order_relaxed) && source.nextPacket(packet)) {
+		bus.publish(packet);
+	}
+	bus.close();
+}
+
+SubscriptionSource::SubscriptionSource(std::shared_ptr<FrameSubscription> subscription, AudioFormat format)
+	: subscription(std::move(subscription)), audioFormat(format)
+{
+}
+
+bool SubscriptionSource::nextPacket(CapturePacket& packet)
+{
+	current.reset();
+	while (!subscription->pop(current)) {
+		if (subscription->isClosed()) return false;
+	}
+
+	packet.samples = current->samples;
+	packet.frameCount = current->frameCount;
+	packet.silent = current->silent;
+	packet.timestampUs = current->timestampUs;
+	packet.readyNs = current->readyNs;
+	return true;
+}
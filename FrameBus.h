@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CaptureSource.h"
+
+class FrameBlockPool;
+
+// One captured packet in pooled storage. Blocks are shared read-only between
+// consumers through FrameRef and go back to the pool when the last ref drops.
+struct FrameBlock
+{
+	float* samples = nullptr;   // interleaved, points into the pool's slab
+	std::size_t capacity = 0;   // in samples
+	unsigned int frameCount = 0;
+	bool silent = false;
+	std::uint64_t timestampUs = 0;
+	std::uint64_t readyNs = 0;
+
+private:
+	friend class FrameRef;
+	friend class FrameBlockPool;
+	std::atomic<int> refs{ 0 };
+	FrameBlockPool* pool = nullptr;
+};
+
+class FrameRef
+{
+public:
+	FrameRef() = default;
+	FrameRef(const FrameRef& other);
+	FrameRef(FrameRef&& other) noexcept;
+	FrameRef& operator=(FrameRef other) noexcept;
+	~FrameRef();
+
+	void reset();
+	explicit operator bool() const { return block != nullptr; }
+	const FrameBlock* operator->() const { return block; }
+	const FrameBlock& operator*() const { return *block; }
+
+private:
+	friend class FrameBlockPool;
+	friend class FrameBus;
+	explicit FrameRef(FrameBlock* block);
+
+	FrameBlock* block = nullptr;
+};
+
+// Fixed set of blocks whose sample storage is carved from one slab allocated at
+// construction, so acquire/release never touch the heap.
+class FrameBlockPool
+{
+public:
+	FrameBlockPool(std::size_t blockCount, std::size_t samplesPerBlock);
+
+	// Returns an empty ref when every block is in use.
+	FrameRef acquire();
+	std::size_t available() const;
+
+private:
+	friend class FrameRef;
+	void release(FrameBlock* block);
+
+	std::unique_ptr<FrameBlock[]> blocks;
+	std::vector<float> slab;
+	std::vector<FrameBlock*> freeList;
+	mutable std::mutex mutex;
+};
+
+enum class OverflowPolicy : std::uint8_t
+{
+	DropNewest, // keep what is queued, discard the incoming block
+	DropOldest, // discard the oldest queued block to make room
+	Block       // wait up to blockTimeout for room, then drop the incoming block; this stalls
+	            // publish(), so only for sources that can wait (files, simulations), never a device
+};
+
+// Bounded per-consumer queue of shared blocks.
+class FrameSubscription
+{
+public:
+	FrameSubscription(std::size_t capacity, OverflowPolicy policy, std::chrono::milliseconds blockTimeout);
+
+	// Returns false on timeout, or once the bus is closed and the queue drained.
+	bool pop(FrameRef& out, std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
+	bool isClosed() const;
+
+	std::uint64_t delivered() const { return deliveredCount; }
+	std::uint64_t dropped() const { return droppedCount; }
+
+private:
+	friend class FrameBus;
+	void push(const FrameRef& block);
+	void close();
+
+	std::vector<FrameRef> ring;
+	std::size_t head = 0;
+	std::size_t size = 0;
+	OverflowPolicy policy;
+	std::chrono::milliseconds blockTimeout;
+	bool closed = false;
+
+	mutable std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::atomic<std::uint64_t> deliveredCount{ 0 };
+	std::atomic<std::uint64_t> droppedCount{ 0 };
+};
+
+// Fan-out of a single capture: each packet is copied once into a pooled block and
+// the same block is queued for every subscriber. A slow subscriber only loses its
+// own blocks (per its OverflowPolicy); the others keep receiving.
+class FrameBus
+{
+public:
+	FrameBus(AudioFormat format, unsigned int maxFramesPerBlock, std::size_t poolBlocks);
+
+	std::shared_ptr<FrameSubscription> subscribe(std::size_t capacity, OverflowPolicy policy,
+		std::chrono::milliseconds blockTimeout = std::chrono::milliseconds(20));
+
+	// Packets longer than maxFramesPerBlock are split over several blocks. Integer PCM
+	// packets are converted to float on the way in, so blocks are always float.
+	void publish(const CapturePacket& packet);
+	void close();
+
+	AudioFormat format() const { return audioFormat; }
+	std::uint64_t poolExhausted() const { return exhaustedCount; }
+
+private:
+	AudioFormat audioFormat;
+	unsigned int maxFramesPerBlock;
+	FrameBlockPool pool;
+	std::vector<std::shared_ptr<FrameSubscription>> subscribers;
+	std::mutex mutex;
+	std::atomic<std::uint64_t> exhaustedCount{ 0 };
+};
+
+// Pumps source into bus until the source ends or stop is set, then closes the bus.
+void PumpSource(CaptureSource& source, FrameBus& bus, const std::atomic<bool>& stop);
+
+// Adapts a subscription back into a CaptureSource, e.g. to feed DirectionPipeline.
+// The current block stays referenced until the next call.
+class SubscriptionSource : public CaptureSource
+{
+public:
+	SubscriptionSource(std::shared_ptr<FrameSubscription> subscription, AudioFormat format);
+
+	AudioFormat format() const override { return audioFormat; }
+	bool nextPacket(CapturePacket& packet) override;
+
+private:
+	std::shared_ptr<FrameSubscription> subscription;
+	AudioFormat audioFormat;
+	FrameRef current;
+};
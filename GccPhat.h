@@ -0,0 +1,94 @@
+#pragma once
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "Direction.h"
+
+class FftPlan;
+
+struct DelayEstimate
+{
+	bool valid = false;
+	float delaySamples = 0.0f; // > 0: left lags right, i.e. the source is on the right
+	float azimuth = 0.0f;      // degrees, same convention as DirectionState
+	float confidence = 0.0f;   // height of the normalized GCC-PHAT peak, 0..1
+};
+
+// Receives the left and right spectra (frameSize / 2 + 1 non-negative bins, Hann
+// windowed) of every frame a GccPhatEstimator transforms, so other stereo cues can
+// share its FFT instead of running their own.
+class StereoSpectrumSink
+{
+public:
+	virtual ~StereoSpectrumSink() = default;
+	virtual void onSpectra(const std::complex<float>* left, const std::complex<float>* right, unsigned int frameSize) = 0;
+};
+
+// Streaming GCC-PHAT time-difference-of-arrival estimator for stereo input.
+// Frames of frameSize samples overlap by frameSize - hop; each frame's
+// phase-transformed cross-spectrum is averaged over time, and the peak of its
+// inverse transform within +/- maxDelaySec gives the delay, refined to a
+// fraction of a sample by parabolic interpolation.
+class GccPhatEstimator
+{
+public:
+	// hop 0 means 50% overlap. maxDelaySec is the largest physical delay (ear or
+	// microphone spacing / speed of sound) and maps to +/-90 degrees.
+	GccPhatEstimator(unsigned int sampleRate, unsigned int frameSize = 1024, unsigned int hop = 0,
+		float maxDelaySec = 0.00066f);
+
+	// Feeds interleaved samples (the first two channels are used). Returns true
+	// when at least one new estimate was produced. Does not allocate. With analyze
+	// false the history advances without transforming, for cheap gated stretches.
+	bool push(const float* samples, unsigned int frameCount, int numChannels, bool analyze = true);
+	// Same, from separate left and right buffers.
+	bool pushPlanar(const float* leftSamples, const float* rightSamples, unsigned int frameCount, bool analyze = true);
+	void reset();
+	// Restricts the phase transform to bins up to maxHz (0 = the whole band): cheaper,
+	// and still enough for the inter-channel delay of a broadband source.
+	void setMaxFrequency(float maxHz);
+	// Also hands every transformed frame's spectra to sink (null detaches); the sink
+	// must outlive the estimator or be detached first.
+	void setSpectrumSink(StereoSpectrumSink* sink) { spectrumSink = sink; }
+
+	const DelayEstimate& estimate() const { return current; }
+	unsigned int frameSize() const { return size; }
+	unsigned int hopSize() const { return hop; }
+	std::uint64_t framesAnalyzed() const { return analyzed; }
+
+private:
+	bool pushStrided(const float* leftSamples, const float* rightSamples, std::size_t stride, unsigned int frameCount, bool analyze);
+	void analyzeFrame();
+
+	unsigned int size;
+	unsigned int hop;
+	unsigned int sampleRate;
+	unsigned int bandBins;                 // bins that go through the phase transform
+	int maxLag;
+	float smoothing = 0.5f;
+	const FftPlan& plan;
+	StereoSpectrumSink* spectrumSink = nullptr;
+
+	std::vector<float> window;
+	std::vector<float> left, right;        // last frameSize input samples
+	std::vector<float> windowedLeft, windowedRight;
+	std::vector<std::complex<float>> scratch, spectrumLeft, spectrumRight;
+	std::vector<std::complex<float>> averaged; // smoothed PHAT cross-spectrum, non-negative bins
+	std::vector<std::complex<float>> correlation;
+	unsigned int filled = 0;
+	unsigned int sinceLast = 0;
+	bool primed = false;
+	std::uint64_t analyzed = 0;
+
+	DelayEstimate current;
+};
+
+// Combines the level cue with the delay cue into one azimuth, each weighted by its
+// confidence. The direction is re-derived from the fused azimuth; without a usable
+// delay estimate (or with a zero-lag peak) the level state is returned unchanged.
+DirectionState FuseStereoCues(const DirectionState& level, const DelayEstimate& delay);
+
+// Runs the estimator on a band-limited stereo source with a known fractional delay
+// at several frame sizes and prints cost (share of one core at 48 kHz) and error.
+void BenchmarkGccPhat(double durationSec);
@@ -0,0 +1,157 @@
+#include "HardwareCounters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <utility>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr int KindCount = static_cast<int>(CounterKind::Count);
+	const char* const KindNames[KindCount] = { "ns de CPU", "ciclos", "instrucoes", "falhas de cache", "falhas de desvio" };
+	const char* const StageNames[] = { "captura/conversao", "analise", "publicacao" };
+
+#ifdef __linux__
+	int openCounter(std::uint32_t type, std::uint64_t config, int groupFd)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = groupFd < 0 ? 1 : 0;
+		// User space only: perf_event_paranoid 2 (the common default) refuses kernel counting
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+	}
+#endif
+}
+
+HardwareCounters::HardwareCounters()
+{
+	for (int i = 0; i < KindCount; ++i) {
+		fds[i] = -1;
+		slot[i] = -1;
+	}
+
+#ifdef __linux__
+	const std::pair<std::uint32_t, std::uint64_t> events[KindCount] = {
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	int leader = -1;
+	for (int i = 0; i < KindCount; ++i) {
+		const int fd = openCounter(events[i].first, events[i].second, leader);
+		if (fd < 0) {
+			reason += (reason.empty() ? "" : ", ") + std::string(KindNames[i]) + ": " + std::strerror(errno);
+			if (leader < 0) break;
+			continue;
+		}
+		if (leader < 0) leader = fd;
+		fds[i] = fd;
+		slot[i] = opened++;
+	}
+
+	if (leader >= 0) {
+		ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#else
+	reason = "perf_event_open indisponivel nesta plataforma";
+#endif
+}
+
+HardwareCounters::~HardwareCounters()
+{
+#ifdef __linux__
+	for (const int fd : fds) {
+		if (fd >= 0) close(fd);
+	}
+#endif
+}
+
+bool HardwareCounters::read(std::uint64_t* values) const
+{
+	std::fill(values, values + KindCount, 0);
+	if (opened == 0) return false;
+
+#ifdef __linux__
+	// nr, time_enabled, time_running, then one value per group member
+	std::uint64_t buffer[3 + KindCount];
+	const int leader = fds[static_cast<int>(CounterKind::TaskClock)];
+	if (::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened) * sizeof(std::uint64_t))) return false;
+
+	const double scale = buffer[2] > 0 && buffer[2] < buffer[1] ? static_cast<double>(buffer[1]) / buffer[2] : 1.0;
+	for (int i = 0; i < KindCount; ++i) {
+		if (slot[i] >= 0) values[i] = static_cast<std::uint64_t>(buffer[3 + slot[i]] * scale);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void StageCounters::restart()
+{
+	counters.read(last);
+}
+
+void StageCounters::mark(PipelineStage stage, unsigned int frames)
+{
+	std::uint64_t now[KindCount];
+	if (!counters.read(now)) return;
+
+	Totals& t = totals[static_cast<int>(stage)];
+	for (int i = 0; i < KindCount; ++i) {
+		t.values[i] += now[i] - last[i];
+		last[i] = now[i];
+	}
+	++t.packets;
+	t.frames += frames;
+}
+
+void StageCounters::print(std::ostream& out) const
+{
+	if (!counters.available()) {
+		out << "  contadores de hardware indisponiveis (" << counters.status() << ")\n";
+		return;
+	}
+	if (!counters.status().empty()) {
+		out << "  contadores ausentes: " << counters.status() << '\n';
+	}
+
+	const auto flags = out.flags();
+	out << std::fixed << std::setprecision(2);
+	for (int s = 0; s < static_cast<int>(PipelineStage::Count); ++s) {
+		const Totals& t = totals[s];
+		if (t.packets == 0) continue;
+
+		const double packets = static_cast<double>(t.packets);
+		const double frames = static_cast<double>(std::max<std::uint64_t>(t.frames, 1));
+		out << "  " << StageNames[s] << " (" << t.packets << " pacotes):";
+		for (int i = 0; i < KindCount; ++i) {
+			if (!counters.has(static_cast<CounterKind>(i))) continue;
+			out << ' ' << KindNames[i] << ' ' << t.values[i] / packets << "/pacote " << t.values[i] / frames << "/quadro;";
+		}
+		if (counters.has(CounterKind::Cycles) && counters.has(CounterKind::Instructions) && t.values[1] > 0) {
+			out << " IPC " << static_cast<double>(t.values[2]) / t.values[1];
+		}
+		out << '\n';
+	}
+	out.flags(flags);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+enum class CounterKind : std::uint8_t
+{
+	TaskClock,    // ns on CPU (software counter, the fallback when the PMU is hidden)
+	Cycles,
+	Instructions,
+	CacheMisses,
+	BranchMisses,
+	Count
+};
+
+// One perf_event_open group (user space only) on the calling thread: task clock as
+// leader, hardware counters as members. Whatever the kernel refuses is left out,
+// so in containers and VMs without a virtual PMU the group degrades to the task
+// clock, and where perf_event_open is missing entirely (non-Linux) to nothing.
+class HardwareCounters
+{
+public:
+	HardwareCounters();
+	~HardwareCounters();
+
+	HardwareCounters(const HardwareCounters&) = delete;
+	HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+	bool available() const { return opened > 0; }
+	bool has(CounterKind kind) const { return slot[static_cast<int>(kind)] >= 0; }
+	// Why counters are missing, empty when all are open.
+	const std::string& status() const { return reason; }
+
+	// Running totals (scaled when the kernel multiplexed the group); missing counters read 0.
+	bool read(std::uint64_t* values) const;
+
+private:
+	int fds[static_cast<int>(CounterKind::Count)];
+	int slot[static_cast<int>(CounterKind::Count)]; // position in the group read, -1 = missing
+	int opened = 0;
+	std::string reason;
+};
+
+enum class PipelineStage : std::uint8_t
+{
+	Capture,   // source.nextPacket(): device read and sample conversion
+	Analysis,  // level analysis, delay estimation, multi-source
+	Publish,   // overlay atomic, shared memory, event stream, timeline
+	Count
+};
+
+// Per-stage counter deltas. Call restart() before the first stage of a packet and
+// mark(stage) after each stage; every mark costs one read() of the group.
+class StageCounters
+{
+public:
+	StageCounters() = default;
+
+	bool available() const { return counters.available(); }
+	void restart();
+	void mark(PipelineStage stage, unsigned int frames);
+
+	// Per-packet and per-frame ratios for each stage.
+	void print(std::ostream& out) const;
+
+private:
+	struct Totals
+	{
+		std::uint64_t values[static_cast<int>(CounterKind::Count)] = {};
+		std::uint64_t packets = 0;
+		std::uint64_t frames = 0;
+	};
+
+	HardwareCounters counters;
+	std::uint64_t last[static_cast<int>(CounterKind::Count)] = {};
+	Totals totals[static_cast<int>(PipelineStage::Count)];
+};
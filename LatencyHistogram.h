@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+// Fixed-size log-linear histogram (32 sub-buckets per power of two, ~3% error).
+// Recording never allocates, so it is safe to use on the capture thread.
+class LatencyHistogram
+{
+public:
+	void record(std::uint64_t value)
+	{
+		++buckets[bucketOf(value)];
+		++count;
+		sum += value;
+		maxValue = std::max(maxValue, value);
+	}
+
+	void reset() { *this = LatencyHistogram(); }
+
+	std::uint64_t samples() const { return count; }
+	std::uint64_t max() const { return maxValue; }
+	double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+	// Upper bound of the bucket holding quantile q (0..1).
+	std::uint64_t percentile(double q) const
+	{
+		if (count == 0) return 0;
+		const auto target = static_cast<std::uint64_t>(q * (count - 1)) + 1;
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < buckets.size(); ++i) {
+			seen += buckets[i];
+			if (seen >= target) return std::min(upperBound(i), maxValue);
+		}
+		return maxValue;
+	}
+
+	void print(std::ostream& out, const char* unit) const
+	{
+		out << "n=" << count << " media=" << mean() << unit
+			<< " p50=" << percentile(0.50) << unit << " p90=" << percentile(0.90) << unit
+			<< " p99=" << percentile(0.99) << unit << " p99.9=" << percentile(0.999) << unit
+			<< " max=" << maxValue << unit << '\n';
+	}
+
+private:
+	static constexpr int SubBits = 5;
+	static constexpr int SubBuckets = 1 << SubBits;
+
+	static std::size_t bucketOf(std::uint64_t v)
+	{
+		if (v < SubBuckets) return static_cast<std::size_t>(v);
+		int msb = 63;
+		while ((v >> msb) == 0) --msb;
+		const auto sub = static_cast<std::size_t>((v >> (msb - SubBits)) - SubBuckets);
+		return SubBuckets + static_cast<std::size_t>(msb - SubBits) * SubBuckets + sub;
+	}
+
+	static std::uint64_t upperBound(std::size_t index)
+	{
+		if (index < SubBuckets) return index;
+		const int shift = static_cast<int>((index - SubBuckets) / SubBuckets);
+		const std::uint64_t sub = (index - SubBuckets) % SubBuckets;
+		return ((SubBuckets + sub + 1) << shift) - 1;
+	}
+
+	std::array<std::uint64_t, SubBuckets * (64 - SubBits + 1)> buckets{};
+	std::uint64_t count = 0;
+	std::uint64_t sum = 0;
+	std::uint64_t maxValue = 0;
+};
@@ -0,0 +1,229 @@
+#include "MirroredRing.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	std::size_t RoundUp(std::size_t value, std::size_t granularity)
+	{
+		return (value + granularity - 1) / granularity * granularity;
+	}
+}
+
+MirroredRingBuffer::MirroredRingBuffer(std::size_t minBytes, bool mapTwice)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	size = RoundUp(std::max<std::size_t>(minBytes, 1), info.dwAllocationGranularity);
+
+	HANDLE section = mapTwice ? CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size), nullptr) : nullptr;
+	if (section) {
+		// Find a free range twice the size, release it and map both views into it. Another
+		// thread may take the range in between, so try a few times.
+		for (int attempt = 0; attempt < 8 && !base; ++attempt) {
+			void* range = VirtualAlloc(nullptr, 2 * size, MEM_RESERVE, PAGE_NOACCESS);
+			if (!range) break;
+			VirtualFree(range, 0, MEM_RELEASE);
+			char* first = static_cast<char*>(MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, size, range));
+			char* second = first ? static_cast<char*>(MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, size, first + size)) : nullptr;
+			if (first && second) {
+				base = first;
+			} else if (first) {
+				UnmapViewOfFile(first);
+			}
+		}
+		// The views keep the section alive
+		CloseHandle(section);
+	}
+#else
+	const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	size = RoundUp(std::max<std::size_t>(minBytes, 1), page);
+
+#ifdef __linux__
+	const int fd = mapTwice ? memfd_create("avis-ring", MFD_CLOEXEC) : -1;
+	if (fd >= 0) {
+		if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+			// Reserve the whole range first so both mappings land next to each other
+			void* range = mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (range != MAP_FAILED) {
+				char* first = static_cast<char*>(range);
+				const bool mapped = mmap(first, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+					mmap(first + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+				if (mapped) base = first;
+				else munmap(range, 2 * size);
+			}
+		}
+		close(fd);
+	}
+#else
+	(void)mapTwice;
+#endif
+#endif
+
+	if (!base) {
+		fallback = true;
+		software.assign(2 * size, 0);
+		base = software.data();
+	}
+}
+
+MirroredRingBuffer::~MirroredRingBuffer()
+{
+	if (fallback) return;
+#ifdef _WIN32
+	UnmapViewOfFile(base + size);
+	UnmapViewOfFile(base);
+#else
+	munmap(base, 2 * size);
+#endif
+}
+
+void MirroredRingBuffer::syncMirror(std::size_t start, std::size_t bytes)
+{
+	// [start, size) was written in the first half and [size, start + bytes) in the
+	// second; each goes to its twin in the other half
+	const std::size_t end = start + bytes;
+	const std::size_t firstHalf = std::min(end, size);
+	if (firstHalf > start) std::memcpy(base + size + start, base + start, firstHalf - start);
+	if (end > size) std::memcpy(base, base + size, end - size);
+}
+
+FrameReframer::FrameReframer(int numChannels, unsigned int windowFrames, unsigned int hopFrames, bool mapTwice)
+	: channels(numChannels), frameBytes(static_cast<std::size_t>(numChannels) * sizeof(float)), window(windowFrames),
+	hop(hopFrames ? hopFrames : std::max(windowFrames / 2, 1u)),
+	// Room for a window plus a typical packet, so a push rarely has to stop for windows
+	ring((static_cast<std::size_t>(windowFrames) + 2048) * frameBytes, mapTwice),
+	capacityFrames(ring.capacity() / frameBytes)
+{
+	if (numChannels <= 0 || windowFrames == 0 || hop > windowFrames) {
+		throw std::runtime_error("Janela/salto invalidos para o reenquadrador");
+	}
+}
+
+namespace
+{
+	// What the ring replaces: a linear buffer compacted with memmove after every push
+	class CompactingReframer
+	{
+	public:
+		CompactingReframer(int numChannels, unsigned int windowFrames, unsigned int hopFrames)
+			: channels(numChannels), window(windowFrames), hop(hopFrames)
+		{
+		}
+
+		template <typename OnWindow>
+		void push(const float* samples, unsigned int frameCount, OnWindow&& onWindow)
+		{
+			buffer.insert(buffer.end(), samples, samples + static_cast<std::size_t>(frameCount) * channels);
+			std::size_t start = 0;
+			for (; buffer.size() / channels - start >= window; start += hop) {
+				onWindow(buffer.data() + start * channels, first + start);
+			}
+			buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(start * channels));
+			first += start;
+		}
+
+	private:
+		int channels;
+		unsigned int window;
+		unsigned int hop;
+		std::vector<float> buffer;
+		std::uint64_t first = 0;
+	};
+}
+
+bool BenchmarkReframer(double seconds)
+{
+	using Clock = std::chrono::steady_clock;
+	const int channelCounts[] = { 2, 6 };
+	const unsigned int windows[][2] = { { 1024, 512 }, { 2048, 480 }, { 4800, 4800 } };
+	const double slice = seconds / (std::size(channelCounts) * std::size(windows) * 3);
+	bool ok = true;
+
+	std::cout << "ns por janela, pacotes de 1 a 2048 quadros:\n";
+	for (const int channels : channelCounts) {
+		// Sizes drawn like a jittery device, so windows start anywhere in the packets
+		std::uint32_t random = 7;
+		std::vector<unsigned int> sizes(512);
+		for (auto& value : sizes) {
+			random = random * 1664525u + 1013904223u;
+			value = 1 + (random >> 8) % 2048;
+		}
+		std::vector<float> stream(static_cast<std::size_t>(2048) * channels * 4);
+		for (auto& x : stream) {
+			random = random * 1664525u + 1013904223u;
+			x = static_cast<float>(random >> 8) / 16777216.0f - 0.5f;
+		}
+
+		for (const auto& shape : windows) {
+			const unsigned int window = shape[0];
+			const unsigned int hop = shape[1];
+
+			// Checksum per window: position-weighted, so a shifted window does not cancel out
+			auto digest = [window, channels](const float* data) {
+				double sum = 0.0;
+				for (std::size_t i = 0; i < static_cast<std::size_t>(window) * channels; i += 7) sum += data[i] * static_cast<double>(i + 1);
+				return sum;
+			};
+
+			auto run = [&](auto& reframer, std::vector<double>* digests) {
+				std::uint64_t count = 0;
+				volatile float sink = 0.0f;
+				std::size_t packet = 0;
+				std::size_t offset = 0;
+				const auto start = Clock::now();
+				double elapsed = 0.0;
+				do {
+					for (int i = 0; i < 64; ++i, ++packet) {
+						const unsigned int frames = sizes[packet % sizes.size()];
+						offset = (offset + 131 * channels) % (stream.size() / 2);
+						reframer.push(stream.data() + offset, frames, [&](const float* data, std::uint64_t) {
+							if (digests) digests->push_back(digest(data));
+							else sink = sink + data[0] + data[static_cast<std::size_t>(window) * channels - 1];
+							++count;
+						});
+					}
+					elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+				} while (digests ? packet < 4096 : elapsed < slice);
+				return count ? elapsed * 1e9 / count : 0.0;
+			};
+
+			std::vector<double> expected, viaRing, viaSoftware;
+			{
+				CompactingReframer reference(channels, window, hop);
+				FrameReframer ring(channels, window, hop);
+				FrameReframer software(channels, window, hop, false);
+				run(reference, &expected);
+				run(ring, &viaRing);
+				run(software, &viaSoftware);
+			}
+			const bool same = expected == viaRing && expected == viaSoftware;
+			ok = ok && same;
+
+			CompactingReframer reference(channels, window, hop);
+			FrameReframer ring(channels, window, hop);
+			FrameReframer software(channels, window, hop, false);
+			const double compactNs = run(reference, nullptr);
+			const double ringNs = run(ring, nullptr);
+			const double softwareNs = run(software, nullptr);
+			std::cout << "  " << channels << " canais, janela " << window << " salto " << hop << ": memmove " << compactNs
+				<< ", anel espelhado " << ringNs << (ring.mirrored() ? "" : " (sem mapeamento duplo)")
+				<< ", espelho em software " << softwareNs << (same ? "" : "  JANELAS DIFERENTES") << '\n';
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Ring buffer whose storage is mapped twice, back to back, so the bytes at
+// [offset, offset + capacity()) are always one contiguous span whatever the offset:
+// a read or write that runs past the end lands at the start through the second
+// mapping, with no wraparound copy. Linux maps a memfd twice, Windows a pagefile
+// section (MapViewOfFileEx at a reserved address). Where neither works, a plain
+// buffer of twice the size is kept in sync by commit(), which costs one extra copy
+// per write but reads stay contiguous.
+class MirroredRingBuffer
+{
+public:
+	// capacity() is minBytes rounded up to the page (allocation granularity on Windows).
+	// mapTwice false goes straight to the software mirror, for comparison.
+	explicit MirroredRingBuffer(std::size_t minBytes, bool mapTwice = true);
+	~MirroredRingBuffer();
+
+	MirroredRingBuffer(const MirroredRingBuffer&) = delete;
+	MirroredRingBuffer& operator=(const MirroredRingBuffer&) = delete;
+
+	std::size_t capacity() const { return size; }
+	bool mirrored() const { return !fallback; }
+
+	// Start of the span at offset (taken modulo capacity); valid for capacity() bytes.
+	char* at(std::uint64_t offset) { return base + offset % size; }
+	const char* at(std::uint64_t offset) const { return base + offset % size; }
+
+	// Must follow every write through at(); a no-op when the mapping mirrors itself.
+	void commit(std::uint64_t offset, std::size_t bytes)
+	{
+		if (fallback) syncMirror(static_cast<std::size_t>(offset % size), bytes);
+	}
+
+	void write(std::uint64_t offset, const void* data, std::size_t bytes)
+	{
+		std::memcpy(at(offset), data, bytes);
+		commit(offset, bytes);
+	}
+
+private:
+	void syncMirror(std::size_t start, std::size_t bytes);
+
+	char* base = nullptr;
+	std::size_t size = 0;
+	bool fallback = false;
+	std::vector<char> software;
+};
+
+// Re-chunks packets of any size into fixed windows of windowFrames interleaved frames,
+// advancing by hopFrames, e.g. so the level analysis sees the same window whatever
+// numFramesAvailable WASAPI reported. Each window is handed out as a pointer into the
+// ring; nothing is copied besides writing the packet in once.
+class FrameReframer
+{
+public:
+	// hop 0 means 50% overlap; hop must not exceed the window.
+	FrameReframer(int numChannels, unsigned int windowFrames, unsigned int hopFrames = 0, bool mapTwice = true);
+
+	// Appends frameCount interleaved frames and calls onWindow(const float* window,
+	// std::uint64_t firstFrame) for every window completed on the way. The window stays
+	// valid until the next push.
+	template <typename OnWindow>
+	void push(const float* samples, unsigned int frameCount, OnWindow&& onWindow)
+	{
+		append(frameCount, onWindow, [&](float* out, unsigned int from, unsigned int count) {
+			std::memcpy(out, samples + static_cast<std::size_t>(from) * channels, static_cast<std::size_t>(count) * frameBytes);
+		});
+	}
+
+	// Same, from one buffer per channel (interleaved while writing into the ring).
+	template <typename OnWindow>
+	void pushPlanar(const float* const* planes, unsigned int frameCount, OnWindow&& onWindow)
+	{
+		append(frameCount, onWindow, [&](float* out, unsigned int from, unsigned int count) {
+			for (unsigned int i = 0; i < count; ++i) {
+				for (int ch = 0; ch < channels; ++ch) *out++ = planes[ch][from + i];
+			}
+		});
+	}
+
+	void reset() { written = next = 0; }
+
+	unsigned int windowSize() const { return window; }
+	unsigned int hopSize() const { return hop; }
+	std::uint64_t framesWritten() const { return written; }
+	bool mirrored() const { return ring.mirrored(); }
+
+private:
+	template <typename OnWindow, typename Copy>
+	void append(unsigned int frameCount, OnWindow& onWindow, Copy&& copy)
+	{
+		unsigned int done = 0;
+		while (done < frameCount) {
+			// Never overwrite frames the next window still needs
+			const std::uint64_t room = capacityFrames - (written - next);
+			const unsigned int take = static_cast<unsigned int>(std::min<std::uint64_t>(room, frameCount - done));
+			const std::uint64_t offset = written * frameBytes;
+			copy(reinterpret_cast<float*>(ring.at(offset)), done, take);
+			ring.commit(offset, static_cast<std::size_t>(take) * frameBytes);
+			written += take;
+			done += take;
+
+			for (; written - next >= window; next += hop) {
+				onWindow(reinterpret_cast<const float*>(ring.at(next * frameBytes)), next);
+			}
+		}
+	}
+
+	int channels;
+	std::size_t frameBytes;
+	unsigned int window;
+	unsigned int hop;
+	MirroredRingBuffer ring;
+	std::uint64_t capacityFrames;
+	std::uint64_t written = 0; // frames pushed so far
+	std::uint64_t next = 0;    // first frame of the next window
+};
+
+// Feeds packets of random sizes through the reframer (mirrored and software-mirrored)
+// and through a reframer that compacts a linear buffer with memmove, checks that all
+// three produce the same windows, and prints the cost per window. Returns false on a
+// mismatch.
+bool BenchmarkReframer(double seconds);
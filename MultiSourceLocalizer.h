@@ -0,0 +1,86 @@
+#pragma once
+#include <complex>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "CaptureSource.h"
+
+class FftPlan;
+
+struct SourceEstimate
+{
+	float azimuth = 0.0f; // degrees, 0 = front, negative = left
+	float weight = 0.0f;  // share of the histogram energy under this peak's bin
+};
+
+// Time-frequency localization of several simultaneous sources. Every STFT bin gets
+// its own direction from the per-channel magnitudes (speaker-vector sum, or the
+// level balance for stereo), and adds its energy to a decaying azimuth histogram
+// whose strongest peaks are reported as separate sources.
+class MultiSourceLocalizer
+{
+public:
+	static constexpr int MaxSources = 8;
+
+	// hop 0 means 50% overlap; histogramBins covers the full circle.
+	MultiSourceLocalizer(AudioFormat format, unsigned int fftSize = 1024, unsigned int hop = 0,
+		int histogramBins = 72, int maxSources = 4);
+
+	// Feeds interleaved samples. Returns true when at least one new frame was
+	// analyzed. Does not allocate. With analyze false the history advances without
+	// transforming, like GccPhatEstimator::push.
+	bool push(const float* samples, unsigned int frameCount, bool analyze = true);
+	void reset();
+	// Only bins up to maxHz (0 = the default 16 kHz) are measured and localized.
+	void setMaxFrequency(float maxHz);
+
+	// Strongest first.
+	int sourceCount() const { return foundCount; }
+	const SourceEstimate* sources() const { return found; }
+	const std::vector<float>& histogram() const { return smoothed; }
+
+	unsigned int fftSize() const { return size; }
+	unsigned int hopSize() const { return hop; }
+	std::uint64_t framesAnalyzed() const { return analyzed; }
+
+private:
+	void analyzeFrame();
+	void findPeaks();
+
+	AudioFormat audioFormat;
+	unsigned int size;
+	unsigned int hop;
+	unsigned int spectrumBins;
+	unsigned int firstBin, lastBin;
+	unsigned int bandLastBin;     // lastBin, or lower under setMaxFrequency()
+	int histogramBins;
+	int maxSources;
+	float decay = 0.8f;
+	const FftPlan& plan;
+
+	std::vector<float> window;
+	std::vector<float> history;   // channel-major, size samples per channel
+	std::vector<float> windowed;  // channel-major
+	std::vector<std::complex<float>> scratch, spectrumA, spectrumB;
+	std::vector<float> magnitude; // channel-major, spectrumBins per channel
+	std::vector<float> binX, binY, binPower, binAzimuth;
+	std::vector<float> speakerX, speakerY;
+	std::vector<float> accumulated, smoothed;
+
+	unsigned int filled = 0;
+	unsigned int sinceLast = 0;
+	std::uint64_t analyzed = 0;
+	SourceEstimate found[MaxSources];
+	int foundCount = 0;
+};
+
+// Offline: localizes a whole WAV file on several threads, each taking one
+// contiguous segment (with a warm-up pre-roll so the output matches a serial run),
+// and writes "time_s,rank,azimuth,weight" rows in time order.
+void AnalyzeSourcesInFile(const std::string& path, std::ostream& out, int threads, int maxSources);
+
+// Real-time factor on a generated scene, and how often each static source of the
+// scene is among the reported peaks.
+void BenchmarkMultiSource(const std::string& scene, int numChannels, double durationSec);
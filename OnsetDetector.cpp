@@ -0,0 +1,177 @@
+#include "OnsetDetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "DirectionPipeline.h"
+#include "SignalGenerator.h"
+
+namespace
+{
+	// Sum of squares with independent partial sums, so the loop vectorizes
+	// without relaxed floating-point flags.
+	double sumOfSquares(const float* x, std::size_t count)
+	{
+		float partial[8] = {};
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			for (int k = 0; k < 8; ++k) partial[k] += x[i + k] * x[i + k];
+		}
+		double sum = 0.0;
+		for (const float p : partial) sum += p;
+		for (; i < count; ++i) sum += static_cast<double>(x[i]) * x[i];
+		return sum;
+	}
+
+	// Blocks below this mean-square level (about -70 dBFS) never count as onsets
+	constexpr float EnergyFloor = 1e-7f;
+}
+
+OnsetDetector::OnsetDetector(unsigned int sampleRate, unsigned int blockFrames, float ratio, float refractorySec)
+	: blockFrames(std::max(1u, blockFrames)), ratio(ratio)
+{
+	// ~200 ms time constant for the baseline
+	const float blocksPerSecond = static_cast<float>(sampleRate) / static_cast<float>(this->blockFrames);
+	baselineAlpha = 1.0f - std::exp(-1.0f / (0.2f * blocksPerSecond));
+	refractoryBlocks = static_cast<unsigned int>(refractorySec * blocksPerSecond);
+	sinceOnset = refractoryBlocks;
+}
+
+void OnsetDetector::reset()
+{
+	blockSum = 0.0;
+	blockFill = 0;
+	baseline = 0.0f;
+	sinceOnset = refractoryBlocks;
+	primed = false;
+	detected = false;
+	onsetCount = 0;
+}
+
+void OnsetDetector::finishBlock()
+{
+	const float energy = static_cast<float>(blockSum / (static_cast<double>(blockFrames) * blockChannels));
+	blockSum = 0.0;
+	blockFill = 0;
+
+	if (!primed) {
+		baseline = energy;
+		primed = true;
+		return;
+	}
+
+	++sinceOnset;
+	if (energy > EnergyFloor && energy > ratio * baseline && sinceOnset > refractoryBlocks) {
+		detected = true;
+		sinceOnset = 0;
+		++onsetCount;
+	}
+	baseline += baselineAlpha * (energy - baseline);
+}
+
+bool OnsetDetector::process(const float* samples, unsigned int frameCount, int numChannels)
+{
+	detected = false;
+	if (!samples || numChannels <= 0) return false;
+	blockChannels = numChannels;
+
+	unsigned int i = 0;
+	while (i < frameCount) {
+		const unsigned int take = std::min(blockFrames - blockFill, frameCount - i);
+		blockSum += sumOfSquares(samples + static_cast<std::size_t>(i) * numChannels, static_cast<std::size_t>(take) * numChannels);
+		blockFill += take;
+		i += take;
+		if (blockFill == blockFrames) finishBlock();
+	}
+	return detected;
+}
+
+bool OnsetDetector::processPlanar(const float* const* channels, unsigned int frameCount, int numChannels)
+{
+	detected = false;
+	if (!channels || numChannels <= 0) return false;
+	blockChannels = numChannels;
+
+	unsigned int i = 0;
+	while (i < frameCount) {
+		const unsigned int take = std::min(blockFrames - blockFill, frameCount - i);
+		for (int ch = 0; ch < numChannels; ++ch) blockSum += sumOfSquares(channels[ch] + i, take);
+		blockFill += take;
+		i += take;
+		if (blockFill == blockFrames) finishBlock();
+	}
+	return detected;
+}
+
+bool CheckOnsetGating(double durationSec)
+{
+	constexpr unsigned int SampleRate = 48000;
+	constexpr double StepPeriod = 0.5;
+	constexpr double MaxDelaySec = 0.03;
+
+	// Steady ambience in front, one footstep per period alternating between the sides
+	const int stepCount = static_cast<int>(durationSec / StepPeriod);
+	std::vector<SignalSpec> scene;
+	scene.push_back({ SignalKind::Noise, 0.0f, 0.0f, 0.0f, 0.03f });
+	for (int k = 0; k < stepCount; ++k) {
+		SignalSpec step{ SignalKind::Footsteps, k % 2 == 0 ? -90.0f : 90.0f };
+		step.level = 0.8f;
+		step.startSec = static_cast<float>(k * StepPeriod);
+		step.durationSec = static_cast<float>(StepPeriod);
+		scene.push_back(step);
+	}
+
+	struct Result
+	{
+		double fraction = 0.0;
+		int missed = 0;
+		double worstDelay = 0.0;
+	};
+
+	auto run = [&](bool gated) {
+		SignalGenerator generator({ 2, SampleRate }, scene, stepCount * StepPeriod);
+		DirectionPipeline pipeline(generator);
+		pipeline.setOnsetGating(gated);
+
+		Result result;
+		int step = -1;
+		bool reported = true;
+		double packetStart = 0.0;
+		while (pipeline.step()) {
+			const double packetEnd = static_cast<double>(pipeline.stats().frames) / SampleRate;
+			const int current = static_cast<int>(packetStart / StepPeriod);
+			packetStart = packetEnd;
+
+			if (current != step) {
+				if (!reported) ++result.missed;
+				step = current;
+				reported = false;
+			}
+			if (reported) continue;
+
+			const double delay = packetEnd - step * StepPeriod;
+			const Direction expected = step % 2 == 0 ? Direction::Left : Direction::Right;
+			if (pipeline.lastState().direction == expected && delay <= MaxDelaySec) {
+				reported = true;
+				result.worstDelay = std::max(result.worstDelay, delay);
+			}
+		}
+		if (!reported) ++result.missed;
+		result.fraction = pipeline.stats().fullCostFraction();
+		return result;
+	};
+
+	const Result full = run(false);
+	const Result gated = run(true);
+
+	std::cout << stepCount << " passos sobre ruido ambiente, um a cada " << StepPeriod << " s\n";
+	std::cout << "  sem gatilho: " << 100.0 * full.fraction << "% analisado, " << full.missed
+		<< " perdidos, pior atraso " << 1000.0 * full.worstDelay << " ms\n";
+	std::cout << "  com gatilho: " << 100.0 * gated.fraction << "% analisado, " << gated.missed
+		<< " perdidos, pior atraso " << 1000.0 * gated.worstDelay << " ms\n";
+
+	const bool ok = gated.missed == 0 && gated.fraction < 1.0;
+	std::cout << (ok ? "OK" : "FALHA") << '\n';
+	return ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+// Streaming energy-derivative onset detector. Input is split into short blocks;
+// a block whose mean-square energy jumps well above a slow running baseline is an
+// onset. State carries across packets, so packet boundaries do not matter.
+class OnsetDetector
+{
+public:
+	// blockFrames ~2.7 ms at 48 kHz; ratio 4 is a +6 dB jump over the baseline.
+	explicit OnsetDetector(unsigned int sampleRate, unsigned int blockFrames = 128,
+		float ratio = 4.0f, float refractorySec = 0.05f);
+
+	// Returns true when an onset starts inside this packet. Does not allocate.
+	bool process(const float* samples, unsigned int frameCount, int numChannels);
+	// Same, reading one buffer per channel.
+	bool processPlanar(const float* const* channels, unsigned int frameCount, int numChannels);
+	void reset();
+
+	std::uint64_t onsets() const { return onsetCount; }
+
+private:
+	void finishBlock();
+
+	unsigned int blockFrames;
+	float ratio;
+	float baselineAlpha;
+	unsigned int refractoryBlocks;
+
+	double blockSum = 0.0;
+	unsigned int blockFill = 0;
+	int blockChannels = 1;
+	float baseline = 0.0f;
+	unsigned int sinceOnset = 0;
+	bool primed = false;
+	bool detected = false;
+	std::uint64_t onsetCount = 0;
+};
+
+// Generates footsteps over continuous ambience and checks that onset-gated
+// analysis still reports each step's side in time while analyzing only part of
+// the audio at full cost. Returns false when a step is missed or reported late.
+bool CheckOnsetGating(double durationSec);
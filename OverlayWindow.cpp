@@ -2,6 +2,8 @@
 #include <thread>
 #include <atomic>
 
+#include "Trace.h"
+
 static std::atomic<int>* g_directionPtr = nullptr;
 static int lastRenderedDirection = 0;
 static std::atomic<bool> g_shouldExit = false;
@@ -9,6 +11,7 @@ static std::atomic<bool> g_shouldExit = false;
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
     case WM_PAINT: {
+        AVIS_TRACE_SCOPE("overlay-paint");
         PAINTSTRUCT ps;
         HDC hdc = BeginPaint(hwnd, &ps);
         RECT rect;
@@ -47,6 +50,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 void RunOverlay(std::atomic<int>& directionRef) {
     g_directionPtr = &directionRef;
     g_shouldExit = false;  // Reset the exit flag
+    AVIS_TRACE_THREAD("overlay");
 
     const wchar_t CLASS_NAME[] = L"OverlayWindowClass";
 
@@ -74,8 +78,10 @@ void RunOverlay(std::atomic<int>& directionRef) {
     ShowWindow(hwnd, SW_SHOW);
 
     std::thread updater([hwnd]() {
+        AVIS_TRACE_THREAD("overlay-poll");
         while (!g_shouldExit && IsWindow(hwnd)) {
             if (g_directionPtr) {
+                AVIS_TRACE_SCOPE("overlay-poll");
                 int currentDir = g_directionPtr->load();
                 if (currentDir != lastRenderedDirection) {
                     lastRenderedDirection = currentDir;
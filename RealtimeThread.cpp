@@ -0,0 +1,174 @@
+#include "RealtimeThread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "LatencyHistogram.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	// Each level touches one chunk; the read after the call keeps it from becoming a tail call
+	// (which would reuse the same frame and prefault nothing).
+	unsigned char touchStack(std::size_t bytes)
+	{
+		volatile unsigned char chunk[16384];
+		for (std::size_t i = 0; i < sizeof(chunk); i += 4096) chunk[i] = 0;
+		if (bytes <= sizeof(chunk)) return chunk[0];
+		const unsigned char deeper = touchStack(bytes - sizeof(chunk));
+		return static_cast<unsigned char>(chunk[0] + deeper);
+	}
+
+	void note(RealtimeReport& report, const std::string& text)
+	{
+		if (!report.notes.empty()) report.notes += "; ";
+		report.notes += text;
+	}
+}
+
+RealtimeReport ApplyRealtimeOptions(const RealtimeOptions& options)
+{
+	RealtimeReport report;
+
+#ifdef _WIN32
+	if (options.policy != SchedulingPolicy::Default) {
+		DWORD taskIndex = 0;
+		if (HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex)) {
+			AvSetMmThreadPriority(task, AVRT_PRIORITY_HIGH);
+			report.scheduling = true;
+		} else if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+			report.scheduling = true;
+			note(report, "MMCSS indisponivel, usando THREAD_PRIORITY_TIME_CRITICAL");
+		} else {
+			note(report, "prioridade nao alterada");
+		}
+	}
+
+	if (!options.cpus.empty()) {
+		DWORD_PTR mask = 0;
+		for (const int cpu : options.cpus) {
+			if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) mask |= DWORD_PTR(1) << cpu;
+		}
+		report.affinity = mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+		if (!report.affinity) note(report, "afinidade de CPU recusada");
+	}
+
+	if (options.lockMemory) {
+		// No mlockall on Windows: raise the minimum working set so the pools stay resident
+		report.memoryLocked = SetProcessWorkingSetSizeEx(GetCurrentProcess(), 64 << 20, 256 << 20, QUOTA_LIMITS_HARDWS_MIN_ENABLE) != 0;
+		if (!report.memoryLocked) note(report, "working set nao fixado");
+	}
+#else
+	if (options.policy != SchedulingPolicy::Default) {
+		const int policy = options.policy == SchedulingPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+		sched_param param{};
+		param.sched_priority = std::max(sched_get_priority_min(policy), std::min(options.priority, sched_get_priority_max(policy)));
+		const int err = pthread_setschedparam(pthread_self(), policy, &param);
+		report.scheduling = err == 0;
+		if (err != 0) note(report, std::string("escalonamento tempo real recusado (") + std::strerror(err) + ")");
+	}
+
+	if (!options.cpus.empty()) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (const int cpu : options.cpus) {
+			if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+		}
+		const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		report.affinity = err == 0;
+		if (err != 0) note(report, std::string("afinidade de CPU recusada (") + std::strerror(err) + ")");
+	}
+
+	if (options.lockMemory) {
+		report.memoryLocked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+		if (!report.memoryLocked) note(report, std::string("mlockall recusado (") + std::strerror(errno) + ")");
+	}
+#endif
+
+	if (options.prefaultStackBytes > 0) {
+		touchStack(options.prefaultStackBytes);
+		report.stackPrefaulted = true;
+	}
+	return report;
+}
+
+void PrintRealtimeReport(const RealtimeReport& report, const char* threadName)
+{
+	std::cout << "Thread " << threadName << ": tempo real=" << (report.scheduling ? "sim" : "nao")
+		<< " afinidade=" << (report.affinity ? "sim" : "nao")
+		<< " memoria travada=" << (report.memoryLocked ? "sim" : "nao");
+	if (!report.notes.empty()) std::cout << " (" << report.notes << ")";
+	std::cout << '\n';
+}
+
+std::vector<int> ParseCpuList(const std::string& spec)
+{
+	std::vector<int> cpus;
+	std::stringstream items(spec);
+	std::string item;
+	while (std::getline(items, item, ',')) {
+		if (!item.empty()) cpus.push_back(std::stoi(item));
+	}
+	return cpus;
+}
+
+void BenchmarkSchedulingJitter(const RealtimeOptions& options, double durationSec)
+{
+	using Clock = std::chrono::steady_clock;
+
+	auto measure = [durationSec](const RealtimeOptions* rt) {
+		const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+		std::atomic<bool> stop = false;
+
+		// Synthetic contention: one busy thread per core at default priority
+		std::vector<std::thread> hogs;
+		for (unsigned int i = 0; i < cores; ++i) {
+			hogs.emplace_back([&stop] {
+				volatile std::uint64_t spin = 0;
+				while (!stop.load(std::memory_order_relaxed)) spin = spin + 1;
+			});
+		}
+
+		LatencyHistogram lateness;
+		std::thread worker([&] {
+			if (rt) PrintRealtimeReport(ApplyRealtimeOptions(*rt), "bench");
+
+			const auto period = std::chrono::milliseconds(1);
+			const auto end = Clock::now() + std::chrono::duration<double>(durationSec);
+			auto next = Clock::now() + period;
+			while (next < end) {
+				std::this_thread::sleep_until(next);
+				const auto late = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - next).count();
+				lateness.record(static_cast<std::uint64_t>(std::max<long long>(late, 0)));
+				next += period;
+			}
+		});
+
+		worker.join();
+		stop = true;
+		for (auto& hog : hogs) hog.join();
+		return lateness;
+	};
+
+	std::cout << "Atraso ao acordar (periodo 1 ms, " << std::thread::hardware_concurrency() << " threads de carga)\n";
+	std::cout << "  padrao:      ";
+	measure(nullptr).print(std::cout, "us");
+	const LatencyHistogram tuned = measure(&options);
+	std::cout << "  configurado: ";
+	tuned.print(std::cout, "us");
+}
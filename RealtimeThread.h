@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class SchedulingPolicy : std::uint8_t
+{
+	Default,
+	Fifo,       // SCHED_FIFO on Linux, MMCSS "Pro Audio" on Windows
+	RoundRobin  // SCHED_RR on Linux, MMCSS "Pro Audio" on Windows
+};
+
+struct RealtimeOptions
+{
+	SchedulingPolicy policy = SchedulingPolicy::Default;
+	int priority = 10;                  // Linux: 1..99 for FIFO/RR
+	std::vector<int> cpus;              // empty: leave affinity alone
+	bool lockMemory = false;            // mlockall(MCL_CURRENT | MCL_FUTURE); working set lock on Windows
+	std::size_t prefaultStackBytes = 0; // touch this much stack up front
+
+	bool requested() const { return policy != SchedulingPolicy::Default || !cpus.empty() || lockMemory || prefaultStackBytes > 0; }
+};
+
+// What ApplyRealtimeOptions managed to do; anything not permitted is skipped and noted.
+struct RealtimeReport
+{
+	bool scheduling = false;
+	bool affinity = false;
+	bool memoryLocked = false;
+	bool stackPrefaulted = false;
+	std::string notes;
+};
+
+// Applies options to the calling thread (memory locking is process-wide).
+// Never throws: every setting falls back to the default when not permitted.
+// Pools (FrameBlockPool, pipeline scratch) are value-initialized when built, so
+// their pages are already faulted in; lockMemory keeps them resident.
+RealtimeReport ApplyRealtimeOptions(const RealtimeOptions& options);
+void PrintRealtimeReport(const RealtimeReport& report, const char* threadName);
+
+// Parses "2,3" into a CPU list.
+std::vector<int> ParseCpuList(const std::string& spec);
+
+// Wakes a thread every millisecond while other threads load every core, and
+// prints the wake-up lateness distribution with default and with the given options.
+void BenchmarkSchedulingJitter(const RealtimeOptions& options, double durationSec);
@@ -0,0 +1,797 @@
+#include "RecordingWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "WavFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// RIFF form: RIFF/RF64 header, JUNK/ds64 (28 bytes), fmt (16 bytes), data header
+	constexpr std::uint64_t RiffSlotOffset = 12;
+	constexpr std::uint32_t Ds64Bytes = 28;
+	constexpr std::uint64_t RiffDataOffset = 80;
+	// W64: riff GUID + size + wave GUID, fmt chunk (24 + 16), data chunk header
+	constexpr std::uint64_t W64DataOffset = 104;
+	constexpr std::uint32_t RiffSizeLimit = 0xFFFFFFFFu;
+
+	constexpr unsigned char W64Riff[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+	constexpr unsigned char W64Wave[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+	constexpr unsigned char W64Fmt[16] = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+	constexpr unsigned char W64Data[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+
+	// Where the size fields of a recording live
+	struct Layout
+	{
+		bool wave64 = false;
+		bool ds64Slot = false;   // RIFF form with room to become RF64
+		std::uint64_t dataOffset = 0;
+		unsigned int blockAlign = 0;
+	};
+
+	void put(unsigned char* p, std::uint64_t value, int bytes)
+	{
+		for (int i = 0; i < bytes; ++i) p[i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+
+	std::uint64_t get(const unsigned char* p, int bytes)
+	{
+		std::uint64_t value = 0;
+		for (int i = 0; i < bytes; ++i) value |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+		return value;
+	}
+
+	void putFormat(unsigned char* p, int channels, unsigned int sampleRate, bool isFloat, unsigned int bits)
+	{
+		const unsigned int blockAlign = channels * bits / 8;
+		put(p, isFloat ? 3 : 1, 2);
+		put(p + 2, channels, 2);
+		put(p + 4, sampleRate, 4);
+		put(p + 8, static_cast<std::uint64_t>(sampleRate) * blockAlign, 4);
+		put(p + 12, blockAlign, 2);
+		put(p + 14, bits, 2);
+	}
+
+	// Header of an empty recording; sizes are filled in by writeSizes
+	std::vector<unsigned char> makeHeader(RecordingContainer container, int channels, unsigned int sampleRate, bool isFloat, unsigned int bits)
+	{
+		if (container == RecordingContainer::W64) {
+			std::vector<unsigned char> h(W64DataOffset, 0);
+			std::memcpy(h.data(), W64Riff, 16);
+			std::memcpy(h.data() + 24, W64Wave, 16);
+			std::memcpy(h.data() + 40, W64Fmt, 16);
+			put(h.data() + 56, 40, 8);
+			putFormat(h.data() + 64, channels, sampleRate, isFloat, bits);
+			std::memcpy(h.data() + 80, W64Data, 16);
+			return h;
+		}
+
+		std::vector<unsigned char> h(RiffDataOffset, 0);
+		std::memcpy(h.data(), "RIFF", 4);
+		std::memcpy(h.data() + 8, "WAVE", 4);
+		std::memcpy(h.data() + RiffSlotOffset, "JUNK", 4);
+		put(h.data() + RiffSlotOffset + 4, Ds64Bytes, 4);
+		std::memcpy(h.data() + 48, "fmt ", 4);
+		put(h.data() + 52, 16, 4);
+		putFormat(h.data() + 56, channels, sampleRate, isFloat, bits);
+		std::memcpy(h.data() + 72, "data", 4);
+		return h;
+	}
+
+	// A left-justified sample (full scale 2^31) in the file's sample format
+	void storeSample(std::int32_t value, char* out, bool isFloat, unsigned int bits)
+	{
+		if (isFloat) {
+			const float f = value / 2147483648.0f;
+			std::memcpy(out, &f, sizeof(f));
+			return;
+		}
+		put(reinterpret_cast<unsigned char*>(out), static_cast<std::uint32_t>(value) >> (32 - bits), static_cast<int>(bits / 8));
+	}
+
+	void writeSizes(PreallocatedFile& file, const Layout& layout, std::uint64_t dataBytes)
+	{
+		unsigned char field[8];
+		if (layout.wave64) {
+			put(field, layout.dataOffset + dataBytes, 8);
+			file.writeAt(16, field, 8);
+			put(field, 24 + dataBytes, 8);
+			file.writeAt(layout.dataOffset - 8, field, 8);
+			return;
+		}
+
+		const std::uint64_t riffBytes = layout.dataOffset - 8 + dataBytes;
+		if (riffBytes <= RiffSizeLimit) {
+			put(field, riffBytes, 4);
+			file.writeAt(4, field, 4);
+			put(field, dataBytes, 4);
+			file.writeAt(layout.dataOffset - 4, field, 4);
+			return;
+		}
+		if (!layout.ds64Slot) {
+			throw std::runtime_error("WAV passa de 4 GB e nao tem espaco para ds64");
+		}
+
+		// ds64 goes in before the RF64 id, so the header is consistent at every step
+		unsigned char ds64[8 + Ds64Bytes] = {};
+		std::memcpy(ds64, "ds64", 4);
+		put(ds64 + 4, Ds64Bytes, 4);
+		put(ds64 + 8, riffBytes, 8);
+		put(ds64 + 16, dataBytes, 8);
+		put(ds64 + 24, dataBytes / layout.blockAlign, 8);
+		file.writeAt(RiffSlotOffset, ds64, sizeof(ds64));
+		put(field, RiffSizeLimit, 4);
+		file.writeAt(layout.dataOffset - 4, field, 4);
+		unsigned char riff[8];
+		std::memcpy(riff, "RF64", 4);
+		put(riff + 4, RiffSizeLimit, 4);
+		file.writeAt(0, riff, 8);
+	}
+
+	Layout readLayout(const PreallocatedFile& file, const std::string& path)
+	{
+		const std::uint64_t fileSize = file.size();
+		unsigned char head[40];
+		if (!file.readAt(0, head, sizeof(head))) {
+			throw std::runtime_error("Arquivo de gravacao truncado: " + path);
+		}
+
+		Layout layout;
+		unsigned char chunk[24];
+		if (std::memcmp(head, W64Riff, 16) == 0 && std::memcmp(head + 24, W64Wave, 16) == 0) {
+			layout.wave64 = true;
+			for (std::uint64_t pos = 40; pos + 24 <= fileSize; ) {
+				file.readAt(pos, chunk, 24);
+				const std::uint64_t size = get(chunk + 16, 8);
+				if (std::memcmp(chunk, W64Fmt, 16) == 0 && file.readAt(pos + 24, head, 16)) {
+					layout.blockAlign = static_cast<unsigned int>(get(head + 12, 2));
+				} else if (std::memcmp(chunk, W64Data, 16) == 0) {
+					layout.dataOffset = pos + 24;
+					break;
+				}
+				if (size < 24) break;
+				pos += (size + 7) & ~std::uint64_t(7);
+			}
+		} else if ((std::memcmp(head, "RIFF", 4) == 0 || std::memcmp(head, "RF64", 4) == 0) && std::memcmp(head + 8, "WAVE", 4) == 0) {
+			for (std::uint64_t pos = 12; pos + 8 <= fileSize; ) {
+				file.readAt(pos, chunk, 8);
+				const std::uint64_t size = get(chunk + 4, 4);
+				if (pos == RiffSlotOffset && size >= Ds64Bytes && (std::memcmp(chunk, "JUNK", 4) == 0 || std::memcmp(chunk, "ds64", 4) == 0)) {
+					layout.ds64Slot = true;
+				} else if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16 && file.readAt(pos + 8, head, 16)) {
+					layout.blockAlign = static_cast<unsigned int>(get(head + 12, 2));
+				} else if (std::memcmp(chunk, "data", 4) == 0) {
+					layout.dataOffset = pos + 8;
+					break;
+				}
+				pos += 8 + size + (size & 1);
+			}
+		}
+
+		if (layout.dataOffset == 0 || layout.blockAlign == 0) {
+			throw std::runtime_error("Cabecalho de gravacao nao reconhecido: " + path);
+		}
+		return layout;
+	}
+
+	[[noreturn]] void fileError(const char* what, const std::string& path)
+	{
+		throw std::runtime_error(std::string(what) + ": " + path);
+	}
+}
+
+RecordingContainer ContainerForPath(const std::string& path)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".w64" ? RecordingContainer::W64 : RecordingContainer::Rf64;
+}
+
+std::string SegmentPath(const std::string& path, int index)
+{
+	const std::filesystem::path p(path);
+	std::ostringstream name;
+	name << p.stem().string() << '-' << std::setw(3) << std::setfill('0') << index << p.extension().string();
+	return (p.parent_path() / name.str()).string();
+}
+
+PreallocatedFile::PreallocatedFile(const std::string& path, bool create)
+	: path(path)
+{
+#ifdef _WIN32
+	handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+		create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		handle = nullptr;
+		fileError("Erro ao abrir o arquivo de gravacao", path);
+	}
+#else
+	fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0644);
+	if (fd < 0) {
+		fileError("Erro ao abrir o arquivo de gravacao", path);
+	}
+#endif
+}
+
+PreallocatedFile::~PreallocatedFile()
+{
+	close();
+}
+
+void PreallocatedFile::write(const void* data, std::size_t bytes)
+{
+	const auto* p = static_cast<const char*>(data);
+#ifdef _WIN32
+	while (bytes > 0) {
+		DWORD written = 0;
+		const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(bytes, 1u << 30));
+		if (!WriteFile(handle, p, chunk, &written, nullptr) || written == 0) fileError("Erro ao gravar", path);
+		p += written;
+		bytes -= written;
+	}
+#else
+	while (bytes > 0) {
+		const ssize_t written = ::write(fd, p, bytes);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) fileError("Erro ao gravar", path);
+		p += written;
+		bytes -= static_cast<std::size_t>(written);
+	}
+#endif
+}
+
+void PreallocatedFile::writeAt(std::uint64_t offset, const void* data, std::size_t bytes)
+{
+#ifdef _WIN32
+	// WriteFile with an OVERLAPPED offset moves the pointer of a synchronous handle
+	LARGE_INTEGER position{};
+	SetFilePointerEx(handle, LARGE_INTEGER{}, &position, FILE_CURRENT);
+	OVERLAPPED at{};
+	at.Offset = static_cast<DWORD>(offset);
+	at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD written = 0;
+	const bool ok = WriteFile(handle, data, static_cast<DWORD>(bytes), &written, &at) && written == bytes;
+	SetFilePointerEx(handle, position, nullptr, FILE_BEGIN);
+	if (!ok) fileError("Erro ao gravar", path);
+#else
+	const auto* p = static_cast<const char*>(data);
+	while (bytes > 0) {
+		const ssize_t written = ::pwrite(fd, p, bytes, static_cast<off_t>(offset));
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) fileError("Erro ao gravar", path);
+		p += written;
+		offset += static_cast<std::uint64_t>(written);
+		bytes -= static_cast<std::size_t>(written);
+	}
+#endif
+}
+
+bool PreallocatedFile::readAt(std::uint64_t offset, void* data, std::size_t bytes) const
+{
+#ifdef _WIN32
+	LARGE_INTEGER position{};
+	SetFilePointerEx(handle, LARGE_INTEGER{}, &position, FILE_CURRENT);
+	OVERLAPPED at{};
+	at.Offset = static_cast<DWORD>(offset);
+	at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD got = 0;
+	const bool ok = ReadFile(handle, data, static_cast<DWORD>(bytes), &got, &at) && got == bytes;
+	SetFilePointerEx(handle, position, nullptr, FILE_BEGIN);
+	return ok;
+#else
+	return ::pread(fd, data, bytes, static_cast<off_t>(offset)) == static_cast<ssize_t>(bytes);
+#endif
+}
+
+bool PreallocatedFile::reserve(std::uint64_t offset, std::uint64_t bytes)
+{
+#ifdef _WIN32
+	FILE_ALLOCATION_INFO info{};
+	info.AllocationSize.QuadPart = static_cast<LONGLONG>(offset + bytes);
+	return SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info)) != 0;
+#elif defined(__linux__)
+	return ::fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(bytes)) == 0;
+#else
+	(void)offset;
+	(void)bytes;
+	return false;
+#endif
+}
+
+void PreallocatedFile::sync()
+{
+#ifdef _WIN32
+	FlushFileBuffers(handle);
+#elif defined(__linux__)
+	::fdatasync(fd);
+#else
+	::fsync(fd);
+#endif
+}
+
+void PreallocatedFile::truncate(std::uint64_t size)
+{
+#ifdef _WIN32
+	// Moving end of file alone can leave reserved clusters past it; the allocation
+	// size is what gives them back
+	FILE_END_OF_FILE_INFO end{};
+	end.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+	FILE_ALLOCATION_INFO allocation{};
+	allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+	if (!SetFileInformationByHandle(handle, FileEndOfFileInfo, &end, sizeof(end)) ||
+		!SetFileInformationByHandle(handle, FileAllocationInfo, &allocation, sizeof(allocation))) {
+		fileError("Erro ao ajustar o tamanho", path);
+	}
+#else
+	if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		fileError("Erro ao ajustar o tamanho", path);
+	}
+#endif
+}
+
+std::uint64_t PreallocatedFile::size() const
+{
+#ifdef _WIN32
+	LARGE_INTEGER size{};
+	GetFileSizeEx(handle, &size);
+	return static_cast<std::uint64_t>(size.QuadPart);
+#else
+	struct stat info{};
+	fstat(fd, &info);
+	return static_cast<std::uint64_t>(info.st_size);
+#endif
+}
+
+void PreallocatedFile::close()
+{
+#ifdef _WIN32
+	if (handle) CloseHandle(handle);
+	handle = nullptr;
+#else
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+}
+
+RecordingWriter::RecordingWriter(const std::string& path, int numChannels, unsigned int sampleRate, RecordingOptions options)
+	: basePath(path), options(options), numChannels(numChannels), sampleRate(sampleRate)
+{
+	if (numChannels <= 0 || numChannels > 0xFFFF || sampleRate == 0) {
+		throw std::runtime_error("Formato de gravacao invalido: " + path);
+	}
+	if (!options.writeFloat && options.bitsPerSample != 16 && options.bitsPerSample != 24 && options.bitsPerSample != 32) {
+		throw std::runtime_error("Profundidade de bits nao suportada na gravacao: " + path);
+	}
+	if (options.writeFloat) this->options.bitsPerSample = 32;
+	blockAlign = numChannels * (this->options.bitsPerSample / 8);
+	dataOffset = options.container == RecordingContainer::W64 ? W64DataOffset : RiffDataOffset;
+
+	if (options.segmentSeconds > 0.0) {
+		segmentFrameLimit = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(options.segmentSeconds * sampleRate));
+	}
+	if (options.segmentBytes > 0) {
+		if (options.segmentBytes < dataOffset + blockAlign) {
+			throw std::runtime_error("Segmento menor que o cabecalho: " + path);
+		}
+		const std::uint64_t frames = (options.segmentBytes - dataOffset) / blockAlign;
+		segmentFrameLimit = segmentFrameLimit ? std::min(segmentFrameLimit, frames) : frames;
+	}
+	if (options.checkpointSeconds > 0.0) {
+		checkpointInterval = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(options.checkpointSeconds * sampleRate));
+	}
+
+	// Whole frames, so a flush never leaves half a frame on disk
+	buffer.resize(std::max<std::size_t>(1, (64 * 1024) / blockAlign) * blockAlign);
+	openSegment();
+}
+
+RecordingWriter::~RecordingWriter()
+{
+	try {
+		close();
+	} catch (const std::exception&) {
+		// The data is on disk; RecoverRecording can still fix the header
+	}
+}
+
+template <typename T, typename Convert>
+void RecordingWriter::append(const T* samples, unsigned int frameCount, Convert convert, std::size_t stride)
+{
+	while (frameCount > 0) {
+		if (!file) openSegment();
+
+		// Stop at the next checkpoint or segment boundary, whichever comes first
+		std::uint64_t frames = frameCount;
+		if (segmentFrameLimit) frames = std::min(frames, segmentFrameLimit - segmentFrames);
+		if (checkpointInterval) frames = std::min(frames, checkpointFrames + checkpointInterval - segmentFrames);
+
+		for (std::uint64_t left = frames; left > 0; ) {
+			const std::uint64_t room = std::min<std::uint64_t>(left, (buffer.size() - buffered) / blockAlign);
+			const std::size_t count = static_cast<std::size_t>(room) * numChannels;
+			convert(samples, buffer.data() + buffered, count);
+			samples += count * stride;
+			buffered += static_cast<std::size_t>(room) * blockAlign;
+			left -= room;
+			if (buffered == buffer.size()) flush();
+		}
+
+		segmentFrames += frames;
+		totalFrames += frames;
+		frameCount -= static_cast<unsigned int>(frames);
+		if (checkpointInterval && segmentFrames == checkpointFrames + checkpointInterval) checkpoint();
+		if (segmentFrameLimit && segmentFrames == segmentFrameLimit) closeSegment();
+	}
+}
+
+void RecordingWriter::write(const float* samples, unsigned int frameCount)
+{
+	const unsigned int bits = options.bitsPerSample;
+	if (options.writeFloat) {
+		append(samples, frameCount, [](const float* in, char* out, std::size_t count) {
+			std::memcpy(out, in, count * sizeof(float));
+		});
+	} else if (bits == 16) {
+		append(samples, frameCount, [](const float* in, char* out, std::size_t count) {
+			NormalizeAudio(in, reinterpret_cast<std::int16_t*>(out), count);
+		});
+	} else {
+		// Clamped and scaled to the largest positive value, like NormalizeAudio for 16-bit
+		const double scale = static_cast<double>((1u << (bits - 1)) - 1);
+		append(samples, frameCount, [bits, scale](const float* in, char* out, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i, out += bits / 8) {
+				const double x = std::clamp(static_cast<double>(in[i]), -1.0, 1.0);
+				put(reinterpret_cast<unsigned char*>(out), static_cast<std::uint64_t>(std::llround(x * scale)), static_cast<int>(bits / 8));
+			}
+		});
+	}
+}
+
+void RecordingWriter::write(const std::int16_t* samples, unsigned int frameCount)
+{
+	const bool isFloat = options.writeFloat;
+	const unsigned int bits = options.bitsPerSample;
+	if (!isFloat && bits == 16) {
+		append(samples, frameCount, [](const std::int16_t* in, char* out, std::size_t count) {
+			std::memcpy(out, in, count * sizeof(std::int16_t));
+		});
+	} else {
+		append(samples, frameCount, [isFloat, bits](const std::int16_t* in, char* out, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i, out += bits / 8) {
+				storeSample(static_cast<std::int32_t>(static_cast<std::uint32_t>(static_cast<std::uint16_t>(in[i])) << 16), out, isFloat, bits);
+			}
+		});
+	}
+}
+
+void RecordingWriter::write(const void* pcm, PcmEncoding encoding, unsigned int frameCount)
+{
+	const bool isFloat = options.writeFloat;
+	const unsigned int bits = options.bitsPerSample;
+	const std::size_t sampleBytes = PcmBytesPerSample(encoding);
+	if (!isFloat && bits == 8 * sampleBytes) {
+		// Same layout as the file: the device's bytes go straight in
+		append(static_cast<const char*>(pcm), frameCount, [sampleBytes](const char* in, char* out, std::size_t count) {
+			std::memcpy(out, in, count * sampleBytes);
+		}, sampleBytes);
+	} else {
+		append(static_cast<const char*>(pcm), frameCount, [encoding, isFloat, bits](const char* in, char* out, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i, out += bits / 8) storeSample(LoadPcmSample(in, encoding, i), out, isFloat, bits);
+		}, sampleBytes);
+	}
+}
+
+void RecordingWriter::openSegment()
+{
+	++segmentIndex;
+	segmentFile = segmentFrameLimit ? SegmentPath(basePath, segmentIndex) : basePath;
+	file = std::make_unique<PreallocatedFile>(segmentFile, true);
+
+	const std::vector<unsigned char> header = makeHeader(options.container, numChannels, sampleRate, options.writeFloat, options.bitsPerSample);
+	file->write(header.data(), header.size());
+	fileEnd = dataOffset;
+	reservedEnd = dataOffset;
+	reserving = options.preallocateBytes > 0;
+	segmentFrames = 0;
+	checkpointFrames = 0;
+}
+
+void RecordingWriter::flush()
+{
+	if (buffered == 0) return;
+
+	if (reserving && fileEnd + buffered > reservedEnd) {
+		std::uint64_t end = reservedEnd + std::max<std::uint64_t>(options.preallocateBytes, buffered);
+		if (segmentFrameLimit) end = std::min(end, dataOffset + segmentFrameLimit * blockAlign);
+		reserving = file->reserve(reservedEnd, end - reservedEnd);
+		reservedEnd = end;
+	}
+
+	file->write(buffer.data(), buffered);
+	fileEnd += buffered;
+	buffered = 0;
+}
+
+void RecordingWriter::checkpoint()
+{
+	flush();
+	Layout layout;
+	layout.wave64 = options.container == RecordingContainer::W64;
+	layout.ds64Slot = !layout.wave64;
+	layout.dataOffset = dataOffset;
+	layout.blockAlign = blockAlign;
+	writeSizes(*file, layout, segmentFrames * blockAlign);
+	if (options.syncCheckpoints) file->sync();
+	checkpointFrames = segmentFrames;
+	++checkpointCount;
+}
+
+void RecordingWriter::closeSegment()
+{
+	checkpoint();
+	// Gives back the part of the last extent that was never written
+	file->truncate(fileEnd);
+	file->close();
+	file.reset();
+}
+
+void RecordingWriter::close()
+{
+	if (closed) return;
+	closed = true;
+	if (file) closeSegment();
+}
+
+std::uint64_t RecoverRecording(const std::string& path)
+{
+	PreallocatedFile file(path, false);
+	const Layout layout = readLayout(file, path);
+	const std::uint64_t fileSize = file.size();
+	if (fileSize < layout.dataOffset) {
+		throw std::runtime_error("Gravacao sem dados: " + path);
+	}
+
+	const std::uint64_t dataBytes = (fileSize - layout.dataOffset) / layout.blockAlign * layout.blockAlign;
+	writeSizes(file, layout, dataBytes);
+	file.truncate(layout.dataOffset + dataBytes);
+	file.sync();
+	return dataBytes / layout.blockAlign;
+}
+
+namespace
+{
+	constexpr int CheckChannels = 2;
+	constexpr unsigned int CheckRate = 48000;
+
+	std::int16_t patternSample(std::uint64_t frame, int channel)
+	{
+		return static_cast<std::int16_t>(static_cast<std::uint16_t>(frame * 31 + channel * 977 + (frame >> 7) * 13));
+	}
+
+	void fillPattern(std::vector<std::int16_t>& out, std::uint64_t firstFrame, unsigned int frames, int channels)
+	{
+		out.resize(static_cast<std::size_t>(frames) * channels);
+		for (unsigned int i = 0; i < frames; ++i) {
+			for (int ch = 0; ch < channels; ++ch) out[static_cast<std::size_t>(i) * channels + ch] = patternSample(firstFrame + i, ch);
+		}
+	}
+
+	// Frames at the start of the file that match the pattern from firstFrame on;
+	// the file must hold nothing else.
+	bool matchesPattern(const std::string& path, std::uint64_t firstFrame, std::uint64_t expectedFrames)
+	{
+		WavReader reader(path);
+		const int channels = reader.format().channels;
+		if (reader.totalFrames() != expectedFrames) return false;
+
+		std::vector<float> block(4096 * static_cast<std::size_t>(channels));
+		std::uint64_t frame = firstFrame;
+		while (const unsigned int got = reader.read(block.data(), 4096)) {
+			for (unsigned int i = 0; i < got; ++i, ++frame) {
+				for (int ch = 0; ch < channels; ++ch) {
+					if (block[static_cast<std::size_t>(i) * channels + ch] * 32768.0f != patternSample(frame, ch)) return false;
+				}
+			}
+		}
+		return frame == firstFrame + expectedFrames;
+	}
+
+	bool checkRotation(const std::string& directory, RecordingContainer container, const RecordingOptions& base, const char* name)
+	{
+		const std::string path = (std::filesystem::path(directory) / (container == RecordingContainer::W64 ? "avis-rot.w64" : "avis-rot.wav")).string();
+		const std::uint64_t dataOffset = container == RecordingContainer::W64 ? W64DataOffset : RiffDataOffset;
+		RecordingOptions options = base;
+		options.container = container;
+		options.checkpointSeconds = 0.01;
+
+		const std::uint64_t total = 3 * CheckRate + 1234;
+		int segments = 0;
+		{
+			RecordingWriter writer(path, CheckChannels, CheckRate, options);
+			std::vector<std::int16_t> block;
+			// Odd write sizes so boundaries fall inside writes
+			for (std::uint64_t frame = 0, size = 1; frame < total; frame += size, size = size * 7 % 997 + 1) {
+				size = std::min(size, total - frame);
+				fillPattern(block, frame, static_cast<unsigned int>(size), CheckChannels);
+				writer.write(block.data(), static_cast<unsigned int>(size));
+			}
+			writer.close();
+			segments = writer.segmentCount();
+		}
+
+		bool ok = segments > 1;
+		std::uint64_t frame = 0;
+		for (int i = 1; i <= segments; ++i) {
+			const std::string segment = SegmentPath(path, i);
+			const std::uint64_t bytes = std::filesystem::file_size(segment);
+			const std::uint64_t frames = (bytes - dataOffset) / (CheckChannels * 2);
+			ok = ok && bytes == dataOffset + frames * CheckChannels * 2 && matchesPattern(segment, frame, frames);
+			if (options.segmentBytes) ok = ok && bytes <= options.segmentBytes;
+			frame += frames;
+			std::filesystem::remove(segment);
+		}
+		ok = ok && frame == total;
+
+		std::cout << "  " << name << ": " << (ok ? "ok" : "FALHOU") << " (" << segments << " segmentos)\n";
+		return ok;
+	}
+
+	// Records until KillAfterFrames have been written, then kills the writer; returns
+	// the frames its last header checkpoint covered
+	std::uint64_t recordAndKill(const std::string& path, const RecordingOptions& options)
+	{
+		constexpr std::uint64_t KillAfterFrames = 3 * CheckRate / 2;
+		constexpr unsigned int BlockFrames = 480;
+		std::uint64_t progress[2] = {}; // written, checkpointed
+
+#ifdef _WIN32
+		// No fork: the bytes of the open file at this moment are what a kill would leave
+		{
+			RecordingWriter writer(path + ".live", CheckChannels, CheckRate, options);
+			std::vector<std::int16_t> block;
+			for (std::uint64_t frame = 0; frame < KillAfterFrames; frame += BlockFrames) {
+				fillPattern(block, frame, BlockFrames, CheckChannels);
+				writer.write(block.data(), BlockFrames);
+			}
+			progress[1] = writer.framesCheckpointed();
+
+			std::ifstream live(path + ".live", std::ios::binary);
+			std::ofstream snapshot(path, std::ios::binary | std::ios::trunc);
+			snapshot << live.rdbuf();
+		}
+		std::filesystem::remove(path + ".live");
+#else
+		int channel[2];
+		if (pipe(channel) != 0) return 0;
+		const pid_t child = fork();
+		if (child == 0) {
+			::close(channel[0]);
+			try {
+				RecordingWriter writer(path, CheckChannels, CheckRate, options);
+				std::vector<std::int16_t> block;
+				for (std::uint64_t frame = 0; ; frame += BlockFrames) {
+					fillPattern(block, frame, BlockFrames, CheckChannels);
+					writer.write(block.data(), BlockFrames);
+					const std::uint64_t report[2] = { writer.framesWritten(), writer.framesCheckpointed() };
+					if (::write(channel[1], report, sizeof(report)) != sizeof(report)) break;
+					usleep(100);
+				}
+			} catch (...) {
+			}
+			_exit(1);
+		}
+		::close(channel[1]);
+		while (progress[0] < KillAfterFrames && ::read(channel[0], progress, sizeof(progress)) == sizeof(progress)) {
+		}
+		if (child > 0) {
+			kill(child, SIGKILL);
+			waitpid(child, nullptr, 0);
+		}
+		::close(channel[0]);
+#endif
+		return progress[1];
+	}
+
+	bool checkKill(const std::string& directory, RecordingContainer container, const char* name)
+	{
+		const bool w64 = container == RecordingContainer::W64;
+		const std::string path = (std::filesystem::path(directory) / (w64 ? "avis-kill.w64" : "avis-kill.wav")).string();
+		const std::uint64_t dataOffset = w64 ? W64DataOffset : RiffDataOffset;
+		RecordingOptions options;
+		options.container = container;
+		options.checkpointSeconds = 1.0;
+		options.preallocateBytes = 1 << 20;
+
+		const std::uint64_t checkpointed = recordAndKill(path, options);
+		bool ok = checkpointed > 0;
+
+		// Readable as it was left: at least up to the last checkpoint
+		if (ok) ok = WavReader(path).totalFrames() >= checkpointed;
+
+		std::uint64_t recovered = 0;
+		if (ok) {
+			recovered = RecoverRecording(path);
+			ok = recovered >= checkpointed && std::filesystem::file_size(path) == dataOffset + recovered * CheckChannels * 2 &&
+				matchesPattern(path, 0, recovered);
+		}
+
+		// A torn last frame is dropped
+		if (ok) {
+			{
+				std::ofstream torn(path, std::ios::binary | std::ios::app);
+				torn.write("\x01\x02\x03", 3);
+			}
+			ok = RecoverRecording(path) == recovered && matchesPattern(path, 0, recovered);
+		}
+
+		std::cout << "  " << name << ": " << (ok ? "ok" : "FALHOU") << " (checkpoint em " << checkpointed
+			<< " quadros, " << recovered << " recuperados)\n";
+		std::filesystem::remove(path);
+		return ok;
+	}
+
+	// A sparse data chunk past 4 GB: recovery must promote the header to RF64
+	bool checkPromotion(const std::string& directory)
+	{
+		const std::string path = (std::filesystem::path(directory) / "avis-rf64.wav").string();
+		const std::uint64_t frames = (5ull << 30) / (CheckChannels * 2);
+		{
+			RecordingOptions options;
+			options.preallocateBytes = 0;
+			RecordingWriter writer(path, CheckChannels, CheckRate, options);
+			writer.close();
+		}
+		{
+			PreallocatedFile file(path, false);
+			file.truncate(RiffDataOffset + frames * CheckChannels * 2);
+		}
+
+		bool ok = RecoverRecording(path) == frames;
+		char id[4] = {};
+		std::ifstream(path, std::ios::binary).read(id, 4);
+		ok = ok && std::memcmp(id, "RF64", 4) == 0 && WavReader(path).totalFrames() == frames;
+
+		std::cout << "  RF64 acima de 4 GB: " << (ok ? "ok" : "FALHOU") << '\n';
+		std::filesystem::remove(path);
+		return ok;
+	}
+}
+
+bool CheckRecordingRecovery(const std::string& directory)
+{
+	RecordingOptions bySeconds;
+	bySeconds.segmentSeconds = 0.7;
+	RecordingOptions byBytes;
+	byBytes.segmentBytes = 150000;
+
+	bool ok = true;
+	ok = checkRotation(directory, RecordingContainer::Rf64, bySeconds, "rotacao por tempo (WAV/RF64)") && ok;
+	ok = checkRotation(directory, RecordingContainer::W64, bySeconds, "rotacao por tempo (W64)") && ok;
+	ok = checkRotation(directory, RecordingContainer::Rf64, byBytes, "rotacao por tamanho (WAV/RF64)") && ok;
+	ok = checkKill(directory, RecordingContainer::Rf64, "gravacao interrompida (WAV/RF64)") && ok;
+	ok = checkKill(directory, RecordingContainer::W64, "gravacao interrompida (W64)") && ok;
+	ok = checkPromotion(directory) && ok;
+	std::cout << (ok ? "Gravacoes recuperaveis\n" : "Falha na recuperacao de gravacoes\n");
+	return ok;
+}
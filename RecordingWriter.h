@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CaptureSource.h"
+
+// Long-running recordings: 64-bit sizes, disk space reserved ahead in large extents,
+// headers that are valid while the file is still growing, and optional rotation.
+//
+// Rf64 writes a plain WAV with a 28-byte JUNK chunk in front of "fmt ", and turns it
+// into RF64 (JUNK -> ds64) in place once the data passes 4 GB, so short recordings stay
+// readable everywhere. W64 (Sony Wave64) uses 64-bit sizes from the start.
+//
+// Preallocation never moves end of file (FALLOC_FL_KEEP_SIZE / FileAllocationInfo), so
+// after a crash the file length is exactly what reached the kernel. The header is
+// rewritten with the current sizes at every checkpoint; RecoverRecording() brings it up
+// to the file length and releases the unused reservation.
+
+enum class RecordingContainer : std::uint8_t
+{
+	Rf64,
+	W64
+};
+
+struct RecordingOptions
+{
+	RecordingContainer container = RecordingContainer::Rf64;
+	bool writeFloat = false;
+	int bitsPerSample = 16;                        // integer PCM: 16, 24 or 32; float is always 32
+	std::uint64_t preallocateBytes = 64ull << 20; // reserved past the write position, 0 = off
+	double checkpointSeconds = 2.0;
+	bool syncCheckpoints = false;                  // fdatasync / FlushFileBuffers at each checkpoint
+	// Rotation, 0 = off. Segments split at an exact frame, so concatenating them gives
+	// back the stream without gaps or overlap.
+	double segmentSeconds = 0.0;
+	std::uint64_t segmentBytes = 0;
+};
+
+// W64 for ".w64" paths, Rf64 otherwise.
+RecordingContainer ContainerForPath(const std::string& path);
+// "rec.wav", 3 -> "rec-003.wav".
+std::string SegmentPath(const std::string& path, int index);
+
+// Unbuffered file with explicit offsets (CreateFile / POSIX fd).
+class PreallocatedFile
+{
+public:
+	PreallocatedFile(const std::string& path, bool create);
+	~PreallocatedFile();
+	PreallocatedFile(const PreallocatedFile&) = delete;
+	PreallocatedFile& operator=(const PreallocatedFile&) = delete;
+
+	void write(const void* data, std::size_t bytes);
+	void writeAt(std::uint64_t offset, const void* data, std::size_t bytes);
+	bool readAt(std::uint64_t offset, void* data, std::size_t bytes) const;
+	// Reserves [offset, offset + bytes) without changing the file size. Returns false
+	// where the filesystem cannot (the file then simply grows on demand).
+	bool reserve(std::uint64_t offset, std::uint64_t bytes);
+	void sync();
+	// Sets the size, which also releases any reservation past it.
+	void truncate(std::uint64_t size);
+	std::uint64_t size() const;
+	void close();
+
+private:
+	std::string path;
+#ifdef _WIN32
+	void* handle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+class RecordingWriter
+{
+public:
+	RecordingWriter(const std::string& path, int numChannels, unsigned int sampleRate, RecordingOptions options = {});
+	~RecordingWriter();
+
+	RecordingWriter(const RecordingWriter&) = delete;
+	RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+	void write(const float* samples, unsigned int frameCount);
+	void write(const std::int16_t* samples, unsigned int frameCount);
+	// Device PCM as is; copied straight through when it matches bitsPerSample.
+	void write(const void* pcm, PcmEncoding encoding, unsigned int frameCount);
+	void close();
+
+	std::uint64_t framesWritten() const { return totalFrames; }
+	// Frames covered by the last header checkpoint of the current segment.
+	std::uint64_t framesCheckpointed() const { return checkpointFrames; }
+	std::uint64_t checkpoints() const { return checkpointCount; }
+	int segmentCount() const { return segmentIndex; }
+	const std::string& currentPath() const { return segmentFile; }
+	bool preallocating() const { return reserving; }
+
+private:
+	template <typename T, typename Convert>
+	void append(const T* samples, unsigned int frameCount, Convert convert, std::size_t stride = 1);
+	void openSegment();
+	void closeSegment();
+	void flush();
+	void checkpoint();
+
+	std::string basePath;
+	RecordingOptions options;
+	int numChannels;
+	unsigned int sampleRate;
+	unsigned int blockAlign;
+	std::uint64_t dataOffset = 0;
+	std::uint64_t segmentFrameLimit = 0;   // 0 = no rotation
+	std::uint64_t checkpointInterval = 0;  // frames
+
+	std::unique_ptr<PreallocatedFile> file;
+	std::string segmentFile;
+	int segmentIndex = 0;
+	bool reserving = false;
+	std::uint64_t reservedEnd = 0;
+	std::uint64_t fileEnd = 0;             // bytes handed to the kernel
+	std::uint64_t segmentFrames = 0;
+	std::uint64_t checkpointFrames = 0;
+	std::uint64_t checkpointCount = 0;
+	std::uint64_t totalFrames = 0;
+	std::vector<char> buffer;
+	std::size_t buffered = 0;
+	bool closed = false;
+};
+
+// Brings the header of an interrupted recording up to the file length (RIFF, RF64 or
+// W64), drops a trailing partial frame and releases preallocated space. Returns the
+// number of frames in the file.
+std::uint64_t RecoverRecording(const std::string& path);
+
+// Rotation round trips plus a recording killed mid-stream (a forked child on POSIX, a
+// snapshot of the open file on Windows) that must recover up to its last checkpoint.
+bool CheckRecordingRecovery(const std::string& directory);
@@ -0,0 +1,116 @@
+#include "ReplaySource.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "DirectionPipeline.h"
+
+ReplaySource::ReplaySource(const std::string& path, ReplayOptions options)
+	: reader(path), options(std::move(options)), rngState(this->options.seed * 2654435761u + 1u)
+{
+	unsigned int largest = 0;
+	for (const auto& [frames, weight] : this->options.packetSizes) {
+		if (frames == 0) continue;
+		totalWeight += weight;
+		largest = std::max(largest, frames);
+	}
+	if (totalWeight == 0) {
+		throw std::runtime_error("Distribuicao de tamanhos de pacote vazia");
+	}
+	buffer.resize(static_cast<std::size_t>(largest) * reader.format().channels);
+}
+
+std::uint32_t ReplaySource::nextRandom()
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+unsigned int ReplaySource::drawPacketSize()
+{
+	unsigned int pick = nextRandom() % totalWeight;
+	for (const auto& [frames, weight] : options.packetSizes) {
+		if (frames == 0) continue;
+		if (pick < weight) return frames;
+		pick -= weight;
+	}
+	return options.packetSizes.back().first;
+}
+
+bool ReplaySource::nextPacket(CapturePacket& packet)
+{
+	const unsigned int wanted = drawPacketSize();
+	// Drawn even in fast mode so both modes see the same packet sequence
+	const double jitter = (nextRandom() >> 8) * (1.0 / 16777216.0) * options.jitterMs;
+
+	const unsigned int frames = reader.read(buffer.data(), wanted);
+	if (frames == 0) return false;
+
+	const AudioFormat fmt = reader.format();
+	const std::size_t numSamples = static_cast<std::size_t>(frames) * fmt.channels;
+
+	packet.samples = buffer.data();
+	packet.frameCount = frames;
+	packet.timestampUs = position * 1000000ull / fmt.sampleRate;
+	packet.silent = options.markSilence && std::all_of(buffer.begin(), buffer.begin() + numSamples, [](float x) { return x == 0.0f; });
+	position += frames;
+
+	if (!options.realTime) {
+		packet.readyNs = SteadyNowNs();
+		return true;
+	}
+
+	// The device has the packet once its last frame was played; the driver hands it over after the jitter
+	if (startNs == 0) startNs = SteadyNowNs();
+	packet.readyNs = startNs + position * 1000000000ull / fmt.sampleRate;
+	const auto deliverNs = packet.readyNs + static_cast<std::uint64_t>(jitter * 1e6);
+	const auto now = SteadyNowNs();
+	if (deliverNs > now) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(deliverNs - now));
+	}
+	return true;
+}
+
+void ReportReplayLatency(const std::string& path, const ReplayOptions& options)
+{
+	ReplaySource source(path, options);
+	DirectionPipeline pipeline(source);
+	pipeline.setHardwareCounters(options.hardwareCounters);
+
+	const auto start = SteadyNowNs();
+	pipeline.runToEnd();
+	const double wallSeconds = (SteadyNowNs() - start) / 1e9;
+
+	const PipelineStats& stats = pipeline.stats();
+	const double audioSeconds = static_cast<double>(stats.frames) / source.format().sampleRate;
+
+	std::cout << "Replay de " << path << ": " << stats.packets << " pacotes (" << stats.silentPackets << " silenciosos), "
+		<< audioSeconds << " s de audio em " << wallSeconds << " s\n";
+	std::cout << "  latencia de decisao: ";
+	stats.decisionLatencyUs.print(std::cout, "us");
+	std::cout << "  processamento:       ";
+	stats.processingUs.print(std::cout, "us");
+	if (const StageCounters* counters = pipeline.stageCounters()) {
+		std::cout << "  contadores por etapa:\n";
+		counters->print(std::cout);
+	}
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> ParsePacketSizes(const std::string& spec)
+{
+	std::vector<std::pair<unsigned int, unsigned int>> sizes;
+	std::stringstream items(spec);
+	std::string item;
+	while (std::getline(items, item, ',')) {
+		const auto colon = item.find(':');
+		const auto frames = static_cast<unsigned int>(std::stoul(item.substr(0, colon)));
+		const auto weight = colon == std::string::npos ? 1u : static_cast<unsigned int>(std::stoul(item.substr(colon + 1)));
+		sizes.emplace_back(frames, weight);
+	}
+	return sizes;
+}
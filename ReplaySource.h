@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "WavFile.h"
+
+struct ReplayOptions
+{
+	bool realTime = true;      // false: deliver packets as fast as they are consumed
+	double jitterMs = 0.0;     // real-time only: extra uniform delay per packet, in [0, jitterMs]
+	// Packet sizes in frames with relative weights, drawn per packet. The default
+	// matches the 10 ms packets WASAPI delivers in shared mode at 48 kHz.
+	std::vector<std::pair<unsigned int, unsigned int>> packetSizes = { { 480, 1 } };
+	bool markSilence = true;   // flag all-zero packets as silent, like AUDCLNT_BUFFERFLAGS_SILENT
+	std::uint32_t seed = 1;
+	bool hardwareCounters = false; // ReportReplayLatency: also print per-stage perf counters
+};
+
+// Plays a WAV file (e.g. one written by CaptureAudio) through the CaptureSource
+// interface with device-like packetization. Packet sizes and jitter come from a
+// seeded generator, so a recording always replays as the same packet sequence.
+class ReplaySource : public CaptureSource
+{
+public:
+	ReplaySource(const std::string& path, ReplayOptions options = {});
+
+	AudioFormat format() const override { return reader.format(); }
+	bool nextPacket(CapturePacket& packet) override;
+
+private:
+	unsigned int drawPacketSize();
+	std::uint32_t nextRandom();
+
+	WavReader reader;
+	ReplayOptions options;
+	std::uint32_t rngState;
+	unsigned int totalWeight = 0;
+	std::uint64_t position = 0;
+	std::uint64_t startNs = 0;
+	std::vector<float> buffer;
+};
+
+// Replays the file through DirectionPipeline and prints the decision latency distribution.
+void ReportReplayLatency(const std::string& path, const ReplayOptions& options);
+// Parses "480:8,441:1,960:1" (frames:weight, weight optional) into ReplayOptions::packetSizes.
+std::vector<std::pair<unsigned int, unsigned int>> ParsePacketSizes(const std::string& spec);
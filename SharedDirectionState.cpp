@@ -0,0 +1,504 @@
+#include "SharedDirectionState.h"
+
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "LatencyHistogram.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <ctime>
+#endif
+
+namespace
+{
+	std::size_t segmentBytes(std::uint32_t capacity)
+	{
+		return sizeof(SharedState::Header) + static_cast<std::size_t>(capacity) * sizeof(SharedState::Slot);
+	}
+
+#ifdef _WIN32
+	std::string wakeName(const std::string& name)
+	{
+		return "Local\\" + name + "_wake";
+	}
+#endif
+
+	std::uint32_t currentProcessId()
+	{
+#ifdef _WIN32
+		return static_cast<std::uint32_t>(GetCurrentProcessId());
+#else
+		return static_cast<std::uint32_t>(getpid());
+#endif
+	}
+
+	bool processAlive(std::uint32_t pid)
+	{
+#ifdef _WIN32
+		HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+		if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+		const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+		CloseHandle(process);
+		return alive;
+#else
+		return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+	}
+
+	// A segment is live while it carries our magic and its writer process still runs.
+	// Anything else (crashed writer, half-initialised or foreign contents) may be replaced.
+	bool segmentInUse(const void* data, std::size_t size)
+	{
+		if (size < sizeof(SharedState::Header)) return false;
+		const auto* header = static_cast<const SharedState::Header*>(data);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return header->magic == SharedState::Magic && header->writerPid != 0 && processAlive(header->writerPid);
+	}
+
+#ifndef _WIN32
+	bool segmentInUse(const std::string& fullName)
+	{
+		const int fd = shm_open(fullName.c_str(), O_RDONLY, 0);
+		if (fd < 0) return false;
+		struct stat info {};
+		const std::size_t size = fstat(fd, &info) == 0 ? static_cast<std::size_t>(info.st_size) : 0;
+		void* mapped = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (mapped == MAP_FAILED) return false;
+		const bool inUse = segmentInUse(mapped, size);
+		munmap(mapped, size);
+		return inUse;
+	}
+#endif
+
+#ifdef __linux__
+	// Shared (not FUTEX_PRIVATE) so waiters in other processes are found
+	void futexWait(std::atomic<std::uint32_t>* word, std::uint32_t expected, unsigned int timeoutMs)
+	{
+		timespec timeout{ static_cast<time_t>(timeoutMs / 1000), static_cast<long>(timeoutMs % 1000) * 1000000L };
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+	}
+
+	void futexWakeAll(std::atomic<std::uint32_t>* word)
+	{
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+#endif
+}
+
+SharedMapping::~SharedMapping()
+{
+#ifdef _WIN32
+	if (address) UnmapViewOfFile(address);
+	if (handle) CloseHandle(handle);
+#else
+	if (address) munmap(address, bytes);
+	if (!ownedName.empty()) shm_unlink(ownedName.c_str());
+#endif
+}
+
+void SharedMapping::create(const std::string& name, std::size_t size)
+{
+#ifdef _WIN32
+	const std::string fullName = "Local\\" + name;
+	handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size), fullName.c_str());
+	if (!handle) throw std::runtime_error("Falha ao criar memoria compartilhada " + fullName);
+	const bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+	address = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!address) throw std::runtime_error("Falha ao mapear memoria compartilhada " + fullName);
+	// Windows keeps the mapping while any reader holds it, so a dead writer's segment is reused in place
+	if (existed && segmentInUse(address, size)) {
+		throw std::runtime_error("Memoria compartilhada ja em uso por outro processo: " + fullName);
+	}
+#else
+	const std::string fullName = "/" + name;
+	int fd = shm_open(fullName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		if (segmentInUse(fullName)) {
+			throw std::runtime_error("Memoria compartilhada ja em uso por outro processo: " + fullName);
+		}
+		// Left behind by a crashed writer: readers still mapping it keep the old copy
+		shm_unlink(fullName.c_str());
+		fd = shm_open(fullName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	}
+	if (fd < 0) throw std::runtime_error("Falha ao criar memoria compartilhada " + fullName);
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		::close(fd);
+		shm_unlink(fullName.c_str());
+		throw std::runtime_error("Falha ao dimensionar memoria compartilhada " + fullName);
+	}
+	void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED) {
+		shm_unlink(fullName.c_str());
+		throw std::runtime_error("Falha ao mapear memoria compartilhada " + fullName);
+	}
+	address = mapped;
+	ownedName = fullName;
+#endif
+	bytes = size;
+	std::memset(address, 0, size);
+}
+
+void SharedMapping::open(const std::string& name)
+{
+#ifdef _WIN32
+	const std::string fullName = "Local\\" + name;
+	handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, fullName.c_str());
+	if (!handle) throw std::runtime_error("Memoria compartilhada nao encontrada: " + fullName);
+	address = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!address) throw std::runtime_error("Falha ao mapear memoria compartilhada " + fullName);
+	MEMORY_BASIC_INFORMATION info{};
+	VirtualQuery(address, &info, sizeof(info));
+	bytes = info.RegionSize;
+#else
+	const std::string fullName = "/" + name;
+	const int fd = shm_open(fullName.c_str(), O_RDWR, 0);
+	if (fd < 0) throw std::runtime_error("Memoria compartilhada nao encontrada: " + fullName);
+	struct stat info {};
+	fstat(fd, &info);
+	bytes = static_cast<std::size_t>(info.st_size);
+	void* mapped = bytes > 0 ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if (mapped == MAP_FAILED) throw std::runtime_error("Falha ao mapear memoria compartilhada " + fullName);
+	address = mapped;
+#endif
+}
+
+DirectionStatePublisher::DirectionStatePublisher(const std::string& name, std::uint32_t capacity)
+{
+	if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+		throw std::runtime_error("Capacidade do anel compartilhado deve ser potencia de dois");
+	}
+
+	mapping.create(name, segmentBytes(capacity));
+	header = static_cast<SharedState::Header*>(mapping.data());
+	slots = reinterpret_cast<SharedState::Slot*>(header + 1);
+
+	header->capacity = capacity;
+	header->slotBytes = sizeof(SharedState::Slot);
+	header->version = SharedState::Version;
+	header->writerPid = currentProcessId();
+	// Magic last: readers treat a segment without it as not ready
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = SharedState::Magic;
+
+#ifdef _WIN32
+	event = CreateSemaphoreA(nullptr, 0, LONG_MAX, wakeName(name).c_str());
+#endif
+}
+
+DirectionStatePublisher::~DirectionStatePublisher()
+{
+#ifdef _WIN32
+	if (event) CloseHandle(event);
+#endif
+}
+
+void DirectionStatePublisher::publish(std::uint64_t timestampUs, const DirectionState& state)
+{
+	const std::uint64_t index = header->published.load(std::memory_order_relaxed);
+	SharedState::Slot& slot = slots[index & (header->capacity - 1)];
+
+	const std::uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.direction.store(static_cast<std::uint32_t>(state.direction), std::memory_order_relaxed);
+	slot.azimuthBits.store(std::bit_cast<std::uint32_t>(state.azimuth), std::memory_order_relaxed);
+	slot.confidenceBits.store(std::bit_cast<std::uint32_t>(state.confidence), std::memory_order_relaxed);
+	slot.timestampUs.store(timestampUs, std::memory_order_relaxed);
+	slot.publishedNs.store(SteadyNowNs(), std::memory_order_relaxed);
+
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	header->published.store(index + 1, std::memory_order_seq_cst);
+
+	// Pairs with the waiter count in waitForUpdate: no syscall unless someone sleeps
+	header->wakeWord.fetch_add(1, std::memory_order_seq_cst);
+	if (const std::uint32_t waiting = header->waiters.load(std::memory_order_seq_cst)) {
+#if defined(__linux__)
+		futexWakeAll(&header->wakeWord);
+#elif defined(_WIN32)
+		ReleaseSemaphore(event, static_cast<LONG>(waiting), nullptr);
+#else
+		(void)waiting;
+#endif
+	}
+}
+
+void DirectionStatePublisher::publishQuality(std::uint32_t tier, std::uint32_t changes)
+{
+	header->qualityTier.store(tier, std::memory_order_relaxed);
+	header->tierChanges.store(changes, std::memory_order_relaxed);
+}
+
+std::uint64_t DirectionStatePublisher::published() const
+{
+	return header->published.load(std::memory_order_acquire);
+}
+
+DirectionStateReader::DirectionStateReader(const std::string& name)
+{
+	mapping.open(name);
+	if (mapping.size() < sizeof(SharedState::Header)) {
+		throw std::runtime_error("Memoria compartilhada invalida: " + name);
+	}
+
+	auto* mapped = static_cast<SharedState::Header*>(mapping.data());
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (mapped->magic != SharedState::Magic || mapped->version != SharedState::Version
+		|| mapped->slotBytes != sizeof(SharedState::Slot) || mapping.size() < segmentBytes(mapped->capacity)) {
+		throw std::runtime_error("Versao de memoria compartilhada nao suportada: " + name);
+	}
+	header = mapped;
+	slots = reinterpret_cast<const SharedState::Slot*>(mapped + 1);
+
+#ifdef _WIN32
+	event = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, wakeName(name).c_str());
+#endif
+}
+
+DirectionStateReader::~DirectionStateReader()
+{
+#ifdef _WIN32
+	if (event) CloseHandle(event);
+#endif
+}
+
+std::uint64_t DirectionStateReader::published() const
+{
+	return header->published.load(std::memory_order_acquire);
+}
+
+std::uint32_t DirectionStateReader::qualityTier() const
+{
+	return header->qualityTier.load(std::memory_order_relaxed);
+}
+
+std::uint32_t DirectionStateReader::tierChanges() const
+{
+	return header->tierChanges.load(std::memory_order_relaxed);
+}
+
+bool DirectionStateReader::latest(SharedDirectionSample& out) const
+{
+	// Retry when the writer lapped the slot while it was being read
+	for (;;) {
+		const std::uint64_t count = published();
+		if (count == 0) return false;
+		if (read(count - 1, out)) return true;
+	}
+}
+
+bool DirectionStateReader::read(std::uint64_t index, SharedDirectionSample& out) const
+{
+	const SharedState::Slot& slot = slots[index & (header->capacity - 1)];
+
+	for (;;) {
+		const std::uint64_t count = published();
+		if (index >= count || count - index > header->capacity) return false;
+
+		const std::uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		if (before & 1) continue;
+
+		const std::uint32_t direction = slot.direction.load(std::memory_order_relaxed);
+		const std::uint32_t azimuth = slot.azimuthBits.load(std::memory_order_relaxed);
+		const std::uint32_t confidence = slot.confidenceBits.load(std::memory_order_relaxed);
+		const std::uint64_t timestampUs = slot.timestampUs.load(std::memory_order_relaxed);
+		const std::uint64_t publishedNs = slot.publishedNs.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != before) continue;
+
+		// The slot may hold a newer lap than requested
+		if (published() - index > header->capacity) return false;
+
+		out.index = index;
+		out.timestampUs = timestampUs;
+		out.publishedNs = publishedNs;
+		out.state.direction = static_cast<Direction>(direction);
+		out.state.azimuth = std::bit_cast<float>(azimuth);
+		out.state.confidence = std::bit_cast<float>(confidence);
+		return true;
+	}
+}
+
+std::uint64_t DirectionStateReader::waitForUpdate(std::uint64_t seen, unsigned int timeoutMs) const
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	for (;;) {
+		std::uint64_t count = published();
+		if (count > seen) return count;
+
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0) return count;
+
+		const std::uint32_t word = header->wakeWord.load(std::memory_order_seq_cst);
+		header->waiters.fetch_add(1, std::memory_order_seq_cst);
+		count = header->published.load(std::memory_order_seq_cst);
+		if (count <= seen) {
+#if defined(__linux__)
+			futexWait(&header->wakeWord, word, static_cast<unsigned int>(remaining));
+#elif defined(_WIN32)
+			(void)word;
+			WaitForSingleObject(event, static_cast<DWORD>(remaining));
+#else
+			(void)word;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+		}
+		header->waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+}
+
+#ifdef __linux__
+
+namespace
+{
+	// Every field is derived from the index, so a torn record cannot pass
+	DirectionState expectedState(std::uint64_t index)
+	{
+		DirectionState state;
+		state.direction = static_cast<Direction>(index % 12);
+		state.azimuth = static_cast<float>(index % 360) - 180.0f;
+		state.confidence = static_cast<float>(index % 101) / 100.0f;
+		return state;
+	}
+
+	bool consistent(const SharedDirectionSample& sample)
+	{
+		const DirectionState expected = expectedState(sample.timestampUs);
+		return sample.timestampUs == sample.index && sample.state.direction == expected.direction
+			&& sample.state.azimuth == expected.azimuth && sample.state.confidence == expected.confidence;
+	}
+
+	int runReader(const std::string& name, int id)
+	{
+		DirectionStateReader reader(name);
+		LatencyHistogram wakeNs;
+		std::uint64_t seen = reader.published();
+		std::uint64_t records = 0, lost = 0, torn = 0, disorder = 0, lastIndex = 0;
+		bool finished = false;
+
+		while (!finished) {
+			const std::uint64_t count = reader.waitForUpdate(seen, 2000);
+			if (count == seen) break;
+
+			SharedDirectionSample sample;
+			if (reader.latest(sample) && sample.index == count - 1) {
+				const std::uint64_t now = SteadyNowNs();
+				if (now > sample.publishedNs) wakeNs.record(now - sample.publishedNs);
+			}
+
+			for (std::uint64_t i = seen; i < count; ++i) {
+				if (!reader.read(i, sample)) {
+					++lost;
+					continue;
+				}
+				if (sample.timestampUs == ~0ull) {
+					finished = true;
+					break;
+				}
+				++records;
+				torn += !consistent(sample);
+				disorder += records > 1 && sample.index <= lastIndex;
+				lastIndex = sample.index;
+			}
+			seen = count;
+		}
+
+		// Cost of the hot read
+		SharedDirectionSample sample;
+		constexpr int Reads = 1000000;
+		const std::uint64_t start = SteadyNowNs();
+		for (int i = 0; i < Reads; ++i) reader.latest(sample);
+		const double nsPerRead = static_cast<double>(SteadyNowNs() - start) / Reads;
+
+		std::ostringstream line;
+		line << "  leitor " << id << ": " << records << " registros, " << lost << " sobrescritos, "
+			<< torn << " inconsistentes, " << disorder << " fora de ordem, latest() " << nsPerRead
+			<< " ns, despertar p50 " << wakeNs.percentile(0.5) / 1000.0 << " us p99 "
+			<< wakeNs.percentile(0.99) / 1000.0 << " us\n";
+		std::cout << line.str() << std::flush;
+		return torn == 0 && disorder == 0 && finished ? 0 : 1;
+	}
+}
+
+bool CheckSharedState(int readerCount, double durationSec)
+{
+	const std::string name = "avis_check_" + std::to_string(getpid());
+	DirectionStatePublisher publisher(name, 1024);
+
+	// Flushed before fork so the children do not inherit buffered output
+	std::cout << "1 escritor, " << readerCount << " processos leitores, " << durationSec << " s" << std::endl;
+	std::vector<pid_t> children;
+	for (int i = 0; i < readerCount; ++i) {
+		const pid_t pid = fork();
+		if (pid == 0) {
+			int code = 1;
+			try {
+				code = runReader(name, i);
+			} catch (const std::exception& e) {
+				std::cerr << "Erro no leitor " << i << ": " << e.what() << '\n';
+			}
+			std::cout.flush();
+			_exit(code);
+		}
+		if (pid > 0) children.push_back(pid);
+	}
+
+	// Give the readers time to map the segment before the burst starts
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	std::uint64_t index = 0;
+	const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(durationSec);
+	while (std::chrono::steady_clock::now() < end) {
+		publisher.publish(index, expectedState(index));
+		++index;
+		// ~10 kHz, a hundred times the analyzer's own rate
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	publisher.publish(~0ull, {});
+
+	bool ok = children.size() == static_cast<std::size_t>(readerCount);
+	for (const pid_t pid : children) {
+		int status = 0;
+		waitpid(pid, &status, 0);
+		ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+	std::cout << "  " << index << " registros publicados\n" << (ok ? "OK" : "FALHA") << '\n';
+	return ok;
+}
+
+#else
+
+bool CheckSharedState(int, double)
+{
+	std::cerr << "shm-check so esta disponivel no Linux\n";
+	return false;
+}
+
+#endif
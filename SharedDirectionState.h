@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "Direction.h"
+
+// Shared-memory layout (version 1). Everything is fixed-size and lock-free, so
+// any process mapping the segment can read it without the analyzer's code.
+// Each slot is a seqlock: odd sequence = being written.
+namespace SharedState
+{
+	constexpr std::uint32_t Magic = 0x4D535641; // "AVSM"
+	constexpr std::uint32_t Version = 1;
+
+	struct Slot
+	{
+		std::atomic<std::uint32_t> sequence;
+		std::atomic<std::uint32_t> direction;
+		std::atomic<std::uint32_t> azimuthBits;
+		std::atomic<std::uint32_t> confidenceBits;
+		std::atomic<std::uint64_t> timestampUs;  // stream position
+		std::atomic<std::uint64_t> publishedNs;  // SteadyNowNs() at publish
+		std::uint64_t reserved[4];
+	};
+
+	struct Header
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t capacity;     // slots, power of two
+		std::uint32_t slotBytes;
+		std::atomic<std::uint64_t> published; // records written so far
+		std::atomic<std::uint32_t> wakeWord;  // futex word, bumped on every publish
+		std::atomic<std::uint32_t> waiters;   // readers blocked in waitForUpdate
+		std::atomic<std::uint32_t> qualityTier; // QualityTier of the analysis, 0 = full
+		std::atomic<std::uint32_t> tierChanges;
+		std::uint32_t writerPid;    // process that created the segment
+		std::uint32_t reserved32;
+		std::uint64_t reserved[2];
+	};
+
+	static_assert(sizeof(Slot) == 64, "one slot per cache line");
+	static_assert(sizeof(Header) == 64, "header layout is part of version 1");
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared atomics must be address-free");
+}
+
+struct SharedDirectionSample
+{
+	std::uint64_t index = 0;       // position in the publish sequence
+	std::uint64_t timestampUs = 0;
+	std::uint64_t publishedNs = 0;
+	DirectionState state;
+};
+
+// Platform mapping of a named segment (POSIX shm_open / Windows file mapping).
+class SharedMapping
+{
+public:
+	SharedMapping() = default;
+	~SharedMapping();
+	SharedMapping(const SharedMapping&) = delete;
+	SharedMapping& operator=(const SharedMapping&) = delete;
+
+	// Fails while the segment's writer is still alive; one left by a dead writer is replaced.
+	void create(const std::string& name, std::size_t bytes);
+	void open(const std::string& name);
+
+	void* data() const { return address; }
+	std::size_t size() const { return bytes; }
+
+private:
+	void* address = nullptr;
+	std::size_t bytes = 0;
+	std::string ownedName; // unlinked on destruction when this side created it
+#ifdef _WIN32
+	void* handle = nullptr;
+#endif
+};
+
+// Writer side: owns the segment "name" and publishes each DirectionState into a ring
+// of capacity slots. publish() never blocks or allocates and only makes a syscall
+// when a reader is waiting.
+class DirectionStatePublisher
+{
+public:
+	explicit DirectionStatePublisher(const std::string& name, std::uint32_t capacity = 256);
+	~DirectionStatePublisher();
+
+	void publish(std::uint64_t timestampUs, const DirectionState& state);
+	// Adaptive quality: the tier analysis runs at and how often it changed.
+	void publishQuality(std::uint32_t tier, std::uint32_t changes);
+	std::uint64_t published() const;
+
+private:
+	SharedMapping mapping;
+	SharedState::Header* header = nullptr;
+	SharedState::Slot* slots = nullptr;
+#ifdef _WIN32
+	void* event = nullptr;
+#endif
+};
+
+// Reader side: maps the segment read-only in spirit (it only touches the futex
+// word and waiter count). Reads are a handful of loads, no syscalls.
+class DirectionStateReader
+{
+public:
+	explicit DirectionStateReader(const std::string& name);
+	~DirectionStateReader();
+
+	std::uint64_t published() const;
+	// Most recent record; false when nothing was published yet.
+	bool latest(SharedDirectionSample& out) const;
+	// Record number index; false when it is not written yet or already overwritten.
+	bool read(std::uint64_t index, SharedDirectionSample& out) const;
+	// Tier the writer's analysis runs at (0 = full quality) and its change count.
+	std::uint32_t qualityTier() const;
+	std::uint32_t tierChanges() const;
+	// Blocks until published() > seen or the timeout expires; returns published().
+	std::uint64_t waitForUpdate(std::uint64_t seen, unsigned int timeoutMs) const;
+
+private:
+	SharedMapping mapping;
+	SharedState::Header* header = nullptr;
+	const SharedState::Slot* slots = nullptr;
+#ifdef _WIN32
+	void* event = nullptr;
+#endif
+};
+
+// Linux: forks readerCount processes that block on the futex, check every record
+// they see for tearing and order, and time latest(); the parent publishes for
+// durationSec. Returns false on any torn or out-of-order read.
+bool CheckSharedState(int readerCount, double durationSec);
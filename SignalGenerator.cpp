@@ -0,0 +1,290 @@
+#include "SignalGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "DirectionAnalyzer.h"
+#include "HardwareCounters.h"
+#include "RecordingWriter.h"
+#include "SpeakerLayout.h"
+
+namespace
+{
+	constexpr double Pi = 3.14159265358979323846;
+
+	// xorshift32: unlike <random> distributions it gives identical output on every standard library
+	float nextNoise(std::uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return static_cast<float>(state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+	}
+
+	float wrapAzimuth(float azimuth)
+	{
+		azimuth = std::fmod(azimuth + 180.0f, 360.0f);
+		if (azimuth < 0.0f) azimuth += 360.0f;
+		return azimuth - 180.0f;
+	}
+
+	// Distinct positioned speaker azimuths, sorted; computed once per layout.
+	std::vector<float> sortedPositions(const std::vector<float>& speakerAzimuth)
+	{
+		std::vector<float> positions;
+		for (const float a : speakerAzimuth) {
+			if (!std::isnan(a)) positions.push_back(a);
+		}
+		std::sort(positions.begin(), positions.end());
+		positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+		return positions;
+	}
+
+	// Constant-power pan between the two speakers (by azimuth) surrounding the source.
+	void panGains(const std::vector<float>& speakerAzimuth, const std::vector<float>& positions, float azimuth, float* gains)
+	{
+		const int numChannels = static_cast<int>(speakerAzimuth.size());
+		std::fill(gains, gains + numChannels, 0.0f);
+
+		auto assign = [&](float position, float gain) {
+			int shared = 0;
+			for (const float a : speakerAzimuth) shared += (a == position);
+			for (int ch = 0; ch < numChannels; ++ch) {
+				if (speakerAzimuth[ch] == position) gains[ch] += gain / std::sqrt(static_cast<float>(shared));
+			}
+		};
+
+		if (positions.size() == 1) {
+			assign(positions[0], 1.0f);
+			return;
+		}
+
+		azimuth = wrapAzimuth(azimuth);
+		for (std::size_t i = 0; i < positions.size(); ++i) {
+			const float a = positions[i];
+			float b = (i + 1 < positions.size()) ? positions[i + 1] : positions[0] + 360.0f;
+			float x = azimuth;
+			if (x < a) x += 360.0f;
+			if (x > b) continue;
+
+			const float f = (x - a) / (b - a);
+			assign(a, static_cast<float>(std::cos(f * Pi / 2)));
+			assign(i + 1 < positions.size() ? positions[i + 1] : positions[0], static_cast<float>(std::sin(f * Pi / 2)));
+			return;
+		}
+	}
+}
+
+SignalGenerator::SignalGenerator(AudioFormat format, std::vector<SignalSpec> sources, double durationSec,
+	unsigned int packetFrames, std::uint32_t seed)
+	: audioFormat(format), sources(std::move(sources)),
+	totalFrames(static_cast<std::uint64_t>(durationSec * format.sampleRate)), packetFrames(packetFrames)
+{
+	if (format.channels <= 0 || format.sampleRate == 0 || packetFrames == 0) {
+		throw std::runtime_error("Formato invalido para o gerador de sinais");
+	}
+
+	speakerAzimuth.resize(format.channels);
+	SpeakerAzimuths(format.channels, speakerAzimuth.data());
+	speakerPositions = sortedPositions(speakerAzimuth);
+
+	noiseState.resize(this->sources.size());
+	for (std::size_t i = 0; i < noiseState.size(); ++i) {
+		noiseState[i] = seed * 2654435761u + static_cast<std::uint32_t>(i) * 40503u + 1u;
+	}
+	lowpassState.assign(this->sources.size(), 0.0f);
+	gains.resize(this->sources.size() * format.channels);
+	buffer.resize(static_cast<std::size_t>(packetFrames) * format.channels);
+}
+
+float SignalGenerator::sourceEnvelope(const SignalSpec& spec, double t) const
+{
+	const double local = t - spec.startSec;
+	if (local < 0.0 || local >= spec.durationSec) return 0.0f;
+
+	switch (spec.kind) {
+	case SignalKind::Bursts:
+		return std::fmod(local, 0.4) < 0.1 ? 1.0f : 0.0f;
+	case SignalKind::Footsteps:
+		return static_cast<float>(std::exp(-std::fmod(local, 0.5) / 0.02));
+	default:
+		return 1.0f;
+	}
+}
+
+float SignalGenerator::sourceSample(std::size_t index, double t)
+{
+	const SignalSpec& spec = sources[index];
+	const float envelope = sourceEnvelope(spec, t);
+
+	// Noise is drawn even when silent so a source's samples do not depend on its neighbours' timing
+	const float noise = nextNoise(noiseState[index]);
+	if (envelope == 0.0f) return 0.0f;
+
+	switch (spec.kind) {
+	case SignalKind::Tone:
+		return spec.level * static_cast<float>(std::sin(2.0 * Pi * spec.frequency * (t - spec.startSec)));
+	case SignalKind::Footsteps:
+		lowpassState[index] += 0.15f * (noise - lowpassState[index]);
+		return spec.level * envelope * lowpassState[index] * 4.0f;
+	default:
+		return spec.level * envelope * noise;
+	}
+}
+
+bool SignalGenerator::nextPacket(CapturePacket& packet)
+{
+	if (position >= totalFrames) return false;
+
+	const unsigned int frames = static_cast<unsigned int>(std::min<std::uint64_t>(packetFrames, totalFrames - position));
+	const int numChannels = audioFormat.channels;
+	const double rate = audioFormat.sampleRate;
+	const double midpoint = (position + frames / 2.0) / rate;
+
+	// Gains are updated once per packet; at 10 ms packets a moving source is smooth enough
+	lastTruthActive = false;
+	float loudest = 0.0f;
+	for (std::size_t s = 0; s < sources.size(); ++s) {
+		const SignalSpec& spec = sources[s];
+		const float azimuth = wrapAzimuth(spec.azimuth + spec.azimuthSpeed * static_cast<float>(midpoint - spec.startSec));
+		panGains(speakerAzimuth, speakerPositions, azimuth, gains.data() + s * numChannels);
+
+		const float strength = spec.level * sourceEnvelope(spec, midpoint);
+		if (strength > 0.05f * spec.level && strength > loudest) {
+			loudest = strength;
+			lastTruthActive = true;
+			lastTruthAzimuth = azimuth;
+		}
+	}
+
+	std::fill(buffer.begin(), buffer.begin() + static_cast<std::size_t>(frames) * numChannels, 0.0f);
+	bool silent = true;
+	for (unsigned int i = 0; i < frames; ++i) {
+		const double t = (position + i) / rate;
+		float* frame = buffer.data() + static_cast<std::size_t>(i) * numChannels;
+		for (std::size_t s = 0; s < sources.size(); ++s) {
+			const float x = sourceSample(s, t);
+			if (x == 0.0f) continue;
+			silent = false;
+			const float* g = gains.data() + s * numChannels;
+			for (int ch = 0; ch < numChannels; ++ch) frame[ch] += g[ch] * x;
+		}
+	}
+
+	packet.samples = buffer.data();
+	packet.frameCount = frames;
+	packet.silent = silent;
+	packet.timestampUs = position * 1000000ull / audioFormat.sampleRate;
+
+	position += frames;
+	return true;
+}
+
+std::vector<SignalSpec> MakeScene(const std::string& name)
+{
+	std::vector<SignalSpec> scene;
+
+	if (name == "sweep") {
+		// One full turn every 10 s
+		scene.push_back({ SignalKind::Noise, -180.0f, 36.0f });
+	} else if (name == "footsteps") {
+		const float positions[] = { -90.0f, 90.0f, 180.0f, -45.0f, 45.0f };
+		for (int i = 0; i < 5; ++i) {
+			SignalSpec step{ SignalKind::Footsteps, positions[i] };
+			step.level = 0.8f;
+			step.startSec = 3.0f * i;
+			step.durationSec = 3.0f;
+			scene.push_back(step);
+		}
+	} else if (name == "mixed") {
+		scene.push_back({ SignalKind::Tone, 30.0f, 0.0f, 440.0f, 0.1f });
+		scene.push_back({ SignalKind::Bursts, -110.0f, 0.0f, 0.0f, 0.6f });
+		scene.push_back({ SignalKind::Footsteps, 90.0f, -20.0f, 0.0f, 0.8f });
+	} else if (name == "tones") {
+		scene.push_back({ SignalKind::Tone, -60.0f, 0.0f, 300.0f, 0.4f });
+		scene.push_back({ SignalKind::Tone, 120.0f, 0.0f, 1000.0f, 0.2f });
+	} else {
+		throw std::runtime_error("Cena desconhecida: " + name);
+	}
+	return scene;
+}
+
+void WriteSignalToWav(SignalGenerator& generator, const std::string& path)
+{
+	const AudioFormat format = generator.format();
+	RecordingWriter writer(path, format.channels, format.sampleRate);
+
+	CapturePacket packet;
+	while (generator.nextPacket(packet)) {
+		writer.write(packet.samples, packet.frameCount);
+	}
+	writer.close();
+
+	std::cout << "Gravados " << writer.framesWritten() << " quadros em " << path << '\n';
+}
+
+void BenchmarkAnalyzerOnScene(const std::string& scene, int numChannels, double durationSec)
+{
+	using Clock = std::chrono::steady_clock;
+
+	SignalGenerator generator({ numChannels, 48000 }, MakeScene(scene), durationSec);
+	DirectionAnalyzer analyzer;
+	StageCounters counters;
+
+	double generateSeconds = 0.0;
+	double analyzeSeconds = 0.0;
+	std::uint64_t frames = 0;
+	std::uint64_t active = 0;
+	std::uint64_t lateral = 0;
+	std::uint64_t lateralHits = 0;
+	double errorSum = 0.0;
+
+	CapturePacket packet;
+	while (true) {
+		counters.restart();
+		const auto t0 = Clock::now();
+		if (!generator.nextPacket(packet)) break;
+		const auto t1 = Clock::now();
+		counters.mark(PipelineStage::Capture, packet.frameCount);
+
+		DirectionState state;
+		if (!packet.silent) {
+			state = analyzer.analyzeState(packet.samples, packet.frameCount, numChannels);
+		}
+		const auto t2 = Clock::now();
+		counters.mark(PipelineStage::Analysis, packet.frameCount);
+
+		generateSeconds += std::chrono::duration<double>(t1 - t0).count();
+		analyzeSeconds += std::chrono::duration<double>(t2 - t1).count();
+		frames += packet.frameCount;
+
+		if (!generator.truthActive() || packet.silent) continue;
+
+		const float truth = generator.truthAzimuth();
+		++active;
+		errorSum += std::fabs(wrapAzimuth(state.azimuth - truth));
+
+		// Lateral agreement is only defined away from the front/back axis
+		const double side = std::sin(truth * Pi / 180.0);
+		if (std::fabs(side) > 0.17) {
+			++lateral;
+			lateralHits += (side < 0) == (state.azimuth < 0);
+		}
+	}
+
+	const double audioSeconds = static_cast<double>(frames) / 48000.0;
+	std::cout << "Cena " << scene << ", " << numChannels << " canais, " << audioSeconds << " s de audio\n";
+	std::cout << "  gerador:    " << (generateSeconds > 0 ? audioSeconds / generateSeconds : 0.0) << "x tempo real\n";
+	std::cout << "  analisador: " << (analyzeSeconds > 0 ? audioSeconds / analyzeSeconds : 0.0) << "x tempo real\n";
+	if (active > 0) {
+		std::cout << "  erro medio de azimute: " << errorSum / active << " graus (" << active << " pacotes ativos)\n";
+	}
+	if (lateral > 0) {
+		std::cout << "  acerto lateral: " << 100.0 * lateralHits / lateral << "%\n";
+	}
+	std::cout << "  contadores (captura = gerador):\n";
+	counters.print(std::cout);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CaptureSource.h"
+
+enum class SignalKind : std::uint8_t
+{
+	Noise,      // continuous white noise
+	Tone,       // sine at frequency
+	Bursts,     // 100 ms noise bursts every 400 ms
+	Footsteps   // low-passed clicks with a fast decay, twice per second
+};
+
+struct SignalSpec
+{
+	SignalKind kind = SignalKind::Noise;
+	float azimuth = 0.0f;       // degrees at startSec, 0 = front, negative = left
+	float azimuthSpeed = 0.0f;  // degrees per second, for moving sources
+	float frequency = 440.0f;   // Tone only
+	float level = 0.5f;         // peak amplitude
+	float startSec = 0.0f;
+	float durationSec = 1e9f;
+};
+
+// Deterministic multichannel test signal: every source is panned between the two
+// nearest speakers of the layout with constant-power gains. The same seed always
+// yields the same samples on every platform.
+class SignalGenerator : public CaptureSource
+{
+public:
+	SignalGenerator(AudioFormat format, std::vector<SignalSpec> sources, double durationSec,
+		unsigned int packetFrames = 480, std::uint32_t seed = 1);
+
+	AudioFormat format() const override { return audioFormat; }
+	bool nextPacket(CapturePacket& packet) override;
+
+	// Ground truth for the last packet: azimuth of the loudest active source.
+	bool truthActive() const { return lastTruthActive; }
+	float truthAzimuth() const { return lastTruthAzimuth; }
+
+private:
+	float sourceSample(std::size_t index, double t);
+	float sourceEnvelope(const SignalSpec& spec, double t) const;
+
+	AudioFormat audioFormat;
+	std::vector<SignalSpec> sources;
+	std::uint64_t totalFrames;
+	unsigned int packetFrames;
+	std::uint64_t position = 0;
+
+	std::vector<float> speakerAzimuth;
+	std::vector<float> speakerPositions;
+	std::vector<std::uint32_t> noiseState;
+	std::vector<float> lowpassState;
+	std::vector<float> gains;
+	std::vector<float> buffer;
+
+	bool lastTruthActive = false;
+	float lastTruthAzimuth = 0.0f;
+};
+
+// Named source sets: "sweep", "footsteps", "mixed", "tones".
+std::vector<SignalSpec> MakeScene(const std::string& name);
+
+void WriteSignalToWav(SignalGenerator& generator, const std::string& path);
+// Runs the analyzer on the generator as fast as possible and reports throughput
+// (as a multiple of real time) and how well the reported azimuth follows the truth.
+void BenchmarkAnalyzerOnScene(const std::string& scene, int numChannels, double durationSec);
@@ -0,0 +1,36 @@
+#pragma once
+#include <cmath>
+
+// Nominal speaker azimuths (degrees, 0 = front, negative = left) for the channel
+// orders DirectionAnalyzer understands. Channels without a position (LFE) are NaN.
+inline void SpeakerAzimuths(int numChannels, float* azimuth)
+{
+	const float none = std::nanf("");
+
+	switch (numChannels) {
+	case 1: // Mono
+		azimuth[0] = 0.0f;
+		return;
+	case 2: // Stereo: [L, R]
+		azimuth[0] = -30.0f; azimuth[1] = 30.0f;
+		return;
+	case 4: // Quadraphonic: [FL, FR, RL, RR]
+		azimuth[0] = -45.0f; azimuth[1] = 45.0f; azimuth[2] = -135.0f; azimuth[3] = 135.0f;
+		return;
+	case 5: // 5.0 surround: [FL, FR, FC, RL, RR]
+		azimuth[0] = -30.0f; azimuth[1] = 30.0f; azimuth[2] = 0.0f; azimuth[3] = -110.0f; azimuth[4] = 110.0f;
+		return;
+	case 6: // 5.1 surround: [FL, FR, FC, LFE, RL, RR]
+		azimuth[0] = -30.0f; azimuth[1] = 30.0f; azimuth[2] = 0.0f; azimuth[3] = none; azimuth[4] = -110.0f; azimuth[5] = 110.0f;
+		return;
+	case 8: // 7.1 surround: [FL, FR, FC, LFE, RL, RR, SL, SR]
+		azimuth[0] = -30.0f; azimuth[1] = 30.0f; azimuth[2] = 0.0f; azimuth[3] = none;
+		azimuth[4] = -150.0f; azimuth[5] = 150.0f; azimuth[6] = -90.0f; azimuth[7] = 90.0f;
+		return;
+	default: // Same convention as the analyzer fallback: even channels left, odd right
+		for (int ch = 0; ch < numChannels; ++ch) {
+			azimuth[ch] = (ch % 2 == 0) ? -90.0f : 90.0f;
+		}
+		return;
+	}
+}
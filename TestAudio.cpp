@@ -3,7 +3,11 @@
 #include <vector>
 #include <cmath>
 
-void AnalyzeAudioDirection(const std::string& filePath) {
+#include "DirectionTimeline.h"
+#include "EnergyPyramid.h"
+
+// pyramid, when given, must have been created for a stereo stream at the file's rate.
+void AnalyzeAudioDirection(const std::string& filePath, TimelineWriter* timeline = nullptr, EnergyPyramidBuilder* pyramid = nullptr) {
 
     SF_INFO sfinfo;
     SNDFILE* file = sf_open(filePath.c_str(), SFM_READ, &sfinfo);
@@ -27,6 +31,8 @@ void AnalyzeAudioDirection(const std::string& filePath) {
         sf_count_t framesRead = sf_readf_float(file, audioData.data(), BLOCK_SIZE);
         if (framesRead == 0) break;
 
+        if (pyramid) pyramid->push(audioData.data(), static_cast<unsigned int>(framesRead));
+
         float leftSum = 0.0f;
         float rightSum = 0.0f;
 
@@ -40,6 +46,15 @@ void AnalyzeAudioDirection(const std::string& filePath) {
 
         float balance = (leftSum - rightSum) / (leftSum + rightSum + 1e-6f);
 
+        if (timeline) {
+            DirectionState state;
+            state.direction = balance > 0.1f ? Direction::Left : balance < -0.1f ? Direction::Right : Direction::Center;
+            state.azimuth = -balance * 90.0f;
+            state.confidence = std::fabs(balance);
+            const float bands[2] = { leftSum, rightSum };
+            timeline->append(secondsProcessed * 1000000ull, state, bands);
+        }
+
         std::cout << "Tempo: " << ++secondsProcessed << "s -> ";
         if (balance > 0.1f) {
             std::cout << "Som mais  ESQUERDA (balance = " << balance << ")" << std::endl;
@@ -0,0 +1,406 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CaptureSource.h"
+#include "DirectionPipeline.h"
+#include "SignalGenerator.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define AVIS_TRACE_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define AVIS_TRACE_RDTSC 1
+#endif
+
+namespace
+{
+	constexpr std::size_t RingEvents = std::size_t(1) << 16;
+	const char* const DeadlineMissName = "deadline miss";
+
+	inline std::uint64_t traceTicks()
+	{
+#ifdef AVIS_TRACE_RDTSC
+		return __rdtsc();
+#else
+		return SteadyNowNs();
+#endif
+	}
+
+	// Fields are relaxed atomics so the flight-recorder dump can read a ring the
+	// owning thread is still overwriting; torn slots are rejected by index.
+	struct Event
+	{
+		std::atomic<std::uint64_t> begin{ 0 };
+		std::atomic<std::uint64_t> end{ 0 };
+		std::atomic<const char*> name{ nullptr };
+	};
+
+	struct ThreadRing
+	{
+		std::unique_ptr<Event[]> events{ new Event[RingEvents] };
+		std::atomic<std::uint64_t> head{ 0 }; // written by the owning thread
+		std::atomic<std::uint64_t> tail{ 0 }; // stream mode: advanced by the flusher
+		std::uint32_t tid = 0;
+		std::string name;
+	};
+
+	struct CopiedEvent
+	{
+		std::uint64_t begin;
+		std::uint64_t end;
+		const char* name;
+		std::uint32_t tid;
+	};
+
+	struct Session
+	{
+		std::mutex mutex; // registry, file and flusher state
+		std::vector<std::unique_ptr<ThreadRing>> rings;
+
+		std::atomic<bool> active{ false };
+		TraceMode mode = TraceMode::Stream;
+		std::string path;
+		double flightSeconds = 10.0;
+
+		std::ofstream out;
+		bool firstEvent = true;
+
+		std::thread flusher;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		std::atomic<bool> missRequested{ false };
+		std::uint64_t lastMissDumpNs = 0;
+		int missDumps = 0;
+
+		std::atomic<std::uint64_t> dropped{ 0 };
+		std::uint64_t startTicks = 0;
+		std::uint64_t startNs = 0;
+	};
+
+	Session& session()
+	{
+		static Session s;
+		return s;
+	}
+
+	thread_local ThreadRing* t_ring = nullptr;
+	thread_local std::string t_name; // held until the thread records its first event
+
+	// Created on the first event of an active session, so threads that never
+	// trace do not pay for a ring
+	ThreadRing& threadRing()
+	{
+		if (!t_ring) {
+			Session& s = session();
+			std::lock_guard lock(s.mutex);
+			s.rings.push_back(std::make_unique<ThreadRing>());
+			t_ring = s.rings.back().get();
+			t_ring->tid = static_cast<std::uint32_t>(s.rings.size());
+			t_ring->name = t_name.empty() ? "thread " + std::to_string(t_ring->tid) : std::move(t_name);
+		}
+		return *t_ring;
+	}
+
+	void record(std::uint64_t begin, std::uint64_t end, const char* name)
+	{
+		Session& s = session();
+		ThreadRing& ring = threadRing();
+		const std::uint64_t at = ring.head.load(std::memory_order_relaxed);
+		if (s.mode == TraceMode::Stream && at - ring.tail.load(std::memory_order_acquire) >= RingEvents) {
+			s.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		// Pairs with the acquire fence in copyRecent(): a reader that sees any of these
+		// stores also sees head == at, so it knows the slot is being rewritten
+		std::atomic_thread_fence(std::memory_order_release);
+		Event& event = ring.events[at & (RingEvents - 1)];
+		event.begin.store(begin, std::memory_order_relaxed);
+		event.end.store(end, std::memory_order_relaxed);
+		event.name.store(name, std::memory_order_relaxed);
+		ring.head.store(at + 1, std::memory_order_release);
+	}
+
+	// Ticks to microseconds since the session start, calibrated against steady_clock
+	// over the whole session so far.
+	struct TickConverter
+	{
+		std::uint64_t startTicks;
+		double usPerTick;
+
+		explicit TickConverter(const Session& s)
+			: startTicks(s.startTicks)
+		{
+			const std::uint64_t ticks = traceTicks() - s.startTicks;
+			const std::uint64_t ns = SteadyNowNs() - s.startNs;
+			usPerTick = ticks > 0 ? static_cast<double>(ns) / 1000.0 / static_cast<double>(ticks) : 0.001;
+		}
+
+		double operator()(std::uint64_t ticks) const
+		{
+			return static_cast<double>(static_cast<std::int64_t>(ticks - startTicks)) * usPerTick;
+		}
+	};
+
+	void writeEvent(std::ostream& out, bool& first, const CopiedEvent& event, const TickConverter& convert)
+	{
+		out << (first ? "" : ",\n");
+		first = false;
+		out << std::fixed << std::setprecision(3);
+		if (event.name == DeadlineMissName) {
+			out << "{\"name\":\"" << event.name << "\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << convert(event.begin)
+				<< ",\"pid\":1,\"tid\":" << event.tid << '}';
+		} else {
+			out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"ts\":" << convert(event.begin)
+				<< ",\"dur\":" << convert(event.end) - convert(event.begin) << ",\"pid\":1,\"tid\":" << event.tid << '}';
+		}
+	}
+
+	void writeThreadNames(std::ostream& out, bool& first, const Session& s)
+	{
+		for (const auto& ring : s.rings) {
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->tid
+				<< ",\"args\":{\"name\":\"" << ring->name << "\"}}";
+			first = false;
+		}
+	}
+
+	// Stream mode: everything between tail and head is complete and not overwritten.
+	void drainRings(Session& s)
+	{
+		const TickConverter convert(s);
+		for (const auto& ring : s.rings) {
+			const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+			std::uint64_t at = ring->tail.load(std::memory_order_relaxed);
+			for (; at < head; ++at) {
+				const Event& e = ring->events[at & (RingEvents - 1)];
+				writeEvent(s.out, s.firstEvent, { e.begin.load(std::memory_order_relaxed), e.end.load(std::memory_order_relaxed),
+					e.name.load(std::memory_order_relaxed), ring->tid }, convert);
+			}
+			ring->tail.store(at, std::memory_order_release);
+		}
+		s.out.flush();
+	}
+
+	// Flight-recorder mode: copy whatever the rings still hold, newer than sinceTicks.
+	std::vector<CopiedEvent> copyRecent(const Session& s, std::uint64_t sinceTicks)
+	{
+		std::vector<CopiedEvent> events;
+		for (const auto& ring : s.rings) {
+			const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+			const std::uint64_t first = head > RingEvents ? head - RingEvents : 0;
+			const std::size_t start = events.size();
+			for (std::uint64_t at = first; at < head; ++at) {
+				const Event& e = ring->events[at & (RingEvents - 1)];
+				events.push_back({ e.begin.load(std::memory_order_relaxed), e.end.load(std::memory_order_relaxed),
+					e.name.load(std::memory_order_relaxed), ring->tid });
+			}
+
+			// Slots the owner started rewriting while we copied are dropped
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const std::uint64_t after = ring->head.load(std::memory_order_relaxed);
+			const std::uint64_t valid = after >= RingEvents ? after - RingEvents + 1 : 0;
+			if (valid > first) {
+				const std::size_t skip = static_cast<std::size_t>(std::min(valid - first, head - first));
+				events.erase(events.begin() + static_cast<std::ptrdiff_t>(start), events.begin() + static_cast<std::ptrdiff_t>(start + skip));
+			}
+		}
+		events.erase(std::remove_if(events.begin(), events.end(),
+			[sinceTicks](const CopiedEvent& e) { return !e.name || e.end < sinceTicks; }), events.end());
+		std::sort(events.begin(), events.end(), [](const CopiedEvent& a, const CopiedEvent& b) { return a.begin < b.begin; });
+		return events;
+	}
+
+	bool dumpLocked(Session& s, const std::string& path)
+	{
+		const TickConverter convert(s);
+		const double windowTicks = s.flightSeconds * 1e6 / convert.usPerTick;
+		const std::uint64_t now = traceTicks();
+		const std::uint64_t since = now - std::min<std::uint64_t>(now - s.startTicks, static_cast<std::uint64_t>(windowTicks));
+
+		std::ofstream out(path, std::ios::trunc);
+		if (!out) return false;
+		out << "[\n";
+		bool first = true;
+		for (const CopiedEvent& event : copyRecent(s, since)) writeEvent(out, first, event, convert);
+		writeThreadNames(out, first, s);
+		out << "\n]\n";
+		return static_cast<bool>(out);
+	}
+
+	void flusherLoop()
+	{
+		Session& s = session();
+		std::unique_lock lock(s.mutex);
+		while (!s.stopping) {
+			s.wake.wait_for(lock, std::chrono::milliseconds(100));
+			if (s.mode == TraceMode::Stream) {
+				drainRings(s);
+			} else if (s.missRequested.exchange(false)) {
+				const std::uint64_t now = SteadyNowNs();
+				if (s.missDumps == 0 || now - s.lastMissDumpNs >= static_cast<std::uint64_t>(s.flightSeconds * 1e9)) {
+					const std::string dumpPath = s.path + ".miss" + std::to_string(++s.missDumps) + ".json";
+					if (dumpLocked(s, dumpPath)) std::cout << "Trace gravado apos prazo perdido: " << dumpPath << '\n';
+					s.lastMissDumpNs = now;
+				}
+			}
+		}
+	}
+}
+
+TraceScope::TraceScope(const char* name)
+	: name(name), begin(session().active.load(std::memory_order_relaxed) ? traceTicks() : 0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+	if (begin != 0) record(begin, traceTicks(), name);
+}
+
+void StartTracing(TraceMode mode, const std::string& path, double flightSeconds)
+{
+	StopTracing();
+
+	Session& s = session();
+	{
+		std::lock_guard lock(s.mutex);
+		s.mode = mode;
+		s.path = path;
+		s.flightSeconds = flightSeconds;
+		s.stopping = false;
+		s.firstEvent = true;
+		s.missDumps = 0;
+		s.missRequested = false;
+		s.dropped = 0;
+		s.startTicks = traceTicks();
+		s.startNs = SteadyNowNs();
+
+		// Rings of earlier sessions are emptied; their threads may still be alive
+		for (const auto& ring : s.rings) ring->tail.store(ring->head.load());
+
+		if (mode == TraceMode::Stream) {
+			s.out.open(path, std::ios::trunc);
+			if (!s.out) throw std::runtime_error("Falha ao criar arquivo de trace " + path);
+			s.out << "[\n";
+		}
+	}
+	s.active = true;
+	s.flusher = std::thread(flusherLoop);
+}
+
+void StopTracing()
+{
+	Session& s = session();
+	if (!s.flusher.joinable()) return;
+	s.active = false;
+	{
+		std::lock_guard lock(s.mutex);
+		s.stopping = true;
+	}
+	s.wake.notify_all();
+	s.flusher.join();
+
+	std::lock_guard lock(s.mutex);
+	if (s.mode == TraceMode::Stream) {
+		drainRings(s);
+		writeThreadNames(s.out, s.firstEvent, s);
+		s.out << "\n]\n";
+		s.out.close();
+	} else {
+		dumpLocked(s, s.path);
+	}
+}
+
+bool TracingActive()
+{
+	return session().active.load(std::memory_order_relaxed);
+}
+
+bool DumpFlightRecorder(const std::string& path)
+{
+	Session& s = session();
+	std::lock_guard lock(s.mutex);
+	return s.mode == TraceMode::FlightRecorder && dumpLocked(s, path);
+}
+
+void TraceDeadlineMiss()
+{
+	Session& s = session();
+	if (!s.active.load(std::memory_order_relaxed)) return;
+	const std::uint64_t now = traceTicks();
+	record(now, now, DeadlineMissName);
+	if (s.mode == TraceMode::FlightRecorder) s.missRequested.store(true, std::memory_order_relaxed);
+}
+
+void TraceSetThreadName(const char* name)
+{
+	if (!t_ring) {
+		t_name = name;
+		return;
+	}
+	std::lock_guard lock(session().mutex);
+	t_ring->name = name;
+}
+
+std::uint64_t TraceDroppedEvents()
+{
+	return session().dropped.load();
+}
+
+void BenchmarkTracing(const std::string& path, double durationSec, TraceMode mode)
+{
+	using Clock = std::chrono::steady_clock;
+	constexpr int Scopes = 1000000;
+
+	auto costNs = [] {
+		const auto start = Clock::now();
+		for (int i = 0; i < Scopes; ++i) {
+			TraceScope scope("bench");
+		}
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / Scopes;
+	};
+
+	// Warm the calling thread's ring so registration is not timed
+	threadRing();
+	const double idle = costNs();
+	StartTracing(TraceMode::FlightRecorder, path, durationSec);
+	const double active = costNs();
+	StopTracing();
+
+	std::cout << "Custo por escopo: " << idle << " ns sem sessao, " << active << " ns com sessao ativa\n";
+
+	StartTracing(mode, path, durationSec);
+	TraceSetThreadName("analise");
+	SignalGenerator generator({ 8, 48000 }, MakeScene("mixed"), durationSec);
+	DirectionPipeline pipeline(generator);
+	pipeline.setMultiSource(3);
+	std::uint64_t packets = 0;
+	while (true) {
+		bool more = false;
+		{
+			TraceScope scope("pacote");
+			more = pipeline.step();
+		}
+		if (!more) break;
+		if (++packets == 100 && mode == TraceMode::FlightRecorder) TraceDeadlineMiss();
+	}
+	// Give the flusher one cycle to handle the miss dump
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	StopTracing();
+
+	std::cout << packets << " pacotes analisados, trace em " << path << " (" << TraceDroppedEvents() << " eventos descartados)\n";
+}
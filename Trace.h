@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Scoped hot-path tracing. With AVIS_TRACE undefined every macro below compiles to
+// nothing. With it defined, a scope costs two timestamp reads and three relaxed
+// stores into the calling thread's own ring when a session is active, and one
+// relaxed load when not.
+
+enum class TraceMode : std::uint8_t
+{
+	Stream,         // a background thread drains the rings into the JSON file as it goes
+	FlightRecorder  // rings keep overwriting; the last flightSeconds are dumped on demand or on a deadline miss
+};
+
+// Chrome / Perfetto trace-event JSON ("X" complete events, one tid per traced thread).
+void StartTracing(TraceMode mode, const std::string& path, double flightSeconds = 10.0);
+// Stream: closes the file. FlightRecorder: dumps the last flightSeconds to path.
+void StopTracing();
+bool TracingActive();
+
+// Writes the last flightSeconds of every thread's ring to path.
+bool DumpFlightRecorder(const std::string& path);
+// Requests a flight-recorder dump ("<path>.miss<N>.json") from the background
+// thread; at most one per flightSeconds. Safe to call from the real-time path.
+void TraceDeadlineMiss();
+
+void TraceSetThreadName(const char* name);
+// Events a full ring had to drop in stream mode.
+std::uint64_t TraceDroppedEvents();
+
+class TraceScope
+{
+public:
+	// name must outlive the session (string literals).
+	explicit TraceScope(const char* name);
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* name;
+	std::uint64_t begin;
+};
+
+// Prints the cost of a scope with tracing idle and active, then traces the
+// analyzer on a generated scene into path.
+void BenchmarkTracing(const std::string& path, double durationSec, TraceMode mode);
+
+#ifdef AVIS_TRACE
+#define AVIS_TRACE_JOIN2(a, b) a##b
+#define AVIS_TRACE_JOIN(a, b) AVIS_TRACE_JOIN2(a, b)
+#define AVIS_TRACE_SCOPE(name) TraceScope AVIS_TRACE_JOIN(traceScope, __LINE__)(name)
+#define AVIS_TRACE_THREAD(name) TraceSetThreadName(name)
+#define AVIS_TRACE_DEADLINE_MISS() TraceDeadlineMiss()
+#else
+#define AVIS_TRACE_SCOPE(name) ((void)0)
+#define AVIS_TRACE_THREAD(name) ((void)0)
+#define AVIS_TRACE_DEADLINE_MISS() ((void)0)
+#endif
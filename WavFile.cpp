@@ -0,0 +1,189 @@
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Funo para escrever o cabealho WAV
+void WriteWAVHeader(std::ofstream& file, const WAVHeader& header) {
+    file.write(header.chunkID, 4);
+    file.write(reinterpret_cast<const char*>(&header.chunkSize), 4);
+    file.write(header.format, 4);
+    file.write(header.subchunk1ID, 4);
+    file.write(reinterpret_cast<const char*>(&header.subchunk1Size), 4);
+    file.write(reinterpret_cast<const char*>(&header.audioFormat), 2);
+    file.write(reinterpret_cast<const char*>(&header.numChannels), 2);
+    file.write(reinterpret_cast<const char*>(&header.sampleRate), 4);
+    file.write(reinterpret_cast<const char*>(&header.byteRate), 4);
+    file.write(reinterpret_cast<const char*>(&header.blockAlign), 2);
+    file.write(reinterpret_cast<const char*>(&header.bitsPerSample), 2);
+    file.write(header.subchunk2ID, 4);
+    file.write(reinterpret_cast<const char*>(&header.subchunk2Size), 4);
+}
+
+// Funo para normalizar udio em formato float para PCM de 16 bits
+void NormalizeAudio(const float* input, int16_t* output, size_t numSamples) {
+    for (size_t i = 0; i < numSamples; i++) {
+        float sample = input[i];
+        sample = std::max(-1.0f, std::min(1.0f, sample)); // Limita o valor entre -1.0 e 1.0
+        output[i] = static_cast<int16_t>(sample * 32767.0f); // Converte para PCM de 16 bits
+    }
+}
+
+namespace
+{
+	uint32_t readLE(const unsigned char* p, int bytes)
+	{
+		uint32_t v = 0;
+		for (int i = 0; i < bytes; ++i) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+		return v;
+	}
+}
+
+WavReader::WavReader(const std::string& path)
+	: file(path, std::ios::binary)
+{
+	if (!file.is_open()) {
+		throw std::runtime_error("Erro ao abrir o arquivo WAV: " + path);
+	}
+
+	auto parseFormat = [&](const std::vector<unsigned char>& fmt) {
+		if (fmt.size() < 16) return false;
+		uint32_t tag = readLE(fmt.data(), 2);
+		if (tag == 0xFFFE && fmt.size() >= 26) tag = readLE(fmt.data() + 24, 2); // SubFormat GUID starts with the tag
+		audioFormat.channels = static_cast<int>(readLE(fmt.data() + 2, 2));
+		audioFormat.sampleRate = readLE(fmt.data() + 4, 4);
+		blockAlign = readLE(fmt.data() + 12, 2);
+		bytesPerSample = static_cast<int>(readLE(fmt.data() + 14, 2)) / 8;
+		isFloat = (tag == 3);
+
+		const bool supported = (tag == 1 && bytesPerSample >= 2 && bytesPerSample <= 4) || (isFloat && bytesPerSample == 4);
+		if (!supported || audioFormat.channels <= 0 || blockAlign != static_cast<unsigned>(audioFormat.channels * bytesPerSample)) {
+			throw std::runtime_error("Formato WAV nao suportado: " + path);
+		}
+		return true;
+	};
+
+	// Recordings that are still being written (or were interrupted) can claim more
+	// data than the file holds
+	auto clampToFile = [&] {
+		dataOffset = static_cast<std::uint64_t>(file.tellg());
+		file.seekg(0, std::ios::end);
+		const std::uint64_t fileSize = static_cast<std::uint64_t>(file.tellg());
+		dataBytes = std::min(dataBytes, fileSize - std::min(fileSize, dataOffset));
+		file.seekg(static_cast<std::streamoff>(dataOffset));
+	};
+
+	unsigned char riff[40];
+	if (!file.read(reinterpret_cast<char*>(riff), 12)) {
+		throw std::runtime_error("Arquivo nao e WAV: " + path);
+	}
+
+	bool haveFormat = false;
+	std::vector<unsigned char> fmt;
+	if (std::memcmp(riff, "riff", 4) == 0) {
+		// Sony Wave64: GUID chunk ids, 64-bit sizes that include the 24-byte chunk header,
+		// chunks aligned to 8 bytes
+		static const unsigned char waveGuid[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+		if (!file.read(reinterpret_cast<char*>(riff + 12), 28) || std::memcmp(riff + 24, waveGuid, 16) != 0) {
+			throw std::runtime_error("Arquivo nao e WAV: " + path);
+		}
+		unsigned char chunk[24];
+		while (file.read(reinterpret_cast<char*>(chunk), 24)) {
+			const std::uint64_t size = readLE(chunk + 16, 4) | static_cast<std::uint64_t>(readLE(chunk + 20, 4)) << 32;
+			if (size < 24) break;
+			if (std::memcmp(chunk, "fmt ", 4) == 0 && std::memcmp(chunk + 4, waveGuid + 4, 12) == 0) {
+				fmt.resize(static_cast<size_t>(size - 24));
+				file.read(reinterpret_cast<char*>(fmt.data()), fmt.size());
+				haveFormat = parseFormat(fmt);
+				file.seekg(((size + 7) & ~std::uint64_t(7)) - size, std::ios::cur);
+			} else if (std::memcmp(chunk, "data", 4) == 0 && std::memcmp(chunk + 4, waveGuid + 4, 12) == 0) {
+				if (!haveFormat) break;
+				dataBytes = size - 24;
+				clampToFile();
+				return;
+			} else {
+				file.seekg(static_cast<std::streamoff>(((size + 7) & ~std::uint64_t(7)) - 24), std::ios::cur);
+			}
+		}
+		throw std::runtime_error("WAV sem dados de audio: " + path);
+	}
+
+	const bool rf64 = std::memcmp(riff, "RF64", 4) == 0;
+	if ((!rf64 && std::memcmp(riff, "RIFF", 4) != 0) || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+		throw std::runtime_error("Arquivo nao e WAV: " + path);
+	}
+
+	std::uint64_t ds64DataBytes = 0;
+	unsigned char chunk[8];
+	while (file.read(reinterpret_cast<char*>(chunk), 8)) {
+		const uint32_t size = readLE(chunk + 4, 4);
+
+		if (std::memcmp(chunk, "fmt ", 4) == 0) {
+			fmt.resize(size);
+			file.read(reinterpret_cast<char*>(fmt.data()), size);
+			if (!parseFormat(fmt)) break;
+			haveFormat = true;
+			if (size & 1) file.seekg(1, std::ios::cur);
+		} else if (rf64 && std::memcmp(chunk, "ds64", 4) == 0 && size >= 16) {
+			// RF64 keeps the real RIFF and data sizes here; the 32-bit fields read 0xFFFFFFFF
+			unsigned char ds64[16];
+			file.read(reinterpret_cast<char*>(ds64), 16);
+			ds64DataBytes = readLE(ds64 + 8, 4) | static_cast<std::uint64_t>(readLE(ds64 + 12, 4)) << 32;
+			file.seekg(size - 16 + (size & 1), std::ios::cur);
+		} else if (std::memcmp(chunk, "data", 4) == 0) {
+			if (!haveFormat) break;
+			dataBytes = (rf64 && size == 0xFFFFFFFFu) ? ds64DataBytes : size;
+			clampToFile();
+			return;
+		} else {
+			file.seekg(size + (size & 1), std::ios::cur); // chunks are word aligned
+		}
+	}
+
+	throw std::runtime_error("WAV sem dados de audio: " + path);
+}
+
+unsigned int WavReader::read(float* out, unsigned int frameCount)
+{
+	const std::uint64_t remaining = totalFrames() - framesRead;
+	const auto frames = static_cast<unsigned int>(std::min<std::uint64_t>(frameCount, remaining));
+	if (frames == 0) return 0;
+
+	raw.resize(static_cast<size_t>(frames) * blockAlign);
+	file.read(raw.data(), static_cast<std::streamsize>(raw.size()));
+	const auto got = static_cast<unsigned int>(file.gcount() / blockAlign);
+	framesRead += got;
+
+	const size_t numSamples = static_cast<size_t>(got) * audioFormat.channels;
+	const auto* p = reinterpret_cast<const unsigned char*>(raw.data());
+	if (isFloat) {
+		std::memcpy(out, p, numSamples * sizeof(float));
+	} else if (bytesPerSample == 2) {
+		for (size_t i = 0; i < numSamples; ++i) {
+			out[i] = static_cast<int16_t>(readLE(p + 2 * i, 2)) / 32768.0f;
+		}
+	} else if (bytesPerSample == 3) {
+		for (size_t i = 0; i < numSamples; ++i) {
+			out[i] = static_cast<int32_t>(readLE(p + 3 * i, 3) << 8) / 2147483648.0f;
+		}
+	} else {
+		for (size_t i = 0; i < numSamples; ++i) {
+			out[i] = static_cast<int32_t>(readLE(p + 4 * i, 4)) / 2147483648.0f;
+		}
+	}
+	return got;
+}
+
+void WavReader::rewind()
+{
+	seek(0);
+}
+
+void WavReader::seek(std::uint64_t frame)
+{
+	frame = std::min(frame, totalFrames());
+	file.clear();
+	file.seekg(static_cast<std::streamoff>(dataOffset + frame * blockAlign));
+	framesRead = frame;
+}
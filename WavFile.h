@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CaptureSource.h"
+
+// Estrutura do cabealho WAV
+struct WAVHeader {
+    char chunkID[4] = { 'R', 'I', 'F', 'F' }; // "RIFF"
+    uint32_t chunkSize;                       // Tamanho do arquivo - 8 bytes
+    char format[4] = { 'W', 'A', 'V', 'E' }; // "WAVE"
+    char subchunk1ID[4] = { 'f', 'm', 't', ' ' }; // "fmt "
+    uint32_t subchunk1Size = 16;              // Tamanho do subchunk (16 para PCM)
+    uint16_t audioFormat = 1;                 // Formato de udio (1 para PCM)
+    uint16_t numChannels;                     // Nmero de canais
+    uint32_t sampleRate;                      // Taxa de amostragem
+    uint32_t byteRate;                        // Bytes por segundo
+    uint16_t blockAlign;                      // Alinhamento do bloco
+    uint16_t bitsPerSample;                   // Bits por amostra
+    char subchunk2ID[4] = { 'd', 'a', 't', 'a' }; // "data"
+    uint32_t subchunk2Size;                   // Tamanho dos dados de udio
+};
+
+void WriteWAVHeader(std::ofstream& file, const WAVHeader& header);
+void NormalizeAudio(const float* input, int16_t* output, size_t numSamples);
+
+// L WAV PCM de 16/24/32 bits ou float de 32 bits (tambm WAVE_FORMAT_EXTENSIBLE),
+// convertendo para float intercalado em [-1, 1]. Aceita tambm RF64 e Wave64, e
+// limita o tamanho dos dados ao que o arquivo realmente contm.
+class WavReader
+{
+public:
+	explicit WavReader(const std::string& path);
+
+	AudioFormat format() const { return audioFormat; }
+	std::uint64_t totalFrames() const { return dataBytes / blockAlign; }
+
+	// Returns the number of frames read (0 at end of data).
+	unsigned int read(float* out, unsigned int frameCount);
+	void rewind();
+	void seek(std::uint64_t frame);
+
+private:
+	std::ifstream file;
+	AudioFormat audioFormat;
+	bool isFloat = false;
+	int bytesPerSample = 0;
+	unsigned int blockAlign = 0;
+	std::uint64_t dataOffset = 0;
+	std::uint64_t dataBytes = 0;
+	std::uint64_t framesRead = 0;
+	std::vector<char> raw;
+};
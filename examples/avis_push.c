@@ -0,0 +1,140 @@
+/*
+ * Embedding the analyzer through the C ABI (Linux).
+ *
+ * Build the library and this example from the repository root:
+ *
+ *   g++ -std=c++20 -O2 -shared -fPIC -fvisibility=hidden -finput-charset=latin1 -DAVIS_BUILD_LIBRARY \
+ *       AvisApi.cpp AdaptiveQuality.cpp Ambisonics.cpp BinauralCues.cpp DirectionPipeline.cpp DirectionAnalyzer.cpp \
+ *       GccPhat.cpp Fft.cpp OnsetDetector.cpp MultiSourceLocalizer.cpp MirroredRing.cpp HardwareCounters.cpp Trace.cpp \
+ *       DirectionTimeline.cpp EventStreamServer.cpp SharedDirectionState.cpp SignalGenerator.cpp RecordingWriter.cpp WavFile.cpp \
+ *       RealtimeThread.cpp \
+ *       -o libavis.so -pthread
+ *   cc -std=c99 -O2 -I. examples/avis_push.c -L. -lavis -lm -Wl,-rpath,'$ORIGIN' -o avis_push
+ *   ./avis_push
+ *
+ * Stereo noise pans from left to right and is pushed as interleaved blocks, with
+ * decisions delivered to a callback; then a 5.1 signal moving from front to back
+ * is pushed as planar buffers and polled.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "AvisApi.h"
+
+#define SAMPLE_RATE 48000
+#define BLOCK_FRAMES 480
+#define PI 3.14159265f
+
+static const char* direction_name(int direction)
+{
+	static const char* names[] = { "esquerda", "direita", "centro", "frente-esquerda", "frente", "frente-direita",
+		"centro-esquerda", "centro-direita", "tras-esquerda", "tras", "tras-direita", "desconhecida" };
+	return direction >= 0 && direction <= AVIS_DIRECTION_UNKNOWN ? names[direction] : "?";
+}
+
+static void on_state(void* user, const avis_state* state)
+{
+	int* last = (int*)user;
+	if (state->direction != *last) {
+		printf("  %6.2f s: %s (azimute %.0f, confianca %.2f)\n", state->timestamp_us / 1e6,
+			direction_name(state->direction), state->azimuth, state->confidence);
+		*last = state->direction;
+	}
+}
+
+static int check(avis_status status, const char* what)
+{
+	if (status != AVIS_OK) fprintf(stderr, "%s: %s\n", what, avis_status_string(status));
+	return status == AVIS_OK;
+}
+
+static void print_stats(const avis_analyzer* analyzer)
+{
+	avis_stats stats;
+	stats.struct_size = sizeof(stats);
+	if (!check(avis_get_stats(analyzer, &stats), "avis_get_stats")) return;
+	printf("  %llu chamadas, %llu decisoes, %.0f ns por chamada (p99 %llu ns)\n", (unsigned long long)stats.pushes,
+		(unsigned long long)stats.decisions, stats.mean_push_ns, (unsigned long long)stats.p99_push_ns);
+}
+
+static int stereo_interleaved(void)
+{
+	avis_config config;
+	avis_config_init(&config);
+	config.channels = 2;
+	config.sample_rate = SAMPLE_RATE;
+
+	avis_analyzer* analyzer = NULL;
+	if (!check(avis_create(&config, &analyzer), "avis_create")) return 0;
+	int last = -1;
+	avis_set_callback(analyzer, on_state, &last);
+
+	printf("Estereo intercalado, ruido com panorama da esquerda para a direita:\n");
+	static float block[BLOCK_FRAMES * 2];
+	unsigned int noise = 1;
+	const int blocks = 3 * SAMPLE_RATE / BLOCK_FRAMES;
+	for (int b = 0; b < blocks; ++b) {
+		const float pan = (float)b / (blocks - 1); /* 0 = left, 1 = right */
+		for (int i = 0; i < BLOCK_FRAMES; ++i) {
+			noise = noise * 1664525u + 1013904223u;
+			const float x = ((float)(noise >> 8) / 16777216.0f - 0.5f);
+			block[2 * i] = x * cosf(pan * PI / 2);
+			block[2 * i + 1] = x * sinf(pan * PI / 2);
+		}
+		/* The library reads block in place and is done with it when the call returns */
+		if (!check(avis_push_interleaved(analyzer, block, BLOCK_FRAMES), "avis_push_interleaved")) break;
+	}
+	print_stats(analyzer);
+	avis_destroy(analyzer);
+	return 1;
+}
+
+static int surround_planar(void)
+{
+	avis_config config;
+	avis_config_init(&config);
+	config.channels = 6; /* FL FR FC LFE RL RR */
+	config.sample_rate = SAMPLE_RATE;
+
+	avis_analyzer* analyzer = NULL;
+	if (!check(avis_create(&config, &analyzer), "avis_create")) return 0;
+
+	printf("5.1 planar, da frente para tras:\n");
+	static float planes[6][BLOCK_FRAMES];
+	const float* channels[6];
+	for (int ch = 0; ch < 6; ++ch) channels[ch] = planes[ch];
+
+	const int blocks = 2 * SAMPLE_RATE / BLOCK_FRAMES;
+	int last = -1;
+	for (int b = 0; b < blocks; ++b) {
+		const float back = (float)b / (blocks - 1);
+		for (int i = 0; i < BLOCK_FRAMES; ++i) {
+			const float x = 0.4f * sinf(2.0f * PI * 300.0f * (float)(b * BLOCK_FRAMES + i) / SAMPLE_RATE);
+			planes[0][i] = planes[1][i] = x * (1.0f - back);
+			planes[2][i] = 0.5f * x * (1.0f - back);
+			planes[3][i] = 0.0f;
+			planes[4][i] = planes[5][i] = x * back;
+		}
+		if (!check(avis_push_planar(analyzer, channels, BLOCK_FRAMES), "avis_push_planar")) break;
+
+		avis_state state;
+		state.struct_size = sizeof(state);
+		if (avis_poll(analyzer, &state) && state.direction != last) {
+			printf("  %6.2f s: %s\n", state.timestamp_us / 1e6, direction_name(state.direction));
+			last = state.direction;
+		}
+	}
+	print_stats(analyzer);
+	avis_destroy(analyzer);
+	return 1;
+}
+
+int main(void)
+{
+	if (avis_abi_version() != AVIS_ABI_VERSION) {
+		fprintf(stderr, "libavis incompativel: ABI %u, esperado %d\n", avis_abi_version(), AVIS_ABI_VERSION);
+		return 1;
+	}
+	return stereo_interleaved() && surround_planar() ? 0 : 1;
+}
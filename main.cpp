@@ -1,12 +1,341 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "AdaptiveQuality.h"
+#include "AllocationCounter.h"
+#include "Ambisonics.h"
 #include "AudioCapturer.h"
+#include "AvisApi.h"
+#include "BinauralCues.h"
+#include "CoroutinePipeline.h"
+#include "DirectionPipeline.h"
+#include "DirectionTimeline.h"
+#include "EnergyCache.h"
+#include "EnergyPyramid.h"
+#include "EventStreamServer.h"
+#include "FlacFile.h"
+#include "FrameBus.h"
+#include "GccPhat.h"
+#include "MirroredRing.h"
+#include "MultiSourceLocalizer.h"
+#include "OnsetDetector.h"
 #include "OverlayWindow.h"
+#include "RealtimeThread.h"
+#include "RecordingWriter.h"
+#include "ReplaySource.h"
+#include "SharedDirectionState.h"
+#include "SignalGenerator.h"
+#include "Trace.h"
+#include "WavFile.h"
 
 
-int main()
+// Offline tools: "avis <command> <file> [options...]". Returns false when argv is not a tool invocation.
+static bool RunTool(int argc, char* argv[], int& exitCode)
 {
+	if (argc < 3) return false;
+
+	const std::string command = argv[1];
+	const std::string path = argv[2];
+	auto option = [&](int i, const char* fallback) { return std::string(i < argc ? argv[i] : fallback); };
+
+	try
+	{
+		if (command == "timeline-csv") ExportTimelineCsv(path, std::cout);
+		else if (command == "timeline-json") ExportTimelineJson(path, std::cout);
+		else if (command == "timeline-bench") BenchmarkTimelineReader(path);
+		else if (command == "pyramid") {
+			// pyramid <file.wav> <out.avep> [f32|f16] [cellMs]
+			BuildEnergyPyramid(path, option(3, "energia.avep"), option(4, "f32") == "f16" ? PyramidPrecision::Float16 : PyramidPrecision::Float32,
+				std::stod(option(5, "10")));
+		}
+		else if (command == "pyramid-query") {
+			// pyramid-query <file.avep> <fromSec> <toSec> [columns]
+			QueryEnergyPyramid(path, std::stod(option(3, "0")), std::stod(option(4, "60")), static_cast<unsigned int>(std::stoul(option(5, "0"))));
+		}
+		else if (command == "pyramid-bench") {
+			// pyramid-bench <file.avep> [queries]
+			BenchmarkEnergyPyramid(path, std::stoi(option(3, "10000")));
+		}
+		else if (command == "retune") {
+			// retune <file.wav> [windowSec] [ratio,ratio,...] [frontRearRatio] [lfe|nolfe]
+			std::vector<float> ratios;
+			const std::string list = option(4, "1.1,1.2,1.5,2");
+			for (std::size_t begin = 0; begin < list.size();) {
+				const std::size_t end = std::min(list.find(',', begin), list.size());
+				ratios.push_back(std::stof(list.substr(begin, end - begin)));
+				begin = end + 1;
+			}
+			DecisionParams params;
+			params.frontRearRatio = std::stof(option(5, "1.2"));
+			params.lfeInRear = option(6, "lfe") != "nolfe";
+			RetuneFromCache(path, std::stod(option(3, "1")), ratios, params);
+		}
+		else if (command == "flac-bench") {
+			// flac-bench <file.wav> [threads]
+			BenchmarkFlac(path, std::stoi(option(3, "0")));
+		}
+		else if (command == "record-recover") {
+			// record-recover <file.wav|file.w64>: fixes the header of an interrupted recording
+			std::cout << RecoverRecording(path) << " quadros recuperados em " << path << '\n';
+		}
+		else if (command == "record-check") {
+			// record-check <dir>: rotation round trips and a recording killed mid-stream
+			exitCode = CheckRecordingRecovery(path) ? 0 : 1;
+			return true;
+		}
+		else if (command == "flac-check") {
+			// flac-check <threads>: bit-exact round trip over synthetic edge cases
+			exitCode = CheckFlacRoundTrip(std::stoi(path)) ? 0 : 1;
+			return true;
+		}
+		else if (command == "gen") {
+			// gen <out.wav> [scene] [channels] [seconds] [seed]
+			SignalGenerator generator({ std::stoi(option(4, "2")), 48000 }, MakeScene(option(3, "sweep")),
+				std::stod(option(5, "10")), 480, static_cast<std::uint32_t>(std::stoul(option(6, "1"))));
+			WriteSignalToWav(generator, path);
+		}
+		else if (command == "gen-bench") {
+			// gen-bench <scene> [channels] [seconds]
+			BenchmarkAnalyzerOnScene(path, std::stoi(option(3, "2")), std::stod(option(4, "60")));
+		}
+		else if (command == "capi-bench") {
+			// capi-bench <seconds>: per-call cost of the C ABI against the analyzer itself
+			BenchmarkCApi(std::stod(path));
+		}
+		else if (command == "coro-bench") {
+			// coro-bench <seconds> [channels]: threaded capture/analysis/logger against the single-thread coroutine pipeline
+			BenchmarkCoroutinePipeline(std::stod(path), std::stoi(option(3, "2")));
+		}
+		else if (command == "reframe-bench") {
+			// reframe-bench <seconds>: mirrored ring against memmove compaction, same windows required
+			exitCode = BenchmarkReframer(std::stod(path)) ? 0 : 1;
+			return true;
+		}
+		else if (command == "quality-check") {
+			// quality-check <seconds> [busyThreads]: backlog under CPU contention, fixed vs adaptive quality
+			exitCode = CheckAdaptiveQuality(std::stod(path), std::stoi(option(3, "128"))) ? 0 : 1;
+			return true;
+		}
+		else if (command == "gccphat-bench") {
+			// gccphat-bench <seconds>
+			BenchmarkGccPhat(std::stod(path));
+		}
+		else if (command == "onset-check") {
+			// onset-check <seconds>: gated analysis must still catch every footstep
+			exitCode = CheckOnsetGating(std::stod(path)) ? 0 : 1;
+			return true;
+		}
+		else if (command == "sources") {
+			// sources <file.wav> [threads] [maxSources]: per-frame source peaks as CSV
+			AnalyzeSourcesInFile(path, std::cout, std::stoi(option(3, "4")), std::stoi(option(4, "4")));
+		}
+		else if (command == "ambisonics") {
+			// ambisonics <file.wav> [threads] [fuma|ambix]: B-format azimuth/elevation/diffuseness every 10 ms as CSV
+			AnalyzeAmbisonicsFile(path, std::cout, std::stoi(option(3, "4")), ParseAmbisonicsFormat(option(4, "fuma")));
+		}
+		else if (command == "ambisonics-bench") {
+			// ambisonics-bench <seconds>: accuracy on encoded fields, cost vs quad levels, parallel vs serial
+			exitCode = BenchmarkAmbisonics(std::stod(path)) ? 0 : 1;
+			return true;
+		}
+		else if (command == "hrtf-table") {
+			// hrtf-table <out.avhc> [sampleRate] [frameSize]: binaural cue table from the spherical-head model
+			WriteSphericalHeadCueTable(path, static_cast<unsigned int>(std::stoul(option(3, "48000"))),
+				static_cast<unsigned int>(std::stoul(option(4, "1024"))));
+		}
+		else if (command == "binaural-bench") {
+			// binaural-bench <table.avhc> [seconds]: full-circle accuracy on rendered noise, cost over GCC-PHAT
+			exitCode = BenchmarkBinauralCues(path, std::stod(option(3, "12"))) ? 0 : 1;
+			return true;
+		}
+		else if (command == "pcm-bench") {
+			// pcm-bench <seconds>: level analysis straight on int16/int24/int32 PCM vs float, same energies required
+			exitCode = BenchmarkPcmAnalysis(std::stod(path)) ? 0 : 1;
+			return true;
+		}
+		else if (command == "batch-bench") {
+			// batch-bench <seconds> [streams]: many streams per call with lanes across streams vs one call per stream
+			exitCode = BenchmarkBatchAnalysis(std::stod(path), std::stoi(option(3, "64"))) ? 0 : 1;
+			return true;
+		}
+		else if (command == "sources-bench") {
+			// sources-bench <scene> [channels] [seconds]
+			BenchmarkMultiSource(path, std::stoi(option(3, "8")), std::stod(option(4, "30")));
+		}
+		else if (command == "replay") {
+			// replay <file.wav> [realtime|fast] [jitterMs] [frames:weight,...] [seed] [counters]
+			ReplayOptions options;
+			options.realTime = option(3, "realtime") != "fast";
+			options.jitterMs = std::stod(option(4, "0"));
+			options.packetSizes = ParsePacketSizes(option(5, "480"));
+			options.seed = static_cast<std::uint32_t>(std::stoul(option(6, "1")));
+			options.hardwareCounters = option(7, "") == "counters";
+			ReportReplayLatency(path, options);
+		}
+		else if (command == "rt-bench") {
+			// rt-bench <seconds> [fifo|rr] [priority] [cpus]
+			RealtimeOptions options;
+			options.policy = option(3, "fifo") == "rr" ? SchedulingPolicy::RoundRobin : SchedulingPolicy::Fifo;
+			options.priority = std::stoi(option(4, "10"));
+			options.cpus = ParseCpuList(option(5, ""));
+			options.lockMemory = true;
+			options.prefaultStackBytes = 256 * 1024;
+			BenchmarkSchedulingJitter(options, std::stod(path));
+		}
+		else if (command == "shm-check") {
+			// shm-check <readers> [seconds]: one writer, many reader processes (Linux)
+			exitCode = CheckSharedState(std::stoi(path), std::stod(option(3, "3"))) ? 0 : 1;
+			return true;
+		}
+		else if (command == "events-bench") {
+			// events-bench <clients> [seconds] [events/s]
+			BenchmarkEventStream(std::stoi(path), std::stod(option(3, "5")), static_cast<unsigned int>(std::stoul(option(4, "1000"))));
+		}
+		else if (command == "trace-bench") {
+			// trace-bench <out.json> [seconds] [stream|flight]
+			BenchmarkTracing(path, std::stod(option(3, "5")), option(4, "stream") == "flight" ? TraceMode::FlightRecorder : TraceMode::Stream);
+		}
+		else if (command == "alloc-check") {
+			// alloc-check <seconds>: fails if the steady-state loop touches the heap
+			exitCode = CheckSteadyStateAllocations(std::stod(path), 2.0) ? 0 : 1;
+			return true;
+		}
+		else return false;
+		exitCode = 0;
+	} catch(const std::exception& e)
+	{
+		std::cerr << "Erro: " << e.what() << '\n';
+		exitCode = 1;
+	}
+	return true;
+}
+
+// One loopback stream shared by the analyzer and the WAV recorder, instead of
+// running CaptureAudio next to the analyzer with a second stream.
+static void RunWithRecorder(AudioCapturer& capturer, std::atomic<int>& direction, const std::string& recordPath,
+	const RecordingOptions& recordingOptions, const PipelineOptions& options, const RealtimeOptions& realtime)
+{
+	const AudioFormat format = capturer.format();
+	// Blocks of one device packet or so; the pool holds both queues full plus a block each
+	FrameBus bus(format, 1024, 512);
+	// The overlay only cares about the latest audio. The recorder gets a deep queue (about
+	// 5 s of 10 ms packets) to ride out slow writes, but the capture thread never waits on
+	// it: past that, blocks are dropped and reported.
+	auto analysis = bus.subscribe(16, OverflowPolicy::DropOldest);
+	auto recording = bus.subscribe(480, OverflowPolicy::DropNewest);
+
+	// A ".flac" path is compressed on the encoder pool; the recorder thread only fills blocks
+	const bool compress = recordPath.size() > 5 && recordPath.compare(recordPath.size() - 5, 5, ".flac") == 0;
+	std::unique_ptr<RecordingWriter> wav;
+	std::unique_ptr<FlacWriter> flac;
+	if (compress) flac = std::make_unique<FlacWriter>(recordPath, format.channels, format.sampleRate);
+	else wav = std::make_unique<RecordingWriter>(recordPath, format.channels, format.sampleRate, recordingOptions);
+	std::thread recorder([&] {
+		AVIS_TRACE_THREAD("gravacao");
+		SubscriptionSource source(recording, format);
+		CapturePacket packet;
+		std::uint64_t reportedDrops = 0;
+		while (source.nextPacket(packet)) {
+			AVIS_TRACE_SCOPE("wav");
+			if (flac) flac->write(packet.samples, packet.frameCount);
+			else wav->write(packet.samples, packet.frameCount);
+			if (const std::uint64_t drops = recording->dropped(); drops != reportedDrops) {
+				std::cerr << "Gravacao atrasada: " << drops - reportedDrops << " blocos descartados (total " << drops << ")\n";
+				reportedDrops = drops;
+			}
+		}
+		if (flac) flac->close();
+		else wav->close();
+	});
+	std::thread analyzer([&] {
+		AVIS_TRACE_THREAD("analise");
+		if (realtime.requested()) PrintRealtimeReport(ApplyRealtimeOptions(realtime), "analise");
+		SubscriptionSource source(analysis, format);
+		DirectionPipeline pipeline(source, &direction);
+		pipeline.configure(options);
+		pipeline.setVerbose(true);
+		pipeline.runToEnd();
+		if (const StageCounters* counters = pipeline.stageCounters()) counters->print(std::cout);
+	});
+
+	std::cout << "Captura em tempo real inicializada, gravando em " << recordPath << "...\n";
+	std::atomic<bool> stop = false;
+	PumpSource(capturer, bus, stop);
+
+	recorder.join();
+	analyzer.join();
+	if (recording->dropped() || bus.poolExhausted()) {
+		std::cerr << "Gravacao incompleta: " << recording->dropped() << " blocos descartados, " << bus.poolExhausted()
+			<< " pacotes sem bloco livre\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (int exitCode = 0; RunTool(argc, argv, exitCode)) {
+		return exitCode;
+	}
+
+	std::string timelinePath;
+	std::string recordPath;
+	std::string sharedName;
+	std::string eventsPath;
+	std::string tracePath;
+	TraceMode traceMode = TraceMode::Stream;
+	double traceSeconds = 10.0;
+	int eventsPort = 0;
+	RealtimeOptions realtime;
+	RecordingOptions recording;
+	PipelineOptions options;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--timeline" && hasValue) timelinePath = argv[++i];
+		else if (arg == "--record" && hasValue) {
+			recordPath = argv[++i];
+			recording.container = ContainerForPath(recordPath);
+		}
+		else if (arg == "--segment-sec" && hasValue) recording.segmentSeconds = std::stod(argv[++i]);
+		else if (arg == "--segment-mb" && hasValue) recording.segmentBytes = static_cast<std::uint64_t>(std::stod(argv[++i]) * (1 << 20));
+		else if (arg == "--record-sync") recording.syncCheckpoints = true;
+		else if (arg == "--rt" && hasValue) {
+			realtime.policy = std::string(argv[++i]) == "rr" ? SchedulingPolicy::RoundRobin : SchedulingPolicy::Fifo;
+			realtime.prefaultStackBytes = 256 * 1024;
+		}
+		else if (arg == "--rt-priority" && hasValue) realtime.priority = std::stoi(argv[++i]);
+		else if (arg == "--cpus" && hasValue) realtime.cpus = ParseCpuList(argv[++i]);
+		else if (arg == "--mlock") realtime.lockMemory = true;
+		else if (arg == "--onset-gate") options.onsetGating = true;
+		else if (arg == "--adaptive") options.adaptiveQuality = true;
+		else if (arg == "--window-ms" && hasValue) options.windowMs = std::stof(argv[++i]);
+		else if (arg == "--hop-ms" && hasValue) options.hopMs = std::stof(argv[++i]);
+		else if (arg == "--binaural" && hasValue) options.binauralTable = argv[++i];
+		else if (arg == "--ambisonics" && hasValue) {
+			options.ambisonics = true;
+			options.ambisonicsFormat = ParseAmbisonicsFormat(argv[++i]);
+		}
+		else if (arg == "--sources" && hasValue) options.multiSource = std::stoi(argv[++i]);
+		else if (arg == "--shm" && hasValue) sharedName = argv[++i];
+		else if (arg == "--events" && hasValue) eventsPath = argv[++i];
+		else if (arg == "--events-tcp" && hasValue) eventsPort = std::stoi(argv[++i]);
+		else if (arg == "--trace" && hasValue) tracePath = argv[++i];
+		else if (arg == "--trace-flight" && hasValue) {
+			tracePath = argv[++i];
+			traceMode = TraceMode::FlightRecorder;
+		}
+		else if (arg == "--trace-seconds" && hasValue) traceSeconds = std::stod(argv[++i]);
+		else if (arg == "--counters") options.hardwareCounters = true;
+		else if (arg == "--deadline-ms" && hasValue) options.deadlineUs = static_cast<unsigned int>(std::stod(argv[++i]) * 1000.0);
+	}
+
+	if (!tracePath.empty()) {
+		StartTracing(traceMode, tracePath, traceSeconds);
+	}
+
 	std::atomic g_direction = 0;
 
 	std::thread overlayThread(RunOverlay, std::ref(g_direction));
@@ -14,7 +343,31 @@ int main()
 	try
 	{
 		AudioCapturer capturer(g_direction);
-		capturer.run();
+
+		std::unique_ptr<TimelineWriter> timeline;
+		if (!timelinePath.empty()) {
+			timeline = std::make_unique<TimelineWriter>(timelinePath, capturer.channelCount());
+			options.timeline = timeline.get();
+		}
+
+		std::unique_ptr<DirectionStatePublisher> publisher;
+		if (!sharedName.empty()) {
+			publisher = std::make_unique<DirectionStatePublisher>(sharedName);
+			options.publisher = publisher.get();
+		}
+
+		std::unique_ptr<EventStreamServer> events;
+		if (!eventsPath.empty()) {
+			events = std::make_unique<EventStreamServer>(eventsPath, eventsPort);
+			options.events = events.get();
+		}
+		capturer.setPipelineOptions(options);
+
+		// The capture loop runs on this thread
+		if (realtime.requested()) PrintRealtimeReport(ApplyRealtimeOptions(realtime), "captura");
+
+		if (recordPath.empty()) capturer.run();
+		else RunWithRecorder(capturer, g_direction, recordPath, recording, options, realtime);
 	} catch(const std::exception& e)
 	{
 		std::cerr << "Erro: " << e.what() << '\n';
@@ -24,6 +377,7 @@ int main()
 	if (overlayThread.joinable()) {
 		overlayThread.join();
 	}
+	StopTracing();
 
 	return 0;
 }